@@ -6,6 +6,12 @@
 #include "window.h"
 #include "config.h"
 
+#include "batch.h"
+#include "cryptography.h"
+#include "rekey.h"
+#include "sessioncache.h"
+#include "watch.h"
+
 /**
  * This structure handles data of an application.
  */
@@ -18,6 +24,37 @@ G_DEFINE_TYPE(LockApplication, lock_application, ADW_TYPE_APPLICATION);
 static void lock_application_show_about(GSimpleAction * self,
                                         GVariant * parameter,
                                         LockApplication * app);
+static void lock_application_screensaver_on_changed(GtkApplication * self,
+                                                    GParamSpec * pspec,
+                                                    gpointer user_data);
+static void lock_application_on_shutdown(GApplication * self,
+                                         gpointer user_data);
+
+/* Command line options of the watch and re-key modes */
+static const GOptionEntry lock_application_options[] = {
+    { "watch", 'w', G_OPTION_FLAG_NONE, G_OPTION_ARG_FILENAME, NULL,
+     N_("Encrypt every file that lands in a folder instead of opening a window"),
+     N_("FOLDER") },
+    { "rekey", 0, G_OPTION_FLAG_NONE, G_OPTION_ARG_NONE, NULL,
+     N_("Encrypt the given files for new recipients without re-encrypting their data"),
+     NULL },
+    { "recipient", 'r', G_OPTION_FLAG_NONE, G_OPTION_ARG_STRING_ARRAY, NULL,
+     N_("Name, email or fingerprint of a key to encrypt for, can be repeated when re-keying"),
+     N_("USER-ID") },
+    { "output", 'o', G_OPTION_FLAG_NONE, G_OPTION_ARG_FILENAME, NULL,
+     N_("Folder of the encrypted files, the watched folder by default"),
+     N_("FOLDER") },
+    { "originals", 0, G_OPTION_FLAG_NONE, G_OPTION_ARG_STRING, NULL,
+     N_("What happens to encrypted originals: keep, delete, shred or move"),
+     N_("POLICY") },
+    { "archive", 0, G_OPTION_FLAG_NONE, G_OPTION_ARG_FILENAME, NULL,
+     N_("Folder originals are moved into"), N_("FOLDER") },
+    { "jobs", 'j', G_OPTION_FLAG_NONE, G_OPTION_ARG_INT, NULL,
+     N_("Number of files encrypted at the same time"), N_("NUMBER") },
+    { G_OPTION_REMAINING, 0, G_OPTION_FLAG_NONE, G_OPTION_ARG_FILENAME_ARRAY,
+     NULL, NULL, N_("[FILE…]") },
+    { NULL }
+};
 
 /**
  * This function initializes a LockApplication.
@@ -39,6 +76,200 @@ static void lock_application_init(LockApplication *app)
     g_signal_connect(about_action, "activate",
                      G_CALLBACK(lock_application_show_about), app);
     g_action_map_add_action(G_ACTION_MAP(app), G_ACTION(about_action));
+
+    g_application_add_main_option_entries(G_APPLICATION(app),
+                                          lock_application_options);
+
+    // Wipe remembered session keys when the session locks
+    g_object_set(app, "register-session", true, NULL);
+    g_signal_connect(app, "notify::screensaver-active",
+                     G_CALLBACK(lock_application_screensaver_on_changed),
+                     NULL);
+    g_signal_connect(app, "shutdown",
+                     G_CALLBACK(lock_application_on_shutdown), NULL);
+}
+
+/**
+ * This function wipes the remembered session keys once the screensaver of the session activates.
+ *
+ * @param self https://docs.gtk.org/gobject/signal.Object.notify.html
+ * @param pspec https://docs.gtk.org/gobject/signal.Object.notify.html
+ * @param user_data https://docs.gtk.org/gobject/signal.Object.notify.html
+ */
+static void lock_application_screensaver_on_changed(GtkApplication *self,
+                                                    GParamSpec *pspec,
+                                                    gpointer user_data)
+{
+    (void)pspec;
+    (void)user_data;
+
+    gboolean active = false;
+    g_object_get(self, "screensaver-active", &active, NULL);
+
+    if (active)
+        session_cache_clear();
+}
+
+/**
+ * This function wipes the remembered session keys before the application quits.
+ *
+ * @param self https://docs.gtk.org/gio/signal.Application.shutdown.html
+ * @param user_data https://docs.gtk.org/gio/signal.Application.shutdown.html
+ */
+static void lock_application_on_shutdown(GApplication *self,
+                                         gpointer user_data)
+{
+    (void)self;
+    (void)user_data;
+
+    session_cache_clear();
+}
+
+/**
+ * This function re-keys encrypted files for the recipients given on the command line.
+ *
+ * @param paths Encrypted files, replaced in place
+ * @param recipients User IDs of the new recipients
+ *
+ * @return Exit status
+ */
+static int lock_application_rekey(const char *const *paths,
+                                  const char *const *recipients)
+{
+    if (!rekey_available()) {
+        g_printerr(_("Re-keying needs a build with libgcrypt\n"));
+        return EXIT_FAILURE;
+    }
+    if (recipients == NULL || recipients[0] == NULL) {
+        g_printerr(_("Re-keying needs at least one --recipient\n"));
+        return EXIT_FAILURE;
+    }
+
+    guint count = g_strv_length((gchar **) recipients);
+    gpgme_key_t *keys = g_new0(gpgme_key_t, count + 1);
+    int status = EXIT_SUCCESS;
+
+    for (guint i = 0; i < count; i++) {
+        keys[i] = key_search(recipients[i]);
+
+        if (keys[i] == NULL) {
+            g_printerr(_("Failed to find key for User ID “%s”\n"),
+                       recipients[i]);
+            status = EXIT_FAILURE;
+            goto cleanup;
+        }
+    }
+
+    for (gsize i = 0; paths != NULL && paths[i] != NULL; i++) {
+        GFile *file = g_file_new_for_commandline_arg(paths[i]);
+
+        if (rekey_file(file, NULL, keys)) {
+            g_print(_("Re-keyed %s\n"), paths[i]);
+        } else {
+            g_printerr(_("Failed to re-key %s\n"), paths[i]);
+            status = EXIT_FAILURE;
+        }
+
+        g_object_unref(file);
+        file = NULL;
+    }
+
+ cleanup:
+    for (guint i = 0; i < count; i++)
+        if (keys[i] != NULL)
+            gpgme_key_release(keys[i]);
+
+    g_free(keys);
+    keys = NULL;
+
+    return status;
+}
+
+/**
+ * This function runs the watch or re-key mode if it was requested on the command line.
+ *
+ * @param app https://docs.gtk.org/gio/vfunc.Application.handle_local_options.html
+ * @param options https://docs.gtk.org/gio/vfunc.Application.handle_local_options.html
+ *
+ * @return Exit status, -1 to continue with the GUI
+ */
+static int lock_application_handle_local_options(GApplication *app,
+                                                 GVariantDict *options)
+{
+    (void)app;
+
+    g_autofree const char **recipients = NULL;
+    g_variant_dict_lookup(options, "recipient", "^a&s", &recipients);
+
+    if (g_variant_dict_contains(options, "rekey")) {
+        g_autofree const char **paths = NULL;
+        g_variant_dict_lookup(options, G_OPTION_REMAINING, "^a&ay", &paths);
+
+        return lock_application_rekey(paths, recipients);
+    }
+
+    const char *directory = NULL;
+    if (!g_variant_dict_lookup(options, "watch", "^&ay", &directory))
+        return -1;
+
+    const char *recipient = NULL;
+    const char *output = NULL;
+    const char *originals = "keep";
+    const char *archive = NULL;
+    int jobs = 0;
+
+    if (recipients != NULL && g_strv_length((gchar **) recipients) == 1)
+        recipient = recipients[0];
+    g_variant_dict_lookup(options, "output", "^&ay", &output);
+    g_variant_dict_lookup(options, "originals", "&s", &originals);
+    g_variant_dict_lookup(options, "archive", "^&ay", &archive);
+    g_variant_dict_lookup(options, "jobs", "i", &jobs);
+
+    watch_config config = {
+        .options = {
+                    .compression = COMPRESSION_AUTOMATIC,
+                    // Only Lock can decrypt files compressed by the pipeline
+                    .zstd = false,
+                    },
+        .threads = (jobs > 0) ? (unsigned int)jobs : batch_threads(),
+    };
+
+    if (!watch_originals_parse(originals, &config.originals)) {
+        g_printerr(_("Unknown policy for originals: %s\n"), originals);
+        return EXIT_FAILURE;
+    }
+    if (config.originals == WATCH_ORIGINALS_MOVE && archive == NULL) {
+        g_printerr(_("Moving originals needs --archive\n"));
+        return EXIT_FAILURE;
+    }
+    if (recipient == NULL) {
+        g_printerr(_("Watching a folder needs exactly one --recipient\n"));
+        return EXIT_FAILURE;
+    }
+
+    config.key = key_search(recipient);
+    if (config.key == NULL) {
+        g_printerr(_("Failed to find key for User ID “%s”\n"), recipient);
+        return EXIT_FAILURE;
+    }
+
+    config.directory = g_file_new_for_commandline_arg(directory);
+    if (output != NULL)
+        config.output = g_file_new_for_commandline_arg(output);
+    if (archive != NULL)
+        config.archive = g_file_new_for_commandline_arg(archive);
+
+    int status = watch_run(&config);
+
+    /* Cleanup */
+    g_clear_object(&config.directory);
+    g_clear_object(&config.output);
+    g_clear_object(&config.archive);
+
+    gpgme_key_release(config.key);
+    config.key = NULL;
+
+    return status;
 }
 
 /**
@@ -65,8 +296,6 @@ static void lock_application_activate(GApplication *app)
 static void lock_application_open(GApplication *self, GFile **files,
                                   int n_files, const char *hint)
 {
-    (void)files;
-    (void)n_files;
     (void)hint;
 
     GList *windows;
@@ -75,7 +304,10 @@ static void lock_application_open(GApplication *self, GFile **files,
     windows = gtk_application_get_windows(GTK_APPLICATION(self));
     if (!windows)
         window = lock_window_new(LOCK_APPLICATION(self));
-    window = LOCK_WINDOW(windows->data);
+    else
+        window = LOCK_WINDOW(windows->data);
+
+    lock_window_open(window, files, n_files);
 
     gtk_window_present(GTK_WINDOW(window));
 }
@@ -89,6 +321,8 @@ static void lock_application_class_init(LockApplicationClass *class)
 {
     G_APPLICATION_CLASS(class)->activate = lock_application_activate;
     G_APPLICATION_CLASS(class)->open = lock_application_open;
+    G_APPLICATION_CLASS(class)->handle_local_options =
+        lock_application_handle_local_options;
 }
 
 /**
@@ -0,0 +1,364 @@
+#include "batch.h"
+
+#include <adwaita.h>
+#include <glib/gi18n.h>
+#include <locale.h>
+#include "config.h"
+
+#include <gpgme.h>
+#include <stdbool.h>
+#include <string.h>
+#include "cryptography.h"
+#include "journal.h"
+
+/*
+ * A batch processes many files with the same operation.
+ *
+ * The files are spread over a thread pool, each file running through process_file() on its own.
+ * Status changes are reported on the main context, so callers can update their UI directly.
+ * Resumable batches journal each file, so running the same batch again skips the files already done.
+ * Derived outputs never replace existing files, those files fail instead.
+ */
+
+/**
+ * This structure holds the state shared by the files of a batch.
+ */
+typedef struct {
+    cryptography_flags flags;
+    gpgme_key_t key;
+    const cryptography_options *options;
+    GFile *directory;
+    journal *journal; /**< NULL if the batch is not resumable */
+
+    batch_status_func func;
+    gpointer user_data;
+
+    gint failed; /**< Number of failed files, accessed atomically */
+} batch_context;
+
+/**
+ * This structure holds a status change to report on the main context.
+ */
+typedef struct {
+    batch_job *job;
+    batch_status status;
+
+    batch_status_func func;
+    gpointer user_data;
+} batch_update;
+
+/**
+ * This function creates a file of a batch.
+ *
+ * @param input File to process. Referenced by the job
+ * @param data Data of the caller
+ *
+ * @return Job. Free with batch_job_free()
+ */
+batch_job *batch_job_new(GFile *input, gpointer data)
+{
+    batch_job *job = g_new0(batch_job, 1);
+    job->input = g_object_ref(input);
+    job->data = data;
+
+    return job;
+}
+
+/**
+ * This function frees a file of a batch.
+ *
+ * @param job Job to free
+ */
+void batch_job_free(batch_job *job)
+{
+    g_clear_object(&job->input);
+    g_clear_object(&job->output);
+    g_clear_object(&job->destination);
+    cryptography_options_clear(&job->options);
+
+    g_free(job);
+}
+
+/**
+ * This function derives the output file of a file processed in a batch.
+ *
+ * Encrypted and signed files get BATCH_SUFFIX, which decryption and verification remove again.
+ * Files without a known suffix get “.out” appended instead of overwriting the input.
+ *
+ * @param input Input file
+ * @param directory Directory of the output. NULL for the directory of the input
+ * @param flags Operation of the batch
+ *
+ * @return Output file. Owned by caller
+ */
+GFile *batch_output_file(GFile *input, GFile *directory,
+                         cryptography_flags flags)
+{
+    static const char *suffixes[] = { BATCH_SUFFIX, ".pgp", ".asc" };
+
+    gchar *basename = g_file_get_basename(input);
+    gchar *name = NULL;
+
+    if (flags & (ENCRYPT | SIGN)) {
+        name = g_strconcat(basename, BATCH_SUFFIX, NULL);
+    } else {
+        for (gsize i = 0; name == NULL && i < G_N_ELEMENTS(suffixes); i++) {
+            gsize length = strlen(basename);
+            gsize suffix = strlen(suffixes[i]);
+
+            if (length > suffix
+                && g_ascii_strcasecmp(basename + length - suffix,
+                                      suffixes[i]) == 0)
+                name = g_strndup(basename, length - suffix);
+        }
+
+        if (name == NULL)
+            name = g_strconcat(basename, ".out", NULL);
+    }
+
+    GFile *parent = (directory != NULL) ? g_object_ref(directory) :
+        g_file_get_parent(input);
+    GFile *output = g_file_get_child(parent, name);
+
+    /* Cleanup */
+    g_object_unref(parent);
+    parent = NULL;
+
+    g_free(basename);
+    basename = NULL;
+
+    g_free(name);
+    name = NULL;
+
+    return output;
+}
+
+/**
+ * This function hashes the content of a file.
+ *
+ * @param file File to hash
+ *
+ * @return Hexadecimal SHA-256 digest. NULL on failure. Owned by caller
+ */
+gchar *batch_checksum(GFile *file)
+{
+    g_autoptr(GError) error = NULL;
+    GFileInputStream *stream = g_file_read(file, NULL, &error);
+    if (stream == NULL) {
+        g_warning(_("Failed to read file: %s"), error->message);
+        return NULL;
+    }
+
+    GChecksum *checksum = g_checksum_new(G_CHECKSUM_SHA256);
+    guint8 *buffer = g_malloc(BATCH_BUFFER_SIZE);
+    gchar *hash = NULL;
+
+    gssize count;
+    while ((count = g_input_stream_read(G_INPUT_STREAM(stream), buffer,
+                                        BATCH_BUFFER_SIZE, NULL,
+                                        &error)) > 0)
+        g_checksum_update(checksum, buffer, count);
+
+    if (count == 0)
+        hash = g_strdup(g_checksum_get_string(checksum));
+    else
+        g_warning(_("Failed to read file: %s"), error->message);
+
+    /* Cleanup */
+    g_free(buffer);
+    buffer = NULL;
+
+    g_checksum_free(checksum);
+    checksum = NULL;
+
+    g_object_unref(stream);
+    stream = NULL;
+
+    return hash;
+}
+
+/**
+ * This function returns the default number of files processed at the same time.
+ *
+ * @return Number of threads
+ */
+unsigned int batch_threads()
+{
+    return MAX(g_get_num_processors(), 1);
+}
+
+/**
+ * This function reports the status of a file on the main context.
+ *
+ * @param update Status change. Freed by the function
+ *
+ * @return https://docs.gtk.org/glib/func.idle_add.html
+ */
+static gboolean batch_update_dispatch(batch_update *update)
+{
+    update->func(update->job, update->status, update->user_data);
+
+    g_free(update);
+
+    /* Only execute once */
+    return false;               // https://docs.gtk.org/glib/func.idle_add.html
+}
+
+/**
+ * This function queues a status report of a file.
+ *
+ * @param context State of the batch
+ * @param job File that changed its status
+ * @param status New status
+ */
+static void batch_update_queue(batch_context *context, batch_job *job,
+                               batch_status status)
+{
+    if (context->func == NULL)
+        return;
+
+    batch_update *update = g_new0(batch_update, 1);
+    update->job = job;
+    update->status = status;
+    update->func = context->func;
+    update->user_data = context->user_data;
+
+    g_idle_add((GSourceFunc) batch_update_dispatch, update);
+}
+
+/**
+ * This function processes a file of a batch on a thread of the pool.
+ *
+ * @param job File to process
+ * @param context State of the batch
+ */
+static void batch_job_process(batch_job *job, batch_context *context)
+{
+    batch_update_queue(context, job, BATCH_PROCESSING);
+
+    job->resumed = false;
+    job->exists = false;
+
+    g_clear_object(&job->output);
+    job->output = (job->destination != NULL) ?
+        g_object_ref(job->destination) :
+        batch_output_file(job->input, context->directory, context->flags);
+
+    guint64 size = 0;
+    guint64 modified = 0;
+    bool journaled = context->journal != NULL
+        && journal_stamp(job->input, &size, &modified);
+
+    if (journaled
+        && journal_resume(context->journal, job->input, job->output, size,
+                          modified)) {
+        job->resumed = true;
+        job->success = true;
+
+        batch_update_queue(context, job, BATCH_SUCCEEDED);
+        return;
+    }
+
+    /* Files next to the input were not chosen by the user, e.g. “report.pdf” when decrypting “report.pdf.gpg” */
+    if (job->destination == NULL && g_file_query_exists(job->output, NULL)) {
+        job->exists = true;
+        job->success = false;
+        g_atomic_int_inc(&context->failed);
+
+        batch_update_queue(context, job, BATCH_FAILED);
+        return;
+    }
+
+    cryptography_options_clear(&job->options);
+    if (context->options != NULL) {
+        job->options = *context->options;
+        job->options.cipher = NULL;
+        job->options.signature_issue = NULL;
+        job->options.signature = NULL;
+    }
+
+    bool success = process_file(job->input, job->output, context->flags,
+                                context->key,
+                                (context->options != NULL) ? &job->options :
+                                NULL);
+    if (!success)
+        g_atomic_int_inc(&context->failed);
+
+    job->success = success;
+
+    if (journaled) {
+        gchar *checksum = success ? batch_checksum(job->output) : NULL;
+        journal_record(context->journal, job->input, job->output, size,
+                       modified, checksum);
+
+        g_free(checksum);
+        checksum = NULL;
+    }
+
+    batch_update_queue(context, job, success ? BATCH_SUCCEEDED : BATCH_FAILED);
+}
+
+/**
+ * This function processes the files of a batch and blocks until all of them are done.
+ *
+ * @param jobs Files to process, elements are batch_job
+ * @param flags Operation to perform on each file
+ * @param key Key to encrypt for. Can be NULL for other operations
+ * @param options Parameters of the operation. Can be NULL
+ * @param directory Directory of the outputs. NULL to write each output next to its input
+ * @param threads Number of files processed at the same time
+ * @param resumable Whether to journal the batch and skip files a previous run of it completed
+ * @param func Function to report status changes to. Can be NULL
+ * @param user_data Data passed to func
+ *
+ * @return Number of failed files
+ */
+unsigned int batch_process(GPtrArray *jobs, cryptography_flags flags,
+                           gpgme_key_t key,
+                           const cryptography_options *options,
+                           GFile *directory, unsigned int threads,
+                           bool resumable, batch_status_func func,
+                           gpointer user_data)
+{
+    batch_context context = {
+        .flags = flags,
+        .key = key,
+        .options = options,
+        .directory = directory,
+        .journal =
+            resumable ? journal_open(jobs, flags, key, directory) : NULL,
+        .func = func,
+        .user_data = user_data,
+        .failed = 0,
+    };
+
+    g_autoptr(GError) error = NULL;
+    GThreadPool *pool =
+        g_thread_pool_new((GFunc) batch_job_process, &context, MAX(threads, 1),
+                          false, &error);
+    if (pool == NULL)
+        g_warning(_("Failed to create batch thread pool: %s"), error->message);
+
+    for (guint i = 0; i < jobs->len; i++) {
+        batch_job *job = g_ptr_array_index(jobs, i);
+
+        batch_update_queue(&context, job, BATCH_QUEUED);
+
+        /* Falls back to processing the files one after another */
+        if (pool == NULL || !g_thread_pool_push(pool, job, NULL))
+            batch_job_process(job, &context);
+    }
+
+    /* Cleanup */
+    if (pool != NULL)
+        g_thread_pool_free(pool, false, true);
+    pool = NULL;
+
+    unsigned int failed = g_atomic_int_get(&context.failed);
+
+    if (context.journal != NULL)
+        journal_close(context.journal, failed == 0);
+    context.journal = NULL;
+
+    return failed;
+}
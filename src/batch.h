@@ -0,0 +1,56 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <gio/gio.h>
+#include <glib.h>
+#include <gpgme.h>
+
+#include <stdbool.h>
+#include "cryptography.h"
+
+/* Suffix of files encrypted or signed in a batch */
+#define BATCH_SUFFIX ".gpg"
+
+/* Size of the reads when hashing a file */
+#define BATCH_BUFFER_SIZE (256 * 1024)
+
+typedef enum {
+    BATCH_QUEUED,
+    BATCH_PROCESSING,
+    BATCH_SUCCEEDED,
+    BATCH_FAILED
+} batch_status;
+
+/**
+ * This structure holds a file of a batch.
+ */
+typedef struct {
+    GFile *input;
+    GFile *output; /**< Derived from the input when the batch is processed */
+    GFile *destination; /**< Output chosen by the caller. NULL to derive the output */
+    bool success; /**< Set once the file is processed */
+    bool resumed; /**< Skipped because a previous run of the batch completed it */
+    bool exists; /**< Skipped because the derived output already exists */
+    cryptography_options options; /**< Details of the operation on the file */
+    gpointer data; /**< Data of the caller, e.g. the row showing the status */
+} batch_job;
+
+/* Called on the main context whenever a file changes its status */
+typedef void (*batch_status_func)(batch_job * job, batch_status status,
+                                  gpointer user_data);
+
+batch_job *batch_job_new(GFile * input, gpointer data);
+void batch_job_free(batch_job * job);
+
+GFile *batch_output_file(GFile * input, GFile * directory,
+                         cryptography_flags flags);
+gchar *batch_checksum(GFile * file);
+unsigned int batch_threads();
+unsigned int batch_process(GPtrArray * jobs, cryptography_flags flags,
+                           gpgme_key_t key,
+                           const cryptography_options * options,
+                           GFile * directory, unsigned int threads,
+                           bool resumable, batch_status_func func,
+                           gpointer user_data);
+
+#endif                          // BATCH_H
@@ -0,0 +1,687 @@
+#include "benchmark.h"
+
+#include <adwaita.h>
+#include <glib/gi18n.h>
+#include <glib/gstdio.h>
+#include <locale.h>
+#include "config.h"
+
+#include <gpgme.h>
+#include <stdbool.h>
+#include <string.h>
+
+#define BENCHMARK_USERID "Lock Benchmark <benchmark@localhost>"
+#define BENCHMARK_PAYLOAD_SIZE 1024
+#define BENCHMARK_DURATION (G_USEC_PER_SEC / 2)
+#define BENCHMARK_MIN_ITERATIONS 3
+#define BENCHMARK_BULK_SIZE (16 * 1024 * 1024)
+
+#define BENCHMARK_FLAGS (GPGME_CREATE_NOPASSWD | GPGME_CREATE_NOEXPIRE)
+
+/**
+ * This function frees a benchmark result.
+ *
+ * @param result Result to free
+ */
+void benchmark_result_free(benchmark_result *result)
+{
+    if (result == NULL)
+        return;
+
+    g_free(result->algorithm);
+    g_free(result->cipher);
+    g_free(result);
+}
+
+/**
+ * This function prints a warning for a failed GPGME operation of a benchmark.
+ *
+ * @param operation Translated description of the operation
+ * @param error Error of the operation
+ */
+static void benchmark_warning(const char *operation, gpgme_error_t error)
+{
+    g_warning(C_
+              ("Error message constructor for failed GPGME operations",
+               "Failed to %s: %s"), operation, gpgme_strerror(error));
+}
+
+/**
+ * This function creates a GPGME context that uses a separate GnuPG home directory.
+ *
+ * @param home Path of the GnuPG home directory
+ *
+ * @return GPGME context or NULL. Owned by caller
+ */
+static gpgme_ctx_t benchmark_context(const char *home)
+{
+    gpgme_ctx_t context;
+    gpgme_error_t error;
+
+    error = gpgme_new(&context);
+    if (error) {
+        benchmark_warning(C_("GPGME Error", "create new GPGME context"), error);
+        return NULL;
+    }
+
+    error = gpgme_set_protocol(context, GPGME_PROTOCOL_OpenPGP);
+    if (!error)
+        error =
+            gpgme_ctx_set_engine_info(context, GPGME_PROTOCOL_OpenPGP, NULL,
+                                      home);
+    if (error) {
+        benchmark_warning(C_
+                          ("GPGME Error",
+                           "set up GPGME context for the benchmark"), error);
+
+        gpgme_release(context);
+        return NULL;
+    }
+
+    return context;
+}
+
+/**
+ * This function fetches a key that was just generated.
+ *
+ * @param context GPGME context
+ * @param fingerprint Fingerprint of the primary key
+ *
+ * @return Key or NULL. Owned by caller
+ */
+static gpgme_key_t benchmark_get_key(gpgme_ctx_t context,
+                                     const char *fingerprint)
+{
+    gpgme_key_t key;
+    gpgme_error_t error;
+
+    error = gpgme_get_key(context, fingerprint, &key, 1);
+    if (error) {
+        benchmark_warning(C_("GPGME Error", "find generated GPG key"), error);
+        return NULL;
+    }
+
+    return key;
+}
+
+/**
+ * This function fetches the primary key generated by the last operation of a context.
+ *
+ * @param context GPGME context
+ *
+ * @return Key or NULL. Owned by caller
+ */
+static gpgme_key_t benchmark_get_generated_key(gpgme_ctx_t context)
+{
+    gpgme_genkey_result_t generated = gpgme_op_genkey_result(context);
+    if (generated == NULL || generated->fpr == NULL)
+        return NULL;
+
+    return benchmark_get_key(context, generated->fpr);
+}
+
+/**
+ * This function measures the rate of signatures and verifications of a key.
+ *
+ * @param context GPGME context
+ * @param key Signing key
+ * @param result Result to store the rates in
+ *
+ * @return Success
+ */
+static bool benchmark_sign(gpgme_ctx_t context, gpgme_key_t key,
+                           benchmark_result *result)
+{
+    gpgme_data_t input;
+    gpgme_data_t output;
+    gpgme_error_t error;
+
+    char payload[BENCHMARK_PAYLOAD_SIZE] = { 0 };
+    char *signature = NULL;
+    size_t signature_length = 0;
+
+    gpgme_signers_clear(context);
+    error = gpgme_signers_add(context, key);
+    if (error) {
+        benchmark_warning(C_("GPGME Error", "add signer"), error);
+        return false;
+    }
+
+    // Sign
+    gint64 start = g_get_monotonic_time();
+    int iterations = 0;
+    do {
+        error = gpgme_data_new_from_mem(&input, payload, sizeof(payload), 0);
+        if (!error) {
+            error = gpgme_data_new(&output);
+            if (!error) {
+                error =
+                    gpgme_op_sign(context, input, output,
+                                  GPGME_SIG_MODE_DETACH);
+
+                gpgme_free(signature);
+                signature =
+                    gpgme_data_release_and_get_mem(output, &signature_length);
+            }
+            gpgme_data_release(input);
+        }
+
+        if (error) {
+            benchmark_warning(C_("GPGME Error", "sign GPGME data from memory"),
+                              error);
+
+            gpgme_free(signature);
+            return false;
+        }
+
+        iterations++;
+    } while (iterations < BENCHMARK_MIN_ITERATIONS
+             || g_get_monotonic_time() - start < BENCHMARK_DURATION);
+
+    result->sign = iterations * (double)G_USEC_PER_SEC /
+        (g_get_monotonic_time() - start);
+
+    // Verify
+    start = g_get_monotonic_time();
+    iterations = 0;
+    do {
+        gpgme_data_t signed_text;
+
+        error = gpgme_data_new_from_mem(&input, signature, signature_length, 0);
+        if (!error) {
+            error =
+                gpgme_data_new_from_mem(&signed_text, payload, sizeof(payload),
+                                        0);
+            if (!error) {
+                error = gpgme_op_verify(context, input, signed_text, NULL);
+                gpgme_data_release(signed_text);
+            }
+            gpgme_data_release(input);
+        }
+
+        if (error) {
+            benchmark_warning(C_
+                              ("GPGME Error", "verify GPGME data from memory"),
+                              error);
+
+            gpgme_free(signature);
+            return false;
+        }
+
+        iterations++;
+    } while (iterations < BENCHMARK_MIN_ITERATIONS
+             || g_get_monotonic_time() - start < BENCHMARK_DURATION);
+
+    result->verify = iterations * (double)G_USEC_PER_SEC /
+        (g_get_monotonic_time() - start);
+
+    /* Cleanup */
+    gpgme_free(signature);
+    signature = NULL;
+
+    return true;
+}
+
+/**
+ * This function measures the rate of encryptions and decryptions to a key.
+ *
+ * @param context GPGME context
+ * @param key Key whose newest encryption subkey is measured
+ * @param result Result to store the rates in
+ *
+ * @return Success
+ */
+static bool benchmark_encrypt(gpgme_ctx_t context, gpgme_key_t key,
+                              benchmark_result *result)
+{
+    gpgme_data_t input;
+    gpgme_data_t output;
+    gpgme_error_t error;
+
+    char payload[BENCHMARK_PAYLOAD_SIZE] = { 0 };
+    char *ciphertext = NULL;
+    size_t ciphertext_length = 0;
+
+    // Encrypt
+    gint64 start = g_get_monotonic_time();
+    int iterations = 0;
+    do {
+        error = gpgme_data_new_from_mem(&input, payload, sizeof(payload), 0);
+        if (!error) {
+            error = gpgme_data_new(&output);
+            if (!error) {
+                error = gpgme_op_encrypt(context, (gpgme_key_t[]) {
+                                         key, NULL}
+                                         , GPGME_ENCRYPT_ALWAYS_TRUST, input,
+                                         output);
+
+                gpgme_free(ciphertext);
+                ciphertext =
+                    gpgme_data_release_and_get_mem(output, &ciphertext_length);
+            }
+            gpgme_data_release(input);
+        }
+
+        if (error) {
+            benchmark_warning(C_
+                              ("GPGME Error", "encrypt GPGME data from memory"),
+                              error);
+
+            gpgme_free(ciphertext);
+            return false;
+        }
+
+        iterations++;
+    } while (iterations < BENCHMARK_MIN_ITERATIONS
+             || g_get_monotonic_time() - start < BENCHMARK_DURATION);
+
+    result->encrypt_rate = iterations * (double)G_USEC_PER_SEC /
+        (g_get_monotonic_time() - start);
+
+    // Decrypt
+    start = g_get_monotonic_time();
+    iterations = 0;
+    do {
+        error =
+            gpgme_data_new_from_mem(&input, ciphertext, ciphertext_length, 0);
+        if (!error) {
+            error = gpgme_data_new(&output);
+            if (!error) {
+                error = gpgme_op_decrypt(context, input, output);
+                gpgme_data_release(output);
+            }
+            gpgme_data_release(input);
+        }
+
+        if (error) {
+            benchmark_warning(C_
+                              ("GPGME Error", "decrypt GPGME data from memory"),
+                              error);
+
+            gpgme_free(ciphertext);
+            return false;
+        }
+
+        iterations++;
+    } while (iterations < BENCHMARK_MIN_ITERATIONS
+             || g_get_monotonic_time() - start < BENCHMARK_DURATION);
+
+    result->decrypt_rate = iterations * (double)G_USEC_PER_SEC /
+        (g_get_monotonic_time() - start);
+
+    /* Cleanup */
+    gpgme_free(ciphertext);
+    ciphertext = NULL;
+
+    return true;
+}
+
+/**
+ * This function encrypts a buffer once and measures the throughput.
+ *
+ * @param context GPGME context
+ * @param key Key to encrypt to
+ * @param payload Buffer to encrypt
+ * @param flags Encryption flags
+ * @param ciphertext Set to the ciphertext. Owned by caller, free with gpgme_free(). Can be NULL
+ * @param ciphertext_length Set to the length of the ciphertext. Can be NULL
+ *
+ * @return Megabytes per second or a negative value on failure
+ */
+static double benchmark_bulk_encrypt(gpgme_ctx_t context, gpgme_key_t key,
+                                     GBytes *payload,
+                                     gpgme_encrypt_flags_t flags,
+                                     char **ciphertext,
+                                     size_t *ciphertext_length)
+{
+    gpgme_data_t input;
+    gpgme_data_t output;
+    gpgme_error_t error;
+
+    gsize length;
+    const char *data = g_bytes_get_data(payload, &length);
+
+    error = gpgme_data_new_from_mem(&input, data, length, 0);
+    if (error)
+        return -1;
+
+    error = gpgme_data_new(&output);
+    if (error) {
+        gpgme_data_release(input);
+        return -1;
+    }
+
+    gint64 start = g_get_monotonic_time();
+    error = gpgme_op_encrypt(context, (gpgme_key_t[]) {
+                             key, NULL}
+                             , GPGME_ENCRYPT_ALWAYS_TRUST | flags, input,
+                             output);
+    gint64 duration = g_get_monotonic_time() - start;
+
+    gpgme_data_release(input);
+
+    if (error) {
+        benchmark_warning(C_("GPGME Error", "encrypt GPGME data from memory"),
+                          error);
+
+        gpgme_data_release(output);
+        return -1;
+    }
+
+    if (ciphertext != NULL)
+        *ciphertext = gpgme_data_release_and_get_mem(output, ciphertext_length);
+    else
+        gpgme_data_release(output);
+
+    return length / (double)MAX(duration, 1);
+}
+
+/**
+ * This function measures the bulk throughput of a key and the cipher the engine negotiates for it.
+ *
+ * Random data is used, which cannot be compressed and shows the cost of compressing already compressed files.
+ *
+ * @param context GPGME context
+ * @param key Key whose newest encryption subkey is measured
+ * @param result Result to store the throughput in
+ *
+ * @return Success
+ */
+static bool benchmark_bulk(gpgme_ctx_t context, gpgme_key_t key,
+                           benchmark_result *result)
+{
+    gpgme_data_t input;
+    gpgme_data_t output;
+    gpgme_error_t error;
+
+    guint32 *random = g_new(guint32, BENCHMARK_BULK_SIZE / sizeof(guint32));
+    GRand *generator = g_rand_new_with_seed(0);
+    for (gsize i = 0; i < BENCHMARK_BULK_SIZE / sizeof(guint32); i++)
+        random[i] = g_rand_int(generator);
+    g_rand_free(generator);
+    generator = NULL;
+
+    GBytes *payload = g_bytes_new_take(random, BENCHMARK_BULK_SIZE);
+    random = NULL;
+
+    char *ciphertext = NULL;
+    size_t ciphertext_length = 0;
+
+    result->bulk_encrypt_compressed =
+        benchmark_bulk_encrypt(context, key, payload, 0, NULL, NULL);
+    result->bulk_encrypt =
+        benchmark_bulk_encrypt(context, key, payload,
+                               GPGME_ENCRYPT_NO_COMPRESS, &ciphertext,
+                               &ciphertext_length);
+
+    g_bytes_unref(payload);
+    payload = NULL;
+
+    if (result->bulk_encrypt < 0 || result->bulk_encrypt_compressed < 0) {
+        gpgme_free(ciphertext);
+        return false;
+    }
+
+    error = gpgme_data_new_from_mem(&input, ciphertext, ciphertext_length, 0);
+    if (!error) {
+        error = gpgme_data_new(&output);
+        if (!error) {
+            gint64 start = g_get_monotonic_time();
+            error = gpgme_op_decrypt(context, input, output);
+            gint64 duration = g_get_monotonic_time() - start;
+
+            result->bulk_decrypt =
+                BENCHMARK_BULK_SIZE / (double)MAX(duration, 1);
+
+            gpgme_decrypt_result_t decrypted = gpgme_op_decrypt_result(context);
+            if (!error && decrypted != NULL && decrypted->symkey_algo != NULL)
+                result->cipher = g_strdup(decrypted->symkey_algo);
+
+            gpgme_data_release(output);
+        }
+        gpgme_data_release(input);
+    }
+
+    /* Cleanup */
+    gpgme_free(ciphertext);
+    ciphertext = NULL;
+
+    if (error) {
+        benchmark_warning(C_("GPGME Error", "decrypt GPGME data from memory"),
+                          error);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * This function measures a signing key algorithm.
+ *
+ * @param context GPGME context
+ * @param algorithm Algorithm of the signing key
+ *
+ * @return Result or NULL. Owned by caller
+ */
+static benchmark_result *benchmark_sign_algorithm(gpgme_ctx_t context,
+                                                  const char *algorithm)
+{
+    gpgme_error_t error;
+
+    gint64 start = g_get_monotonic_time();
+    error = gpgme_op_createkey(context, BENCHMARK_USERID, algorithm, 0, 0, NULL,
+                               GPGME_CREATE_SIGN | BENCHMARK_FLAGS);
+    if (error) {
+        benchmark_warning(C_("GPGME Error", "generate new GPG key for signing"),
+                          error);
+        return NULL;
+    }
+
+    benchmark_result *result = g_new0(benchmark_result, 1);
+    result->algorithm = g_strdup(algorithm);
+    result->keygen = (g_get_monotonic_time() - start) / (double)G_USEC_PER_SEC;
+
+    gpgme_key_t key = benchmark_get_generated_key(context);
+    if (key == NULL || !benchmark_sign(context, key, result)) {
+        benchmark_result_free(result);
+        result = NULL;
+    }
+
+    /* Cleanup */
+    if (key != NULL)
+        gpgme_key_release(key);
+    key = NULL;
+
+    return result;
+}
+
+/**
+ * This function measures an encryption subkey algorithm.
+ *
+ * @param context GPGME context
+ * @param primary Primary key to add the subkey to
+ * @param algorithm Algorithm of the encryption subkey
+ *
+ * @return Result or NULL. Owned by caller
+ */
+static benchmark_result *benchmark_encrypt_algorithm(gpgme_ctx_t context,
+                                                     gpgme_key_t primary,
+                                                     const char *algorithm)
+{
+    gpgme_error_t error;
+
+    gint64 start = g_get_monotonic_time();
+    error = gpgme_op_createsubkey(context, primary, algorithm, 0, 0,
+                                  GPGME_CREATE_ENCR | BENCHMARK_FLAGS);
+    if (error) {
+        benchmark_warning(C_
+                          ("GPGME Error", "generate new GPG key for encryption"),
+                          error);
+        return NULL;
+    }
+
+    benchmark_result *result = g_new0(benchmark_result, 1);
+    result->algorithm = g_strdup(algorithm);
+    result->encrypt = true;
+    result->keygen = (g_get_monotonic_time() - start) / (double)G_USEC_PER_SEC;
+
+    /* The engine encrypts to the newest encryption subkey */
+    gpgme_key_t key = benchmark_get_key(context, primary->subkeys->fpr);
+    if (key == NULL || !benchmark_encrypt(context, key, result)
+        || !benchmark_bulk(context, key, result)) {
+        benchmark_result_free(result);
+        result = NULL;
+    }
+
+    /* Cleanup */
+    if (key != NULL)
+        gpgme_key_release(key);
+    key = NULL;
+
+    return result;
+}
+
+/**
+ * This function stops the agent of a GnuPG home directory and removes the directory.
+ *
+ * @param home Path of the GnuPG home directory
+ */
+static void benchmark_cleanup(const char *home)
+{
+    const char *gpgconf = gpgme_get_dirinfo("gpgconf-name");
+    if (gpgconf != NULL) {
+        const char *argv[] =
+            { gpgconf, "--homedir", home, "--kill", "all", NULL };
+
+        g_spawn_sync(NULL, (gchar **) argv, NULL,
+                     G_SPAWN_STDOUT_TO_DEV_NULL | G_SPAWN_STDERR_TO_DEV_NULL,
+                     NULL, NULL, NULL, NULL, NULL, NULL);
+    }
+
+    GDir *directory = g_dir_open(home, 0, NULL);
+    if (directory != NULL) {
+        const gchar *name;
+
+        while ((name = g_dir_read_name(directory)) != NULL) {
+            gchar *path = g_build_filename(home, name, NULL);
+            GStatBuf status;
+
+            if (g_lstat(path, &status) == 0 && S_ISDIR(status.st_mode))
+                benchmark_cleanup(path);
+            else
+                g_unlink(path);
+
+            g_free(path);
+            path = NULL;
+        }
+
+        g_dir_close(directory);
+        directory = NULL;
+    }
+
+    g_rmdir(home);
+}
+
+/**
+ * This function measures the cost of key algorithms on this machine.
+ *
+ * All keys are generated without passphrase in a temporary GnuPG home directory, which is removed afterwards.
+ *
+ * @param sign_algorithms NULL-terminated array of signing key algorithms
+ * @param encrypt_algorithms NULL-terminated array of encryption subkey algorithms
+ *
+ * @return Array of benchmark_result or NULL. Owned by caller
+ */
+GPtrArray *benchmark_run(const char *const *sign_algorithms,
+                         const char *const *encrypt_algorithms)
+{
+    GError *error = NULL;
+
+    gchar *home = g_dir_make_tmp("lock-benchmark-XXXXXX", &error);
+    if (home == NULL) {
+        g_warning(_("Failed to create benchmark directory: %s"),
+                  error->message);
+
+        g_error_free(error);
+        error = NULL;
+
+        return NULL;
+    }
+
+    gpgme_ctx_t context = benchmark_context(home);
+    if (context == NULL) {
+        benchmark_cleanup(home);
+        g_free(home);
+
+        return NULL;
+    }
+
+    gpgme_set_armor(context, 0);
+
+    GPtrArray *results =
+        g_ptr_array_new_with_free_func((GDestroyNotify) benchmark_result_free);
+
+    // Sign
+    for (size_t i = 0; sign_algorithms[i] != NULL; i++) {
+        benchmark_result *result =
+            benchmark_sign_algorithm(context, sign_algorithms[i]);
+
+        if (result != NULL)
+            g_ptr_array_add(results, result);
+    }
+
+    // Encrypt
+    gpgme_key_t primary = NULL;
+    if (!gpgme_op_createkey(context, BENCHMARK_USERID, "ed25519", 0, 0, NULL,
+                            GPGME_CREATE_SIGN | BENCHMARK_FLAGS))
+        primary = benchmark_get_generated_key(context);
+
+    for (size_t i = 0; primary != NULL && encrypt_algorithms[i] != NULL; i++) {
+        benchmark_result *result =
+            benchmark_encrypt_algorithm(context, primary,
+                                        encrypt_algorithms[i]);
+
+        if (result != NULL)
+            g_ptr_array_add(results, result);
+    }
+
+    /* Cleanup */
+    if (primary != NULL)
+        gpgme_key_release(primary);
+    primary = NULL;
+
+    gpgme_release(context);
+
+    benchmark_cleanup(home);
+
+    g_free(home);
+    home = NULL;
+
+    return results;
+}
+
+/**
+ * This function finds the result of an algorithm.
+ *
+ * @param results Array of benchmark_result. Can be NULL
+ * @param algorithm Algorithm to find
+ * @param encrypt Whether the algorithm was measured as encryption subkey
+ *
+ * @return Result or NULL
+ */
+benchmark_result *benchmark_lookup(GPtrArray *results, const char *algorithm,
+                                   bool encrypt)
+{
+    if (results == NULL || algorithm == NULL)
+        return NULL;
+
+    for (guint i = 0; i < results->len; i++) {
+        benchmark_result *result = g_ptr_array_index(results, i);
+
+        if (result->encrypt == encrypt
+            && strcmp(result->algorithm, algorithm) == 0)
+            return result;
+    }
+
+    return NULL;
+}
@@ -0,0 +1,32 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <glib.h>
+
+#include <stdbool.h>
+
+/**
+ * This structure holds the measured cost of a key algorithm.
+ */
+typedef struct {
+    char *algorithm;
+    bool encrypt; /**< Measured as encryption subkey instead of signing key */
+    double keygen; /**< Seconds to generate a key */
+    double sign; /**< Signatures per second */
+    double verify; /**< Verifications per second */
+    double encrypt_rate; /**< Encryptions per second */
+    double decrypt_rate; /**< Decryptions per second */
+    char *cipher; /**< Symmetric algorithm and mode the engine negotiated */
+    double bulk_encrypt; /**< Megabytes per second encrypted without compression */
+    double bulk_encrypt_compressed; /**< Megabytes per second encrypted with compression */
+    double bulk_decrypt; /**< Megabytes per second decrypted */
+} benchmark_result;
+
+void benchmark_result_free(benchmark_result * result);
+
+GPtrArray *benchmark_run(const char *const *sign_algorithms,
+                         const char *const *encrypt_algorithms);
+benchmark_result *benchmark_lookup(GPtrArray * results, const char *algorithm,
+                                   bool encrypt);
+
+#endif                          // BENCHMARK_H
@@ -0,0 +1,149 @@
+#include "compression.h"
+
+#include <adwaita.h>
+#include <glib/gi18n.h>
+#include <locale.h>
+#include "config.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <string.h>
+
+/* Bits per byte above which deflate gains next to nothing */
+#define COMPRESSION_ENTROPY_THRESHOLD 7.5
+
+/**
+ * This structure describes the magic number of a compressed format.
+ */
+typedef struct {
+    gsize offset;
+    const char *magic;
+    gsize length;
+} compression_magic;
+
+#define MAGIC(Offset, Magic) { Offset, Magic, sizeof(Magic) - 1 }
+
+static const compression_magic compression_magics[] = {
+    /* Archives and compressors */
+    MAGIC(0, "\x1f\x8b"),       // gzip
+    MAGIC(0, "BZh"),            // bzip2
+    MAGIC(0, "\xfd" "7zXZ\x00"),        // xz
+    MAGIC(0, "\x28\xb5\x2f\xfd"),       // zstd
+    MAGIC(0, "\x04\x22\x4d\x18"),       // lz4
+    MAGIC(0, "PK\x03\x04"),     // zip and derived formats
+    MAGIC(0, "7z\xbc\xaf\x27\x1c"),     // 7z
+    MAGIC(0, "Rar!\x1a\x07"),   // rar
+    /* Images */
+    MAGIC(0, "\xff\xd8\xff"),   // jpeg
+    MAGIC(0, "\x89PNG\r\n\x1a\n"),      // png
+    MAGIC(0, "GIF8"),           // gif
+    MAGIC(8, "WEBP"),           // webp
+    /* Audio and video */
+    MAGIC(4, "ftyp"),           // mp4, mov, m4a, heic and avif
+    MAGIC(0, "\x1a\x45\xdf\xa3"),       // matroska and webm
+    MAGIC(0, "OggS"),           // ogg
+    MAGIC(0, "fLaC"),           // flac
+    MAGIC(0, "ID3"),            // mp3
+    /* OpenPGP messages are encrypted or compressed already */
+    MAGIC(0, "-----BEGIN PGP MESSAGE-----"),
+};
+
+/**
+ * This function checks whether a sample starts with the magic number of a compressed format.
+ *
+ * @param sample Start of the input
+ * @param length Length of the sample
+ *
+ * @return Whether the input is in a compressed format
+ */
+bool compression_is_compressed_format(const guint8 *sample, gsize length)
+{
+    for (gsize i = 0; i < G_N_ELEMENTS(compression_magics); i++) {
+        const compression_magic *magic = &compression_magics[i];
+
+        if (length >= magic->offset + magic->length
+            && memcmp(sample + magic->offset, magic->magic,
+                      magic->length) == 0)
+            return true;
+    }
+
+    return false;
+}
+
+/**
+ * This function computes the Shannon entropy of a sample.
+ *
+ * @param sample Start of the input
+ * @param length Length of the sample
+ *
+ * @return Entropy in bits per byte
+ */
+double compression_entropy(const guint8 *sample, gsize length)
+{
+    if (length == 0)
+        return 0;
+
+    gsize counts[256] = { 0 };
+    for (gsize i = 0; i < length; i++)
+        counts[sample[i]]++;
+
+    double entropy = 0;
+    for (int i = 0; i < 256; i++) {
+        if (counts[i] == 0)
+            continue;
+
+        double probability = counts[i] / (double)length;
+        entropy -= probability * log2(probability);
+    }
+
+    return entropy;
+}
+
+/**
+ * This function estimates whether compressing an input is worth its cost.
+ *
+ * @param sample Start of the input
+ * @param length Length of the sample
+ *
+ * @return Whether the input should be compressed
+ */
+bool compression_useful(const guint8 *sample, gsize length)
+{
+    if (compression_is_compressed_format(sample, length))
+        return false;
+
+    return compression_entropy(sample, length) < COMPRESSION_ENTROPY_THRESHOLD;
+}
+
+/**
+ * This function estimates whether compressing a file is worth its cost.
+ *
+ * Only the start of the file is sampled.
+ *
+ * @param file File to sample
+ *
+ * @return Whether the file should be compressed. True if the file cannot be sampled
+ */
+bool compression_file_useful(GFile *file)
+{
+    GFileInputStream *stream = g_file_read(file, NULL, NULL);
+    if (stream == NULL)
+        return true;
+
+    guint8 *sample = g_malloc(COMPRESSION_SAMPLE_SIZE);
+    gsize length = 0;
+
+    bool useful = !g_input_stream_read_all(G_INPUT_STREAM(stream), sample,
+                                           COMPRESSION_SAMPLE_SIZE, &length,
+                                           NULL, NULL)
+        || compression_useful(sample, length);
+
+    /* Cleanup */
+    g_free(sample);
+    sample = NULL;
+
+    g_object_unref(stream);
+    stream = NULL;
+
+    return useful;
+}
@@ -0,0 +1,17 @@
+#ifndef COMPRESSION_H
+#define COMPRESSION_H
+
+#include <gio/gio.h>
+#include <glib.h>
+
+#include <stdbool.h>
+
+/* Size of the start of an input that is sampled */
+#define COMPRESSION_SAMPLE_SIZE (64 * 1024)
+
+bool compression_is_compressed_format(const guint8 * sample, gsize length);
+double compression_entropy(const guint8 * sample, gsize length);
+bool compression_useful(const guint8 * sample, gsize length);
+bool compression_file_useful(GFile * file);
+
+#endif                          // COMPRESSION_H
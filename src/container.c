@@ -0,0 +1,741 @@
+#include "container.h"
+#include "pipeline.h"
+
+#include <adwaita.h>
+#include <glib/gi18n.h>
+#include <glib/gstdio.h>
+#include <locale.h>
+#include "config.h"
+
+#include <gpgme.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/random.h>
+#include <unistd.h>
+
+/*
+ * A container is laid out as follows, all integers being big-endian:
+ *
+ * CONTAINER_MAGIC
+ * Chunks, each an OpenPGP message with the index of the chunk as file name
+ * Index: Offset and length of each chunk as 64 bit integers
+ * Footer: Offset of the index, number of chunks, chunk size and plaintext size as 64 bit integers, container ID,
+ *         CONTAINER_INDEX_MAGIC
+ *
+ * The plaintext of every chunk starts with a header of the container ID, index of the chunk, number of chunks, chunk
+ * size and plaintext size as 64 bit integers. The index and footer are not authenticated, so every chunk checks them
+ * against its header.
+ */
+#define CONTAINER_ID_SIZE 16
+#define CONTAINER_ENTRY_SIZE (2 * sizeof(guint64))
+#define CONTAINER_FOOTER_SIZE \
+    (4 * sizeof(guint64) + CONTAINER_ID_SIZE + CONTAINER_MAGIC_LENGTH)
+#define CONTAINER_HEADER_SIZE (CONTAINER_ID_SIZE + 4 * sizeof(guint64))
+
+/**
+ * This structure holds the state shared by the chunks of a container operation.
+ */
+typedef struct {
+    int input;
+    int output;
+
+    gpgme_key_t key;
+    gpgme_encrypt_flags_t flags;
+
+    guint8 id[CONTAINER_ID_SIZE]; /**< Random ID bound into every chunk */
+    guint64 count; /**< Number of chunks */
+    guint64 chunk_size;
+    guint64 size; /**< Size of the plaintext */
+    guint64 offset; /**< Start of the plaintext range to decrypt */
+    guint64 end; /**< End of the plaintext range to decrypt */
+
+    GMutex mutex;
+    GCond cond;
+} container_job;
+
+/**
+ * This structure holds a single chunk of a container.
+ */
+typedef struct {
+    guint64 index;
+    guint64 offset; /**< Offset of the encrypted chunk in the container */
+    guint64 length; /**< Length of the encrypted chunk */
+
+    char *data; /**< Encrypted chunk waiting to be written */
+    gpgme_error_t error;
+    bool done;
+} container_chunk;
+
+/**
+ * This function reads from a file descriptor at an offset completely.
+ *
+ * @param descriptor File descriptor to read from
+ * @param buffer Buffer to fill
+ * @param length Bytes to read
+ * @param offset Offset to read at
+ *
+ * @return Success. Sets errno on failure
+ */
+static bool container_read_at(int descriptor, void *buffer, gsize length,
+                              guint64 offset)
+{
+    guint8 *bytes = buffer;
+
+    while (length > 0) {
+        ssize_t count = pread(descriptor, bytes, length, offset);
+
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count < 0)
+            return false;
+        if (count == 0) {
+            errno = EIO;
+            return false;
+        }
+
+        bytes += count;
+        length -= count;
+        offset += count;
+    }
+
+    return true;
+}
+
+/**
+ * This function writes to a file descriptor at an offset completely.
+ *
+ * @param descriptor File descriptor to write to
+ * @param buffer Data to write
+ * @param length Bytes to write
+ * @param offset Offset to write at
+ *
+ * @return Success. Sets errno on failure
+ */
+static bool container_write_at(int descriptor, const void *buffer,
+                               gsize length, guint64 offset)
+{
+    const guint8 *bytes = buffer;
+
+    while (length > 0) {
+        ssize_t count = pwrite(descriptor, bytes, length, offset);
+
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count < 0)
+            return false;
+
+        bytes += count;
+        length -= count;
+        offset += count;
+    }
+
+    return true;
+}
+
+/**
+ * This function returns the plaintext length of a chunk.
+ *
+ * @param job Container operation
+ * @param index Index of the chunk
+ *
+ * @return Length in bytes
+ */
+static gsize container_plain_length(container_job *job, guint64 index)
+{
+    return MIN(job->chunk_size, job->size - index * job->chunk_size);
+}
+
+/**
+ * This function writes the authenticated header of a chunk.
+ *
+ * @param job Container operation
+ * @param index Index of the chunk
+ * @param header Buffer of CONTAINER_HEADER_SIZE bytes
+ */
+static void container_header(container_job *job, guint64 index,
+                             guint8 *header)
+{
+    guint64 fields[4] = {
+        GUINT64_TO_BE(index),
+        GUINT64_TO_BE(job->count),
+        GUINT64_TO_BE(job->chunk_size),
+        GUINT64_TO_BE(job->size)
+    };
+
+    memcpy(header, job->id, CONTAINER_ID_SIZE);
+    memcpy(header + CONTAINER_ID_SIZE, fields, sizeof(fields));
+}
+
+/**
+ * This function creates a GPGME context for a chunk.
+ *
+ * GPGME contexts must not be shared between threads, so every chunk uses its own.
+ *
+ * @param context Receives the context
+ *
+ * @return GPGME error
+ */
+static gpgme_error_t container_context(gpgme_ctx_t *context)
+{
+    gpgme_error_t error = gpgme_new(context);
+    if (error)
+        return error;
+
+    return gpgme_set_protocol(*context, GPGME_PROTOCOL_OpenPGP);
+}
+
+/**
+ * This function signals that a chunk is processed.
+ *
+ * @param chunk Processed chunk
+ * @param job Container operation
+ * @param error Outcome of the processing
+ */
+static void container_chunk_done(container_chunk *chunk, container_job *job,
+                                 gpgme_error_t error)
+{
+    g_mutex_lock(&job->mutex);
+    chunk->error = error;
+    chunk->done = true;
+    g_cond_broadcast(&job->cond);
+    g_mutex_unlock(&job->mutex);
+}
+
+/**
+ * This function checks whether a file is a container.
+ *
+ * @param file File to check
+ *
+ * @return Whether the file starts with CONTAINER_MAGIC
+ */
+bool container_detect(GFile *file)
+{
+    GFileInputStream *stream = g_file_read(file, NULL, NULL);
+    if (stream == NULL)
+        return false;
+
+    char magic[CONTAINER_MAGIC_LENGTH];
+    gsize length = 0;
+    bool detected = g_input_stream_read_all(G_INPUT_STREAM(stream), magic,
+                                            CONTAINER_MAGIC_LENGTH, &length,
+                                            NULL, NULL)
+        && length == CONTAINER_MAGIC_LENGTH
+        && memcmp(magic, CONTAINER_MAGIC, CONTAINER_MAGIC_LENGTH) == 0;
+
+    /* Cleanup */
+    g_object_unref(stream);
+    stream = NULL;
+
+    return detected;
+}
+
+/**** Encryption ****/
+
+/**
+ * This function encrypts a chunk of the input. Runs in a thread pool.
+ *
+ * @param chunk Chunk to encrypt
+ * @param job Container operation
+ */
+static void container_encrypt_chunk(container_chunk *chunk, container_job *job)
+{
+    gsize length = container_plain_length(job, chunk->index);
+    char *plain = g_malloc(CONTAINER_HEADER_SIZE + length);
+
+    gpgme_ctx_t context = NULL;
+    gpgme_data_t input = NULL;
+    gpgme_data_t output = NULL;
+    gpgme_error_t error = 0;
+
+    container_header(job, chunk->index, (guint8 *) plain);
+
+    if (!container_read_at(job->input, plain + CONTAINER_HEADER_SIZE, length,
+                           chunk->index * job->chunk_size))
+        error = gpgme_error_from_syserror();
+
+    if (!error)
+        error = container_context(&context);
+
+    if (!error)
+        error = gpgme_data_new_from_mem(&input, plain,
+                                        CONTAINER_HEADER_SIZE + length, 0);
+
+    if (!error) {
+        gchar *name = g_strdup_printf("%" G_GUINT64_FORMAT, chunk->index);
+        error = gpgme_data_set_file_name(input, name);
+
+        g_free(name);
+        name = NULL;
+    }
+
+    if (!error)
+        error = gpgme_data_new(&output);
+
+    if (!error)
+        error = gpgme_op_encrypt(context, (gpgme_key_t[]) {
+                                 job->key, NULL}
+                                 , job->flags, input, output);
+
+    if (!error) {
+        size_t size;
+
+        chunk->data = gpgme_data_release_and_get_mem(output, &size);
+        chunk->length = size;
+        output = NULL;
+    }
+
+    /* Cleanup */
+    gpgme_data_release(output);
+    gpgme_data_release(input);
+    gpgme_release(context);
+
+    g_free(plain);
+    plain = NULL;
+
+    container_chunk_done(chunk, job, error);
+}
+
+/**
+ * This function writes the index and footer of a container.
+ *
+ * @param job Container operation
+ * @param chunks Written chunks
+ * @param count Number of chunks
+ * @param offset Offset after the last chunk
+ *
+ * @return Success. Sets errno on failure
+ */
+static bool container_write_index(container_job *job, container_chunk *chunks,
+                                  guint64 count, guint64 offset)
+{
+    gsize length = count * CONTAINER_ENTRY_SIZE + CONTAINER_FOOTER_SIZE;
+    guint64 *index = g_malloc(length);
+
+    for (guint64 i = 0; i < count; i++) {
+        index[2 * i] = GUINT64_TO_BE(chunks[i].offset);
+        index[2 * i + 1] = GUINT64_TO_BE(chunks[i].length);
+    }
+
+    guint64 *footer = index + 2 * count;
+    footer[0] = GUINT64_TO_BE(offset);
+    footer[1] = GUINT64_TO_BE(count);
+    footer[2] = GUINT64_TO_BE(job->chunk_size);
+    footer[3] = GUINT64_TO_BE(job->size);
+    memcpy(footer + 4, job->id, CONTAINER_ID_SIZE);
+    memcpy((guint8 *) (footer + 4) + CONTAINER_ID_SIZE, CONTAINER_INDEX_MAGIC,
+           CONTAINER_MAGIC_LENGTH);
+
+    bool success = container_write_at(job->output, index, length, offset);
+
+    /* Cleanup */
+    g_free(index);
+    index = NULL;
+
+    return success;
+}
+
+/**
+ * This function encrypts a file into a container of chunks encrypted in parallel.
+ *
+ * Every chunk is a standard OpenPGP message for the key, bound to the container by its authenticated header.
+ *
+ * @param input_path Path of the file to encrypt
+ * @param output_path Path to write the container to
+ * @param key Key to encrypt for
+ * @param flags GPGME encryption flags of every chunk
+ *
+ * @return Success
+ */
+bool container_encrypt(const char *input_path, const char *output_path,
+                       gpgme_key_t key, gpgme_encrypt_flags_t flags)
+{
+    GStatBuf status;
+    if (g_stat(input_path, &status) != 0) {
+        g_warning(_("Failed to open input file: %s"), strerror(errno));
+        return false;
+    }
+
+    container_job job = {
+        .key = key,
+        .flags = flags,
+        .chunk_size = CONTAINER_CHUNK_SIZE,
+        .size = status.st_size
+    };
+    job.count = (job.size + job.chunk_size - 1) / job.chunk_size;
+
+    if (getrandom(job.id, CONTAINER_ID_SIZE, 0) != CONTAINER_ID_SIZE) {
+        g_warning(_("Failed to create container ID: %s"), strerror(errno));
+        return false;
+    }
+
+    job.input = open(input_path, O_RDONLY | O_CLOEXEC);
+    if (job.input < 0) {
+        g_warning(_("Failed to open input file: %s"), strerror(errno));
+        return false;
+    }
+
+    /* The output replaces an existing file only once it is complete */
+    pipeline_stage *output = pipeline_file_open(output_path, &job.output);
+    if (output == NULL) {
+        g_warning(_("Failed to open output file: %s"), strerror(errno));
+
+        close(job.input);
+        return false;
+    }
+
+    g_mutex_init(&job.mutex);
+    g_cond_init(&job.cond);
+
+    guint64 count = job.count;
+    container_chunk *chunks = g_new0(container_chunk, count);
+
+    guint threads = g_get_num_processors();
+    GThreadPool *pool =
+        g_thread_pool_new((GFunc) container_encrypt_chunk, &job, threads,
+                          false, NULL);
+
+    /* Encrypted chunks are written in order, so only a window of chunks is in memory */
+    guint64 window = 2 * threads;
+    guint64 next = 0;
+    for (; next < count && next < window; next++) {
+        chunks[next].index = next;
+        g_thread_pool_push(pool, &chunks[next], NULL);
+    }
+
+    guint64 offset = CONTAINER_MAGIC_LENGTH;
+    bool success =
+        container_write_at(job.output, CONTAINER_MAGIC, CONTAINER_MAGIC_LENGTH,
+                           0);
+    if (!success)
+        g_warning(_("Failed to write output file: %s"), strerror(errno));
+
+    for (guint64 i = 0; success && i < count; i++) {
+        g_mutex_lock(&job.mutex);
+        while (!chunks[i].done)
+            g_cond_wait(&job.cond, &job.mutex);
+        g_mutex_unlock(&job.mutex);
+
+        if (chunks[i].error) {
+            g_warning(C_
+                      ("Error message constructor for failed GPGME operations",
+                       "Failed to %s: %s"), C_("GPGME Error",
+                                               "encrypt chunk of file"),
+                      gpgme_strerror(chunks[i].error));
+
+            success = false;
+            break;
+        }
+
+        chunks[i].offset = offset;
+        success =
+            container_write_at(job.output, chunks[i].data, chunks[i].length,
+                               offset);
+        if (!success)
+            g_warning(_("Failed to write output file: %s"), strerror(errno));
+        offset += chunks[i].length;
+
+        gpgme_free(chunks[i].data);
+        chunks[i].data = NULL;
+
+        if (next < count) {
+            chunks[next].index = next;
+            g_thread_pool_push(pool, &chunks[next], NULL);
+            next++;
+        }
+    }
+
+    // Drops queued chunks after a failure and waits for running ones
+    g_thread_pool_free(pool, !success, true);
+    pool = NULL;
+
+    if (success) {
+        success = container_write_index(&job, chunks, count, offset)
+            && pipeline_file_publish(output);
+        if (!success)
+            g_warning(_("Failed to write output file: %s"), strerror(errno));
+    }
+
+    /* Cleanup */
+    for (guint64 i = 0; i < count; i++)
+        gpgme_free(chunks[i].data);
+    g_free(chunks);
+    chunks = NULL;
+
+    g_mutex_clear(&job.mutex);
+    g_cond_clear(&job.cond);
+
+    close(job.input);
+
+    pipeline_file_release(output);
+    output = NULL;
+
+    return success;
+}
+
+/**** Decryption ****/
+
+/**
+ * This function reads and validates the index of a container.
+ *
+ * @param job Container operation, receives the chunk size and plaintext size
+ * @param count Receives the number of chunks
+ *
+ * @return Chunks. Owned by caller. NULL on failure
+ */
+static container_chunk *container_read_index(container_job *job,
+                                             guint64 *count)
+{
+    GStatBuf status;
+    if (fstat(job->input, &status) != 0
+        || (guint64) status.st_size <
+        CONTAINER_MAGIC_LENGTH + CONTAINER_FOOTER_SIZE)
+        return NULL;
+
+    guint64 footer[4];
+    char magic[CONTAINER_MAGIC_LENGTH];
+    guint64 end = status.st_size - CONTAINER_FOOTER_SIZE;
+
+    if (!container_read_at(job->input, footer, sizeof(footer), end)
+        || !container_read_at(job->input, job->id, CONTAINER_ID_SIZE,
+                              end + sizeof(footer))
+        || !container_read_at(job->input, magic, CONTAINER_MAGIC_LENGTH,
+                              end + sizeof(footer) + CONTAINER_ID_SIZE)
+        || memcmp(magic, CONTAINER_INDEX_MAGIC, CONTAINER_MAGIC_LENGTH) != 0)
+        return NULL;
+
+    guint64 offset = GUINT64_FROM_BE(footer[0]);
+    *count = GUINT64_FROM_BE(footer[1]);
+    job->chunk_size = GUINT64_FROM_BE(footer[2]);
+    job->size = GUINT64_FROM_BE(footer[3]);
+    job->count = *count;
+
+    if (job->chunk_size == 0
+        || *count != (job->size + job->chunk_size - 1) / job->chunk_size
+        || offset < CONTAINER_MAGIC_LENGTH || offset > end
+        || (end - offset) / CONTAINER_ENTRY_SIZE != *count
+        || (end - offset) % CONTAINER_ENTRY_SIZE != 0)
+        return NULL;
+
+    guint64 *index = g_malloc(end - offset + 1);
+    if (!container_read_at(job->input, index, end - offset, offset)) {
+        g_free(index);
+        return NULL;
+    }
+
+    container_chunk *chunks = g_new0(container_chunk, *count);
+    bool valid = true;
+
+    for (guint64 i = 0; i < *count; i++) {
+        chunks[i].index = i;
+        chunks[i].offset = GUINT64_FROM_BE(index[2 * i]);
+        chunks[i].length = GUINT64_FROM_BE(index[2 * i + 1]);
+
+        if (chunks[i].offset < CONTAINER_MAGIC_LENGTH
+            || chunks[i].offset > offset
+            || chunks[i].length > offset - chunks[i].offset)
+            valid = false;
+    }
+
+    /* Cleanup */
+    g_free(index);
+    index = NULL;
+
+    if (!valid) {
+        g_free(chunks);
+        return NULL;
+    }
+
+    return chunks;
+}
+
+/**
+ * This function decrypts a chunk of a container and writes the part in the requested range. Runs in a thread pool.
+ *
+ * @param chunk Chunk to decrypt
+ * @param job Container operation
+ */
+static void container_decrypt_chunk(container_chunk *chunk, container_job *job)
+{
+    char *cipher = g_malloc(chunk->length + 1);
+
+    gpgme_ctx_t context = NULL;
+    gpgme_data_t input = NULL;
+    gpgme_data_t output = NULL;
+    gpgme_error_t error = 0;
+
+    if (!container_read_at(job->input, cipher, chunk->length, chunk->offset))
+        error = gpgme_error_from_syserror();
+
+    if (!error)
+        error = container_context(&context);
+
+    if (!error)
+        error = gpgme_data_new_from_mem(&input, cipher, chunk->length, 0);
+
+    if (!error)
+        error = gpgme_data_new(&output);
+
+    if (!error)
+        error = gpgme_op_decrypt(context, input, output);
+
+    /* Chunks must not be reordered or swapped with chunks of other containers of equal size */
+    if (!error) {
+        gpgme_decrypt_result_t result = gpgme_op_decrypt_result(context);
+        gchar *name = g_strdup_printf("%" G_GUINT64_FORMAT, chunk->index);
+
+        if (result == NULL || g_strcmp0(result->file_name, name) != 0)
+            error = gpgme_error(GPG_ERR_BAD_DATA);
+
+        g_free(name);
+        name = NULL;
+    }
+
+    if (!error) {
+        size_t length;
+        char *plain = gpgme_data_release_and_get_mem(output, &length);
+        output = NULL;
+
+        /* The unauthenticated footer must describe the container the chunk was encrypted for */
+        guint8 header[CONTAINER_HEADER_SIZE];
+        container_header(job, chunk->index, header);
+
+        guint64 start = chunk->index * job->chunk_size;
+        if (length != CONTAINER_HEADER_SIZE
+            + container_plain_length(job, chunk->index)
+            || memcmp(plain, header, CONTAINER_HEADER_SIZE) != 0)
+            error = gpgme_error(GPG_ERR_BAD_DATA);
+
+        guint64 from = MAX(start, job->offset);
+        guint64 to = MIN(start + length - CONTAINER_HEADER_SIZE, job->end);
+
+        if (!error
+            && !container_write_at(job->output,
+                                   plain + CONTAINER_HEADER_SIZE +
+                                   (from - start), to - from,
+                                   from - job->offset))
+            error = gpgme_error_from_syserror();
+
+        gpgme_free(plain);
+        plain = NULL;
+    }
+
+    /* Cleanup */
+    gpgme_data_release(output);
+    gpgme_data_release(input);
+    gpgme_release(context);
+
+    g_free(cipher);
+    cipher = NULL;
+
+    container_chunk_done(chunk, job, error);
+}
+
+/**
+ * This function decrypts a range of the plaintext of a container in parallel.
+ *
+ * Only the chunks overlapping the range are decrypted.
+ *
+ * @param input_path Path of the container
+ * @param output_path Path to write the plaintext range to
+ * @param offset Start of the range
+ * @param length Length of the range. G_MAXUINT64 for the rest of the plaintext
+ *
+ * @return Success
+ */
+bool container_decrypt(const char *input_path, const char *output_path,
+                       guint64 offset, guint64 length)
+{
+    container_job job = { 0 };
+
+    job.input = open(input_path, O_RDONLY | O_CLOEXEC);
+    if (job.input < 0) {
+        g_warning(_("Failed to open input file: %s"), strerror(errno));
+        return false;
+    }
+
+    guint64 count;
+    container_chunk *chunks = container_read_index(&job, &count);
+    if (chunks == NULL) {
+        g_warning(C_
+                  ("Error message constructor for failed GPGME operations",
+                   "Failed to %s: %s"), C_("GPGME Error",
+                                           "read index of chunked file"),
+                  gpgme_strerror(gpgme_error(GPG_ERR_BAD_DATA)));
+
+        close(job.input);
+        return false;
+    }
+
+    if (offset > job.size) {
+        g_warning(_("Failed to decrypt range: offset is beyond the end of the file"));
+
+        g_free(chunks);
+        close(job.input);
+        return false;
+    }
+
+    job.offset = offset;
+    job.end = (length > job.size - offset) ? job.size : offset + length;
+
+    pipeline_stage *output = pipeline_file_open(output_path, &job.output);
+    if (output == NULL) {
+        g_warning(_("Failed to open output file: %s"), strerror(errno));
+
+        g_free(chunks);
+        close(job.input);
+        return false;
+    }
+
+    g_mutex_init(&job.mutex);
+    g_cond_init(&job.cond);
+
+    /* Decrypted chunks are written at their own offset, so they finish in any order */
+    GThreadPool *pool =
+        g_thread_pool_new((GFunc) container_decrypt_chunk, &job,
+                          g_get_num_processors(), false, NULL);
+
+    if (job.end > job.offset) {
+        for (guint64 i = job.offset / job.chunk_size;
+             i <= (job.end - 1) / job.chunk_size; i++)
+            g_thread_pool_push(pool, &chunks[i], NULL);
+    }
+
+    g_thread_pool_free(pool, false, true);
+    pool = NULL;
+
+    bool success = true;
+    for (guint64 i = 0; i < count; i++) {
+        if (!chunks[i].error)
+            continue;
+
+        g_warning(C_
+                  ("Error message constructor for failed GPGME operations",
+                   "Failed to %s: %s"), C_("GPGME Error",
+                                           "decrypt chunk of file"),
+                  gpgme_strerror(chunks[i].error));
+
+        success = false;
+        break;
+    }
+
+    if (success && !pipeline_file_publish(output)) {
+        g_warning(_("Failed to write output file: %s"), strerror(errno));
+        success = false;
+    }
+
+    /* Cleanup */
+    g_free(chunks);
+    chunks = NULL;
+
+    g_mutex_clear(&job.mutex);
+    g_cond_clear(&job.cond);
+
+    close(job.input);
+
+    pipeline_file_release(output);
+    output = NULL;
+
+    return success;
+}
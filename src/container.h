@@ -0,0 +1,25 @@
+#ifndef CONTAINER_H
+#define CONTAINER_H
+
+#include <gio/gio.h>
+#include <glib.h>
+#include <gpgme.h>
+
+#include <stdbool.h>
+
+/* Starts a file of independently encrypted chunks */
+#define CONTAINER_MAGIC "LOCKCHK\x02"
+/* Ends the index of the chunks */
+#define CONTAINER_INDEX_MAGIC "LOCKIDX\x02"
+#define CONTAINER_MAGIC_LENGTH (sizeof(CONTAINER_MAGIC) - 1)
+
+/* Size of the plaintext of a chunk */
+#define CONTAINER_CHUNK_SIZE (16 * 1024 * 1024)
+
+bool container_detect(GFile * file);
+bool container_encrypt(const char *input_path, const char *output_path,
+                       gpgme_key_t key, gpgme_encrypt_flags_t flags);
+bool container_decrypt(const char *input_path, const char *output_path,
+                       guint64 offset, guint64 length);
+
+#endif                          // CONTAINER_H
@@ -1,7 +1,14 @@
 #include "cryptography.h"
+#include "compression.h"
+#include "container.h"
+#include "directory.h"
+#include "openpgp.h"
+#include "pipeline.h"
+#include "sessioncache.h"
 
 #include <adwaita.h>
 #include <glib/gi18n.h>
+#include <glib/gstdio.h>
 #include <locale.h>
 #include "config.h"
 
@@ -9,7 +16,9 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <string.h>
+#include <unistd.h>
 
 #define HANDLE_ERROR(Return, Error, String, Context, FreeCode) if (Error) \
     { \
@@ -30,6 +39,199 @@ void cryptography_init()
     g_message("GnuPG Made Easy %s", gpgme_check_version(NULL));
 }
 
+/**
+ * This function resets the details reported back in the options of an operation.
+ *
+ * @param options Options to reset
+ */
+void cryptography_options_clear(cryptography_options *options)
+{
+    g_free(options->cipher);
+    options->cipher = NULL;
+
+    g_free(options->signature_issue);
+    options->signature_issue = NULL;
+
+    options->compressed = false;
+    options->size = 0;
+    options->duration = 0;
+}
+
+/**
+ * This function decides whether an encryption compresses its input.
+ *
+ * @param sample Start of the input
+ * @param length Length of the sample
+ * @param file Input file. Sampled if sample is NULL
+ * @param options Options of the operation, receives the decision. Can be NULL
+ *
+ * @return GPGME encryption flags
+ */
+static gpgme_encrypt_flags_t cryptography_encrypt_flags(const guint8 *sample,
+                                                        gsize length,
+                                                        GFile *file,
+                                                        cryptography_options
+                                                        *options)
+{
+    compression_mode mode =
+        (options != NULL) ? options->compression : COMPRESSION_AUTOMATIC;
+
+    bool compress;
+    switch (mode) {
+    case COMPRESSION_ALWAYS:
+        compress = true;
+        break;
+    case COMPRESSION_NEVER:
+        compress = false;
+        break;
+    default:
+        compress = (sample != NULL) ? compression_useful(sample, length) :
+            compression_file_useful(file);
+
+        if (!compress)
+            g_debug("Skipping compression of incompressible input");
+        break;
+    }
+
+    if (options != NULL)
+        options->compressed = compress;
+
+    return compress ? 0 : GPGME_ENCRYPT_NO_COMPRESS;
+}
+
+/**
+ * This function stores the details of a finished operation in its options.
+ *
+ * @param context GPGME context of the operation
+ * @param flags Processing options
+ * @param start Monotonic time at the start of the operation
+ * @param options Options of the operation. Can be NULL
+ */
+static void cryptography_options_report(gpgme_ctx_t context,
+                                        cryptography_flags flags, gint64 start,
+                                        cryptography_options *options)
+{
+    if (options == NULL)
+        return;
+
+    options->duration = g_get_monotonic_time() - start;
+
+    if (flags & DECRYPT) {
+        gpgme_decrypt_result_t result = gpgme_op_decrypt_result(context);
+
+        g_free(options->cipher);
+        options->cipher = (result != NULL && result->symkey_algo != NULL) ?
+            g_strdup(result->symkey_algo) : NULL;
+    }
+}
+
+/**
+ * This function describes why a signature could not be checked.
+ *
+ * @param status Status of the signature
+ *
+ * @return Description
+ */
+static const char *cryptography_signature_issue(gpgme_error_t status)
+{
+    switch (gpgme_err_code(status)) {
+    case GPG_ERR_NO_PUBKEY:
+        return C_("Signature issue", "signed by an unknown key");
+    case GPG_ERR_KEY_EXPIRED:
+        return C_("Signature issue", "signed by an expired key");
+    case GPG_ERR_CERT_REVOKED:
+        return C_("Signature issue", "signed by a revoked key");
+    case GPG_ERR_SIG_EXPIRED:
+        return C_("Signature issue", "signature expired");
+    default:
+        return gpgme_strerror(status);
+    }
+}
+
+/**
+ * This function checks the signatures an operation verified.
+ *
+ * Only bad signatures fail. Signatures that cannot be checked, e.g. because their key is missing or expired,
+ * are reported in options instead, so the data is still written.
+ *
+ * @param context GPGME context of the operation
+ * @param required Whether the data has to be signed
+ * @param options Options of the operation, receives the first issue. Can be NULL
+ *
+ * @return Whether no signature is bad
+ */
+static bool cryptography_signatures_valid(gpgme_ctx_t context, bool required,
+                                          cryptography_options *options)
+{
+    gpgme_verify_result_t result = gpgme_op_verify_result(context);
+    if (result == NULL || result->signatures == NULL)
+        return !required;
+
+    for (gpgme_signature_t signature = result->signatures; signature != NULL;
+         signature = signature->next) {
+        gpgme_err_code_t code = gpgme_err_code(signature->status);
+
+        if (code == GPG_ERR_BAD_SIGNATURE)
+            return false;
+        if (code == GPG_ERR_NO_ERROR)
+            continue;
+
+        const char *issue = cryptography_signature_issue(signature->status);
+        g_warning(_("Failed to check signature: %s"), issue);
+
+        if (options != NULL && options->signature_issue == NULL)
+            options->signature_issue = g_strdup(issue);
+    }
+
+    return true;
+}
+
+/**
+ * This function prepares a decryption to reuse or remember the session key of a message.
+ *
+ * @param context GPGME context of the decryption
+ * @param id Identity of the message. NULL if the session cache is not used
+ */
+static void cryptography_session_prepare(gpgme_ctx_t context, const char *id)
+{
+    if (id == NULL)
+        return;
+
+    gpgme_set_ctx_flag(context, "export-session-key", "1");
+
+    /* Skips the public-key decryption */
+    char *session_key = session_cache_lookup(id);
+    if (session_key != NULL)
+        gpgme_set_ctx_flag(context, "override-session-key", session_key);
+
+    session_cache_key_free(session_key);
+    session_key = NULL;
+}
+
+/**
+ * This function remembers the session key of a decrypted message.
+ *
+ * @param context GPGME context of the decryption
+ * @param id Identity of the message. NULL if the session cache is not used
+ * @param error Error of the decryption
+ */
+static void cryptography_session_finish(gpgme_ctx_t context, const char *id,
+                                        gpgme_error_t error)
+{
+    if (id == NULL)
+        return;
+
+    // A remembered session key that failed is not tried again
+    if (error) {
+        session_cache_remove(id);
+        return;
+    }
+
+    gpgme_decrypt_result_t result = gpgme_op_decrypt_result(context);
+    if (result != NULL && result->session_key != NULL)
+        session_cache_insert(id, result->session_key);
+}
+
 /**** Key ****/
 
 /**
@@ -76,15 +278,20 @@ gpgme_key_t key_search(const char *userid)
 /**
  * This function generates a new GPG keypair.
  *
+ * The subkey is added to the key the engine reports as generated, in the same context.
+ *
  * @param userid User ID of the new keypair
  * @param sign_algorithm Algorithm of the signing key of the new keypair
  * @param encrypt_algorithm Algorithm of the encryption key of the new keypair
  * @param expiry Expiry in seconds of the new keypair
+ *
+ * @return Success
  */
 bool key_generate(const char *userid, const char *sign_algorithm,
                   const char *encrypt_algorithm, unsigned long expiry)
 {
     gpgme_ctx_t context;
+    gpgme_key_t key;
     gpgme_error_t error;
 
     error = gpgme_new(&context);
@@ -107,369 +314,1685 @@ bool key_generate(const char *userid, const char *sign_algorithm,
                  C_("GPGME Error", "generate new GPG key for signing"),
                  context,);
 
-    gpgme_key_t key = key_search(userid);
+    gpgme_genkey_result_t result = gpgme_op_genkey_result(context);
+    if (result == NULL || result->fpr == NULL) {
+        g_warning(_("Failed to find the fingerprint of the generated key."));
+
+        gpgme_release(context);
+        return false;
+    }
+
+    error = gpgme_get_key(context, result->fpr, &key, 1);
+    HANDLE_ERROR(false, error,
+                 C_("GPGME Error", "find generated GPG key"), context,);
 
     error =
         gpgme_op_createsubkey(context, key, encrypt_algorithm, 0, expiry,
                               GPGME_CREATE_ENCR | flags);
-    HANDLE_ERROR(false, error,
-                 C_("GPGME Error", "generate new GPG key for signing"),
-                 context, error =
-                 gpgme_op_delete_ext(context, key,
-                                     GPGME_DELETE_ALLOW_SECRET |
-                                     GPGME_DELETE_FORCE);
-                 HANDLE_ERROR(false, error,
-                              C_("GPGME Error",
-                                 "delete unfinished, generated ECC key"),
-                              context,); gpgme_key_release(key););
+    if (error) {
+        g_warning(C_
+                  ("Error message constructor for failed GPGME operations",
+                   "Failed to %s: %s"), C_("GPGME Error",
+                                           "generate new GPG key for encryption"),
+                  gpgme_strerror(error));
+
+        /* Do not leave a keypair without an encryption key behind */
+        error =
+            gpgme_op_delete_ext(context, key,
+                                GPGME_DELETE_ALLOW_SECRET | GPGME_DELETE_FORCE);
+        if (error)
+            g_warning(C_
+                      ("Error message constructor for failed GPGME operations",
+                       "Failed to %s: %s"), C_("GPGME Error",
+                                               "delete unfinished, generated key"),
+                      gpgme_strerror(error));
+
+        /* Cleanup */
+        gpgme_key_release(key);
+        gpgme_release(context);
+
+        return false;
+    }
 
+    /* Cleanup */
     gpgme_key_release(key);
+    gpgme_release(context);
 
     return true;
 }
 
 /**
- * This function manages keys.
- *
- * @param path Path of the file to import or export. Can be NULL
- * @param userid UID of the key to export or remove. Can be NULL
- * @param flags Processing options
+ * This structure holds the shared state of a batch of keypair generations.
+ */
+typedef struct {
+    const char *sign_algorithm;
+    const char *encrypt_algorithm;
+    unsigned long expiry;
+    key_generate_stats *stats;
+} key_generate_batch_data;
+
+/**
+ * This function generates a keypair of a batch in a worker thread.
  *
- * @return Success
+ * @param userid https://docs.gtk.org/glib/callback.Func.html
+ * @param batch https://docs.gtk.org/glib/callback.Func.html
  */
-bool key_manage(const char *path, const char *userid, key_flags flags)
+static void key_generate_batch_worker(gchar *userid,
+                                      key_generate_batch_data *batch)
 {
-    gpgme_ctx_t context;
-    gpgme_data_t keydata;
-    gpgme_error_t error;
-
-    error = gpgme_new(&context);
-    HANDLE_ERROR(false, error, C_("GPGME Error", "create new GPGME context"),
-                 context,);
-
-    error = gpgme_set_protocol(context, GPGME_PROTOCOL_OpenPGP);
-    HANDLE_ERROR(false, error,
-                 C_("GPGME Error", "set protocol of GPGME context to OpenPGP"),
-                 context,);
+    if (key_generate(userid, batch->sign_algorithm, batch->encrypt_algorithm,
+                     batch->expiry))
+        g_atomic_int_inc(&batch->stats->generated);
+    else
+        g_atomic_int_inc(&batch->stats->failed);
 
-    if (flags & IMPORT) {
-        error = gpgme_data_new_from_file(&keydata, path, 1);
-        HANDLE_ERROR(false, error,
-                     C_("GPGME Error", "load GPGME key data from file"),
-                     context, gpgme_data_release(keydata);
-            );
+    /* Cleanup */
+    g_free(userid);
+    userid = NULL;
+}
 
-        error = gpgme_op_import(context, keydata);
-        HANDLE_ERROR(false, error,
-                     C_("GPGME Error", "import GPG key from file"), context,
-                     gpgme_data_release(keydata);
-            );
+/**
+ * This function reads a field of a line of a CSV file.
+ *
+ * Surrounding whitespace and double quotes are removed.
+ *
+ * @param field Field to read
+ *
+ * @return Field. Owned by caller
+ */
+static gchar *key_generate_batch_field(const gchar *field)
+{
+    gchar *value = g_strstrip(g_strdup(field));
+    gsize length = strlen(value);
 
-        /* Cleanup */
-        gpgme_data_release(keydata);
-    } else if (flags & EXPORT) {
-        gpgme_set_armor(context, 1);
+    if (length >= 2 && value[0] == '"' && value[length - 1] == '"') {
+        value[length - 1] = '\0';
+        memmove(value, value + 1, length - 1);
+    }
 
-        error = gpgme_data_new(&keydata);
-        HANDLE_ERROR(false, error,
-                     C_("GPGME Error", "create GPGME key data in memory"),
-                     context, gpgme_data_release(keydata);
-            );
+    return value;
+}
 
-        error = gpgme_op_export(context, userid, 0, keydata);
-        HANDLE_ERROR(false, error,
-                     C_("GPGME Error", "export GPG key(s) to file"), context,
-                     gpgme_data_release(keydata);
-            );
+/**
+ * This function generates a keypair for every identity of a CSV file.
+ *
+ * Each line holds the name and email of an identity. Empty lines, lines starting with a hash and a header line are skipped. The keypairs are generated by a pool of worker threads.
+ *
+ * @param path Path of the CSV file
+ * @param sign_algorithm Algorithm of the signing keys of the new keypairs
+ * @param encrypt_algorithm Algorithm of the encryption keys of the new keypairs
+ * @param expiry Expiry in seconds of the new keypairs
+ * @param stats Stats to store the outcome of the batch in
+ *
+ * @return Whether every keypair was generated
+ */
+bool key_generate_batch(const char *path, const char *sign_algorithm,
+                        const char *encrypt_algorithm, unsigned long expiry,
+                        key_generate_stats *stats)
+{
+    memset(stats, 0, sizeof(*stats));
 
-        size_t length;
-        char *buffer = gpgme_data_release_and_get_mem(keydata, &length);
+    gchar *contents;
+    GError *error = NULL;
 
-        char *armor = malloc(length + 1);
-        memcpy(armor, buffer, length);
-        armor[length] = '\0';
+    if (!g_file_get_contents(path, &contents, NULL, &error)) {
+        g_warning(_("Failed to read identities file: %s"), error->message);
 
-        FILE *file;
+        g_error_free(error);
+        error = NULL;
 
-        file = fopen(path, "w");
-        if (file == NULL) {
-            g_warning(_("Failed to open export file: %s"), strerror(errno));
+        return false;
+    }
 
-            /* Cleanup */
-            gpgme_release(context);
+    key_generate_batch_data batch = {
+        .sign_algorithm = sign_algorithm,
+        .encrypt_algorithm = encrypt_algorithm,
+        .expiry = expiry,
+        .stats = stats,
+    };
+
+    GThreadPool *pool =
+        g_thread_pool_new((GFunc) key_generate_batch_worker, &batch,
+                          (gint) g_get_num_processors(), false, &error);
+    if (pool == NULL) {
+        g_warning(C_
+                  ("First format specifier is a translation string marked as “Thread Error”",
+                   "Failed to create %s thread: %s"), C_("Thread Error",
+                                                         "key generation"),
+                  error->message);
+
+        g_error_free(error);
+        error = NULL;
+
+        g_free(contents);
+        return false;
+    }
 
-            gpgme_free(buffer);
-            buffer = NULL;
+    gchar **lines = g_strsplit(contents, "\n", -1);
+    for (guint i = 0; lines[i] != NULL; i++) {
+        gchar *line = g_strstrip(lines[i]);
+        if (line[0] == '\0' || line[0] == '#')
+            continue;
 
-            free(armor);
-            armor = NULL;
+        gchar **fields = g_strsplit(line, ",", 3);
+        if (fields[0] == NULL || fields[1] == NULL) {
+            g_warning(_("Skipping malformed identity on line %u"), i + 1);
+            g_atomic_int_inc(&stats->failed);
 
-            return false;
+            g_strfreev(fields);
+            continue;
         }
 
-        fprintf(file, armor);
-        fclose(file);
+        gchar *name = key_generate_batch_field(fields[0]);
+        gchar *email = key_generate_batch_field(fields[1]);
+
+        /* Header, workers update the failures concurrently */
+        if (strchr(email, '@') == NULL) {
+            if (stats->queued > 0 || g_atomic_int_get(&stats->failed) > 0) {
+                g_warning(_("Skipping malformed identity on line %u"), i + 1);
+                g_atomic_int_inc(&stats->failed);
+            }
+        } else {
+            g_thread_pool_push(pool, g_strdup_printf("%s <%s>", name, email),
+                               NULL);
+            stats->queued++;
+        }
 
         /* Cleanup */
-        gpgme_free(buffer);
-        buffer = NULL;
+        g_free(name);
+        name = NULL;
+
+        g_free(email);
+        email = NULL;
 
-        free(armor);
-        armor = NULL;
+        g_strfreev(fields);
+        fields = NULL;
     }
 
-    if (flags & REMOVE) {
-        gpgme_key_t key;
+    /* Wait for all queued keypairs */
+    g_thread_pool_free(pool, false, true);
+    pool = NULL;
 
-        key = key_search(userid);
-        if (key == NULL) {
-            g_warning(_("Could not find key for User ID %s to remove."),
-                      userid);
-            return false;
-        }
+    /* Cleanup */
+    g_strfreev(lines);
+    lines = NULL;
 
-        error = gpgme_op_delete(context, key, 1);
-        HANDLE_ERROR(false, error, C_("GPGME Error", "remove GPG key"), context,
-                     gpgme_key_release(key);
-            );
+    g_free(contents);
+    contents = NULL;
 
-        /* Cleanup */
-        gpgme_key_release(key);
+    return stats->failed == 0 && stats->queued > 0;
+}
+
+/**
+ * This function imports keys from a single file.
+ *
+ * @param context GPGME context
+ * @param path Path of the file to import
+ * @param file Stats to store the outcome of the file in
+ *
+ * @return Whether the file was imported
+ */
+static bool key_import_file(gpgme_ctx_t context, const char *path,
+                            key_import_stats *file)
+{
+    gpgme_data_t keydata;
+    gpgme_error_t error;
+
+    memset(file, 0, sizeof(*file));
+
+    int descriptor = open(path, O_RDONLY | O_CLOEXEC);
+    if (descriptor < 0) {
+        g_warning(_("Failed to open import file %s: %s"), path,
+                  strerror(errno));
+
+        file->failed = 1;
+        return false;
     }
+    posix_fadvise(descriptor, 0, 0, POSIX_FADV_SEQUENTIAL);
 
-    /* Cleanup */
-    gpgme_release(context);
+    error = gpgme_data_new_from_fd(&keydata, descriptor);
+    bool ran = !error;
+    if (ran) {
+        error = gpgme_op_import(context, keydata);
+        gpgme_data_release(keydata);
+    }
+    close(descriptor);
+
+    /* The shared context still holds the result of the previous file otherwise */
+    gpgme_import_result_t result = ran ? gpgme_op_import_result(context) :
+        NULL;
+    if (result != NULL) {
+        file->imported = result->imported;
+        file->unchanged = result->unchanged;
+        file->failed = result->not_imported;
+    }
 
-    return true;
-}
+    if (error) {
+        g_warning(C_
+                  ("Error message constructor for failed GPGME operations",
+                   "Failed to %s: %s"), C_("GPGME Error",
+                                           "import GPG key from file"),
+                  gpgme_strerror(error));
 
-/**** Operations ****/
+        if (file->failed == 0)
+            file->failed = 1;
+        return false;
+    }
+
+    file->success = true;
+
+    return file->failed == 0;
+}
 
 /**
- * This function processes text.
+ * This function reads the keys of an import file.
  *
- * @param text Text to process
- * @param flags Processing options
- * @param key Key to encrypt for. Can be NULL
+ * @param path Path of the file
+ * @param data Set to the binary key data of the file. Owned by caller
  *
- * @return Processed text as an OpenPGP ASCII armor. Owned by caller
+ * @return Array of openpgp_key_block or NULL if the file cannot be parsed. Owned by caller
  */
-char *process_text(const char *text, cryptography_flags flags, gpgme_key_t key)
+static GPtrArray *key_import_read(const char *path, GBytes **data)
 {
-    gpgme_ctx_t context;
-    gpgme_data_t input;
-    gpgme_data_t output;
+    GMappedFile *file = g_mapped_file_new(path, false, NULL);
+    if (file == NULL)
+        return NULL;
 
-    gpgme_error_t error;
+    const guint8 *contents = (const guint8 *)g_mapped_file_get_contents(file);
+    gsize length = g_mapped_file_get_length(file);
 
-    error = gpgme_new(&context);
-    HANDLE_ERROR(NULL, error, C_("GPGME Error", "create new GPGME context"),
-                 context,);
+    if (length > 0 && (contents[0] & 0x80))
+        *data = g_mapped_file_get_bytes(file);
+    else
+        *data = openpgp_dearmor(contents, length);
 
-    error = gpgme_set_protocol(context, GPGME_PROTOCOL_OpenPGP);
-    HANDLE_ERROR(NULL, error,
-                 C_("GPGME Error", "set protocol of GPGME context to OpenPGP"),
-                 context,);
+    g_mapped_file_unref(file);
+    file = NULL;
 
-    gpgme_set_armor(context, 1);
+    if (*data == NULL)
+        return NULL;
 
-    error = gpgme_data_new_from_mem(&input, text, strlen(text), 1);
-    HANDLE_ERROR(NULL, error,
-                 C_("GPGME Error",
-                    "create new GPGME input data from string"), context,
-                 gpgme_data_release(input););
+    gsize size;
+    const guint8 *binary = g_bytes_get_data(*data, &size);
+    GPtrArray *blocks = openpgp_key_blocks(binary, size);
 
-    error = gpgme_data_new(&output);
-    HANDLE_ERROR(NULL, error,
-                 C_("GPGME Error", "create new GPGME output data in memory"),
-                 context, gpgme_data_release(input);
-                 gpgme_data_release(output););
+    if (blocks == NULL) {
+        g_bytes_unref(*data);
+        *data = NULL;
+    }
 
-    if (flags & ENCRYPT) {
-        error = gpgme_op_encrypt(context, (gpgme_key_t[]) {
-                                 key, NULL}
-                                 , 0, input, output);
-        HANDLE_ERROR(NULL, error,
-                     C_("GPGME Error", "encrypt GPGME data from memory"),
-                     context, gpgme_data_release(input);
-                     gpgme_data_release(output););
-    } else if (flags & DECRYPT) {
-        error = gpgme_op_decrypt(context, input, output);
-        HANDLE_ERROR(NULL, error,
-                     C_("GPGME Error", "decrypt GPGME data from memory"),
-                     context, gpgme_data_release(input);
-                     gpgme_data_release(output););
+    return blocks;
+}
+
+/**
+ * This function exports the keys of the keyring matching the fingerprints of an import.
+ *
+ * @param context GPGME context
+ * @param patterns NULL-terminated array of fingerprints
+ *
+ * @return Hash table of fingerprints to sets of packet digests or NULL. Owned by caller
+ */
+static GHashTable *key_import_local(gpgme_ctx_t context, const char **patterns)
+{
+    gpgme_data_t keydata;
+    gpgme_error_t error;
+
+    GHashTable *local =
+        g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                              (GDestroyNotify) g_hash_table_unref);
+    if (patterns[0] == NULL)
+        return local;
+
+    error = gpgme_data_new(&keydata);
+    if (error) {
+        g_hash_table_unref(local);
+        return NULL;
     }
 
-    if (flags & SIGN) {
-        error = gpgme_op_sign(context, input, output, GPGME_SIG_MODE_NORMAL);
-        HANDLE_ERROR(NULL, error,
-                     C_("GPGME Error", "sign GPGME data from memory"), context,
-                     gpgme_data_release(input); gpgme_data_release(output););
-    } else if (flags & VERIFY) {
-        error = gpgme_op_verify(context, input, NULL, output);
-        HANDLE_ERROR(NULL, error,
-                     C_("GPGME Error", "verify GPGME data from memory"),
-                     context, gpgme_data_release(input);
-                     gpgme_data_release(output););
+    gpgme_set_armor(context, 0);
+    error = gpgme_op_export_ext(context, patterns, 0, keydata);
+    if (error) {
+        g_warning(C_
+                  ("Error message constructor for failed GPGME operations",
+                   "Failed to %s: %s"), C_("GPGME Error",
+                                           "export GPG keys to compare"),
+                  gpgme_strerror(error));
+
+        gpgme_data_release(keydata);
+        g_hash_table_unref(local);
+        return NULL;
     }
 
     size_t length;
-    char *buffer = gpgme_data_release_and_get_mem(output, &length);
+    char *buffer = gpgme_data_release_and_get_mem(keydata, &length);
 
-    char *string = malloc(length + 1);
-    memcpy(string, buffer, length);
-    string[length] = '\0';
+    GPtrArray *blocks = openpgp_key_blocks((const guint8 *)buffer, length);
+    if (blocks != NULL) {
+        for (guint i = 0; i < blocks->len; i++) {
+            openpgp_key_block *block = g_ptr_array_index(blocks, i);
 
-    /* Cleanup */
-    gpgme_release(context);
-    gpgme_data_release(input);
+            g_hash_table_replace(local, g_strdup(block->fingerprint),
+                                 g_hash_table_ref(block->packets));
+        }
+
+        g_ptr_array_unref(blocks);
+    } else {
+        g_hash_table_unref(local);
+        local = NULL;
+    }
 
+    /* Cleanup */
     gpgme_free(buffer);
     buffer = NULL;
 
-    return string;
+    return local;
 }
 
 /**
- * This function processes a file.
+ * This function checks whether a key block holds nothing the keyring lacks.
  *
- * @param input_path Path to the file to process
- * @param output_path Path to write the processed file to
- * @param flags Processing options
- * @param key Key to encrypt for. Can be NULL
+ * @param local Hash table of fingerprints to sets of packet digests
+ * @param block Key block of an import file
  *
- * @return Success
+ * @return Whether every packet of the block is in the keyring
  */
-bool process_file(const char *input_path, const char *output_path,
-                  cryptography_flags flags, gpgme_key_t key)
-{
-    // TODO: Remove flag condition once GPGME 1.24.0 is release: gpgme_op_decrypt and gpgme_op_verify will support writing directly files
-    if (flags & ENCRYPT || flags & SIGN) {
-        /* Overwriting */
-        FILE *file = fopen(output_path, "r");
-        if (file != NULL) {
-            fclose(file);
-            remove(output_path);
-            g_message(_("Removed %s to prepare overwriting"), output_path);
-        }
-    }
+static bool key_import_known(GHashTable *local, openpgp_key_block *block)
+{
+    GHashTable *packets = g_hash_table_lookup(local, block->fingerprint);
+    if (packets == NULL)
+        return false;
 
-    gpgme_ctx_t context;
-    gpgme_data_t input;
-    gpgme_data_t output;
+    GHashTableIter iter;
+    gpointer digest;
 
-    gpgme_error_t error;
+    g_hash_table_iter_init(&iter, block->packets);
+    while (g_hash_table_iter_next(&iter, &digest, NULL))
+        if (!g_hash_table_contains(packets, digest))
+            return false;
 
-    error = gpgme_new(&context);
+    return true;
+}
+
+/**
+ * This function imports keys from files.
+ *
+ * The keys of all files are compared with the keyring first. Keys the keyring already holds completely are counted as unchanged without running the engine for them. All other public keys are imported in a single operation. Files with secret keys or files that cannot be parsed are imported one by one. A file that fails to import does not stop the import of the remaining files.
+ *
+ * @param paths NULL-terminated array of paths of the files to import
+ * @param stats Array with one element per path to store the outcome of each file in
+ *
+ * @return Whether all files were imported
+ */
+bool key_import(const char *const *paths, key_import_stats *stats)
+{
+    gpgme_ctx_t context;
+    gpgme_data_t keydata;
+    gpgme_error_t error;
+
+    error = gpgme_new(&context);
     HANDLE_ERROR(false, error, C_("GPGME Error", "create new GPGME context"),
                  context,);
 
     error = gpgme_set_protocol(context, GPGME_PROTOCOL_OpenPGP);
-    HANDLE_ERROR(NULL, error,
+    HANDLE_ERROR(false, error,
                  C_("GPGME Error", "set protocol of GPGME context to OpenPGP"),
                  context,);
 
-    // TODO: Do not copy file data to memory once GPGME supports this behavior
-    error = gpgme_data_new_from_file(&input, input_path, 1);
+    size_t n_files = g_strv_length((gchar **) paths);
+    GBytes **data = g_new0(GBytes *, n_files);
+    GPtrArray **blocks = g_new0(GPtrArray *, n_files);
+    bool *batched = g_new0(bool, n_files);
+
+    // Pre-scan
+    GHashTable *fingerprints = g_hash_table_new(g_str_hash, g_str_equal);
+    for (size_t i = 0; i < n_files; i++) {
+        memset(&stats[i], 0, sizeof(stats[i]));
+
+        blocks[i] = key_import_read(paths[i], &data[i]);
+        if (blocks[i] == NULL)
+            continue;
+
+        batched[i] = true;
+        for (guint j = 0; j < blocks[i]->len; j++) {
+            openpgp_key_block *block = g_ptr_array_index(blocks[i], j);
+
+            if (block->secret)
+                batched[i] = false;
+            else
+                g_hash_table_add(fingerprints, block->fingerprint);
+        }
+    }
+
+    const char **patterns =
+        (const char **)g_hash_table_get_keys_as_array(fingerprints, NULL);
+    GHashTable *local = key_import_local(context, patterns);
+
+    g_free(patterns);
+    patterns = NULL;
+
+    g_hash_table_unref(fingerprints);
+    fingerprints = NULL;
+
+    // Import
+    GByteArray *changed = g_byte_array_new();
+    GPtrArray *sent = g_ptr_array_new();
+    GArray *owners = g_array_new(false, false, sizeof(size_t));
+
+    for (size_t i = 0; i < n_files && local != NULL; i++) {
+        if (!batched[i])
+            continue;
+
+        const guint8 *binary = g_bytes_get_data(data[i], NULL);
+        for (guint j = 0; j < blocks[i]->len; j++) {
+            openpgp_key_block *block = g_ptr_array_index(blocks[i], j);
+
+            if (key_import_known(local, block)) {
+                stats[i].unchanged++;
+                continue;
+            }
+
+            g_byte_array_append(changed, binary + block->offset,
+                                block->length);
+            g_ptr_array_add(sent, block);
+            g_array_append_val(owners, i);
+        }
+    }
+
+    if (local == NULL) {
+        for (size_t i = 0; i < n_files; i++)
+            batched[i] = false;
+    } else if (changed->len > 0) {
+        error =
+            gpgme_data_new_from_mem(&keydata, (const char *)changed->data,
+                                    changed->len, 0);
+        if (!error) {
+            error = gpgme_op_import(context, keydata);
+            gpgme_data_release(keydata);
+        }
+
+        gpgme_import_result_t result = gpgme_op_import_result(context);
+        if (error || result == NULL) {
+            if (error)
+                g_warning(C_
+                          ("Error message constructor for failed GPGME operations",
+                           "Failed to %s: %s"), C_("GPGME Error",
+                                                   "import GPG keys from files"),
+                          gpgme_strerror(error));
+
+            /* Importing the same keys again is harmless */
+            for (size_t i = 0; i < n_files; i++)
+                batched[i] = false;
+        } else {
+            /* Statuses are reported in the order the keys were sent */
+            guint cursor = 0;
+            for (gpgme_import_status_t status = result->imports;
+                 status != NULL; status = status->next) {
+                guint position = cursor;
+
+                for (guint k = 0; status->fpr != NULL && k < sent->len; k++) {
+                    openpgp_key_block *block = g_ptr_array_index(sent, k);
+
+                    if (g_ascii_strcasecmp(block->fingerprint, status->fpr) ==
+                        0) {
+                        position = k;
+                        break;
+                    }
+                }
+                position = MIN(position, sent->len - 1);
+                cursor = position + 1;
+
+                key_import_stats *file =
+                    &stats[g_array_index(owners, size_t, position)];
+                if (status->result != GPG_ERR_NO_ERROR)
+                    file->failed++;
+                else if (status->status == 0)
+                    file->unchanged++;
+                else
+                    file->imported++;
+            }
+        }
+    }
+
+    bool success = true;
+    for (size_t i = 0; i < n_files; i++) {
+        if (batched[i]) {
+            stats[i].success = true;
+            if (stats[i].failed > 0)
+                success = false;
+        } else if (!key_import_file(context, paths[i], &stats[i])) {
+            success = false;
+        }
+    }
+
+    /* Cleanup */
+    gpgme_release(context);
+
+    g_byte_array_unref(changed);
+    g_ptr_array_unref(sent);
+    g_array_unref(owners);
+
+    if (local != NULL)
+        g_hash_table_unref(local);
+    local = NULL;
+
+    for (size_t i = 0; i < n_files; i++) {
+        if (blocks[i] != NULL)
+            g_ptr_array_unref(blocks[i]);
+        if (data[i] != NULL)
+            g_bytes_unref(data[i]);
+    }
+    g_free(blocks);
+    blocks = NULL;
+
+    g_free(data);
+    data = NULL;
+
+    g_free(batched);
+    batched = NULL;
+
+    return success;
+}
+
+/**
+ * This function lists the keys of the keyring with matching fingerprints in a single operation.
+ *
+ * @param context GPGME context
+ * @param fingerprints NULL-terminated array of fingerprints
+ * @param secret Whether to list secret keys
+ *
+ * @return NULL-terminated array of keys or NULL if any key is missing. Owned by caller, release with key_list_free()
+ */
+static gpgme_key_t *key_list(gpgme_ctx_t context,
+                             const char *const *fingerprints, bool secret)
+{
+    gpgme_error_t error;
+    guint n_keys = g_strv_length((gchar **) fingerprints);
+
+    gpgme_key_t *keys = g_new0(gpgme_key_t, n_keys + 1);
+    guint found = 0;
+
+    error =
+        gpgme_op_keylist_ext_start(context, (const char **)fingerprints,
+                                   secret, 0);
+    while (!error && found < n_keys) {
+        error = gpgme_op_keylist_next(context, &keys[found]);
+
+        if (!error)
+            found++;
+    }
+    gpgme_op_keylist_end(context);
+
+    if (found < n_keys) {
+        if (gpgme_err_code(error) != GPG_ERR_EOF)
+            g_warning(C_
+                      ("Error message constructor for failed GPGME operations",
+                       "Failed to %s: %s"), C_("GPGME Error", "list keys"),
+                      gpgme_strerror(error));
+        else
+            g_warning(_("Could not find %u of %u keys."), n_keys - found,
+                      n_keys);
+
+        for (guint i = 0; i < found; i++)
+            gpgme_key_release(keys[i]);
+        g_free(keys);
+
+        return NULL;
+    }
+
+    return keys;
+}
+
+/**
+ * This function releases an array of keys.
+ *
+ * @param keys NULL-terminated array of keys
+ */
+static void key_list_free(gpgme_key_t *keys)
+{
+    for (guint i = 0; keys[i] != NULL; i++)
+        gpgme_key_release(keys[i]);
+
+    g_free(keys);
+}
+
+/**
+ * This function exports public keys to a single file.
+ *
+ * The keys are streamed by the engine straight into the file.
+ *
+ * @param path Path of the file to export to
+ * @param fingerprints NULL-terminated array of fingerprints of the keys to export. NULL to export the whole keyring
+ * @param flags Export options
+ *
+ * @return Success
+ */
+bool key_export(const char *path, const char *const *fingerprints,
+                key_export_flags flags)
+{
+    gpgme_ctx_t context;
+    gpgme_data_t keydata;
+    gpgme_error_t error;
+
+    error = gpgme_new(&context);
+    HANDLE_ERROR(false, error, C_("GPGME Error", "create new GPGME context"),
+                 context,);
+
+    error = gpgme_set_protocol(context, GPGME_PROTOCOL_OpenPGP);
     HANDLE_ERROR(false, error,
-                 C_("GPGME Error",
-                    "create new GPGME input data from file"), context,
-                 gpgme_data_release(input););
+                 C_("GPGME Error", "set protocol of GPGME context to OpenPGP"),
+                 context,);
 
-    // TODO: Always set input file name once GPGME 1.24.0 is released: gpgme_op_encrypt and gpgme_op_sign will be able to read input data directly from files
-    if (flags & DECRYPT || flags & VERIFY) {
-        error = gpgme_data_set_file_name(input, input_path);
-        HANDLE_ERROR(false, error,
-                     C_("GPGME Error", "set file name of GPGME input data"),
-                     context, gpgme_data_release(input);
-                     gpgme_data_release(output););
+    gpgme_key_t *keys = NULL;
+    if (fingerprints != NULL) {
+        keys = key_list(context, fingerprints, false);
+        if (keys == NULL) {
+            gpgme_release(context);
+            return false;
+        }
     }
 
-    error = gpgme_data_new(&output);
+    gpgme_set_armor(context, !(flags & EXPORT_BINARY));
+
+    gpgme_export_mode_t mode = 0;
+    if (flags & EXPORT_MINIMAL)
+        mode |= GPGME_EXPORT_MODE_MINIMAL;
+
+    int descriptor = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (descriptor < 0) {
+        g_warning(_("Failed to open export file: %s"), strerror(errno));
+
+        /* Cleanup */
+        gpgme_release(context);
+        if (keys != NULL)
+            key_list_free(keys);
+
+        return false;
+    }
+
+    error = gpgme_data_new_from_fd(&keydata, descriptor);
+    if (!error) {
+        if (keys != NULL)
+            error = gpgme_op_export_keys(context, keys, mode, keydata);
+        else
+            error = gpgme_op_export(context, NULL, mode, keydata);
+
+        gpgme_data_release(keydata);
+    }
+
+    bool success = !error;
+    if (error)
+        g_warning(C_
+                  ("Error message constructor for failed GPGME operations",
+                   "Failed to %s: %s"), C_("GPGME Error",
+                                           "export GPG key(s) to file"),
+                  gpgme_strerror(error));
+
+    if (close(descriptor) != 0 && success) {
+        g_warning(_("Failed to write export file: %s"), strerror(errno));
+        success = false;
+    }
+
+    /* Do not leave a truncated export behind */
+    if (!success)
+        unlink(path);
+
+    /* Cleanup */
+    gpgme_release(context);
+    if (keys != NULL)
+        key_list_free(keys);
+
+    return success;
+}
+
+/**
+ * This function removes keys and their subkeys from the keyring.
+ *
+ * All keys are removed through a single context. A key that fails to be removed does not stop the removal of the remaining keys.
+ *
+ * @param fingerprints NULL-terminated array of fingerprints of the keys to remove
+ *
+ * @return Whether all keys were removed
+ */
+bool key_remove(const char *const *fingerprints)
+{
+    gpgme_ctx_t context;
+    gpgme_error_t error;
+
+    error = gpgme_new(&context);
+    HANDLE_ERROR(false, error, C_("GPGME Error", "create new GPGME context"),
+                 context,);
+
+    error = gpgme_set_protocol(context, GPGME_PROTOCOL_OpenPGP);
     HANDLE_ERROR(false, error,
+                 C_("GPGME Error", "set protocol of GPGME context to OpenPGP"),
+                 context,);
+
+    gpgme_key_t *keys = key_list(context, fingerprints, false);
+    if (keys == NULL) {
+        gpgme_release(context);
+        return false;
+    }
+
+    bool success = true;
+    for (guint i = 0; keys[i] != NULL; i++) {
+        error =
+            gpgme_op_delete_ext(context, keys[i],
+                                GPGME_DELETE_ALLOW_SECRET |
+                                GPGME_DELETE_FORCE);
+        if (error) {
+            g_warning(C_
+                      ("Error message constructor for failed GPGME operations",
+                       "Failed to %s: %s"), C_("GPGME Error", "remove GPG key"),
+                      gpgme_strerror(error));
+
+            success = false;
+        }
+    }
+
+    /* Cleanup */
+    gpgme_release(context);
+    key_list_free(keys);
+
+    return success;
+}
+
+/**** Operations ****/
+
+/**
+ * This function processes text.
+ *
+ * @param text Text to process
+ * @param flags Processing options
+ * @param key Key to encrypt for. Can be NULL
+ * @param options Parameters of the operation, receives the details reported by the engine. Can be NULL
+ *
+ * @return Processed text as an OpenPGP ASCII armor. Owned by caller
+ */
+char *process_text(const char *text, cryptography_flags flags, gpgme_key_t key,
+                   cryptography_options *options)
+{
+    gpgme_ctx_t context;
+    gpgme_data_t input;
+    gpgme_data_t output;
+
+    gpgme_error_t error;
+
+    error = gpgme_new(&context);
+    HANDLE_ERROR(NULL, error, C_("GPGME Error", "create new GPGME context"),
+                 context,);
+
+    error = gpgme_set_protocol(context, GPGME_PROTOCOL_OpenPGP);
+    HANDLE_ERROR(NULL, error,
+                 C_("GPGME Error", "set protocol of GPGME context to OpenPGP"),
+                 context,);
+
+    gpgme_set_armor(context, 1);
+
+    error = gpgme_data_new_from_mem(&input, text, strlen(text), 1);
+    HANDLE_ERROR(NULL, error,
+                 C_("GPGME Error",
+                    "create new GPGME input data from string"), context,
+                 gpgme_data_release(input););
+
+    error = gpgme_data_new(&output);
+    HANDLE_ERROR(NULL, error,
                  C_("GPGME Error", "create new GPGME output data in memory"),
                  context, gpgme_data_release(input);
                  gpgme_data_release(output););
 
-    // TODO: Always set output file name once GPGME 1.24.0 is released: gpgme_op_decrypt and gpgme_op_verify will be able to write output data directly to files
-    if (flags & ENCRYPT || flags & SIGN) {
-        error = gpgme_data_set_file_name(output, output_path);
-        HANDLE_ERROR(false, error,
-                     C_("GPGME Error", "set file name of GPGME output data"),
-                     context, gpgme_data_release(input);
-                     gpgme_data_release(output););
-    }
+    if (options != NULL)
+        options->size = strlen(text);
+
+    g_autofree gchar *id = (flags & DECRYPT && options != NULL
+                            && options->session_cache) ?
+        session_cache_id_data(text, strlen(text)) : NULL;
+    cryptography_session_prepare(context, id);
+
+    gint64 start = g_get_monotonic_time();
 
     if (flags & ENCRYPT) {
         error = gpgme_op_encrypt(context, (gpgme_key_t[]) {
                                  key, NULL}
-                                 , 0, input, output);
-        HANDLE_ERROR(false, error,
-                     C_("GPGME Error", "encrypt GPGME data from file"), context,
-                     gpgme_data_release(input); gpgme_data_release(output););
+                                 , cryptography_encrypt_flags((const guint8 *)text,
+                                                            MIN(strlen(text),
+                                                                COMPRESSION_SAMPLE_SIZE),
+                                                            NULL, options), input,
+                                 output);
+        HANDLE_ERROR(NULL, error,
+                     C_("GPGME Error", "encrypt GPGME data from memory"),
+                     context, gpgme_data_release(input);
+                     gpgme_data_release(output););
     } else if (flags & DECRYPT) {
         error = gpgme_op_decrypt(context, input, output);
-        HANDLE_ERROR(false, error,
-                     C_("GPGME Error", "decrypt GPGME data from file"), context,
-                     gpgme_data_release(input); gpgme_data_release(output););
+        cryptography_session_finish(context, id, error);
+        HANDLE_ERROR(NULL, error,
+                     C_("GPGME Error", "decrypt GPGME data from memory"),
+                     context, gpgme_data_release(input);
+                     gpgme_data_release(output););
     }
 
     if (flags & SIGN) {
         error = gpgme_op_sign(context, input, output, GPGME_SIG_MODE_NORMAL);
-        HANDLE_ERROR(false, error,
-                     C_("GPGME Error", "sign GPGME data from file"), context,
+        HANDLE_ERROR(NULL, error,
+                     C_("GPGME Error", "sign GPGME data from memory"), context,
                      gpgme_data_release(input); gpgme_data_release(output););
     } else if (flags & VERIFY) {
         error = gpgme_op_verify(context, input, NULL, output);
-        HANDLE_ERROR(false, error,
-                     C_("GPGME Error", "verify GPGME data from file"), context,
-                     gpgme_data_release(input); gpgme_data_release(output););
+        HANDLE_ERROR(NULL, error,
+                     C_("GPGME Error", "verify GPGME data from memory"),
+                     context, gpgme_data_release(input);
+                     gpgme_data_release(output););
     }
-    // TODO: Do not manually write to files once GPGME 1.24.0 is released: gpgme_op_decrypt and gpgme_op_verify will be able to write output data directly to files
-    if (flags & DECRYPT || flags & VERIFY) {
-        size_t length;
-        void *buffer = gpgme_data_release_and_get_mem(output, &length);
 
-        void *data = malloc(length + 1);
-        memcpy(data, buffer, length);
+    cryptography_options_report(context, flags, start, options);
 
-        FILE *file;
+    size_t length;
+    char *buffer = gpgme_data_release_and_get_mem(output, &length);
 
-        file = fopen(output_path, "w");
-        if (file == NULL) {
-            g_warning(_("Failed to open output file: %s"), strerror(errno));
+    char *string = malloc(length + 1);
+    memcpy(string, buffer, length);
+    string[length] = '\0';
 
-            /* Cleanup */
-            gpgme_release(context);
-            gpgme_data_release(input);
+    /* Cleanup */
+    gpgme_release(context);
+    gpgme_data_release(input);
 
-            gpgme_free(buffer);
-            buffer = NULL;
+    gpgme_free(buffer);
+    buffer = NULL;
 
-            free(data);
-            data = NULL;
+    return string;
+}
+/**
+ * This function returns the size of a file.
+ *
+ * @param file File to query
+ *
+ * @return Size in bytes. 0 if unknown
+ */
+static int64_t process_file_size(GFile *file)
+{
+    GFileInfo *info = g_file_query_info(file, G_FILE_ATTRIBUTE_STANDARD_SIZE,
+                                        G_FILE_QUERY_INFO_NONE, NULL, NULL);
+    if (info == NULL)
+        return 0;
 
-            return false;
-        }
+    int64_t size = g_file_info_get_size(info);
 
-        fwrite(data, length, 1, file);
-        fclose(file);
+    /* Cleanup */
+    g_object_unref(info);
+    info = NULL;
 
-        /* Cleanup */
-        gpgme_free(buffer);
-        buffer = NULL;
+    return size;
+}
 
-        free(data);
-        data = NULL;
+/**
+ * This function encrypts a file into or decrypts a file from a container of chunks processed in parallel.
+ *
+ * Chunks are read and written at random offsets, so both files need to be local.
+ *
+ * @param input_file File to process
+ * @param output_file File to write the processed file to
+ * @param flags Processing options
+ * @param key Key to encrypt for. Can be NULL
+ * @param options Parameters of the operation, receives the details of the operation. Can be NULL
+ *
+ * @return Success
+ */
+static bool process_file_chunked(GFile *input_file, GFile *output_file,
+                                 cryptography_flags flags, gpgme_key_t key,
+                                 cryptography_options *options)
+{
+    char *input_path = g_file_get_path(input_file);
+    char *output_path = g_file_get_path(output_file);
+
+    bool success = false;
+    if (input_path == NULL || output_path == NULL) {
+        g_warning(_("Failed to process chunked file: %s"),
+                  C_("Chunked file error", "file is not stored locally"));
+        goto cleanup;
     }
 
-    /* Cleanup */
-    gpgme_release(context);
-    gpgme_data_release(input);
-    // TODO: Remove free condition once GPGME 1.24.0 is released: gpgme_op_decrypt and gpgme_op_verify will be able to write output data directly to files
-    if (flags & ENCRYPT || flags & SIGN)
-        gpgme_data_release(output);
+    if (options != NULL)
+        options->size = process_file_size(input_file);
+    gint64 start = g_get_monotonic_time();
 
-    return true;
+    if (flags & ENCRYPT)
+        success = container_encrypt(input_path, output_path, key,
+                                    cryptography_encrypt_flags(NULL, 0,
+                                                               input_file,
+                                                               options));
+    else
+        success = container_decrypt(input_path, output_path, 0, G_MAXUINT64);
+
+    if (options != NULL)
+        options->duration = g_get_monotonic_time() - start;
+
+ cleanup:
+    g_free(input_path);
+    input_path = NULL;
+
+    g_free(output_path);
+    output_path = NULL;
+
+    return success;
+}
+
+/**
+ * This function verifies a file against a detached signature.
+ *
+ * @param input_file Signed file
+ * @param signature_file Detached signature, binary or armored
+ * @param options Parameters of the operation, receives the details reported by the engine. Can be NULL
+ *
+ * @return Whether the file is signed and all signatures are good
+ */
+static bool process_file_detached(GFile *input_file, GFile *signature_file,
+                                  cryptography_options *options)
+{
+    gpgme_ctx_t context;
+    gpgme_data_t input;
+    gpgme_data_t signature;
+
+    gpgme_error_t error;
+
+    error = gpgme_new(&context);
+    HANDLE_ERROR(false, error, C_("GPGME Error", "create new GPGME context"),
+                 context,);
+
+    error = gpgme_set_protocol(context, GPGME_PROTOCOL_OpenPGP);
+    HANDLE_ERROR(false, error,
+                 C_("GPGME Error", "set protocol of GPGME context to OpenPGP"),
+                 context,);
+
+    error = pipeline_input_data(input_file, false, &input);
+    HANDLE_ERROR(false, error,
+                 C_("GPGME Error",
+                    "create new pipelined GPGME input data from file"),
+                 context,);
+
+    error = pipeline_input_data(signature_file, false, &signature);
+    HANDLE_ERROR(false, error,
+                 C_("GPGME Error",
+                    "create new pipelined GPGME input data from signature"),
+                 context, gpgme_data_release(input););
+
+    if (options != NULL)
+        options->size = process_file_size(input_file);
+
+    gint64 start = g_get_monotonic_time();
+
+    error = gpgme_op_verify(context, signature, input, NULL);
+    if (!error && !cryptography_signatures_valid(context, true, options))
+        error = gpgme_error(GPG_ERR_BAD_SIGNATURE);
+    HANDLE_ERROR(false, error,
+                 C_("GPGME Error",
+                    "verify GPGME data against detached signature"), context,
+                 gpgme_data_release(input); gpgme_data_release(signature););
+
+    cryptography_options_report(context, VERIFY, start, options);
+
+    /* Cleanup */
+    gpgme_release(context);
+    gpgme_data_release(input);
+    gpgme_data_release(signature);
+
+    return true;
+}
+
+/**
+ * This function checks whether a decryption found the plaintext compressed by the pipeline.
+ *
+ * @param context GPGME context of the decryption
+ *
+ * @return Whether the literal file name is PIPELINE_FILE_NAME
+ */
+static bool cryptography_pipeline_signalled(gpgme_ctx_t context)
+{
+    gpgme_decrypt_result_t result = gpgme_op_decrypt_result(context);
+
+    return result != NULL && result->file_name != NULL
+        && strcmp(result->file_name, PIPELINE_FILE_NAME) == 0;
+}
+
+/**
+ * This structure holds the output of a decryption waiting for the literal file name.
+ */
+typedef struct {
+    pipeline_stage *stage;
+    bool decompressed; /**< The stage was switched to decompression in time */
+} process_file_status;
+
+/**
+ * This function switches the output of a decryption to decompression once the engine reports the literal file name
+ * PIPELINE_FILE_NAME, which it does before writing any plaintext.
+ *
+ * https://www.gnupg.org/documentation/manuals/gpgme/Status-Message-Callback.html
+ *
+ * @param hook Status of the decryption
+ * @param keyword Keyword of the status line
+ * @param args Arguments of the status line
+ *
+ * @return GPGME error
+ */
+static gpgme_error_t process_file_on_status(void *hook, const char *keyword,
+                                            const char *args)
+{
+    process_file_status *status = hook;
+
+    if (strcmp(keyword, "PLAINTEXT") != 0 || args == NULL)
+        return GPG_ERR_NO_ERROR;
+
+    /* Format, timestamp and the percent-escaped file name */
+    gchar **fields = g_strsplit(args, " ", 3);
+    if (g_strv_length(fields) == 3
+        && strcmp(fields[2], PIPELINE_FILE_NAME) == 0)
+        status->decompressed = pipeline_output_decompress(status->stage);
+
+    /* Cleanup */
+    g_strfreev(fields);
+    fields = NULL;
+
+    return GPG_ERR_NO_ERROR;
+}
+
+/**
+ * This function runs the engine over a file for process_file().
+ *
+ * @param input_file File to process
+ * @param output_file File to write the processed file to. Only replaced on success
+ * @param flags Processing options
+ * @param key Key to encrypt for. Can be NULL
+ * @param options Parameters of the operation, receives the details reported by the engine. Can be NULL
+ * @param decompress Whether to undo the compression of the pipeline if the plaintext starts with PIPELINE_MARKER. Also done if the literal file name signals it
+ * @param signalled Set if the literal file name signalled compression too late to decompress, the output is discarded then. Can be NULL
+ *
+ * @return Success
+ */
+static bool process_file_engine(GFile *input_file, GFile *output_file,
+                                cryptography_flags flags, gpgme_key_t key,
+                                cryptography_options *options,
+                                bool decompress, bool *signalled)
+{
+    gpgme_ctx_t context;
+    gpgme_data_t input;
+    gpgme_data_t output;
+
+    gpgme_error_t error;
+
+    error = gpgme_new(&context);
+    HANDLE_ERROR(false, error, C_("GPGME Error", "create new GPGME context"),
+                 context,);
+
+    error = gpgme_set_protocol(context, GPGME_PROTOCOL_OpenPGP);
+    HANDLE_ERROR(NULL, error,
+                 C_("GPGME Error", "set protocol of GPGME context to OpenPGP"),
+                 context,);
+
+    gpgme_encrypt_flags_t encrypt_flags = 0;
+    if (flags & ENCRYPT)
+        encrypt_flags =
+            cryptography_encrypt_flags(NULL, 0, input_file, options);
+
+    /* Multi-threaded compression replaces the compression of the engine */
+    bool pipeline = flags & ENCRYPT
+        && !(encrypt_flags & GPGME_ENCRYPT_NO_COMPRESS) && options != NULL
+        && options->zstd && pipeline_available();
+
+    if (pipeline)
+        encrypt_flags |= GPGME_ENCRYPT_NO_COMPRESS;
+
+    /* Files are read and written on separate threads */
+    error = pipeline_input_data(input_file, pipeline, &input);
+    HANDLE_ERROR(false, error,
+                 C_("GPGME Error",
+                    "create new pipelined GPGME input data from file"),
+                 context,);
+
+    /* The literal file name is part of the authenticated plaintext */
+    if (pipeline)
+        gpgme_data_set_file_name(input, PIPELINE_FILE_NAME);
+
+    /* The output is preallocated to about the size of the input */
+    int64_t size = process_file_size(input_file);
+
+    pipeline_stage *stage = NULL;
+    error =
+        pipeline_output_data(output_file, flags & DECRYPT && decompress,
+                             size, &output, &stage);
+    HANDLE_ERROR(false, error,
+                 C_("GPGME Error",
+                    "create new pipelined GPGME output data for file"),
+                 context, gpgme_data_release(input););
+
+    if (options != NULL)
+        options->size = size;
+
+    /* Files compressed by the pipeline are recognized within the same pass */
+    process_file_status status = {.stage = stage };
+    if (flags & DECRYPT && !decompress) {
+        gpgme_set_ctx_flag(context, "full-status", "1");
+        gpgme_set_status_cb(context, process_file_on_status, &status);
+    }
+
+    g_autofree gchar *id = (flags & DECRYPT && options != NULL
+                            && options->session_cache) ?
+        session_cache_id_file(input_file) : NULL;
+    cryptography_session_prepare(context, id);
+
+    gint64 start = g_get_monotonic_time();
+
+    const char *operation = NULL;
+    if (flags & ENCRYPT) {
+        operation = C_("GPGME Error", "encrypt GPGME data from file");
+        error = gpgme_op_encrypt(context, (gpgme_key_t[]) {
+                                 key, NULL}
+                                 , encrypt_flags, input, output);
+    } else if (flags & DECRYPT && flags & VERIFY) {
+        operation =
+            C_("GPGME Error", "decrypt and verify GPGME data from file");
+        error = gpgme_op_decrypt_verify(context, input, output);
+        cryptography_session_finish(context, id, error);
+
+        /* Unsigned data is fine, bad signatures are not */
+        if (!error
+            && !cryptography_signatures_valid(context, false, options))
+            error = gpgme_error(GPG_ERR_BAD_SIGNATURE);
+    } else if (flags & DECRYPT) {
+        operation = C_("GPGME Error", "decrypt GPGME data from file");
+        error = gpgme_op_decrypt(context, input, output);
+        cryptography_session_finish(context, id, error);
+    } else if (flags & SIGN) {
+        operation = C_("GPGME Error", "sign GPGME data from file");
+        error = gpgme_op_sign(context, input, output, GPGME_SIG_MODE_NORMAL);
+    } else if (flags & VERIFY) {
+        operation = C_("GPGME Error", "verify GPGME data from file");
+        error = gpgme_op_verify(context, input, NULL, output);
+    }
+
+    /* Decrypted as is, but the pipeline compressed the plaintext */
+    if (!error && flags & DECRYPT && !decompress && !status.decompressed
+        && signalled != NULL && cryptography_pipeline_signalled(context)) {
+        *signalled = true;
+
+        gpgme_release(context);
+        gpgme_data_release(input);
+        gpgme_data_release(output);
+
+        return false;
+    }
+
+    // Releasing the output of a failed operation keeps the previous file
+    if (!error && !pipeline_finish(stage))
+        error = gpgme_error_from_syserror();
+    HANDLE_ERROR(false, error, operation, context,
+                 gpgme_data_release(input); gpgme_data_release(output););
+
+    cryptography_options_report(context, flags, start, options);
+
+    /* Cleanup */
+    gpgme_release(context);
+    gpgme_data_release(input);
+    gpgme_data_release(output);
+
+    return true;
+}
+
+/**
+ * This function processes a file.
+ *
+ * Decryption combined with VERIFY also checks the signatures inside the encrypted data, if there are any.
+ * Plaintext compressed by the pipeline is decompressed if options ask for zstd or its literal file name says so.
+ * Verification with a detached signature in options writes no output.
+ *
+ * The engine reads and writes the files through pipeline stages, so they can be local files or any location supported by GIO.
+ *
+ * @param input_file File to process
+ * @param output_file File to write the processed file to. Only replaced on success
+ * @param flags Processing options
+ * @param key Key to encrypt for. Can be NULL
+ * @param options Parameters of the operation, receives the details reported by the engine. Can be NULL
+ *
+ * @return Success
+ */
+bool process_file(GFile *input_file, GFile *output_file,
+                  cryptography_flags flags, gpgme_key_t key,
+                  cryptography_options *options)
+{
+    if ((flags & ENCRYPT && options != NULL && options->chunked)
+        || (flags & DECRYPT && container_detect(input_file)))
+        return process_file_chunked(input_file, output_file, flags, key,
+                                    options);
+
+    if (flags & VERIFY && !(flags & DECRYPT) && options != NULL
+        && options->signature != NULL)
+        return process_file_detached(input_file, options->signature, options);
+
+    /* Only decompressed if asked for or signalled by the plaintext */
+    bool decompress = options != NULL && options->zstd;
+    bool signalled = false;
+
+    bool success = process_file_engine(input_file, output_file, flags, key,
+                                       options, decompress, &signalled);
+
+    /* Only if the engine reported the file name after writing plaintext */
+    if (!success && signalled)
+        success = process_file_engine(input_file, output_file, flags, key,
+                                      options, true, NULL);
+
+    return success;
+}
+
+/**
+ * This structure collects the plaintext of a preview.
+ */
+typedef struct {
+    GByteArray *plain;
+    gsize limit;
+} preview_sink;
+
+/**
+ * This function collects plaintext written by the engine until a preview has enough of it.
+ *
+ * @param handle https://www.gnupg.org/documentation/manuals/gpgme/Callback-Based-Data-Buffers.html
+ * @param buffer https://www.gnupg.org/documentation/manuals/gpgme/Callback-Based-Data-Buffers.html
+ * @param size https://www.gnupg.org/documentation/manuals/gpgme/Callback-Based-Data-Buffers.html
+ *
+ * @return Number of bytes consumed or -1 once the preview is complete
+ */
+static gpgme_ssize_t preview_write(void *handle, const void *buffer,
+                                   size_t size)
+{
+    preview_sink *sink = handle;
+
+    gsize room = sink->limit - sink->plain->len;
+    g_byte_array_append(sink->plain, buffer, MIN(size, room));
+
+    if (sink->plain->len < sink->limit)
+        return size;
+
+    /* Failing the write makes GPGME terminate the engine */
+    errno = ECANCELED;
+    return -1;
+}
+
+static struct gpgme_data_cbs preview_cbs = {
+    .write = preview_write,
+};
+
+/**
+ * This function decrypts the start of a file without writing anything.
+ *
+ * The engine is stopped as soon as limit bytes of plaintext are produced, so the work does not depend on the size
+ * of the file. Chunked containers and files compressed by the pipeline are not supported.
+ * The integrity of the data is only checked at its end, so a stopped preview is not authenticated.
+ *
+ * @param file Encrypted file
+ * @param limit Maximum number of plaintext bytes, e.g. PREVIEW_SIZE
+ * @param options Parameters of the operation, receives the details reported by the engine. Can be NULL
+ *
+ * @return Start of the plaintext or NULL on failure. Owned by caller
+ */
+GBytes *preview_file(GFile *file, gsize limit, cryptography_options *options)
+{
+    if (container_detect(file)) {
+        g_warning(_("Failed to preview file: %s"),
+                  C_("Preview error", "chunked files cannot be previewed"));
+        return NULL;
+    }
+
+    gpgme_ctx_t context;
+    gpgme_data_t input;
+    gpgme_data_t output;
+
+    gpgme_error_t error;
+
+    error = gpgme_new(&context);
+    HANDLE_ERROR(NULL, error, C_("GPGME Error", "create new GPGME context"),
+                 context,);
+
+    error = gpgme_set_protocol(context, GPGME_PROTOCOL_OpenPGP);
+    HANDLE_ERROR(NULL, error,
+                 C_("GPGME Error", "set protocol of GPGME context to OpenPGP"),
+                 context,);
+
+    error = pipeline_input_data(file, false, &input);
+    HANDLE_ERROR(NULL, error,
+                 C_("GPGME Error",
+                    "create new pipelined GPGME input data from file"),
+                 context,);
+
+    preview_sink sink = {
+        .plain = g_byte_array_new(),
+        .limit = limit,
+    };
+
+    error = gpgme_data_new_from_cbs(&output, &preview_cbs, &sink);
+    HANDLE_ERROR(NULL, error,
+                 C_("GPGME Error", "create new GPGME data for preview"),
+                 context, gpgme_data_release(input);
+                 g_byte_array_unref(sink.plain););
+
+    if (options != NULL)
+        options->size = process_file_size(file);
+
+    /* A remembered session key skips the public-key decryption */
+    g_autofree gchar *id = (options != NULL && options->session_cache) ?
+        session_cache_id_file(file) : NULL;
+    cryptography_session_prepare(context, id);
+
+    gint64 start = g_get_monotonic_time();
+
+    error = gpgme_op_decrypt(context, input, output);
+
+    /* Stopping the engine fails the decryption, a full preview is fine */
+    bool stopped = sink.plain->len >= limit;
+    if (stopped)
+        error = 0;
+    else
+        cryptography_session_finish(context, id, error);
+
+    HANDLE_ERROR(NULL, error,
+                 C_("GPGME Error", "decrypt GPGME data for preview"), context,
+                 gpgme_data_release(input); gpgme_data_release(output);
+                 g_byte_array_unref(sink.plain););
+
+    if (options != NULL)
+        options->duration = g_get_monotonic_time() - start;
+
+    /* The start of a compressed stream would be shown as garbage */
+    bool compressed = sink.plain->len >= PIPELINE_MARKER_LENGTH
+        && memcmp(sink.plain->data, PIPELINE_MARKER,
+                  PIPELINE_MARKER_LENGTH) == 0
+        && ((options != NULL && options->zstd)
+            || cryptography_pipeline_signalled(context));
+
+    /* Cleanup */
+    gpgme_release(context);
+    gpgme_data_release(input);
+    gpgme_data_release(output);
+
+    if (compressed) {
+        g_warning(_("Failed to preview file: %s"),
+                  C_("Preview error",
+                     "compressed files cannot be previewed"));
+
+        g_byte_array_unref(sink.plain);
+        return NULL;
+    }
+
+    return g_byte_array_free_to_bytes(sink.plain);
+}
+
+/**
+ * This function encrypts a directory into a file or decrypts a file into a directory.
+ *
+ * The directory is streamed through the engine as an archive, see directory.c.
+ *
+ * @param input Directory to encrypt or file to decrypt
+ * @param output File to write the encrypted directory to or directory to extract the decrypted file into
+ * @param flags Processing options, either ENCRYPT or DECRYPT
+ * @param key Key to encrypt for. Can be NULL
+ * @param options Parameters of the operation, receives the details reported by the engine. Can be NULL
+ *
+ * @return Success
+ */
+bool process_directory(GFile *input, GFile *output, cryptography_flags flags,
+                       gpgme_key_t key, cryptography_options *options)
+{
+    gpgme_ctx_t context;
+    gpgme_data_t input_data;
+    gpgme_data_t output_data;
+
+    gpgme_error_t error;
+
+    error = gpgme_new(&context);
+    HANDLE_ERROR(false, error, C_("GPGME Error", "create new GPGME context"),
+                 context,);
+
+    error = gpgme_set_protocol(context, GPGME_PROTOCOL_OpenPGP);
+    HANDLE_ERROR(false, error,
+                 C_("GPGME Error", "set protocol of GPGME context to OpenPGP"),
+                 context,);
+
+    directory_stage *directory = NULL;
+    pipeline_stage *stage = NULL;
+
+    if (flags & ENCRYPT) {
+        error = directory_input_data(input, &input_data, &directory);
+        HANDLE_ERROR(false, error,
+                     C_("GPGME Error",
+                        "create new GPGME input data from folder"), context,);
+
+        error = pipeline_output_data(output, false, 0, &output_data, &stage);
+        HANDLE_ERROR(false, error,
+                     C_("GPGME Error",
+                        "create new pipelined GPGME output data for file"),
+                     context, gpgme_data_release(input_data);
+                     directory_finish(directory, false););
+    } else {
+        error = pipeline_input_data(input, false, &input_data);
+        HANDLE_ERROR(false, error,
+                     C_("GPGME Error",
+                        "create new pipelined GPGME input data from file"),
+                     context,);
+
+        error = directory_output_data(output, &output_data, &directory);
+        HANDLE_ERROR(false, error,
+                     C_("GPGME Error",
+                        "create new GPGME output data for folder"), context,
+                     gpgme_data_release(input_data););
+    }
+
+    g_autofree gchar *id = (flags & DECRYPT && options != NULL
+                            && options->session_cache) ?
+        session_cache_id_file(input) : NULL;
+    cryptography_session_prepare(context, id);
+
+    gint64 start = g_get_monotonic_time();
+
+    const char *operation = NULL;
+    if (flags & ENCRYPT) {
+        // The archive mixes files of all kinds, so sampling one would not tell much
+        gpgme_encrypt_flags_t encrypt_flags = (options != NULL
+                                               && options->compression ==
+                                               COMPRESSION_NEVER) ?
+            GPGME_ENCRYPT_NO_COMPRESS : 0;
+
+        operation = C_("GPGME Error", "encrypt GPGME data from folder");
+        error = gpgme_op_encrypt(context, (gpgme_key_t[]) {
+                                 key, NULL}
+                                 , encrypt_flags, input_data, output_data);
+    } else {
+        operation = C_("GPGME Error", "decrypt GPGME data into folder");
+        error = gpgme_op_decrypt(context, input_data, output_data);
+        cryptography_session_finish(context, id, error);
+    }
+
+    // The archive has to be complete before the encrypted file replaces the output
+    if (!directory_finish(directory, !error) && !error)
+        error = gpgme_error(GPG_ERR_GENERAL);
+    if (!error && stage != NULL && !pipeline_finish(stage))
+        error = gpgme_error_from_syserror();
+    HANDLE_ERROR(false, error, operation, context,
+                 gpgme_data_release(input_data);
+                 gpgme_data_release(output_data););
+
+    cryptography_options_report(context, flags, start, options);
+
+    /* Cleanup */
+    gpgme_release(context);
+    gpgme_data_release(input_data);
+    gpgme_data_release(output_data);
+
+    return true;
+}
+
+/**** Inspection ****/
+
+/**
+ * This function summarizes OpenPGP text without decrypting or verifying it.
+ *
+ * @param text Armored OpenPGP text
+ *
+ * @return Summary or NULL if the text is not OpenPGP. Free with openpgp_summary_free()
+ */
+openpgp_summary *inspect_text(const char *text)
+{
+    return openpgp_inspect((const guint8 *)text,
+                           MIN(strlen(text), INSPECT_HEAD_SIZE));
+}
+
+/**
+ * This function summarizes an OpenPGP file without decrypting or verifying it.
+ *
+ * Only the first INSPECT_HEAD_SIZE bytes are read, however large the file is.
+ *
+ * @param file Binary or armored OpenPGP file
+ *
+ * @return Summary or NULL if the file is not OpenPGP or cannot be read. Free with openpgp_summary_free()
+ */
+openpgp_summary *inspect_file(GFile *file)
+{
+    GFileInputStream *stream = g_file_read(file, NULL, NULL);
+    if (stream == NULL)
+        return NULL;
+
+    guint8 *head = g_malloc(INSPECT_HEAD_SIZE);
+    gsize length = 0;
+    openpgp_summary *summary = NULL;
+
+    if (g_input_stream_read_all(G_INPUT_STREAM(stream), head,
+                                INSPECT_HEAD_SIZE, &length, NULL, NULL))
+        summary = openpgp_inspect(head, length);
+
+    /* Cleanup */
+    g_free(head);
+    head = NULL;
+
+    g_object_unref(stream);
+    stream = NULL;
+
+    return summary;
+}
+
+/**
+ * This function finds a file next to another one, named like it with a suffix added or removed.
+ *
+ * @param file File to look next to
+ * @param suffix Suffix to add or remove
+ * @param strip Whether to remove the suffix instead of adding it
+ *
+ * @return Existing file or NULL. Owned by caller
+ */
+static GFile *inspect_sibling(GFile *file, const char *suffix, bool strip)
+{
+    gchar *basename = g_file_get_basename(file);
+    gchar *name = NULL;
+
+    if (!strip) {
+        name = g_strconcat(basename, suffix, NULL);
+    } else if (strlen(basename) > strlen(suffix)
+               && g_str_has_suffix(basename, suffix)) {
+        name = g_strndup(basename, strlen(basename) - strlen(suffix));
+    }
+
+    GFile *parent = g_file_get_parent(file);
+    GFile *sibling = (name != NULL && parent != NULL) ?
+        g_file_get_child(parent, name) : NULL;
+
+    if (sibling != NULL && !g_file_query_exists(sibling, NULL))
+        g_clear_object(&sibling);
+
+    /* Cleanup */
+    g_clear_object(&parent);
+
+    g_free(name);
+    name = NULL;
+
+    g_free(basename);
+    basename = NULL;
+
+    return sibling;
+}
+
+/**
+ * This function decides which operation a file needs from its leading packets, so no engine run is spent on a wrong guess.
+ *
+ * Encrypted files are decrypted and verified, signed files are verified and files with a detached signature next to them,
+ * named like them with “.sig” or “.asc” appended, are verified against it. Anything else is encrypted.
+ *
+ * @param file File to route. A detached signature is routed to the file it signs
+ * @param input Set to the file to process. Owned by caller
+ * @param signature Set to the detached signature to verify input against or NULL. Owned by caller
+ *
+ * @return Operation or 0 if there is nothing to do, e.g. for keys or a signature without the file it signs
+ */
+cryptography_flags inspect_route(GFile *file, GFile **input,
+                                 GFile **signature)
+{
+    static const char *suffixes[] = { ".sig", ".asc" };
+
+    *input = g_object_ref(file);
+    *signature = NULL;
+
+    if (container_detect(file))
+        return DECRYPT;
+
+    openpgp_summary *summary = inspect_file(file);
+    cryptography_flags flags = 0;
+
+    switch ((summary != NULL) ? summary->type : OPENPGP_MESSAGE_UNKNOWN) {
+    case OPENPGP_MESSAGE_ENCRYPTED:
+        flags = DECRYPT | VERIFY;
+        break;
+    case OPENPGP_MESSAGE_SIGNED:
+    case OPENPGP_MESSAGE_LITERAL:
+    case OPENPGP_MESSAGE_COMPRESSED:
+        /* Signing compresses, so compressed data is most likely signed */
+        flags = VERIFY;
+        break;
+    case OPENPGP_MESSAGE_SIGNATURE:
+        for (gsize i = 0; flags == 0 && i < G_N_ELEMENTS(suffixes); i++) {
+            GFile *signed_file = inspect_sibling(file, suffixes[i], true);
+            if (signed_file == NULL)
+                continue;
+
+            g_object_unref(*input);
+            *input = signed_file;
+            *signature = g_object_ref(file);
+            flags = VERIFY;
+        }
+        break;
+    case OPENPGP_MESSAGE_PUBLIC_KEY:
+    case OPENPGP_MESSAGE_SECRET_KEY:
+        break;
+    case OPENPGP_MESSAGE_UNKNOWN:
+        flags = ENCRYPT;
+
+        for (gsize i = 0; flags == ENCRYPT && i < G_N_ELEMENTS(suffixes); i++) {
+            GFile *sibling = inspect_sibling(file, suffixes[i], false);
+            if (sibling == NULL)
+                continue;
+
+            openpgp_summary *detached = inspect_file(sibling);
+            if (detached != NULL
+                && detached->type == OPENPGP_MESSAGE_SIGNATURE) {
+                *signature = g_object_ref(sibling);
+                flags = VERIFY;
+            }
+
+            openpgp_summary_free(detached);
+            detached = NULL;
+
+            g_object_unref(sibling);
+            sibling = NULL;
+        }
+        break;
+    }
+
+    /* Cleanup */
+    openpgp_summary_free(summary);
+    summary = NULL;
+
+    return flags;
 }
@@ -1,9 +1,18 @@
 #ifndef CRYPTOGRAPHY_H
 #define CRYPTOGRAPHY_H
 
+#include <gio/gio.h>
 #include <gpgme.h>
 
 #include <stdbool.h>
+#include <stdint.h>
+#include "openpgp.h"
+
+/* Bytes read from the start of a file to inspect it */
+#define INSPECT_HEAD_SIZE (64 * 1024)
+
+/* Bytes of plaintext decrypted to preview a file */
+#define PREVIEW_SIZE (16 * 1024)
 
 typedef enum {
     ENCRYPT = 1 << 0,
@@ -13,22 +22,82 @@ typedef enum {
 } cryptography_flags;
 
 typedef enum {
-    IMPORT = 1 << 0,
-    EXPORT = 1 << 1,
-    REMOVE = 1 << 2
-} key_flags;
+    EXPORT_MINIMAL = 1 << 0,
+    EXPORT_BINARY = 1 << 1
+} key_export_flags;
+
+typedef enum {
+    COMPRESSION_AUTOMATIC,      /**< Compress unless the input looks incompressible */
+    COMPRESSION_ALWAYS,
+    COMPRESSION_NEVER
+} compression_mode;
+
+/**
+ * This structure holds the parameters of an operation and the details the engine reports back.
+ */
+typedef struct {
+    compression_mode compression; /**< Compression before encryption */
+    bool zstd; /**< Compress files with multi-threaded zstd instead of the engine */
+    bool chunked; /**< Encrypt files into a container of chunks processed in parallel */
+    bool session_cache; /**< Reuse and remember session keys of decrypted messages, see sessioncache.c */
+    GFile *signature; /**< Detached signature to verify the input against. Not owned */
+    bool compressed; /**< Set to whether an encryption compressed the data */
+    char *cipher; /**< Set to the symmetric algorithm and mode of a decryption, e.g. AES256.OCB */
+    char *signature_issue; /**< Set to why a signature could not be checked, e.g. a missing key. NULL if there is none */
+    int64_t size; /**< Set to the size of the input in bytes */
+    int64_t duration; /**< Set to the duration of the engine operation in microseconds */
+} cryptography_options;
+
+/**
+ * This structure holds the outcome of the import of a single file.
+ */
+typedef struct {
+    bool success;
+    int imported; /**< Keys new to the keyring or updated by the file */
+    int unchanged;
+    int failed;
+} key_import_stats;
+
+/**
+ * This structure holds the outcome of a batch of keypair generations.
+ */
+typedef struct {
+    int queued;
+    int generated;
+    int failed;
+} key_generate_stats;
 
 void cryptography_init();
+void cryptography_options_clear(cryptography_options * options);
 
 // Keys
 gpgme_key_t key_search(const char *userid);
 bool key_generate(const char *userid, const char *sign_algorithm,
                   const char *encrypt_algorithm, unsigned long expiry);
-bool key_manage(const char *path, const char *userid, key_flags flags);
+bool key_generate_batch(const char *path, const char *sign_algorithm,
+                        const char *encrypt_algorithm, unsigned long expiry,
+                        key_generate_stats * stats);
+bool key_import(const char *const *paths, key_import_stats * stats);
+bool key_export(const char *path, const char *const *fingerprints,
+                key_export_flags flags);
+bool key_remove(const char *const *fingerprints);
 
 /* Operations */
-char *process_text(const char *text, cryptography_flags flags, gpgme_key_t key);
-bool process_file(const char *input_path, const char *output_path,
-                  cryptography_flags flags, gpgme_key_t key);
+char *process_text(const char *text, cryptography_flags flags, gpgme_key_t key,
+                   cryptography_options * options);
+bool process_file(GFile * input_file, GFile * output_file,
+                  cryptography_flags flags, gpgme_key_t key,
+                  cryptography_options * options);
+bool process_directory(GFile * input, GFile * output,
+                       cryptography_flags flags, gpgme_key_t key,
+                       cryptography_options * options);
+GBytes *preview_file(GFile * file, gsize limit,
+                     cryptography_options * options);
+
+/* Inspection */
+openpgp_summary *inspect_text(const char *text);
+openpgp_summary *inspect_file(GFile * file);
+cryptography_flags inspect_route(GFile * file, GFile ** input,
+                                 GFile ** signature);
 
 #endif                          // CRYPTOGRAPHY_H
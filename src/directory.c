@@ -0,0 +1,659 @@
+#define _GNU_SOURCE             // nftw
+
+#include "directory.h"
+
+#include <adwaita.h>
+#include <glib/gi18n.h>
+#include <glib/gstdio.h>
+#include <locale.h>
+#include "config.h"
+
+#include <gpgme.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#if HAVE_LIBARCHIVE
+#include <archive.h>
+#include <archive_entry.h>
+#endif
+
+/*
+ * Directories are encrypted as a pax archive streamed into the engine, and decrypted by streaming the archive back out.
+ *
+ * Archive thread -> socket -> engine (GPGME file descriptor data) -> socket -> extraction thread
+ *
+ * No archive is written to disk on either side. The sockets are written with MSG_NOSIGNAL and drained on failure,
+ * so neither side receives SIGPIPE when the other one stops early.
+ *
+ * Symbolic links are stored as links and never followed, neither when archiving nor when extracting.
+ * Holes of sparse files are recorded in the archive and recreated on extraction.
+ * Other special files, extended attributes, ACLs and ownership are not stored.
+ *
+ * The engine only reports forged or corrupted data at the end, so archives are extracted into a hidden directory next to their destination,
+ * which is moved into place on success and removed on failure.
+ * Entries are moved one by one, exchanging them with existing files, so a failed move puts every entry back.
+ */
+
+/* Size of the runs of zeros written for holes of sparse files */
+#define DIRECTORY_HOLE_SIZE (64 * 1024)
+
+/**
+ * This structure holds a directory streamed to or from the engine.
+ */
+struct directory_stage {
+    char *path; /**< Directory to archive or to extract into */
+    char *temporary; /**< Hidden directory an archive is extracted into */
+
+    int engine; /**< Socket of the engine */
+    int archive; /**< Socket of the thread */
+
+    GThread *thread;
+    bool success; /**< Set by the thread */
+};
+
+/**
+ * This function checks whether directories can be streamed to and from the engine.
+ *
+ * @return Whether libarchive is available
+ */
+bool directory_available()
+{
+    return HAVE_LIBARCHIVE;
+}
+
+/**
+ * This function creates a directory stage with a connected pair of sockets.
+ *
+ * @param path Directory of the stage
+ *
+ * @return Directory stage. NULL on failure, sets errno
+ */
+static directory_stage *directory_stage_new(const char *path)
+{
+    int sockets[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sockets) != 0)
+        return NULL;
+
+    int size = DIRECTORY_BUFFER_SIZE;
+    for (int i = 0; i < 2; i++) {
+        setsockopt(sockets[i], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+        setsockopt(sockets[i], SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    }
+
+    directory_stage *stage = g_new0(directory_stage, 1);
+    stage->path = g_strdup(path);
+    stage->engine = sockets[0];
+    stage->archive = sockets[1];
+
+    return stage;
+}
+
+/**
+ * This function frees a directory stage.
+ *
+ * @param stage Directory stage
+ */
+static void directory_stage_free(directory_stage *stage)
+{
+    if (stage->engine >= 0)
+        close(stage->engine);
+    if (stage->archive >= 0)
+        close(stage->archive);
+
+    g_free(stage->path);
+    stage->path = NULL;
+
+    g_free(stage->temporary);
+    stage->temporary = NULL;
+
+    g_free(stage);
+}
+
+/**
+ * This function removes a file or directory while walking a tree bottom-up.
+ *
+ * @param path https://man7.org/linux/man-pages/man3/nftw.3.html
+ * @param status https://man7.org/linux/man-pages/man3/nftw.3.html
+ * @param type https://man7.org/linux/man-pages/man3/nftw.3.html
+ * @param walk https://man7.org/linux/man-pages/man3/nftw.3.html
+ *
+ * @return https://man7.org/linux/man-pages/man3/nftw.3.html
+ */
+static int directory_remove_entry(const char *path, const struct stat *status,
+                                  int type, struct FTW *walk)
+{
+    (void)status;
+    (void)type;
+    (void)walk;
+
+    g_remove(path);
+
+    return 0;
+}
+
+#if HAVE_LIBARCHIVE
+
+/**** Archiving ****/
+
+/**
+ * This function passes archive data to the engine.
+ *
+ * @param archive https://github.com/libarchive/libarchive/wiki/ManPageArchiveWriteOpen3
+ * @param data Directory stage
+ * @param buffer https://github.com/libarchive/libarchive/wiki/ManPageArchiveWriteOpen3
+ * @param length https://github.com/libarchive/libarchive/wiki/ManPageArchiveWriteOpen3
+ *
+ * @return Bytes written. -1 on failure
+ */
+static la_ssize_t directory_archive_write(struct archive *archive, void *data,
+                                          const void *buffer, size_t length)
+{
+    directory_stage *stage = data;
+
+    ssize_t count;
+    do {
+        count = send(stage->archive, buffer, length, MSG_NOSIGNAL);
+    } while (count < 0 && errno == EINTR);
+
+    if (count < 0) {
+        archive_set_error(archive, errno, "%s", g_strerror(errno));
+        return -1;
+    }
+
+    return count;
+}
+
+/**
+ * This function copies the data of a regular file into an archive.
+ *
+ * @param disk Archive reading the directory
+ * @param archive Archive written to the engine
+ * @param zeros Run of zeros for holes. Allocated on the first hole, owned by caller
+ *
+ * @return Success
+ */
+static bool directory_archive_data(struct archive *disk,
+                                   struct archive *archive, guint8 **zeros)
+{
+    const void *buffer;
+    size_t length;
+    int64_t offset;
+    int64_t progress = 0;
+
+    int status;
+    while ((status = archive_read_data_block(disk, &buffer, &length, &offset))
+           == ARCHIVE_OK) {
+        /* Holes are written as zeros, which the sparse map of the entry leaves out of the archive again */
+        while (progress < offset) {
+            if (*zeros == NULL)
+                *zeros = g_malloc0(DIRECTORY_HOLE_SIZE);
+
+            size_t count = MIN(offset - progress, DIRECTORY_HOLE_SIZE);
+            if (archive_write_data(archive, *zeros, count) < 0)
+                return false;
+
+            progress += count;
+        }
+
+        if (archive_write_data(archive, buffer, length) < 0)
+            return false;
+
+        progress += length;
+    }
+
+    return status == ARCHIVE_EOF;
+}
+
+/**
+ * This function archives a directory into the socket of the engine.
+ *
+ * @param stage Directory stage
+ *
+ * @return https://docs.gtk.org/glib/callback.ThreadFunc.html
+ */
+static gpointer directory_archive(directory_stage *stage)
+{
+    struct archive *disk = archive_read_disk_new();
+    struct archive *archive = archive_write_new();
+    struct archive_entry *entry = archive_entry_new();
+    guint8 *zeros = NULL;
+
+    /* Entries are named relative to the parent, so the archive holds the directory itself */
+    gchar *parent = g_path_get_dirname(stage->path);
+    gsize prefix = strlen(parent) + (g_str_has_suffix(parent, "/") ? 0 : 1);
+
+    archive_read_disk_set_symlink_physical(disk);
+    archive_read_disk_set_standard_lookup(disk);
+    archive_read_disk_set_behavior(disk, ARCHIVE_READDISK_NO_TRAVERSE_MOUNTS
+                                   | ARCHIVE_READDISK_NO_XATTR
+                                   | ARCHIVE_READDISK_NO_ACL
+                                   | ARCHIVE_READDISK_NO_FFLAGS);
+
+    archive_write_set_format_pax_restricted(archive);
+    archive_write_set_bytes_in_last_block(archive, 1);
+
+    bool success =
+        archive_write_open2(archive, stage, NULL, directory_archive_write, NULL,
+                            NULL) == ARCHIVE_OK
+        && archive_read_disk_open(disk, stage->path) == ARCHIVE_OK;
+
+    while (success) {
+        archive_entry_clear(entry);
+
+        int status = archive_read_next_header2(disk, entry);
+        if (status == ARCHIVE_EOF)
+            break;
+        if (status < ARCHIVE_WARN) {
+            success = false;
+            break;
+        }
+
+        archive_read_disk_descend(disk);
+
+        const char *path = archive_entry_pathname(entry);
+        mode_t type = archive_entry_filetype(entry);
+
+        if (type != AE_IFREG && type != AE_IFDIR && type != AE_IFLNK) {
+            g_warning(_("Skipped special file while archiving folder: %s"),
+                      path);
+            continue;
+        }
+
+        archive_entry_set_pathname(entry, path + MIN(prefix, strlen(path)));
+
+        success = archive_write_header(archive, entry) >= ARCHIVE_WARN;
+        if (success && type == AE_IFREG)
+            success = directory_archive_data(disk, archive, &zeros);
+    }
+
+    success = (archive_write_close(archive) == ARCHIVE_OK) && success;
+    if (!success)
+        g_warning(_("Failed to archive folder: %s"),
+                  archive_error_string(archive) !=
+                  NULL ? archive_error_string(archive) :
+                  archive_error_string(disk));
+
+    // Ends the stream of the engine
+    close(stage->archive);
+    stage->archive = -1;
+
+    stage->success = success;
+
+    /* Cleanup */
+    g_free(zeros);
+    zeros = NULL;
+
+    g_free(parent);
+    parent = NULL;
+
+    archive_entry_free(entry);
+    archive_read_free(disk);
+    archive_write_free(archive);
+
+    return NULL;
+}
+
+/**** Extraction ****/
+
+/**
+ * This function extracts an archive from the socket of the engine.
+ *
+ * @param stage Directory stage
+ *
+ * @return https://docs.gtk.org/glib/callback.ThreadFunc.html
+ */
+static gpointer directory_extract(directory_stage *stage)
+{
+    struct archive *archive = archive_read_new();
+    struct archive *disk = archive_write_disk_new();
+    struct archive_entry *entry;
+
+    archive_read_support_format_tar(archive);
+
+    archive_write_disk_set_options(disk, ARCHIVE_EXTRACT_TIME
+                                   | ARCHIVE_EXTRACT_PERM
+                                   | ARCHIVE_EXTRACT_SPARSE
+                                   | ARCHIVE_EXTRACT_SECURE_SYMLINKS
+                                   | ARCHIVE_EXTRACT_SECURE_NODOTDOT);
+    archive_write_disk_set_standard_lookup(disk);
+
+    bool success =
+        archive_read_open_fd(archive, stage->archive,
+                             DIRECTORY_HOLE_SIZE) == ARCHIVE_OK;
+
+    while (success) {
+        int status = archive_read_next_header(archive, &entry);
+        if (status == ARCHIVE_EOF)
+            break;
+        if (status < ARCHIVE_WARN) {
+            success = false;
+            break;
+        }
+
+        const char *name = archive_entry_pathname(entry);
+        mode_t type = archive_entry_filetype(entry);
+
+        /* Entries never leave the destination */
+        if (name == NULL || g_path_is_absolute(name)) {
+            g_warning(_("Skipped unsafe archive entry: %s"), name);
+            continue;
+        }
+        if (archive_entry_hardlink(entry) != NULL
+            || (type != AE_IFREG && type != AE_IFDIR && type != AE_IFLNK)) {
+            g_warning(_("Skipped special file while extracting folder: %s"),
+                      name);
+            continue;
+        }
+
+        gchar *path = g_build_filename(stage->temporary, name, NULL);
+        archive_entry_set_pathname(entry, path);
+
+        success = archive_read_extract2(archive, entry, disk) >= ARCHIVE_WARN;
+
+        g_free(path);
+        path = NULL;
+    }
+
+    // Applies the times and permissions of directories
+    success = (archive_write_close(disk) == ARCHIVE_OK) && success;
+    if (!success)
+        g_warning(_("Failed to extract folder: %s"),
+                  archive_error_string(archive) !=
+                  NULL ? archive_error_string(archive) :
+                  archive_error_string(disk));
+
+    /* Keeps the engine from writing into a closed socket */
+    char buffer[4096];
+    ssize_t count;
+    do {
+        count = read(stage->archive, buffer, sizeof(buffer));
+    } while (count > 0 || (count < 0 && errno == EINTR));
+
+    stage->success = success;
+
+    /* Cleanup */
+    archive_read_free(archive);
+    archive_write_free(disk);
+
+    return NULL;
+}
+
+#endif                          // HAVE_LIBARCHIVE
+
+/**** Stages ****/
+
+/**
+ * This function creates GPGME data that reads a directory as an archive.
+ *
+ * @param directory Directory to archive. Needs to be local
+ * @param data Receives the GPGME data
+ * @param stage Receives the directory stage to finish once the engine read all data
+ *
+ * @return GPGME error
+ */
+gpgme_error_t directory_input_data(GFile *directory, gpgme_data_t *data,
+                                   directory_stage **stage)
+{
+#if HAVE_LIBARCHIVE
+    char *path = g_file_get_path(directory);
+    if (path == NULL) {
+        g_warning(_("Failed to archive folder: %s"),
+                  C_("Folder error", "folder is not stored locally"));
+        return gpgme_error(GPG_ERR_INV_VALUE);
+    }
+
+    *stage = directory_stage_new(path);
+
+    g_free(path);
+    path = NULL;
+
+    if (*stage == NULL)
+        return gpgme_error_from_syserror();
+
+    gpgme_error_t error = gpgme_data_new_from_fd(data, (*stage)->engine);
+    if (error) {
+        directory_stage_free(*stage);
+        *stage = NULL;
+
+        return error;
+    }
+
+    gchar *basename = g_file_get_basename(directory);
+    gchar *name = g_strconcat(basename, ".tar", NULL);
+    gpgme_data_set_file_name(*data, name);
+
+    g_free(basename);
+    basename = NULL;
+
+    g_free(name);
+    name = NULL;
+
+    (*stage)->thread =
+        g_thread_new("directory_archive", (GThreadFunc) directory_archive,
+                     *stage);
+
+    return 0;
+#else
+    (void)directory;
+    (void)data;
+    (void)stage;
+
+    return gpgme_error(GPG_ERR_NOT_SUPPORTED);
+#endif
+}
+
+/**
+ * This function creates GPGME data that extracts an archive into a directory.
+ *
+ * @param directory Directory to extract into. Needs to be local
+ * @param data Receives the GPGME data
+ * @param stage Receives the directory stage to finish once the engine wrote all data
+ *
+ * @return GPGME error
+ */
+gpgme_error_t directory_output_data(GFile *directory, gpgme_data_t *data,
+                                    directory_stage **stage)
+{
+#if HAVE_LIBARCHIVE
+    char *path = g_file_get_path(directory);
+    if (path == NULL) {
+        g_warning(_("Failed to extract folder: %s"),
+                  C_("Folder error", "folder is not stored locally"));
+        return gpgme_error(GPG_ERR_INV_VALUE);
+    }
+
+    *stage = directory_stage_new(path);
+
+    g_free(path);
+    path = NULL;
+
+    if (*stage == NULL)
+        return gpgme_error_from_syserror();
+
+    (*stage)->temporary = g_build_filename((*stage)->path, ".lock-XXXXXX",
+                                           NULL);
+    if (g_mkdtemp((*stage)->temporary) == NULL) {
+        gpgme_error_t error = gpgme_error_from_syserror();
+        g_warning(_("Failed to extract folder: %s"), g_strerror(errno));
+
+        g_free((*stage)->temporary);
+        (*stage)->temporary = NULL;
+
+        directory_stage_free(*stage);
+        *stage = NULL;
+
+        return error;
+    }
+
+    gpgme_error_t error = gpgme_data_new_from_fd(data, (*stage)->engine);
+    if (error) {
+        g_rmdir((*stage)->temporary);
+
+        directory_stage_free(*stage);
+        *stage = NULL;
+
+        return error;
+    }
+
+    (*stage)->thread =
+        g_thread_new("directory_extract", (GThreadFunc) directory_extract,
+                     *stage);
+
+    return 0;
+#else
+    (void)directory;
+    (void)data;
+    (void)stage;
+
+    return gpgme_error(GPG_ERR_NOT_SUPPORTED);
+#endif
+}
+
+/**
+ * This function checks whether an existing entry may be replaced by an extracted one.
+ *
+ * @param path Existing entry
+ *
+ * @return Whether the entry is no directory or an empty one
+ */
+static bool directory_replaceable(const char *path)
+{
+    GStatBuf status;
+    if (g_lstat(path, &status) != 0 || !S_ISDIR(status.st_mode))
+        return true;
+
+    GDir *entries = g_dir_open(path, 0, NULL);
+    if (entries == NULL)
+        return false;
+
+    bool empty = (g_dir_read_name(entries) == NULL);
+
+    /* Cleanup */
+    g_dir_close(entries);
+    entries = NULL;
+
+    return empty;
+}
+
+/**
+ * This function moves an extracted archive into its destination.
+ *
+ * Existing entries are exchanged into the hidden directory, so they are removed with it on success.
+ * On failure, every entry moved so far is moved back.
+ *
+ * @param stage Directory stage
+ *
+ * @return Success
+ */
+static bool directory_publish(directory_stage *stage)
+{
+    GDir *entries = g_dir_open(stage->temporary, 0, NULL);
+    if (entries == NULL)
+        return false;
+
+    GPtrArray *moved = g_ptr_array_new_with_free_func(g_free);
+    GArray *exchanged = g_array_new(false, false, sizeof(gboolean));
+
+    bool success = true;
+    const char *name;
+    while (success && (name = g_dir_read_name(entries)) != NULL) {
+        gchar *source = g_build_filename(stage->temporary, name, NULL);
+        gchar *target = g_build_filename(stage->path, name, NULL);
+
+        // Replacing a non-empty folder would drop files the archive does not contain
+        gboolean exchange = g_file_test(target, G_FILE_TEST_EXISTS
+                                        | G_FILE_TEST_IS_SYMLINK);
+        if (exchange && !directory_replaceable(target)) {
+            errno = ENOTEMPTY;
+            success = false;
+        } else {
+            success = (renameat2(AT_FDCWD, source, AT_FDCWD, target,
+                                 exchange ? RENAME_EXCHANGE :
+                                 RENAME_NOREPLACE) == 0);
+        }
+
+        if (success) {
+            g_ptr_array_add(moved, g_strdup(name));
+            g_array_append_val(exchanged, exchange);
+        } else {
+            g_warning(_("Failed to extract folder: %s"), g_strerror(errno));
+        }
+
+        g_free(source);
+        source = NULL;
+
+        g_free(target);
+        target = NULL;
+    }
+
+    /* Rollback */
+    for (guint i = moved->len; !success && i > 0; i--) {
+        gchar *source = g_build_filename(stage->temporary,
+                                         g_ptr_array_index(moved, i - 1),
+                                         NULL);
+        gchar *target = g_build_filename(stage->path,
+                                         g_ptr_array_index(moved, i - 1),
+                                         NULL);
+
+        if (renameat2(AT_FDCWD, target, AT_FDCWD, source,
+                      g_array_index(exchanged, gboolean, i - 1) ?
+                      RENAME_EXCHANGE : RENAME_NOREPLACE) != 0)
+            g_warning(_("Failed to restore %s: %s"), target,
+                      g_strerror(errno));
+
+        g_free(source);
+        source = NULL;
+
+        g_free(target);
+        target = NULL;
+    }
+
+    /* Cleanup */
+    g_ptr_array_free(moved, true);
+    moved = NULL;
+
+    g_array_free(exchanged, true);
+    exchanged = NULL;
+
+    g_dir_close(entries);
+    entries = NULL;
+
+    return success;
+}
+
+/**
+ * This function waits for the thread of a directory stage and frees the stage.
+ *
+ * @param stage Directory stage. Freed by the function
+ * @param success Whether the engine operation succeeded. Extracted files are discarded otherwise
+ *
+ * @return Whether the operation and the directory stage succeeded
+ */
+bool directory_finish(directory_stage *stage, bool success)
+{
+    // Ends the stream of an extraction or stops an archive the engine stopped reading
+    shutdown(stage->engine, SHUT_RDWR);
+
+    g_thread_join(stage->thread);
+    stage->thread = NULL;
+
+    success = success && stage->success;
+
+    if (stage->temporary != NULL) {
+        if (success)
+            success = directory_publish(stage);
+
+        nftw(stage->temporary, directory_remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+    }
+
+    directory_stage_free(stage);
+    stage = NULL;
+
+    return success;
+}
@@ -0,0 +1,22 @@
+#ifndef DIRECTORY_H
+#define DIRECTORY_H
+
+#include <gio/gio.h>
+#include <gpgme.h>
+
+#include <stdbool.h>
+
+/* Size of the socket buffer between the archive and the engine */
+#define DIRECTORY_BUFFER_SIZE (1024 * 1024)
+
+typedef struct directory_stage directory_stage;
+
+bool directory_available();
+
+gpgme_error_t directory_input_data(GFile * directory, gpgme_data_t * data,
+                                   directory_stage ** stage);
+gpgme_error_t directory_output_data(GFile * directory, gpgme_data_t * data,
+                                    directory_stage ** stage);
+bool directory_finish(directory_stage * stage, bool success);
+
+#endif                          // DIRECTORY_H
@@ -0,0 +1,469 @@
+#include "journal.h"
+
+#include <adwaita.h>
+#include <glib/gi18n.h>
+#include <glib/gstdio.h>
+#include <locale.h>
+#include "config.h"
+
+#include <gpgme.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include "batch.h"
+
+/*
+ * A journal remembers the progress of a batch, so a batch started again after a crash or restart
+ * only processes the files that are not done yet.
+ *
+ * Each batch is identified by its operation, key, output directory and set of files, in any order. Its journal is a file in the
+ * state directory with one line appended per processed file:
+ *
+ * <status>\t<input URI>\t<output URI>\t<input size>\t<input modification time>\t<output SHA-256>
+ *
+ * Lines are only appended and synced, so a crash loses at most the line being written.
+ * An unterminated last line is ignored, the latest line of a file wins.
+ *
+ * A file is only skipped if its input is unchanged and its output still has the recorded checksum.
+ * The journal is removed once every file of the batch succeeded.
+ */
+
+#define JOURNAL_DONE "done"
+#define JOURNAL_FAILED "failed"
+#define JOURNAL_FIELDS 6
+
+/**
+ * This structure holds the journal of a batch.
+ */
+struct journal {
+    char *path;
+    int descriptor; /**< Opened for appending */
+    GMutex lock; /**< Serializes appended lines */
+
+    GHashTable *done; /**< Completed files of previous runs, input URI to journal_entry */
+};
+
+/**
+ * This structure holds a completed file of a previous run.
+ */
+typedef struct {
+    gchar *output;
+    guint64 size;
+    guint64 modified;
+    gchar *checksum;
+} journal_entry;
+
+/**
+ * This function frees a completed file of a previous run.
+ *
+ * @param entry Entry to free
+ */
+static void journal_entry_free(journal_entry *entry)
+{
+    g_free(entry->output);
+    entry->output = NULL;
+
+    g_free(entry->checksum);
+    entry->checksum = NULL;
+
+    g_free(entry);
+}
+
+/**
+ * This function returns the directory of the journals.
+ *
+ * @return Path. Owned by caller
+ */
+static gchar *journal_directory()
+{
+    return g_build_filename(g_get_user_state_dir(), PROJECT_ID, "jobs", NULL);
+}
+
+/**
+ * This function compares two strings of a GPtrArray.
+ *
+ * @param a https://docs.gtk.org/glib/callback.CompareFunc.html
+ * @param b https://docs.gtk.org/glib/callback.CompareFunc.html
+ *
+ * @return https://docs.gtk.org/glib/callback.CompareFunc.html
+ */
+static gint journal_compare(gconstpointer a, gconstpointer b)
+{
+    return g_strcmp0(*(const gchar **)a, *(const gchar **)b);
+}
+
+/**
+ * This function identifies a batch.
+ *
+ * The files are sorted, so the same files selected in a different order continue the same journal.
+ *
+ * @param jobs Files of the batch, elements are batch_job
+ * @param flags Operation of the batch
+ * @param key Key of the batch. Can be NULL
+ * @param directory Directory of the outputs. Can be NULL
+ *
+ * @return Hexadecimal SHA-256 digest. Owned by caller
+ */
+static gchar *journal_id(GPtrArray *jobs, cryptography_flags flags,
+                         gpgme_key_t key, GFile *directory)
+{
+    GChecksum *checksum = g_checksum_new(G_CHECKSUM_SHA256);
+
+    gchar *output = (directory != NULL) ? g_file_get_uri(directory) : NULL;
+    gchar *operation = g_strdup_printf("%d\n%s\n%s\n", flags,
+                                       (key != NULL) ? key->subkeys->fpr : "",
+                                       (output != NULL) ? output : "");
+    g_checksum_update(checksum, (const guchar *)operation, -1);
+
+    g_free(operation);
+    operation = NULL;
+
+    g_free(output);
+    output = NULL;
+
+    GPtrArray *lines = g_ptr_array_new_full(jobs->len, g_free);
+
+    for (guint i = 0; i < jobs->len; i++) {
+        batch_job *job = g_ptr_array_index(jobs, i);
+
+        gchar *input = (job->input != NULL) ?
+            g_file_get_uri(job->input) : NULL;
+        gchar *destination = (job->destination != NULL) ?
+            g_file_get_uri(job->destination) : NULL;
+
+        g_ptr_array_add(lines, g_strdup_printf("%s\n%s\n",
+                                               (input != NULL) ? input : "",
+                                               (destination != NULL) ?
+                                               destination : ""));
+
+        g_free(input);
+        input = NULL;
+
+        g_free(destination);
+        destination = NULL;
+    }
+
+    g_ptr_array_sort(lines, journal_compare);
+    for (guint i = 0; i < lines->len; i++)
+        g_checksum_update(checksum, g_ptr_array_index(lines, i), -1);
+
+    gchar *id = g_strdup(g_checksum_get_string(checksum));
+
+    /* Cleanup */
+    g_ptr_array_free(lines, true);
+    lines = NULL;
+
+    g_checksum_free(checksum);
+    checksum = NULL;
+
+    return id;
+}
+
+/**
+ * This function removes journals of batches that were never completed nor started again.
+ *
+ * @param path Directory of the journals
+ */
+static void journal_expire(const char *path)
+{
+    GDir *directory = g_dir_open(path, 0, NULL);
+    if (directory == NULL)
+        return;
+
+    gint64 expiry =
+        g_get_real_time() / G_USEC_PER_SEC -
+        (gint64) JOURNAL_EXPIRY_DAYS * 24 * 60 * 60;
+
+    const char *name;
+    while ((name = g_dir_read_name(directory)) != NULL) {
+        if (!g_str_has_suffix(name, JOURNAL_SUFFIX))
+            continue;
+
+        gchar *file = g_build_filename(path, name, NULL);
+
+        GStatBuf status;
+        if (g_stat(file, &status) == 0 && status.st_mtime < expiry)
+            g_unlink(file);
+
+        g_free(file);
+        file = NULL;
+    }
+
+    /* Cleanup */
+    g_dir_close(directory);
+    directory = NULL;
+}
+
+/**
+ * This function reads the completed files of a journal.
+ *
+ * @param journal Journal to read into
+ */
+static void journal_load(journal *journal)
+{
+    gchar *contents = NULL;
+    if (!g_file_get_contents(journal->path, &contents, NULL, NULL))
+        return;
+
+    gchar **lines = g_strsplit(contents, "\n", -1);
+
+    /* The last element is either empty or an unterminated line of a crash */
+    for (gsize i = 0; lines[i] != NULL && lines[i + 1] != NULL; i++) {
+        gchar **fields = g_strsplit(lines[i], "\t", JOURNAL_FIELDS);
+
+        if (g_strv_length(fields) != JOURNAL_FIELDS)
+            goto next;
+
+        if (strcmp(fields[0], JOURNAL_DONE) != 0) {
+            g_hash_table_remove(journal->done, fields[1]);
+            goto next;
+        }
+
+        journal_entry *entry = g_new0(journal_entry, 1);
+        entry->output = g_strdup(fields[2]);
+        entry->size = g_ascii_strtoull(fields[3], NULL, 10);
+        entry->modified = g_ascii_strtoull(fields[4], NULL, 10);
+        entry->checksum = g_strdup(fields[5]);
+
+        g_hash_table_replace(journal->done, g_strdup(fields[1]), entry);
+
+ next:
+        g_strfreev(fields);
+        fields = NULL;
+    }
+
+    /* Cleanup */
+    g_strfreev(lines);
+    lines = NULL;
+
+    g_free(contents);
+    contents = NULL;
+}
+
+/**
+ * This function opens the journal of a batch, creating it if the batch was never started before.
+ *
+ * @param jobs Files of the batch, elements are batch_job
+ * @param flags Operation of the batch
+ * @param key Key of the batch. Can be NULL
+ * @param directory Directory of the outputs. Can be NULL
+ *
+ * @return Journal or NULL if it cannot be written. Close with journal_close()
+ */
+journal *journal_open(GPtrArray *jobs, cryptography_flags flags,
+                      gpgme_key_t key, GFile *directory)
+{
+    gchar *path = journal_directory();
+    if (g_mkdir_with_parents(path, 0700) != 0) {
+        g_warning(_("Failed to write job journal: %s"), g_strerror(errno));
+
+        g_free(path);
+        path = NULL;
+
+        return NULL;
+    }
+
+    journal_expire(path);
+
+    gchar *id = journal_id(jobs, flags, key, directory);
+    gchar *name = g_strconcat(id, JOURNAL_SUFFIX, NULL);
+
+    journal *journal = g_new0(struct journal, 1);
+    journal->path = g_build_filename(path, name, NULL);
+    journal->done =
+        g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                              (GDestroyNotify) journal_entry_free);
+    g_mutex_init(&journal->lock);
+
+    journal_load(journal);
+
+    journal->descriptor =
+        g_open(journal->path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+    if (journal->descriptor < 0) {
+        g_warning(_("Failed to write job journal: %s"), g_strerror(errno));
+
+        journal_close(journal, false);
+        journal = NULL;
+    }
+
+    /* Cleanup */
+    g_free(name);
+    name = NULL;
+
+    g_free(id);
+    id = NULL;
+
+    g_free(path);
+    path = NULL;
+
+    return journal;
+}
+
+/**
+ * This function reads the metadata of an input that decides whether it changed since it was journaled.
+ *
+ * @param input Input file
+ * @param size Receives the size
+ * @param modified Receives the modification time in microseconds
+ *
+ * @return Success
+ */
+bool journal_stamp(GFile *input, guint64 *size, guint64 *modified)
+{
+    GFileInfo *info =
+        g_file_query_info(input,
+                          G_FILE_ATTRIBUTE_STANDARD_SIZE ","
+                          G_FILE_ATTRIBUTE_TIME_MODIFIED ","
+                          G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC,
+                          G_FILE_QUERY_INFO_NONE, NULL, NULL);
+    if (info == NULL)
+        return false;
+
+    *size = g_file_info_get_size(info);
+    *modified =
+        g_file_info_get_attribute_uint64(info, G_FILE_ATTRIBUTE_TIME_MODIFIED)
+        * G_USEC_PER_SEC
+        + g_file_info_get_attribute_uint32(info,
+                                           G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+
+    /* Cleanup */
+    g_object_unref(info);
+    info = NULL;
+
+    return true;
+}
+
+/**
+ * This function checks whether a file was completed by a previous run and its output is still intact.
+ *
+ * Safe to call from several threads at once.
+ *
+ * @param journal Journal of the batch
+ * @param input Input file
+ * @param output Output file
+ * @param size Size of the input
+ * @param modified Modification time of the input in microseconds
+ *
+ * @return Whether the file can be skipped
+ */
+bool journal_resume(journal *journal, GFile *input, GFile *output,
+                    guint64 size, guint64 modified)
+{
+    gchar *input_uri = g_file_get_uri(input);
+    journal_entry *entry = g_hash_table_lookup(journal->done, input_uri);
+
+    g_free(input_uri);
+    input_uri = NULL;
+
+    if (entry == NULL || entry->size != size || entry->modified != modified)
+        return false;
+
+    gchar *output_uri = g_file_get_uri(output);
+    bool resume = strcmp(entry->output, output_uri) == 0
+        && g_file_query_exists(output, NULL);
+
+    g_free(output_uri);
+    output_uri = NULL;
+
+    if (!resume)
+        return false;
+
+    /* The output might have been modified or truncated since */
+    gchar *checksum = batch_checksum(output);
+    resume = g_strcmp0(checksum, entry->checksum) == 0;
+
+    g_free(checksum);
+    checksum = NULL;
+
+    return resume;
+}
+
+/**
+ * This function appends the outcome of a file to a journal.
+ *
+ * Safe to call from several threads at once.
+ *
+ * @param journal Journal of the batch
+ * @param input Input file
+ * @param output Output file
+ * @param size Size of the input before it was processed
+ * @param modified Modification time of the input before it was processed in microseconds
+ * @param checksum Hexadecimal SHA-256 digest of the output. NULL if the file failed
+ */
+void journal_record(journal *journal, GFile *input, GFile *output,
+                    guint64 size, guint64 modified, const char *checksum)
+{
+    gchar *input_uri = g_file_get_uri(input);
+    gchar *output_uri = g_file_get_uri(output);
+
+    gchar *line =
+        g_strdup_printf("%s\t%s\t%s\t%" G_GUINT64_FORMAT "\t%" G_GUINT64_FORMAT
+                        "\t%s\n",
+                        (checksum != NULL) ? JOURNAL_DONE : JOURNAL_FAILED,
+                        input_uri, output_uri, size, modified,
+                        (checksum != NULL) ? checksum : "");
+    gsize length = strlen(line);
+
+    g_mutex_lock(&journal->lock);
+
+    gsize written = 0;
+    while (written < length) {
+        gssize count =
+            write(journal->descriptor, line + written, length - written);
+
+        if (count < 0 && errno == EINTR)
+            continue;
+
+        if (count < 0) {
+            g_warning(_("Failed to write job journal: %s"), g_strerror(errno));
+            break;
+        }
+
+        written += count;
+    }
+
+    /* The line has to survive a crash right after the file completed */
+    if (written == length)
+        fdatasync(journal->descriptor);
+
+    g_mutex_unlock(&journal->lock);
+
+    /* Cleanup */
+    g_free(line);
+    line = NULL;
+
+    g_free(output_uri);
+    output_uri = NULL;
+
+    g_free(input_uri);
+    input_uri = NULL;
+}
+
+/**
+ * This function closes the journal of a batch.
+ *
+ * @param journal Journal to close
+ * @param complete Whether every file of the batch succeeded, which removes the journal
+ */
+void journal_close(journal *journal, bool complete)
+{
+    if (journal->descriptor >= 0)
+        close(journal->descriptor);
+    journal->descriptor = -1;
+
+    if (complete)
+        g_unlink(journal->path);
+
+    /* Cleanup */
+    g_mutex_clear(&journal->lock);
+
+    g_hash_table_unref(journal->done);
+    journal->done = NULL;
+
+    g_free(journal->path);
+    journal->path = NULL;
+
+    g_free(journal);
+}
@@ -0,0 +1,27 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <gio/gio.h>
+#include <glib.h>
+#include <gpgme.h>
+
+#include <stdbool.h>
+#include "cryptography.h"
+
+/* Suffix of journal files */
+#define JOURNAL_SUFFIX ".journal"
+/* Age in days after which an abandoned journal is removed */
+#define JOURNAL_EXPIRY_DAYS 30
+
+typedef struct journal journal;
+
+journal *journal_open(GPtrArray * jobs, cryptography_flags flags,
+                      gpgme_key_t key, GFile * directory);
+bool journal_stamp(GFile * input, guint64 * size, guint64 * modified);
+bool journal_resume(journal * journal, GFile * input, GFile * output,
+                    guint64 size, guint64 modified);
+void journal_record(journal * journal, GFile * input, GFile * output,
+                    guint64 size, guint64 modified, const char *checksum);
+void journal_close(journal * journal, bool complete);
+
+#endif                          // JOURNAL_H
@@ -8,8 +8,11 @@
 #include "config.h"
 
 #include <gpgme.h>
+#include <string.h>
 #include <time.h>
+#include "benchmark.h"
 #include "cryptography.h"
+#include "keyindex.h"
 #include "threading.h"
 
 /**
@@ -25,12 +28,30 @@ struct _LockKeyDialog {
     GtkButton *refresh_button;
     GtkBox *manage_box;
 
+    GtkToggleButton *select_button;
+    GtkActionBar *selection_bar;
+    gchar **selected; /**< Fingerprints of the keys of a bulk operation */
+    gboolean selected_success;
+
+    GtkButton *select_export_button;
+    GFile *export_file;
+    GSimpleActionGroup *export_actions;
+    key_export_flags export_flags; /**< Options of the running export */
+
+    GtkButton *select_remove_button;
+
     AdwStatusPage *status_page;
     GtkListBox *key_box;
+    GPtrArray *keys; /**< Keys currently presented in the key box */
+
+    gboolean refresh_running;
+    gboolean refresh_pending; /**< Keyring changed while the key list was being reconciled */
+    GPtrArray *refresh_keys; /**< Keys listed by the last reconciliation */
 
     gboolean import_success;
     GtkButton *import_button;
     GListModel *import_file;
+    key_import_stats *import_stats; /**< Outcome of each file of import_file */
 
     gboolean generate_success;
     GtkButton *generate_button;
@@ -39,13 +60,47 @@ struct _LockKeyDialog {
     AdwComboRow *sign_entry;
     AdwComboRow *encrypt_entry;
     AdwSpinRow *expiry_entry;
+
+    GtkButton *benchmark_button;
+    GPtrArray *benchmark; /**< Measured cost of the algorithms */
+    GPtrArray *benchmark_results; /**< Results of the running benchmark */
+    gchar **benchmark_sign; /**< Signing algorithms of the running benchmark */
+    gchar **benchmark_encrypt; /**< Encryption algorithms of the running benchmark */
+
+    GtkButton *generate_batch_button;
+    GFile *generate_file; /**< CSV file of identities */
+    key_generate_stats generate_stats;
 };
 
 G_DEFINE_TYPE(LockKeyDialog, lock_key_dialog, ADW_TYPE_DIALOG);
 
 /* UI */
+static void lock_key_dialog_populate(LockKeyDialog * dialog, GPtrArray * keys);
 gboolean lock_key_dialog_import_on_completed(LockKeyDialog * dialog);
 gboolean lock_key_dialog_generate_on_completed(LockKeyDialog * dialog);
+gboolean lock_key_dialog_generate_batch_on_completed(LockKeyDialog * dialog);
+gboolean lock_key_dialog_export_on_completed(LockKeyDialog * dialog);
+gboolean lock_key_dialog_remove_on_completed(LockKeyDialog * dialog);
+
+/* Selection */
+static void lock_key_dialog_selection_toggled(GtkToggleButton * self,
+                                              LockKeyDialog * dialog);
+static void lock_key_dialog_export_file_present(GtkButton * self,
+                                                LockKeyDialog * dialog);
+static void lock_key_dialog_backup(GSimpleAction * action,
+                                   GVariant * parameter,
+                                   LockKeyDialog * dialog);
+static void lock_key_dialog_remove_confirm(GtkButton * self,
+                                           LockKeyDialog * dialog);
+
+/* Generation */
+static void lock_key_dialog_generate_file_present(GtkButton * self,
+                                                  LockKeyDialog * dialog);
+static void lock_key_dialog_benchmark_start(GtkButton * self,
+                                            LockKeyDialog * dialog);
+static void lock_key_dialog_benchmark_present(GObject * self,
+                                              GParamSpec * pspec,
+                                              LockKeyDialog * dialog);
 
 /* Import */
 static void lock_key_dialog_import_file_present(GtkButton * self,
@@ -64,11 +119,85 @@ static void lock_key_dialog_init(LockKeyDialog *dialog)
                      G_CALLBACK(lock_key_dialog_refresh), dialog);
     lock_key_dialog_refresh(NULL, dialog);
 
+    g_signal_connect(dialog->select_button, "toggled",
+                     G_CALLBACK(lock_key_dialog_selection_toggled), dialog);
+    g_signal_connect(dialog->select_export_button, "clicked",
+                     G_CALLBACK(lock_key_dialog_export_file_present), dialog);
+    g_signal_connect(dialog->select_remove_button, "clicked",
+                     G_CALLBACK(lock_key_dialog_remove_confirm), dialog);
+
+    /* Export options */
+    dialog->export_actions = g_simple_action_group_new();
+
+    g_autoptr(GSimpleAction) export_minimal_action =
+        g_simple_action_new_stateful("export_minimal", NULL,
+                                     g_variant_new_boolean(false));
+    g_action_map_add_action(G_ACTION_MAP(dialog->export_actions),
+                            G_ACTION(export_minimal_action));
+
+    g_autoptr(GSimpleAction) export_binary_action =
+        g_simple_action_new_stateful("export_binary", NULL,
+                                     g_variant_new_boolean(false));
+    g_action_map_add_action(G_ACTION_MAP(dialog->export_actions),
+                            G_ACTION(export_binary_action));
+
+    g_autoptr(GSimpleAction) backup_action =
+        g_simple_action_new("backup", NULL);
+    g_signal_connect(backup_action, "activate",
+                     G_CALLBACK(lock_key_dialog_backup), dialog);
+    g_action_map_add_action(G_ACTION_MAP(dialog->export_actions),
+                            G_ACTION(backup_action));
+
+    gtk_widget_insert_action_group(GTK_WIDGET(dialog), "keys",
+                                   G_ACTION_GROUP(dialog->export_actions));
+
     g_signal_connect(dialog->import_button, "clicked",
                      G_CALLBACK(lock_key_dialog_import_file_present), dialog);
 
     g_signal_connect(dialog->generate_button, "clicked",
                      G_CALLBACK(thread_generate_key), dialog);
+    g_signal_connect(dialog->generate_batch_button, "clicked",
+                     G_CALLBACK(lock_key_dialog_generate_file_present), dialog);
+
+    g_signal_connect(dialog->benchmark_button, "clicked",
+                     G_CALLBACK(lock_key_dialog_benchmark_start), dialog);
+    g_signal_connect(dialog->sign_entry, "notify::selected",
+                     G_CALLBACK(lock_key_dialog_benchmark_present), dialog);
+    g_signal_connect(dialog->encrypt_entry, "notify::selected",
+                     G_CALLBACK(lock_key_dialog_benchmark_present), dialog);
+}
+
+/**
+ * This function finalizes a LockKeyDialog.
+ *
+ * @param object Dialog to be finalized
+ */
+static void lock_key_dialog_finalize(GObject *object)
+{
+    LockKeyDialog *dialog = LOCK_KEY_DIALOG(object);
+
+    if (dialog->keys != NULL) {
+        g_ptr_array_unref(dialog->keys);
+        dialog->keys = NULL;
+    }
+
+    g_strfreev(dialog->selected);
+    dialog->selected = NULL;
+
+    g_clear_object(&dialog->export_actions);
+
+    if (dialog->benchmark != NULL) {
+        g_ptr_array_unref(dialog->benchmark);
+        dialog->benchmark = NULL;
+    }
+
+    g_strfreev(dialog->benchmark_sign);
+    dialog->benchmark_sign = NULL;
+
+    g_strfreev(dialog->benchmark_encrypt);
+    dialog->benchmark_encrypt = NULL;
+
+    G_OBJECT_CLASS(lock_key_dialog_parent_class)->finalize(object);
 }
 
 /**
@@ -78,6 +207,8 @@ static void lock_key_dialog_init(LockKeyDialog *dialog)
  */
 static void lock_key_dialog_class_init(LockKeyDialogClass *class)
 {
+    G_OBJECT_CLASS(class)->finalize = lock_key_dialog_finalize;
+
     gtk_widget_class_set_template_from_resource(GTK_WIDGET_CLASS(class),
                                                 UI_RESOURCE("keydialog.ui"));
 
@@ -89,6 +220,15 @@ static void lock_key_dialog_class_init(LockKeyDialogClass *class)
     gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), LockKeyDialog,
                                          manage_box);
 
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), LockKeyDialog,
+                                         select_button);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), LockKeyDialog,
+                                         selection_bar);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), LockKeyDialog,
+                                         select_export_button);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), LockKeyDialog,
+                                         select_remove_button);
+
     gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), LockKeyDialog,
                                          status_page);
     gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), LockKeyDialog,
@@ -109,6 +249,10 @@ static void lock_key_dialog_class_init(LockKeyDialogClass *class)
                                          encrypt_entry);
     gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), LockKeyDialog,
                                          expiry_entry);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), LockKeyDialog,
+                                         generate_batch_button);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), LockKeyDialog,
+                                         benchmark_button);
 }
 
 /**
@@ -133,6 +277,8 @@ LockKeyDialog *lock_key_dialog_new(LockWindow *window)
 /**
  * This function refreshes the key list of a LockKeyDialog.
  *
+ * The list is painted from the key index right away if it is still valid and reconciled with the keyring in the background.
+ *
  * @param self https://docs.gtk.org/gtk4/signal.Button.clicked.html
  * @param dialog https://docs.gtk.org/gtk4/signal.Button.clicked.html
  */
@@ -140,60 +286,71 @@ void lock_key_dialog_refresh(GtkButton *self, LockKeyDialog *dialog)
 {
     (void)self;
 
+    if (dialog->refresh_running) {
+        dialog->refresh_pending = true;
+        return;
+    }
+
+    if (dialog->keys == NULL) {
+        GPtrArray *keys = key_index_load();
+
+        if (keys != NULL)
+            lock_key_dialog_populate(dialog, keys);
+    }
+
+    dialog->refresh_running = true;
+    dialog->refresh_pending = false;
+
+    g_object_ref(dialog);
+    thread_refresh_keys(dialog);
+}
+
+/**
+ * This function presents keys in the key list of a LockKeyDialog.
+ *
+ * @param dialog Dialog to present the keys in
+ * @param keys Array of key_index_entry. Ownership is transferred to the dialog
+ */
+static void lock_key_dialog_populate(LockKeyDialog *dialog, GPtrArray *keys)
+{
     gtk_list_box_remove_all(dialog->key_box);
 
-    size_t expiry_date_length = strlen("YYYY-mm-dd") + 1;
-    gchar *expiry_date = malloc(expiry_date_length * sizeof(char));
+    if (dialog->keys != NULL)
+        g_ptr_array_unref(dialog->keys);
+    dialog->keys = keys;
 
-    size_t expiry_time_length = strlen("HH:MM") + 1;
-    gchar *expiry_time = malloc(expiry_time_length * sizeof(char));
+    gchar expiry_date[sizeof("YYYY-mm-dd")];
+    gchar expiry_time[sizeof("HH:MM")];
 
     time_t expiry_timestamp;
     struct tm *expiry;
 
-    gpgme_ctx_t context;
-    gpgme_key_t key;
-    gpgme_error_t error;
-
-    error = gpgme_new(&context);
-    if (error)
-        return;
+    gboolean selection_mode =
+        gtk_toggle_button_get_active(dialog->select_button);
 
-    error = gpgme_op_keylist_start(context, NULL, 0);
-    while (!error) {
-        error = gpgme_op_keylist_next(context, &key);
+    for (guint i = 0; i < keys->len; i++) {
+        key_index_entry *key = g_ptr_array_index(keys, i);
+        LockKeyRow *row;
 
-        if (error)
-            break;
+        const gchar *uid = (key->uids[0] != NULL) ? key->uids[0] : "";
 
-        if (key->subkeys->expires == 0) {
-            expiry_date = NULL;
-            expiry_time = NULL;
+        if (key->expires == 0) {
+            row = lock_key_row_new(dialog, uid, key->fingerprint, NULL, NULL);
         } else {
-            expiry_timestamp = (time_t) key->subkeys->expires;
+            expiry_timestamp = (time_t) key->expires;
             expiry = localtime(&expiry_timestamp);
 
-            strftime(expiry_date, expiry_date_length, "%Y-%m-%d", expiry);
-            strftime(expiry_time, expiry_time_length, "%H:%M", expiry);
+            strftime(expiry_date, sizeof(expiry_date), "%Y-%m-%d", expiry);
+            strftime(expiry_time, sizeof(expiry_time), "%H:%M", expiry);
+
+            row = lock_key_row_new(dialog, uid, key->fingerprint, expiry_date,
+                                   expiry_time);
         }
 
-        gtk_list_box_append(dialog->key_box,
-                            GTK_WIDGET(lock_key_row_new
-                                       (dialog, key->uids->uid,
-                                        key->subkeys->fpr, expiry_date,
-                                        expiry_time)));
+        lock_key_row_set_selection_mode(row, selection_mode);
+        gtk_list_box_append(dialog->key_box, GTK_WIDGET(row));
     }
 
-    /* Cleanup */
-    gpgme_release(context);
-    gpgme_key_release(key);
-
-    g_free(expiry_date);
-    expiry_date = NULL;
-
-    g_free(expiry_time);
-    expiry_time = NULL;
-
     if (gtk_list_box_get_row_at_index(dialog->key_box, 0) == NULL) {
         gtk_widget_set_visible(GTK_WIDGET(dialog->key_box), false);
         gtk_box_set_spacing(dialog->manage_box, 0);
@@ -207,6 +364,60 @@ void lock_key_dialog_refresh(GtkButton *self, LockKeyDialog *dialog)
     }
 }
 
+/**
+ * This function reconciles the key list of a LockKeyDialog with the keyring.
+ *
+ * @param dialog https://docs.gtk.org/glib/callback.ThreadFunc.html
+ */
+void lock_key_dialog_reconcile(LockKeyDialog *dialog)
+{
+    key_index_stamp stamp;
+    dialog->refresh_keys = key_index_list(&stamp);
+
+    if (dialog->refresh_keys != NULL)
+        key_index_save(dialog->refresh_keys, &stamp);
+
+    key_index_stamp_clear(&stamp);
+
+    /* UI */
+    g_idle_add((GSourceFunc) lock_key_dialog_reconcile_on_completed, dialog);
+
+    g_thread_exit(0);
+}
+
+/**
+ * This function handles UI updates for key list reconciliations and is supposed to be called via g_idle_add().
+ *
+ * @param dialog https://docs.gtk.org/glib/callback.SourceFunc.html
+ *
+ * @return https://docs.gtk.org/glib/func.idle_add.html
+ */
+gboolean lock_key_dialog_reconcile_on_completed(LockKeyDialog *dialog)
+{
+    GPtrArray *keys = dialog->refresh_keys;
+    dialog->refresh_keys = NULL;
+    dialog->refresh_running = false;
+
+    if (keys != NULL) {
+        if (key_index_equal(keys, dialog->keys))
+            g_ptr_array_unref(keys);
+        else
+            lock_key_dialog_populate(dialog, keys);
+    } else if (dialog->keys == NULL) {
+        lock_key_dialog_populate(dialog,
+                                 g_ptr_array_new_with_free_func((GDestroyNotify)
+                                                                key_index_entry_free));
+    }
+
+    if (dialog->refresh_pending)
+        lock_key_dialog_refresh(NULL, dialog);
+
+    g_object_unref(dialog);
+
+    /* Only execute once */
+    return false;               // https://docs.gtk.org/glib/func.idle_add.html
+}
+
 /**
  * This functions returns the window of a LockKeyDialog.
  *
@@ -230,6 +441,385 @@ void lock_key_dialog_add_toast(LockKeyDialog *dialog, AdwToast *toast)
     adw_toast_overlay_add_toast(dialog->toast_overlay, toast);
 }
 
+/**
+ * This function returns whether an export option of a LockKeyDialog is enabled.
+ *
+ * @param dialog Dialog to get the export option of
+ * @param name Name of the stateful action of the option
+ *
+ * @return Whether the option is enabled
+ */
+static gboolean lock_key_dialog_get_export_option(LockKeyDialog *dialog,
+                                                  const gchar *name)
+{
+    GAction *action =
+        g_action_map_lookup_action(G_ACTION_MAP(dialog->export_actions), name);
+    GVariant *state = g_action_get_state(action);
+
+    gboolean enabled = g_variant_get_boolean(state);
+
+    /* Cleanup */
+    g_variant_unref(state);
+    state = NULL;
+
+    return enabled;
+}
+
+/**
+ * This function returns the export options chosen in a LockKeyDialog.
+ *
+ * @param dialog Dialog to get the export options of
+ *
+ * @return Export options
+ */
+key_export_flags lock_key_dialog_get_export_flags(LockKeyDialog *dialog)
+{
+    key_export_flags flags = 0;
+
+    if (lock_key_dialog_get_export_option(dialog, "export_minimal"))
+        flags |= EXPORT_MINIMAL;
+    if (lock_key_dialog_get_export_option(dialog, "export_binary"))
+        flags |= EXPORT_BINARY;
+
+    return flags;
+}
+
+/**** Selection ****/
+
+/**
+ * This function toggles the selection mode of a LockKeyDialog.
+ *
+ * @param self https://docs.gtk.org/gtk4/signal.ToggleButton.toggled.html
+ * @param dialog https://docs.gtk.org/gtk4/signal.ToggleButton.toggled.html
+ */
+static void lock_key_dialog_selection_toggled(GtkToggleButton *self,
+                                              LockKeyDialog *dialog)
+{
+    gboolean selection_mode = gtk_toggle_button_get_active(self);
+
+    GtkListBoxRow *row;
+    for (int i = 0;
+         (row = gtk_list_box_get_row_at_index(dialog->key_box, i)) != NULL;
+         i++)
+        lock_key_row_set_selection_mode(LOCK_KEY_ROW(row), selection_mode);
+
+    gtk_action_bar_set_revealed(dialog->selection_bar, selection_mode);
+}
+
+/**
+ * This function stores the fingerprints of the selected keys of a LockKeyDialog for a bulk operation.
+ *
+ * @param dialog Dialog to get the selection of
+ *
+ * @return Whether any key is selected
+ */
+static gboolean lock_key_dialog_select(LockKeyDialog *dialog)
+{
+    GStrvBuilder *builder = g_strv_builder_new();
+    guint n_selected = 0;
+
+    GtkListBoxRow *row;
+    for (int i = 0;
+         (row = gtk_list_box_get_row_at_index(dialog->key_box, i)) != NULL;
+         i++) {
+        if (!lock_key_row_get_selected(LOCK_KEY_ROW(row)))
+            continue;
+
+        g_strv_builder_add(builder,
+                           lock_key_row_get_fingerprint(LOCK_KEY_ROW(row)));
+        n_selected++;
+    }
+
+    g_strfreev(dialog->selected);
+    dialog->selected = g_strv_builder_end(builder);
+
+    /* Cleanup */
+    g_strv_builder_unref(builder);
+    builder = NULL;
+
+    if (n_selected == 0) {
+        AdwToast *toast = adw_toast_new(_("No keys selected"));
+        adw_toast_set_timeout(toast, 2);
+        adw_toast_overlay_add_toast(dialog->toast_overlay, toast);
+
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * This function leaves the selection mode of a LockKeyDialog after a bulk operation.
+ *
+ * @param dialog Dialog to reset
+ */
+static void lock_key_dialog_select_finish(LockKeyDialog *dialog)
+{
+    g_strfreev(dialog->selected);
+    dialog->selected = NULL;
+
+    gtk_toggle_button_set_active(dialog->select_button, false);
+    lock_key_dialog_refresh(NULL, dialog);
+}
+
+/**
+ * This function opens the export file of a LockKeyDialog.
+ *
+ * @param object https://docs.gtk.org/gio/callback.AsyncReadyCallback.html
+ * @param result https://docs.gtk.org/gio/callback.AsyncReadyCallback.html
+ * @param user_data https://docs.gtk.org/gio/callback.AsyncReadyCallback.html
+ */
+static void lock_key_dialog_export_file_save(GObject *source_object,
+                                             GAsyncResult *res, gpointer data)
+{
+    GtkFileDialog *file = GTK_FILE_DIALOG(source_object);
+    LockKeyDialog *dialog = LOCK_KEY_DIALOG(data);
+
+    dialog->export_file = gtk_file_dialog_save_finish(file, res, NULL);
+
+    /* Cleanup */
+    g_object_unref(file);
+    file = NULL;
+
+    if (dialog->export_file == NULL)
+        return;
+
+    thread_export_keys(dialog);
+}
+
+/**
+ * This function opens a save file dialog for an export of a LockKeyDialog.
+ *
+ * @param dialog Dialog to export keys of
+ * @param name Suggested file name without extension
+ */
+static void lock_key_dialog_export_file_save_present(LockKeyDialog *dialog,
+                                                     const gchar *name)
+{
+    dialog->export_flags = lock_key_dialog_get_export_flags(dialog);
+
+    GtkFileDialog *file = gtk_file_dialog_new();
+    GCancellable *cancel = g_cancellable_new();
+
+    gchar *initial_name = g_strdup_printf("%s.%s", name,
+                                          (dialog->export_flags &
+                                           EXPORT_BINARY) ? "gpg" : "asc");
+    gtk_file_dialog_set_initial_name(file, initial_name);
+
+    gtk_file_dialog_save(file, GTK_WINDOW(dialog->window),
+                         cancel, lock_key_dialog_export_file_save, dialog);
+
+    /* Cleanup */
+    g_free(initial_name);
+    initial_name = NULL;
+}
+
+/**
+ * This function opens a save file dialog for the selected keys of a LockKeyDialog.
+ *
+ * @param self https://docs.gtk.org/gtk4/signal.Button.clicked.html
+ * @param dialog https://docs.gtk.org/gtk4/signal.Button.clicked.html
+ */
+static void lock_key_dialog_export_file_present(GtkButton *self,
+                                                LockKeyDialog *dialog)
+{
+    (void)self;
+
+    if (!lock_key_dialog_select(dialog))
+        return;
+
+    lock_key_dialog_export_file_save_present(dialog, "keys");
+}
+
+/**
+ * This function opens a save file dialog for a backup of the whole keyring in a LockKeyDialog.
+ *
+ * @param action https://docs.gtk.org/gio/signal.SimpleAction.activate.html
+ * @param parameter https://docs.gtk.org/gio/signal.SimpleAction.activate.html
+ * @param dialog https://docs.gtk.org/gio/signal.SimpleAction.activate.html
+ */
+static void lock_key_dialog_backup(GSimpleAction *action, GVariant *parameter,
+                                   LockKeyDialog *dialog)
+{
+    (void)action;
+    (void)parameter;
+
+    /* No selection exports every key */
+    g_strfreev(dialog->selected);
+    dialog->selected = NULL;
+
+    lock_key_dialog_export_file_save_present(dialog, "keyring");
+}
+
+/**
+ * This function exports the selected keys of a LockKeyDialog to a single file.
+ *
+ * Without a selection the whole keyring is exported.
+ *
+ * @param dialog https://docs.gtk.org/glib/callback.ThreadFunc.html
+ */
+void lock_key_dialog_export(LockKeyDialog *dialog)
+{
+    char *path = g_file_get_path(dialog->export_file);
+
+    dialog->selected_success =
+        key_export(path, (const char *const *)dialog->selected,
+                   dialog->export_flags);
+
+    /* Cleanup */
+    g_free(path);
+    path = NULL;
+
+    /* UI */
+    g_idle_add((GSourceFunc) lock_key_dialog_export_on_completed, dialog);
+
+    g_thread_exit(0);
+}
+
+/**
+ * This function handles UI updates for bulk key exports and is supposed to be called via g_idle_add().
+ *
+ * @param dialog https://docs.gtk.org/glib/callback.SourceFunc.html
+ *
+ * @return https://docs.gtk.org/glib/func.idle_add.html
+ */
+gboolean lock_key_dialog_export_on_completed(LockKeyDialog *dialog)
+{
+    AdwToast *toast;
+
+    if (!dialog->selected_success) {
+        toast = adw_toast_new(_("Export failed"));
+    } else if (dialog->selected == NULL) {
+        toast = adw_toast_new(_("Keyring backed up"));
+    } else {
+        guint n_keys = g_strv_length(dialog->selected);
+
+        toast =
+            adw_toast_new(g_strdup_printf
+                          (ngettext
+                           ("%u key exported", "%u keys exported", n_keys),
+                           n_keys));
+    }
+
+    adw_toast_set_timeout(toast, 2);
+    adw_toast_overlay_add_toast(dialog->toast_overlay, toast);
+
+    lock_key_dialog_select_finish(dialog);
+
+    /* Cleanup */
+    g_object_unref(dialog->export_file);
+    dialog->export_file = NULL;
+
+    /* Only execute once */
+    return false;               // https://docs.gtk.org/glib/func.idle_add.html
+}
+
+/**
+ * This function handles user input of the confirm dialog for bulk key removals.
+ *
+ * @param self https://gnome.pages.gitlab.gnome.org/libadwaita/doc/1-latest/signal.AlertDialog.response.html
+ * @param response https://gnome.pages.gitlab.gnome.org/libadwaita/doc/1-latest/signal.AlertDialog.response.html
+ * @param dialog https://gnome.pages.gitlab.gnome.org/libadwaita/doc/1-latest/signal.AlertDialog.response.html
+ */
+static void lock_key_dialog_remove_confirm_on_responded(AdwAlertDialog *self,
+                                                        gchar *response,
+                                                        LockKeyDialog *dialog)
+{
+    (void)self;
+
+    if (strcmp(response, "remove") != 0)
+        return;
+
+    thread_remove_keys(dialog);
+}
+
+/**
+ * This function confirms whether the selected keys of a LockKeyDialog should be removed.
+ *
+ * @param self https://docs.gtk.org/gtk4/signal.Button.clicked.html
+ * @param dialog https://docs.gtk.org/gtk4/signal.Button.clicked.html
+ */
+static void lock_key_dialog_remove_confirm(GtkButton *self,
+                                           LockKeyDialog *dialog)
+{
+    (void)self;
+
+    if (!lock_key_dialog_select(dialog))
+        return;
+
+    guint n_keys = g_strv_length(dialog->selected);
+
+    AdwAlertDialog *confirm =
+        ADW_ALERT_DIALOG(adw_alert_dialog_new
+                         (_("Remove keys and subkeys?"), NULL));
+    adw_alert_dialog_format_body(confirm,
+                                 ngettext
+                                 ("The removal of %u key cannot be undone!",
+                                  "The removal of %u keys cannot be undone!",
+                                  n_keys), n_keys);
+
+    adw_alert_dialog_add_responses(confirm, "cancel", _("_Cancel"), "remove",
+                                   _("_Remove"), NULL);
+    adw_alert_dialog_set_response_appearance(confirm, "remove",
+                                             ADW_RESPONSE_DESTRUCTIVE);
+
+    adw_alert_dialog_set_default_response(confirm, "cancel");
+    adw_alert_dialog_set_close_response(confirm, "cancel");
+    g_signal_connect(confirm, "response",
+                     G_CALLBACK(lock_key_dialog_remove_confirm_on_responded),
+                     dialog);
+
+    adw_dialog_present(ADW_DIALOG(confirm), GTK_WIDGET(dialog->window));
+}
+
+/**
+ * This function removes the selected keys of a LockKeyDialog from the keyring.
+ *
+ * @param dialog https://docs.gtk.org/glib/callback.ThreadFunc.html
+ */
+void lock_key_dialog_remove(LockKeyDialog *dialog)
+{
+    dialog->selected_success =
+        key_remove((const char *const *)dialog->selected);
+
+    /* UI */
+    g_idle_add((GSourceFunc) lock_key_dialog_remove_on_completed, dialog);
+
+    g_thread_exit(0);
+}
+
+/**
+ * This function handles UI updates for bulk key removals and is supposed to be called via g_idle_add().
+ *
+ * @param dialog https://docs.gtk.org/glib/callback.SourceFunc.html
+ *
+ * @return https://docs.gtk.org/glib/func.idle_add.html
+ */
+gboolean lock_key_dialog_remove_on_completed(LockKeyDialog *dialog)
+{
+    AdwToast *toast;
+
+    if (!dialog->selected_success) {
+        toast = adw_toast_new(_("Removal failed"));
+    } else {
+        guint n_keys = g_strv_length(dialog->selected);
+
+        toast =
+            adw_toast_new(g_strdup_printf
+                          (ngettext
+                           ("%u key removed", "%u keys removed", n_keys),
+                           n_keys));
+    }
+
+    adw_toast_set_timeout(toast, 2);
+    adw_toast_overlay_add_toast(dialog->toast_overlay, toast);
+
+    lock_key_dialog_select_finish(dialog);
+
+    /* Only execute once */
+    return false;               // https://docs.gtk.org/glib/func.idle_add.html
+}
+
 /**** Import ****/
 
 /**
@@ -283,28 +873,30 @@ static void lock_key_dialog_import_file_present(GtkButton *self,
 }
 
 /**
- * This function imports a key in a LockKeyDialog.
+ * This function imports keys in a LockKeyDialog.
  *
  * @param dialog https://docs.gtk.org/glib/callback.ThreadFunc.html
  */
 void lock_key_dialog_import(LockKeyDialog *dialog)
 {
-    char *path = malloc(1 * sizeof(char));
-
-    gboolean thread_success;
-    for (guint i = 0; i < g_list_model_get_n_items(dialog->import_file); i++) {
-        path = g_file_get_path(g_list_model_get_item(dialog->import_file, i));
+    guint n_files = g_list_model_get_n_items(dialog->import_file);
 
-        thread_success = key_manage(path, NULL, IMPORT);
+    char **paths = g_new0(char *, n_files + 1);
+    for (guint i = 0; i < n_files; i++) {
+        GFile *file = g_list_model_get_item(dialog->import_file, i);
+        paths[i] = g_file_get_path(file);
 
-        if (!thread_success)
-            break;
+        g_object_unref(file);
+        file = NULL;
     }
-    dialog->import_success = thread_success;
+
+    dialog->import_stats = g_new0(key_import_stats, n_files);
+    dialog->import_success =
+        key_import((const char *const *)paths, dialog->import_stats);
 
     /* Cleanup */
-    g_free(path);
-    path = NULL;
+    g_strfreev(paths);
+    paths = NULL;
 
     /* UI */
     g_idle_add((GSourceFunc) lock_key_dialog_import_on_completed, dialog);
@@ -312,6 +904,54 @@ void lock_key_dialog_import(LockKeyDialog *dialog)
     g_thread_exit(0);
 }
 
+/**
+ * This function presents the outcome of each file of a key import in a LockKeyDialog.
+ *
+ * @param dialog Dialog to present the outcome in
+ */
+static void lock_key_dialog_import_summary(LockKeyDialog *dialog)
+{
+    GString *body = g_string_new(NULL);
+
+    for (guint i = 0; i < g_list_model_get_n_items(dialog->import_file); i++) {
+        GFile *file = g_list_model_get_item(dialog->import_file, i);
+        gchar *name = g_file_get_basename(file);
+        key_import_stats *stats = &dialog->import_stats[i];
+
+        if (body->len > 0)
+            g_string_append_c(body, '\n');
+
+        if (!stats->success && stats->imported == 0 && stats->unchanged == 0) {
+            g_string_append_printf(body, C_("Formatter is a file name",
+                                            "%s: failed"), name);
+        } else {
+            g_string_append_printf(body,
+                                   C_
+                                   ("First formatter is a file name, the others are numbers of keys",
+                                    "%s: %d new, %d unchanged, %d failed"),
+                                   name, stats->imported, stats->unchanged,
+                                   stats->failed);
+        }
+
+        /* Cleanup */
+        g_free(name);
+        name = NULL;
+
+        g_object_unref(file);
+        file = NULL;
+    }
+
+    AdwAlertDialog *summary =
+        ADW_ALERT_DIALOG(adw_alert_dialog_new(_("Import summary"), body->str));
+    adw_alert_dialog_add_responses(summary, "close", _("_Close"), NULL);
+
+    adw_dialog_present(ADW_DIALOG(summary), GTK_WIDGET(dialog));
+
+    /* Cleanup */
+    g_string_free(body, true);
+    body = NULL;
+}
+
 /**
  * This function handles UI updates for key imports and is supposed to be called via g_idle_add().
  *
@@ -323,17 +963,52 @@ gboolean lock_key_dialog_import_on_completed(LockKeyDialog *dialog)
 {
     AdwToast *toast;
 
-    if (!dialog->import_success) {
+    int imported = 0;
+    int unchanged = 0;
+    for (guint i = 0; i < g_list_model_get_n_items(dialog->import_file); i++) {
+        imported += dialog->import_stats[i].imported;
+        unchanged += dialog->import_stats[i].unchanged;
+    }
+
+    if (!dialog->import_success && imported == 0 && unchanged == 0) {
         toast = adw_toast_new(_("Import failed"));
     } else {
-        toast = adw_toast_new(_("Keys imported"));
+        gchar *imported_keys =
+            g_strdup_printf(ngettext("%d key imported", "%d keys imported",
+                                     imported), imported);
+        gchar *unchanged_keys =
+            g_strdup_printf(ngettext("%d key unchanged", "%d keys unchanged",
+                                     unchanged), unchanged);
+
+        toast =
+            adw_toast_new(g_strdup_printf
+                          (C_
+                           ("First formatter is the number of imported keys, second formatter the number of unchanged keys",
+                            "%s, %s"), imported_keys, unchanged_keys));
+
+        g_free(imported_keys);
+        imported_keys = NULL;
+
+        g_free(unchanged_keys);
+        unchanged_keys = NULL;
     }
 
     adw_toast_set_timeout(toast, 2);
     adw_toast_overlay_add_toast(dialog->toast_overlay, toast);
 
+    if (g_list_model_get_n_items(dialog->import_file) > 1
+        || !dialog->import_success)
+        lock_key_dialog_import_summary(dialog);
+
     lock_key_dialog_refresh(NULL, dialog);
 
+    /* Cleanup */
+    g_free(dialog->import_stats);
+    dialog->import_stats = NULL;
+
+    g_object_unref(dialog->import_file);
+    dialog->import_file = NULL;
+
     /* Only execute once */
     return false;               // https://docs.gtk.org/glib/func.idle_add.html
 }
@@ -341,32 +1016,51 @@ gboolean lock_key_dialog_import_on_completed(LockKeyDialog *dialog)
 /**** Keypair Generation ****/
 
 /**
- * This function generates a new keypair in a LockKeyDialog.
+ * This function reads the algorithms and expiry of new keypairs in a LockKeyDialog.
  *
- * @param dialog Dialog to generate the keypair in and from
+ * @param dialog Dialog to read the parameters from
+ * @param sign_algorithm Set to the algorithm of the signing key
+ * @param encrypt_algorithm Set to the algorithm of the encryption key
+ * @param expiry Set to the expiry in seconds
  */
-void lock_key_dialog_generate(LockKeyDialog *dialog)
+static void lock_key_dialog_generate_parameters(LockKeyDialog *dialog,
+                                                const gchar **sign_algorithm,
+                                                const gchar **encrypt_algorithm,
+                                                unsigned long *expiry)
 {
-    const gchar *name = gtk_editable_get_text(GTK_EDITABLE(dialog->name_entry));
-    const gchar *email =
-        gtk_editable_get_text(GTK_EDITABLE(dialog->email_entry));
-    gchar *userid = g_strdup_printf("%s <%s>", name, email);
-
     gint sign_selected = adw_combo_row_get_selected(dialog->sign_entry);
     GtkStringList *sign_list =
         GTK_STRING_LIST(adw_combo_row_get_model(dialog->sign_entry));
-    const gchar *sign_algorithm =
-        gtk_string_list_get_string(sign_list, sign_selected);
+    *sign_algorithm = gtk_string_list_get_string(sign_list, sign_selected);
 
     gint encrypt_selected = adw_combo_row_get_selected(dialog->encrypt_entry);
     GtkStringList *encrypt_list =
         GTK_STRING_LIST(adw_combo_row_get_model(dialog->encrypt_entry));
-    const gchar *encrypt_algorithm =
+    *encrypt_algorithm =
         gtk_string_list_get_string(encrypt_list, encrypt_selected);
 
     gint expiry_months = (gint) adw_spin_row_get_value(dialog->expiry_entry);
-    unsigned long expiry_seconds =
+    *expiry =
         ((expiry_months / 2) * 31 + (expiry_months / 2) * 30) * 24 * 60 * 60;
+}
+
+/**
+ * This function generates a new keypair in a LockKeyDialog.
+ *
+ * @param dialog Dialog to generate the keypair in and from
+ */
+void lock_key_dialog_generate(LockKeyDialog *dialog)
+{
+    const gchar *name = gtk_editable_get_text(GTK_EDITABLE(dialog->name_entry));
+    const gchar *email =
+        gtk_editable_get_text(GTK_EDITABLE(dialog->email_entry));
+    gchar *userid = g_strdup_printf("%s <%s>", name, email);
+
+    const gchar *sign_algorithm;
+    const gchar *encrypt_algorithm;
+    unsigned long expiry_seconds;
+    lock_key_dialog_generate_parameters(dialog, &sign_algorithm,
+                                        &encrypt_algorithm, &expiry_seconds);
 
     dialog->generate_success =
         key_generate(userid, sign_algorithm, encrypt_algorithm, expiry_seconds);
@@ -406,3 +1100,341 @@ gboolean lock_key_dialog_generate_on_completed(LockKeyDialog *dialog)
     /* Only execute once */
     return false;               // https://docs.gtk.org/glib/func.idle_add.html
 }
+
+/**
+ * This function opens the CSV file of identities of a LockKeyDialog.
+ *
+ * @param object https://docs.gtk.org/gio/callback.AsyncReadyCallback.html
+ * @param result https://docs.gtk.org/gio/callback.AsyncReadyCallback.html
+ * @param user_data https://docs.gtk.org/gio/callback.AsyncReadyCallback.html
+ */
+static void lock_key_dialog_generate_file_open(GObject *source_object,
+                                               GAsyncResult *res,
+                                               gpointer data)
+{
+    GtkFileDialog *file = GTK_FILE_DIALOG(source_object);
+    LockKeyDialog *dialog = LOCK_KEY_DIALOG(data);
+
+    dialog->generate_file = gtk_file_dialog_open_finish(file, res, NULL);
+
+    /* Cleanup */
+    g_object_unref(file);
+    file = NULL;
+
+    if (dialog->generate_file == NULL)
+        return;
+
+    thread_generate_keys(dialog);
+}
+
+/**
+ * This function opens an open file dialog for a CSV file of identities in a LockKeyDialog.
+ *
+ * @param self https://docs.gtk.org/gtk4/signal.Button.clicked.html
+ * @param dialog https://docs.gtk.org/gtk4/signal.Button.clicked.html
+ */
+static void lock_key_dialog_generate_file_present(GtkButton *self,
+                                                  LockKeyDialog *dialog)
+{
+    (void)self;
+
+    GtkFileDialog *file = gtk_file_dialog_new();
+    GCancellable *cancel = g_cancellable_new();
+
+    gtk_file_dialog_open(file, GTK_WINDOW(dialog->window), cancel,
+                         lock_key_dialog_generate_file_open, dialog);
+}
+
+/**
+ * This function generates a keypair for every identity of a CSV file in a LockKeyDialog.
+ *
+ * @param dialog https://docs.gtk.org/glib/callback.ThreadFunc.html
+ */
+void lock_key_dialog_generate_batch(LockKeyDialog *dialog)
+{
+    char *path = g_file_get_path(dialog->generate_file);
+
+    const gchar *sign_algorithm;
+    const gchar *encrypt_algorithm;
+    unsigned long expiry_seconds;
+    lock_key_dialog_generate_parameters(dialog, &sign_algorithm,
+                                        &encrypt_algorithm, &expiry_seconds);
+
+    dialog->generate_success =
+        key_generate_batch(path, sign_algorithm, encrypt_algorithm,
+                           expiry_seconds, &dialog->generate_stats);
+
+    /* Cleanup */
+    g_free(path);
+    path = NULL;
+
+    /* UI */
+    g_idle_add((GSourceFunc) lock_key_dialog_generate_batch_on_completed,
+               dialog);
+
+    g_thread_exit(0);
+}
+
+/**
+ * This function handles UI updates for batches of keypair generations and is supposed to be called via g_idle_add().
+ *
+ * @param dialog https://docs.gtk.org/glib/callback.SourceFunc.html
+ *
+ * @return https://docs.gtk.org/glib/func.idle_add.html
+ */
+gboolean lock_key_dialog_generate_batch_on_completed(LockKeyDialog *dialog)
+{
+    AdwToast *toast;
+
+    if (dialog->generate_stats.generated == 0) {
+        toast = adw_toast_new(_("Generation failed"));
+    } else {
+        toast =
+            adw_toast_new(g_strdup_printf
+                          (C_("Formatters are numbers of keypairs",
+                              "%d keypairs generated, %d failed"),
+                           dialog->generate_stats.generated,
+                           dialog->generate_stats.failed));
+    }
+
+    adw_toast_set_timeout(toast, 2);
+    adw_toast_overlay_add_toast(dialog->toast_overlay, toast);
+
+    lock_key_dialog_refresh(NULL, dialog);
+
+    /* Cleanup */
+    g_object_unref(dialog->generate_file);
+    dialog->generate_file = NULL;
+
+    /* Only execute once */
+    return false;               // https://docs.gtk.org/glib/func.idle_add.html
+}
+
+/**** Benchmark ****/
+
+/**
+ * This function returns the algorithms of a combo row.
+ *
+ * @param row Combo row with a string list model
+ *
+ * @return NULL-terminated array of algorithms. Owned by caller
+ */
+static gchar **lock_key_dialog_benchmark_algorithms(AdwComboRow *row)
+{
+    GListModel *model = adw_combo_row_get_model(row);
+    guint n_items = g_list_model_get_n_items(model);
+
+    gchar **algorithms = g_new0(gchar *, n_items + 1);
+    for (guint i = 0; i < n_items; i++)
+        algorithms[i] =
+            g_strdup(gtk_string_list_get_string(GTK_STRING_LIST(model), i));
+
+    return algorithms;
+}
+
+/**
+ * This function starts a benchmark of the algorithms of a LockKeyDialog.
+ *
+ * The algorithms are collected here, as the thread of the benchmark must not touch the combo rows.
+ *
+ * @param self https://docs.gtk.org/gtk4/signal.Button.clicked.html
+ * @param dialog https://docs.gtk.org/gtk4/signal.Button.clicked.html
+ */
+static void lock_key_dialog_benchmark_start(GtkButton *self,
+                                            LockKeyDialog *dialog)
+{
+    gtk_widget_set_sensitive(GTK_WIDGET(self), false);
+
+    AdwToast *toast = adw_toast_new(_("Measuring algorithms …"));
+    adw_toast_set_timeout(toast, 2);
+    adw_toast_overlay_add_toast(dialog->toast_overlay, toast);
+
+    g_strfreev(dialog->benchmark_sign);
+    dialog->benchmark_sign =
+        lock_key_dialog_benchmark_algorithms(dialog->sign_entry);
+
+    g_strfreev(dialog->benchmark_encrypt);
+    dialog->benchmark_encrypt =
+        lock_key_dialog_benchmark_algorithms(dialog->encrypt_entry);
+
+    g_object_ref(dialog);
+    thread_benchmark_keys(dialog);
+}
+
+/**
+ * This function measures the cost of the algorithms of a LockKeyDialog.
+ *
+ * @param dialog https://docs.gtk.org/glib/callback.ThreadFunc.html
+ */
+void lock_key_dialog_benchmark(LockKeyDialog *dialog)
+{
+    dialog->benchmark_results =
+        benchmark_run((const char *const *)dialog->benchmark_sign,
+                      (const char *const *)dialog->benchmark_encrypt);
+
+    /* Cleanup */
+    g_strfreev(dialog->benchmark_sign);
+    dialog->benchmark_sign = NULL;
+
+    g_strfreev(dialog->benchmark_encrypt);
+    dialog->benchmark_encrypt = NULL;
+
+    /* UI */
+    g_idle_add((GSourceFunc) lock_key_dialog_benchmark_on_completed, dialog);
+
+    g_thread_exit(0);
+}
+
+/**
+ * This function formats the measured cost of an algorithm.
+ *
+ * @param result Result of the algorithm
+ *
+ * @return Description of the cost. Owned by caller
+ */
+static gchar *lock_key_dialog_benchmark_format(benchmark_result *result)
+{
+    if (result->encrypt)
+        return
+            g_strdup_printf(C_
+                            ("Benchmark of an encryption algorithm: key generation seconds, encryptions and decryptions per second, symmetric cipher, megabytes per second encrypted without and with compression and decrypted",
+                             "%.2f s to generate, %.0f encryptions/s, %.0f decryptions/s; %s: %.0f MB/s encrypted, %.0f MB/s compressed, %.0f MB/s decrypted"),
+                            result->keygen, result->encrypt_rate,
+                            result->decrypt_rate,
+                            (result->cipher != NULL) ? result->cipher : "?",
+                            result->bulk_encrypt,
+                            result->bulk_encrypt_compressed,
+                            result->bulk_decrypt);
+
+    return
+        g_strdup_printf(C_
+                        ("Benchmark of a signing algorithm: key generation seconds, signatures and verifications per second",
+                         "%.2f s to generate, %.0f signatures/s, %.0f verifications/s"),
+                        result->keygen, result->sign, result->verify);
+}
+
+/**
+ * This function presents the measured cost of the algorithms of a combo row.
+ *
+ * The subtitle shows the cost of the selected algorithm and the tooltip compares all algorithms.
+ *
+ * @param dialog Dialog holding the benchmark
+ * @param row Combo row of the algorithms
+ * @param kind Translated kind of key of the combo row
+ * @param encrypt Whether the combo row lists encryption algorithms
+ */
+static void lock_key_dialog_benchmark_present_row(LockKeyDialog *dialog,
+                                                  AdwComboRow *row,
+                                                  const gchar *kind,
+                                                  bool encrypt)
+{
+    GtkStringObject *selected = adw_combo_row_get_selected_item(row);
+    benchmark_result *result =
+        benchmark_lookup(dialog->benchmark,
+                         (selected != NULL) ?
+                         gtk_string_object_get_string(selected) : NULL,
+                         encrypt);
+
+    if (result == NULL) {
+        adw_action_row_set_subtitle(ADW_ACTION_ROW(row), kind);
+    } else {
+        gchar *cost = lock_key_dialog_benchmark_format(result);
+        gchar *subtitle = g_strdup_printf("%s · %s", kind, cost);
+
+        adw_action_row_set_subtitle(ADW_ACTION_ROW(row), subtitle);
+
+        /* Cleanup */
+        g_free(subtitle);
+        subtitle = NULL;
+
+        g_free(cost);
+        cost = NULL;
+    }
+
+    GString *comparison = g_string_new(NULL);
+    for (guint i = 0; dialog->benchmark != NULL && i < dialog->benchmark->len;
+         i++) {
+        benchmark_result *other = g_ptr_array_index(dialog->benchmark, i);
+        if (other->encrypt != encrypt)
+            continue;
+
+        gchar *cost = lock_key_dialog_benchmark_format(other);
+
+        if (comparison->len > 0)
+            g_string_append_c(comparison, '\n');
+        g_string_append_printf(comparison, "%s: %s", other->algorithm, cost);
+
+        g_free(cost);
+        cost = NULL;
+    }
+
+    gtk_widget_set_tooltip_text(GTK_WIDGET(row),
+                                (comparison->len > 0) ? comparison->str : NULL);
+
+    /* Cleanup */
+    g_string_free(comparison, true);
+    comparison = NULL;
+}
+
+/**
+ * This function presents the measured cost of the algorithms of a LockKeyDialog.
+ *
+ * @param self https://docs.gtk.org/gobject/signal.Object.notify.html
+ * @param pspec https://docs.gtk.org/gobject/signal.Object.notify.html
+ * @param dialog https://docs.gtk.org/gobject/signal.Object.notify.html
+ */
+static void lock_key_dialog_benchmark_present(GObject *self,
+                                              GParamSpec *pspec,
+                                              LockKeyDialog *dialog)
+{
+    (void)self;
+    (void)pspec;
+
+    lock_key_dialog_benchmark_present_row(dialog, dialog->sign_entry,
+                                          C_
+                                          ("Signing algorithm of the new keypair",
+                                           "Key"), false);
+    lock_key_dialog_benchmark_present_row(dialog, dialog->encrypt_entry,
+                                          C_
+                                          ("Encryption algorithm of the new keypair",
+                                           "Subkey"), true);
+}
+
+/**
+ * This function handles UI updates for benchmarks and is supposed to be called via g_idle_add().
+ *
+ * @param dialog https://docs.gtk.org/glib/callback.SourceFunc.html
+ *
+ * @return https://docs.gtk.org/glib/func.idle_add.html
+ */
+gboolean lock_key_dialog_benchmark_on_completed(LockKeyDialog *dialog)
+{
+    AdwToast *toast;
+
+    if (dialog->benchmark_results == NULL
+        || dialog->benchmark_results->len == 0) {
+        toast = adw_toast_new(_("Benchmark failed"));
+
+        if (dialog->benchmark_results != NULL)
+            g_ptr_array_unref(dialog->benchmark_results);
+    } else {
+        toast = adw_toast_new(_("Benchmark finished"));
+
+        if (dialog->benchmark != NULL)
+            g_ptr_array_unref(dialog->benchmark);
+        dialog->benchmark = dialog->benchmark_results;
+
+        lock_key_dialog_benchmark_present(NULL, NULL, dialog);
+    }
+    dialog->benchmark_results = NULL;
+
+    adw_toast_set_timeout(toast, 2);
+    adw_toast_overlay_add_toast(dialog->toast_overlay, toast);
+
+    gtk_widget_set_sensitive(GTK_WIDGET(dialog->benchmark_button), true);
+
+    g_object_unref(dialog);
+
+    /* Only execute once */
+    return false;               // https://docs.gtk.org/glib/func.idle_add.html
+}
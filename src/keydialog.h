@@ -4,6 +4,8 @@
 #include <adwaita.h>
 #include "window.h"
 
+#include "cryptography.h"
+
 #define LOCK_TYPE_KEY_DIALOG (lock_key_dialog_get_type())
 
 G_DECLARE_FINAL_TYPE(LockKeyDialog, lock_key_dialog, LOCK, KEY_DIALOG,
@@ -13,14 +15,26 @@ LockKeyDialog *lock_key_dialog_new(LockWindow * window);
 
 // UI
 void lock_key_dialog_refresh(GtkButton * self, LockKeyDialog * dialog);
+void lock_key_dialog_reconcile(LockKeyDialog * dialog);
+gboolean lock_key_dialog_reconcile_on_completed(LockKeyDialog * dialog);
 
 LockWindow *lock_key_dialog_get_window(LockKeyDialog * dialog);
 void lock_key_dialog_add_toast(LockKeyDialog * dialog, AdwToast * toast);
+key_export_flags lock_key_dialog_get_export_flags(LockKeyDialog * dialog);
+
+// Selection
+void lock_key_dialog_export(LockKeyDialog * dialog);
+void lock_key_dialog_remove(LockKeyDialog * dialog);
 
 // Import
 void lock_key_dialog_import(LockKeyDialog * dialog);
 
 // Generation
 void lock_key_dialog_generate(LockKeyDialog * dialog);
+void lock_key_dialog_generate_batch(LockKeyDialog * dialog);
+
+// Benchmark
+void lock_key_dialog_benchmark(LockKeyDialog * dialog);
+gboolean lock_key_dialog_benchmark_on_completed(LockKeyDialog * dialog);
 
 #endif                          // KEY_DIALOG_H
@@ -0,0 +1,533 @@
+#include "keyindex.h"
+
+#include <adwaita.h>
+#include <glib/gi18n.h>
+#include <glib/gstdio.h>
+#include <locale.h>
+#include "config.h"
+
+#include <gpgme.h>
+#include <stdbool.h>
+#include <string.h>
+
+#define KEY_INDEX_MAGIC "LOCKKIDX"
+#define KEY_INDEX_VERSION 2
+
+/**
+ * This structure is the header of an index file.
+ *
+ * The header is followed by count records and a table of NUL-terminated strings.
+ * All offsets are relative to the start of the string table.
+ */
+typedef struct {
+    char magic[8];
+    guint32 version;
+    guint32 count;
+    gint64 keybox_mtime; /**< Modification time of the keybox in nanoseconds */
+    gint64 keybox_size;
+    guint32 keybox_path;
+    guint32 strings_size;
+} key_index_header;
+
+/**
+ * This structure is the record of a single key in an index file.
+ */
+typedef struct {
+    guint32 fingerprint;
+    guint32 uids; /**< Offset of the first of n_uids consecutive strings */
+    guint32 n_uids;
+    guint32 subkeys; /**< Offset of the first of n_subkeys consecutive strings */
+    guint32 n_subkeys;
+    guint32 capabilities;
+    gint64 expires;
+} key_index_record;
+
+/**
+ * This function frees an entry of a key index.
+ *
+ * @param entry Entry to free
+ */
+void key_index_entry_free(key_index_entry *entry)
+{
+    if (entry == NULL)
+        return;
+
+    g_free(entry->fingerprint);
+    g_strfreev(entry->uids);
+    g_strfreev(entry->subkeys);
+    g_free(entry);
+}
+
+/**
+ * This function frees the contents of a keybox stamp.
+ *
+ * @param stamp Stamp to clear
+ */
+void key_index_stamp_clear(key_index_stamp *stamp)
+{
+    g_free(stamp->keybox_path);
+    stamp->keybox_path = NULL;
+
+    stamp->keybox_mtime = 0;
+    stamp->keybox_size = 0;
+}
+
+/**
+ * This function returns the path of the index file.
+ *
+ * @return Path. Owned by caller
+ */
+static gchar *key_index_path()
+{
+    return g_build_filename(g_get_user_cache_dir(), PROJECT_ID, "keys.index",
+                            NULL);
+}
+
+/**
+ * This function finds the keybox of the GnuPG home directory in use.
+ *
+ * @param keybox Status of the keybox
+ *
+ * @return Path of the keybox or NULL. Owned by caller
+ */
+static gchar *key_index_keybox(GStatBuf *keybox)
+{
+    const char *homedir = gpgme_get_dirinfo("homedir");
+    if (homedir == NULL)
+        return NULL;
+
+    const char *names[] = { "pubring.kbx", "pubring.gpg", NULL };
+    for (int i = 0; names[i] != NULL; i++) {
+        gchar *path = g_build_filename(homedir, names[i], NULL);
+
+        if (g_stat(path, keybox) == 0)
+            return path;
+
+        g_free(path);
+        path = NULL;
+    }
+
+    return NULL;
+}
+
+/**
+ * This function returns the modification time of a keybox in nanoseconds.
+ *
+ * @param keybox Status of the keybox
+ *
+ * @return Modification time
+ */
+static gint64 key_index_keybox_mtime(GStatBuf *keybox)
+{
+    return (gint64) keybox->st_mtim.tv_sec * 1000000000 +
+        keybox->st_mtim.tv_nsec;
+}
+
+/**
+ * This function lists all keys of the keyring.
+ *
+ * The keybox is stamped before the listing starts, so a change during the listing leaves the index stale.
+ *
+ * @param stamp Set to the state of the keybox to save the listing with. Clear with key_index_stamp_clear(). Can be NULL
+ *
+ * @return Array of key_index_entry or NULL. Owned by caller
+ */
+GPtrArray *key_index_list(key_index_stamp *stamp)
+{
+    gpgme_ctx_t context;
+    gpgme_key_t key;
+    gpgme_error_t error;
+
+    if (stamp != NULL) {
+        GStatBuf keybox;
+
+        *stamp = (key_index_stamp) { 0 };
+        stamp->keybox_path = key_index_keybox(&keybox);
+        if (stamp->keybox_path != NULL) {
+            stamp->keybox_mtime = key_index_keybox_mtime(&keybox);
+            stamp->keybox_size = keybox.st_size;
+        }
+    }
+
+    error = gpgme_new(&context);
+    if (error) {
+        g_warning(C_
+                  ("Error message constructor for failed GPGME operations",
+                   "Failed to %s: %s"), C_("GPGME Error",
+                                           "create new GPGME context"),
+                  gpgme_strerror(error));
+        return NULL;
+    }
+
+    GPtrArray *keys =
+        g_ptr_array_new_with_free_func((GDestroyNotify) key_index_entry_free);
+
+    error = gpgme_op_keylist_start(context, NULL, 0);
+    while (!error) {
+        error = gpgme_op_keylist_next(context, &key);
+
+        if (error)
+            break;
+
+        key_index_entry *entry = g_new0(key_index_entry, 1);
+        entry->fingerprint = g_strdup(key->subkeys->fpr);
+        entry->expires = key->subkeys->expires;
+
+        guint n_uids = 0;
+        for (gpgme_user_id_t uid = key->uids; uid != NULL; uid = uid->next)
+            n_uids++;
+
+        entry->uids = g_new0(char *, n_uids + 1);
+        n_uids = 0;
+        for (gpgme_user_id_t uid = key->uids; uid != NULL; uid = uid->next)
+            entry->uids[n_uids++] = g_strdup(uid->uid);
+
+        guint n_subkeys = 0;
+        for (gpgme_subkey_t subkey = key->subkeys; subkey != NULL;
+             subkey = subkey->next)
+            n_subkeys++;
+
+        entry->subkeys = g_new0(char *, n_subkeys + 1);
+        n_subkeys = 0;
+        for (gpgme_subkey_t subkey = key->subkeys; subkey != NULL;
+             subkey = subkey->next)
+            if (subkey->fpr != NULL)
+                entry->subkeys[n_subkeys++] = g_strdup(subkey->fpr);
+
+        if (key->can_encrypt)
+            entry->capabilities |= KEY_CAN_ENCRYPT;
+        if (key->can_sign)
+            entry->capabilities |= KEY_CAN_SIGN;
+        if (key->can_certify)
+            entry->capabilities |= KEY_CAN_CERTIFY;
+        if (key->can_authenticate)
+            entry->capabilities |= KEY_CAN_AUTHENTICATE;
+
+        g_ptr_array_add(keys, entry);
+
+        gpgme_key_release(key);
+    }
+
+    /* Cleanup */
+    gpgme_release(context);
+
+    if (gpgme_err_code(error) != GPG_ERR_EOF) {
+        g_warning(C_
+                  ("Error message constructor for failed GPGME operations",
+                   "Failed to %s: %s"), C_("GPGME Error", "list keys"),
+                  gpgme_strerror(error));
+
+        g_ptr_array_unref(keys);
+        return NULL;
+    }
+
+    return keys;
+}
+
+/**
+ * This function checks whether an offset points to a string inside the string table of an index.
+ *
+ * @param strings String table
+ * @param strings_size Size of the string table
+ * @param offset Offset of the string
+ *
+ * @return String or NULL
+ */
+static const char *key_index_string(const char *strings, guint32 strings_size,
+                                    guint32 offset)
+{
+    if (offset >= strings_size)
+        return NULL;
+
+    return strings + offset;
+}
+
+/**
+ * This function loads the key index if it is still valid for the keybox.
+ *
+ * @return Array of key_index_entry or NULL. Owned by caller
+ */
+GPtrArray *key_index_load()
+{
+    GStatBuf keybox;
+    gchar *keybox_path = key_index_keybox(&keybox);
+    if (keybox_path == NULL)
+        return NULL;
+
+    gchar *path = key_index_path();
+    GMappedFile *file = g_mapped_file_new(path, false, NULL);
+
+    g_free(path);
+    path = NULL;
+
+    if (file == NULL) {
+        g_free(keybox_path);
+        return NULL;
+    }
+
+    const char *data = g_mapped_file_get_contents(file);
+    gsize length = g_mapped_file_get_length(file);
+    GPtrArray *keys = NULL;
+
+    const key_index_header *header = (const key_index_header *)data;
+    if (length < sizeof(key_index_header)
+        || memcmp(header->magic, KEY_INDEX_MAGIC, sizeof(header->magic)) != 0
+        || header->version != KEY_INDEX_VERSION
+        || header->strings_size == 0
+        || length != sizeof(key_index_header)
+        + (gsize) header->count * sizeof(key_index_record)
+        + header->strings_size)
+        goto cleanup;
+
+    const key_index_record *records =
+        (const key_index_record *)(data + sizeof(key_index_header));
+    const char *strings = (const char *)(records + header->count);
+
+    /* Every string must be terminated inside of the table */
+    if (strings[header->strings_size - 1] != '\0')
+        goto cleanup;
+
+    /* The keyring changed since the index was written */
+    const char *indexed_keybox =
+        key_index_string(strings, header->strings_size, header->keybox_path);
+    if (indexed_keybox == NULL || strcmp(indexed_keybox, keybox_path) != 0
+        || header->keybox_mtime != key_index_keybox_mtime(&keybox)
+        || header->keybox_size != (gint64) keybox.st_size)
+        goto cleanup;
+
+    keys = g_ptr_array_new_full(header->count,
+                                (GDestroyNotify) key_index_entry_free);
+
+    for (guint32 i = 0; i < header->count; i++) {
+        const key_index_record *record = &records[i];
+
+        const char *fingerprint = key_index_string(strings,
+                                                   header->strings_size,
+                                                   record->fingerprint);
+        if (fingerprint == NULL) {
+            g_ptr_array_unref(keys);
+            keys = NULL;
+            goto cleanup;
+        }
+
+        key_index_entry *entry = g_new0(key_index_entry, 1);
+        entry->fingerprint = g_strdup(fingerprint);
+        entry->expires = (long)record->expires;
+        entry->capabilities = record->capabilities;
+        entry->uids = g_new0(char *, record->n_uids + 1);
+        entry->subkeys = g_new0(char *, record->n_subkeys + 1);
+        g_ptr_array_add(keys, entry);
+
+        guint32 offset = record->uids;
+        for (guint32 j = 0; j < record->n_uids; j++) {
+            const char *uid =
+                key_index_string(strings, header->strings_size, offset);
+            if (uid == NULL) {
+                g_ptr_array_unref(keys);
+                keys = NULL;
+                goto cleanup;
+            }
+
+            entry->uids[j] = g_strdup(uid);
+            offset += strlen(uid) + 1;
+        }
+
+        offset = record->subkeys;
+        for (guint32 j = 0; j < record->n_subkeys; j++) {
+            const char *subkey =
+                key_index_string(strings, header->strings_size, offset);
+            if (subkey == NULL) {
+                g_ptr_array_unref(keys);
+                keys = NULL;
+                goto cleanup;
+            }
+
+            entry->subkeys[j] = g_strdup(subkey);
+            offset += strlen(subkey) + 1;
+        }
+    }
+
+ cleanup:
+    g_mapped_file_unref(file);
+    file = NULL;
+
+    g_free(keybox_path);
+    keybox_path = NULL;
+
+    return keys;
+}
+
+/**
+ * This function appends a string to the string table of an index.
+ *
+ * @param strings String table
+ * @param string String to append
+ *
+ * @return Offset of the string
+ */
+static guint32 key_index_append_string(GByteArray *strings, const char *string)
+{
+    guint32 offset = strings->len;
+
+    g_byte_array_append(strings, (const guint8 *)string, strlen(string) + 1);
+
+    return offset;
+}
+
+/**
+ * This function writes the key index for the state of the keybox a listing started from.
+ *
+ * @param keys Array of key_index_entry
+ * @param stamp State of the keybox before the keys were listed, see key_index_list()
+ *
+ * @return Success
+ */
+bool key_index_save(GPtrArray *keys, const key_index_stamp *stamp)
+{
+    if (stamp->keybox_path == NULL)
+        return false;
+
+    key_index_header header = { 0 };
+    memcpy(header.magic, KEY_INDEX_MAGIC, sizeof(header.magic));
+    header.version = KEY_INDEX_VERSION;
+    header.count = keys->len;
+    header.keybox_mtime = stamp->keybox_mtime;
+    header.keybox_size = stamp->keybox_size;
+
+    GByteArray *records = g_byte_array_new();
+    GByteArray *strings = g_byte_array_new();
+
+    header.keybox_path = key_index_append_string(strings, stamp->keybox_path);
+
+    for (guint i = 0; i < keys->len; i++) {
+        key_index_entry *entry = g_ptr_array_index(keys, i);
+        key_index_record record = { 0 };
+
+        record.fingerprint =
+            key_index_append_string(strings, entry->fingerprint);
+        record.uids = strings->len;
+        record.n_uids = g_strv_length(entry->uids);
+        for (guint j = 0; j < record.n_uids; j++)
+            key_index_append_string(strings, entry->uids[j]);
+        record.subkeys = strings->len;
+        record.n_subkeys = g_strv_length(entry->subkeys);
+        for (guint j = 0; j < record.n_subkeys; j++)
+            key_index_append_string(strings, entry->subkeys[j]);
+        record.capabilities = entry->capabilities;
+        record.expires = entry->expires;
+
+        g_byte_array_append(records, (const guint8 *)&record, sizeof(record));
+    }
+    header.strings_size = strings->len;
+
+    GByteArray *data = g_byte_array_sized_new(sizeof(header) + records->len +
+                                              strings->len);
+    g_byte_array_append(data, (const guint8 *)&header, sizeof(header));
+    g_byte_array_append(data, records->data, records->len);
+    g_byte_array_append(data, strings->data, strings->len);
+
+    gchar *path = key_index_path();
+    gchar *directory = g_path_get_dirname(path);
+
+    GError *error = NULL;
+    bool success = g_mkdir_with_parents(directory, 0700) == 0
+        && g_file_set_contents(path, (const gchar *)data->data, data->len,
+                               &error);
+    if (error != NULL) {
+        g_warning(_("Failed to write key index: %s"), error->message);
+
+        g_error_free(error);
+        error = NULL;
+    }
+
+    /* Cleanup */
+    g_byte_array_unref(records);
+    g_byte_array_unref(strings);
+    g_byte_array_unref(data);
+
+    g_free(directory);
+    directory = NULL;
+
+    g_free(path);
+    path = NULL;
+
+    return success;
+}
+
+/**
+ * This function compares two key indexes.
+ *
+ * @param a Array of key_index_entry
+ * @param b Array of key_index_entry
+ *
+ * @return Whether both indexes describe the same keys
+ */
+bool key_index_equal(GPtrArray *a, GPtrArray *b)
+{
+    if (a == NULL || b == NULL || a->len != b->len)
+        return false;
+
+    for (guint i = 0; i < a->len; i++) {
+        key_index_entry *x = g_ptr_array_index(a, i);
+        key_index_entry *y = g_ptr_array_index(b, i);
+
+        if (strcmp(x->fingerprint, y->fingerprint) != 0
+            || x->expires != y->expires
+            || x->capabilities != y->capabilities)
+            return false;
+
+        guint n_uids = g_strv_length(x->uids);
+        if (n_uids != g_strv_length(y->uids))
+            return false;
+
+        for (guint j = 0; j < n_uids; j++)
+            if (strcmp(x->uids[j], y->uids[j]) != 0)
+                return false;
+
+        guint n_subkeys = g_strv_length(x->subkeys);
+        if (n_subkeys != g_strv_length(y->subkeys))
+            return false;
+
+        for (guint j = 0; j < n_subkeys; j++)
+            if (strcmp(x->subkeys[j], y->subkeys[j]) != 0)
+                return false;
+    }
+
+    return true;
+}
+
+/**
+ * This function finds the key a key ID or fingerprint belongs to, e.g. the recipient of an encrypted message.
+ *
+ * Key IDs are the last 16 digits of version 4 fingerprints and the first 16 digits of version 6 fingerprints.
+ *
+ * @param keys Array of key_index_entry
+ * @param id Key ID or fingerprint as hexadecimal
+ *
+ * @return Key owning a matching subkey or NULL. Owned by keys
+ */
+key_index_entry *key_index_find(GPtrArray *keys, const char *id)
+{
+    gsize id_length = strlen(id);
+
+    for (guint i = 0; i < keys->len; i++) {
+        key_index_entry *entry = g_ptr_array_index(keys, i);
+
+        for (guint j = 0; entry->subkeys[j] != NULL; j++) {
+            const char *fingerprint = entry->subkeys[j];
+            gsize length = strlen(fingerprint);
+
+            if (length < id_length)
+                continue;
+
+            if (g_ascii_strcasecmp(fingerprint, id) == 0
+                || (id_length == 16 && length == 40
+                    && g_ascii_strcasecmp(fingerprint + length - 16, id) == 0)
+                || (id_length == 16 && length == 64
+                    && g_ascii_strncasecmp(fingerprint, id, 16) == 0))
+                return entry;
+        }
+    }
+
+    return NULL;
+}
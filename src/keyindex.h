@@ -0,0 +1,44 @@
+#ifndef KEY_INDEX_H
+#define KEY_INDEX_H
+
+#include <glib.h>
+
+#include <stdbool.h>
+
+typedef enum {
+    KEY_CAN_ENCRYPT = 1 << 0,
+    KEY_CAN_SIGN = 1 << 1,
+    KEY_CAN_CERTIFY = 1 << 2,
+    KEY_CAN_AUTHENTICATE = 1 << 3
+} key_capabilities;
+
+/**
+ * This structure holds the metadata of a key required to present it.
+ */
+typedef struct {
+    char *fingerprint;
+    char **uids; /**< NULL-terminated */
+    char **subkeys; /**< NULL-terminated fingerprints of all subkeys, including the primary key */
+    long expires; /**< Zero if the key does not expire */
+    key_capabilities capabilities;
+} key_index_entry;
+
+/**
+ * This structure identifies the state of the keybox a key listing reflects.
+ */
+typedef struct {
+    char *keybox_path; /**< NULL if there is no keybox */
+    gint64 keybox_mtime; /**< Modification time of the keybox in nanoseconds */
+    gint64 keybox_size;
+} key_index_stamp;
+
+void key_index_entry_free(key_index_entry * entry);
+void key_index_stamp_clear(key_index_stamp * stamp);
+
+GPtrArray *key_index_list(key_index_stamp * stamp);
+GPtrArray *key_index_load();
+bool key_index_save(GPtrArray * keys, const key_index_stamp * stamp);
+bool key_index_equal(GPtrArray * a, GPtrArray * b);
+key_index_entry *key_index_find(GPtrArray * keys, const char *id);
+
+#endif                          // KEY_INDEX_H
@@ -19,12 +19,16 @@ struct _LockKeyRow {
 
     LockKeyDialog *dialog;
 
+    GtkCheckButton *select_check;
+    GtkBox *action_box;
+
     gboolean remove_success;
     GtkButton *remove_button;
 
     gboolean export_success;
     GtkButton *export_button;
     GFile *export_file;
+    key_export_flags export_flags;
 };
 
 G_DEFINE_TYPE(LockKeyRow, lock_key_row, ADW_TYPE_ACTION_ROW);
@@ -63,6 +67,11 @@ static void lock_key_row_class_init(LockKeyRowClass *class)
     gtk_widget_class_set_template_from_resource(GTK_WIDGET_CLASS(class),
                                                 UI_RESOURCE("keyrow.ui"));
 
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), LockKeyRow,
+                                         select_check);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), LockKeyRow,
+                                         action_box);
+
     gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), LockKeyRow,
                                          remove_button);
 
@@ -106,6 +115,52 @@ LockKeyRow *lock_key_row_new(LockKeyDialog *dialog,
     return row;
 }
 
+/**
+ * This function returns the fingerprint of the key of a LockKeyRow.
+ *
+ * @param row Row to get the fingerprint of
+ *
+ * @return Fingerprint
+ */
+const gchar *lock_key_row_get_fingerprint(LockKeyRow *row)
+{
+    return adw_action_row_get_subtitle(ADW_ACTION_ROW(row));
+}
+
+/**** Selection ****/
+
+/**
+ * This function toggles the selection mode of a LockKeyRow.
+ *
+ * @param row Row to toggle the selection mode of
+ * @param selection_mode Whether the row is selectable instead of offering actions for its key
+ */
+void lock_key_row_set_selection_mode(LockKeyRow *row, gboolean selection_mode)
+{
+    gtk_widget_set_visible(GTK_WIDGET(row->select_check), selection_mode);
+    gtk_widget_set_visible(GTK_WIDGET(row->action_box), !selection_mode);
+
+    adw_action_row_set_activatable_widget(ADW_ACTION_ROW(row),
+                                          selection_mode ?
+                                          GTK_WIDGET(row->select_check) : NULL);
+
+    if (!selection_mode)
+        gtk_check_button_set_active(row->select_check, false);
+}
+
+/**
+ * This function returns whether a LockKeyRow is selected.
+ *
+ * @param row Row to check
+ *
+ * @return Whether the row is selected
+ */
+gboolean lock_key_row_get_selected(LockKeyRow *row)
+{
+    return gtk_widget_get_visible(GTK_WIDGET(row->select_check))
+        && gtk_check_button_get_active(row->select_check);
+}
+
 /**** Export ****/
 
 /**
@@ -153,21 +208,23 @@ static void lock_key_row_export_file_present(GtkButton *self, LockKeyRow *row)
     LockWindow *window = lock_key_dialog_get_window(row->dialog);
     GCancellable *cancel = g_cancellable_new();
 
+    row->export_flags = lock_key_dialog_get_export_flags(row->dialog);
+
     gtk_file_dialog_save(file, GTK_WINDOW(window),
                          cancel, lock_key_row_export_file_save, row);
 }
 
 /**
- * This function imports a key in a LockKeyDialog.
+ * This function exports the key of a LockKeyRow.
  *
  * @param row https://docs.gtk.org/glib/callback.ThreadFunc.html
  */
 void lock_key_row_export(LockKeyRow *row)
 {
     char *path = g_file_get_path(row->export_file);
-    const char *uid = adw_preferences_row_get_title(ADW_PREFERENCES_ROW(row));
+    const char *fingerprints[] = { lock_key_row_get_fingerprint(row), NULL };
 
-    row->export_success = key_manage(path, uid, EXPORT);
+    row->export_success = key_export(path, fingerprints, row->export_flags);
 
     /* Cleanup */
     g_free(path);
@@ -265,9 +322,9 @@ static void lock_key_row_remove_confirm(GtkButton *self, LockKeyRow *row)
  */
 void lock_key_row_remove(LockKeyRow *row)
 {
-    const char *uid = adw_preferences_row_get_title(ADW_PREFERENCES_ROW(row));
+    const char *fingerprints[] = { lock_key_row_get_fingerprint(row), NULL };
 
-    row->remove_success = key_manage(NULL, uid, REMOVE);
+    row->remove_success = key_remove(fingerprints);
 
     /* UI */
     g_idle_add((GSourceFunc) lock_key_row_remove_on_completed, row);
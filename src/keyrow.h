@@ -14,6 +14,12 @@ LockKeyRow *lock_key_row_new(LockKeyDialog * dialog,
                              const gchar * title, const gchar * subtitle,
                              const gchar * expiry_date,
                              const gchar * expiry_time);
+const gchar *lock_key_row_get_fingerprint(LockKeyRow * row);
+
+// Selection
+void lock_key_row_set_selection_mode(LockKeyRow * row,
+                                     gboolean selection_mode);
+gboolean lock_key_row_get_selected(LockKeyRow * row);
 
 // Export
 void lock_key_row_export(LockKeyRow * row);
@@ -0,0 +1,417 @@
+#include "mirror.h"
+
+#include <adwaita.h>
+#include <glib/gi18n.h>
+#include <locale.h>
+#include "config.h"
+
+#include <gpgme.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "batch.h"
+#include "cryptography.h"
+
+/*
+ * A mirror encrypts each file of a source tree into the same place of a target tree, appending BATCH_SUFFIX.
+ *
+ * The target keeps an index of every mirrored file, each group being the escaped path relative to the root:
+ *
+ * [Documents/report.odt]
+ * size=…
+ * modified=… (microseconds since the epoch)
+ * hash=… (SHA-256 of the content)
+ * recipients=… (fingerprints)
+ *
+ * Files whose size and modification time match the index are skipped without reading them.
+ * Files with new metadata are hashed, and only re-encrypted if their content or the recipients changed.
+ * A run therefore reads the metadata of the whole tree, but only the content of the files that changed.
+ */
+
+#define MIRROR_ATTRIBUTES G_FILE_ATTRIBUTE_STANDARD_NAME "," \
+    G_FILE_ATTRIBUTE_STANDARD_TYPE "," \
+    G_FILE_ATTRIBUTE_STANDARD_SIZE "," \
+    G_FILE_ATTRIBUTE_TIME_MODIFIED "," \
+    G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC
+
+/**
+ * This structure holds the state of a mirror operation.
+ */
+typedef struct {
+    GFile *target;
+    GKeyFile *index;
+    GHashTable *seen; /**< Groups of the index still present in the source */
+    gchar *recipients; /**< Fingerprints the files are encrypted for */
+
+    GPtrArray *jobs; /**< Changed files, elements are batch_job */
+    GPtrArray *entries; /**< Index entries of the changed files, elements are mirror_entry */
+
+    mirror_stats *stats;
+} mirror_context;
+
+/**
+ * This structure holds the index entry of a file to encrypt.
+ */
+typedef struct {
+    gchar *group;
+    guint64 size;
+    guint64 modified;
+    gchar *hash;
+} mirror_entry;
+
+/**
+ * This function frees the index entry of a file.
+ *
+ * @param entry Entry to free
+ */
+static void mirror_entry_free(mirror_entry *entry)
+{
+    g_free(entry->group);
+    entry->group = NULL;
+
+    g_free(entry->hash);
+    entry->hash = NULL;
+
+    g_free(entry);
+}
+
+/**
+ * This function decides whether a file of the source tree needs to be encrypted and queues it.
+ *
+ * @param context State of the mirror operation
+ * @param file File of the source tree
+ * @param info Metadata of the file
+ * @param relative Path of the file relative to the root
+ */
+static void mirror_file(mirror_context *context, GFile *file, GFileInfo *info,
+                        const char *relative)
+{
+    gchar *group = g_uri_escape_string(relative, "/", true);
+    g_hash_table_add(context->seen, g_strdup(group));
+
+    gchar *name = g_strconcat(relative, BATCH_SUFFIX, NULL);
+    GFile *output = g_file_resolve_relative_path(context->target, name);
+
+    guint64 size = g_file_info_get_size(info);
+    guint64 modified =
+        g_file_info_get_attribute_uint64(info, G_FILE_ATTRIBUTE_TIME_MODIFIED)
+        * G_USEC_PER_SEC
+        + g_file_info_get_attribute_uint32(info,
+                                           G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+
+    gchar *recipients =
+        g_key_file_get_string(context->index, group, "recipients", NULL);
+    bool current = g_strcmp0(recipients, context->recipients) == 0
+        && g_file_query_exists(output, NULL);
+
+    /* Unchanged metadata, nothing to read */
+    if (current
+        && g_key_file_get_uint64(context->index, group, "size", NULL) == size
+        && g_key_file_get_uint64(context->index, group, "modified",
+                                 NULL) == modified) {
+        context->stats->unchanged++;
+        goto cleanup;
+    }
+
+    gchar *hash = batch_checksum(file);
+    if (hash == NULL) {
+        context->stats->failed++;
+        goto cleanup;
+    }
+
+    mirror_entry *entry = g_new0(mirror_entry, 1);
+    entry->group = g_strdup(group);
+    entry->size = size;
+    entry->modified = modified;
+    entry->hash = hash;
+
+    gchar *indexed = g_key_file_get_string(context->index, group, "hash", NULL);
+    bool changed = !current || g_strcmp0(indexed, hash) != 0;
+
+    g_free(indexed);
+    indexed = NULL;
+
+    /* Only the metadata changed, e.g. the file was touched or copied */
+    if (!changed) {
+        g_key_file_set_uint64(context->index, group, "size", size);
+        g_key_file_set_uint64(context->index, group, "modified", modified);
+
+        mirror_entry_free(entry);
+        entry = NULL;
+
+        context->stats->unchanged++;
+        goto cleanup;
+    }
+
+    GFile *parent = g_file_get_parent(output);
+    g_file_make_directory_with_parents(parent, NULL, NULL);
+
+    g_object_unref(parent);
+    parent = NULL;
+
+    batch_job *job = batch_job_new(file, entry);
+    job->destination = g_object_ref(output);
+
+    g_ptr_array_add(context->jobs, job);
+    g_ptr_array_add(context->entries, entry);
+
+ cleanup:
+    g_free(recipients);
+    recipients = NULL;
+
+    g_object_unref(output);
+    output = NULL;
+
+    g_free(name);
+    name = NULL;
+
+    g_free(group);
+    group = NULL;
+}
+
+/**
+ * This function walks a directory of the source tree.
+ *
+ * Symbolic links are not followed, so the walk stays inside the tree.
+ *
+ * @param context State of the mirror operation
+ * @param directory Directory to walk
+ * @param relative Path of the directory relative to the root. NULL for the root
+ *
+ * @return Success
+ */
+static bool mirror_walk(mirror_context *context, GFile *directory,
+                        const char *relative)
+{
+    g_autoptr(GError) error = NULL;
+    GFileEnumerator *children =
+        g_file_enumerate_children(directory, MIRROR_ATTRIBUTES,
+                                  G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS, NULL,
+                                  &error);
+    if (children == NULL) {
+        g_warning(_("Failed to read folder: %s"), error->message);
+        return false;
+    }
+
+    bool success = true;
+    GFileInfo *info;
+    GFile *child;
+
+    while (g_file_enumerator_iterate(children, &info, &child, NULL, &error)
+           && info != NULL) {
+        /* An index left in the source by an earlier run is not mirrored */
+        if (g_strcmp0(g_file_info_get_name(info), MIRROR_INDEX_NAME) == 0)
+            continue;
+
+        gchar *path = (relative == NULL) ?
+            g_strdup(g_file_info_get_name(info)) :
+            g_build_filename(relative, g_file_info_get_name(info), NULL);
+
+        switch (g_file_info_get_file_type(info)) {
+        case G_FILE_TYPE_DIRECTORY:
+            success = mirror_walk(context, child, path) && success;
+            break;
+        case G_FILE_TYPE_REGULAR:
+            mirror_file(context, child, info, path);
+            break;
+        default:
+            break;
+        }
+
+        g_free(path);
+        path = NULL;
+    }
+
+    if (error != NULL) {
+        g_warning(_("Failed to read folder: %s"), error->message);
+        success = false;
+    }
+
+    /* Cleanup */
+    g_object_unref(children);
+    children = NULL;
+
+    return success;
+}
+
+/**
+ * This function removes the encrypted files of deleted source files.
+ *
+ * @param context State of the mirror operation
+ */
+static void mirror_prune(mirror_context *context)
+{
+    gchar **groups = g_key_file_get_groups(context->index, NULL);
+
+    for (gsize i = 0; groups[i] != NULL; i++) {
+        if (g_hash_table_contains(context->seen, groups[i]))
+            continue;
+
+        gchar *relative = g_uri_unescape_string(groups[i], NULL);
+        if (relative != NULL) {
+            gchar *name = g_strconcat(relative, BATCH_SUFFIX, NULL);
+            GFile *output =
+                g_file_resolve_relative_path(context->target, name);
+
+            g_file_delete(output, NULL, NULL);
+
+            g_object_unref(output);
+            output = NULL;
+
+            g_free(name);
+            name = NULL;
+        }
+
+        g_key_file_remove_group(context->index, groups[i], NULL);
+        context->stats->removed++;
+
+        g_free(relative);
+        relative = NULL;
+    }
+
+    /* Cleanup */
+    g_strfreev(groups);
+    groups = NULL;
+}
+
+/**
+ * This function checks whether a target tree lies inside its source tree.
+ *
+ * Symbolic links are resolved, so the walk would reach the target through neither path.
+ *
+ * @param source Root of the plain tree
+ * @param target_path Local root of the encrypted tree
+ *
+ * @return Whether the target equals the source or is inside it
+ */
+static bool mirror_nested(GFile *source, const char *target_path)
+{
+    g_autofree char *source_path = g_file_get_path(source);
+    if (source_path == NULL)
+        return false;
+
+    g_autofree char *source_real = realpath(source_path, NULL);
+    g_autofree char *target_real = realpath(target_path, NULL);
+    if (source_real == NULL || target_real == NULL)
+        return false;
+
+    g_autoptr(GFile) source_file = g_file_new_for_path(source_real);
+    g_autoptr(GFile) target_file = g_file_new_for_path(target_real);
+
+    return g_file_equal(source_file, target_file)
+        || g_file_has_prefix(target_file, source_file);
+}
+
+/**
+ * This function encrypts a source tree into a target tree, only processing files that changed since the last run.
+ *
+ * @param source Root of the plain tree
+ * @param target Root of the encrypted tree, holds the index. Needs to be local and outside of the source
+ * @param key Key to encrypt for
+ * @param options Parameters of the encryption. Can be NULL
+ * @param threads Number of files encrypted at the same time
+ * @param stats Receives the outcome
+ *
+ * @return Success of all files
+ */
+bool mirror_directory(GFile *source, GFile *target, gpgme_key_t key,
+                      const cryptography_options *options,
+                      unsigned int threads, mirror_stats *stats)
+{
+    *stats = (mirror_stats) { 0 };
+
+    char *target_path = g_file_get_path(target);
+    if (target_path == NULL) {
+        g_warning(_("Failed to mirror folder: %s"),
+                  C_("Folder error", "folder is not stored locally"));
+        return false;
+    }
+
+    // The walk would encrypt its own output again on every run
+    if (mirror_nested(source, target_path)) {
+        g_warning(_("Failed to mirror folder: %s"),
+                  C_("Folder error", "target folder is inside the source"));
+
+        g_free(target_path);
+        return false;
+    }
+
+    gchar *index_path = g_build_filename(target_path, MIRROR_INDEX_NAME, NULL);
+
+    mirror_context context = {
+        .target = target,
+        .index = g_key_file_new(),
+        .seen = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL),
+        .recipients = g_strdup(key->subkeys->fpr),
+        .jobs = g_ptr_array_new_with_free_func((GDestroyNotify) batch_job_free),
+        .entries =
+            g_ptr_array_new_with_free_func((GDestroyNotify) mirror_entry_free),
+        .stats = stats,
+    };
+
+    // A missing index mirrors everything
+    g_key_file_load_from_file(context.index, index_path, G_KEY_FILE_NONE,
+                              NULL);
+
+    bool success = mirror_walk(&context, source, NULL);
+
+    /* The index already skips files that are done */
+    batch_process(context.jobs, ENCRYPT, key, options, NULL, threads, false,
+                  NULL, NULL);
+
+    for (guint i = 0; i < context.jobs->len; i++) {
+        batch_job *job = g_ptr_array_index(context.jobs, i);
+        mirror_entry *entry = job->data;
+
+        if (!job->success) {
+            // Forces the file to be encrypted again on the next run
+            g_key_file_remove_group(context.index, entry->group, NULL);
+
+            stats->failed++;
+            continue;
+        }
+
+        g_key_file_set_uint64(context.index, entry->group, "size", entry->size);
+        g_key_file_set_uint64(context.index, entry->group, "modified",
+                              entry->modified);
+        g_key_file_set_string(context.index, entry->group, "hash", entry->hash);
+        g_key_file_set_string(context.index, entry->group, "recipients",
+                              context.recipients);
+
+        stats->encrypted++;
+    }
+
+    /* Files missing from an incomplete walk are kept */
+    if (success)
+        mirror_prune(&context);
+
+    g_autoptr(GError) error = NULL;
+    if (!g_key_file_save_to_file(context.index, index_path, &error)) {
+        g_warning(_("Failed to write mirror index: %s"), error->message);
+        success = false;
+    }
+
+    /* Cleanup */
+    g_ptr_array_unref(context.jobs);
+    context.jobs = NULL;
+
+    g_ptr_array_unref(context.entries);
+    context.entries = NULL;
+
+    g_hash_table_unref(context.seen);
+    context.seen = NULL;
+
+    g_key_file_free(context.index);
+    context.index = NULL;
+
+    g_free(context.recipients);
+    context.recipients = NULL;
+
+    g_free(index_path);
+    index_path = NULL;
+
+    g_free(target_path);
+    target_path = NULL;
+
+    return success && stats->failed == 0;
+}
@@ -0,0 +1,28 @@
+#ifndef MIRROR_H
+#define MIRROR_H
+
+#include <gio/gio.h>
+#include <glib.h>
+#include <gpgme.h>
+
+#include <stdbool.h>
+#include "cryptography.h"
+
+/* Name of the change index in the root of an encrypted tree */
+#define MIRROR_INDEX_NAME ".lock-index"
+
+/**
+ * This structure holds the outcome of mirroring a tree.
+ */
+typedef struct {
+    unsigned int encrypted;
+    unsigned int unchanged; /**< Files skipped because neither content nor recipients changed */
+    unsigned int removed; /**< Encrypted files whose source was deleted */
+    unsigned int failed;
+} mirror_stats;
+
+bool mirror_directory(GFile * source, GFile * target, gpgme_key_t key,
+                      const cryptography_options * options,
+                      unsigned int threads, mirror_stats * stats);
+
+#endif                          // MIRROR_H
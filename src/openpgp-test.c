@@ -0,0 +1,248 @@
+#include "openpgp.h"
+
+#include <glib.h>
+#include "config.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+/*
+ * Checks which heads of files openpgp_inspect() takes for OpenPGP data.
+ *
+ * Binary files whose first octet happens to look like a packet header must not be routed to decryption
+ * or verification. Run with `meson test`.
+ */
+
+#define TEST_HEAD_SIZE 4096
+#define TEST_RANDOM_RUNS 10000
+
+/**
+ * This function inspects a head padded with pseudo-random data up to TEST_HEAD_SIZE.
+ *
+ * @param head Start of the head
+ * @param length Length of the start
+ * @param seed Seed of the padding
+ *
+ * @return Summary or NULL. Free with openpgp_summary_free()
+ */
+static openpgp_summary *test_inspect_padded(const guint8 *head, gsize length,
+                                            guint32 seed)
+{
+    guint8 *data = g_malloc(TEST_HEAD_SIZE);
+    GRand *random = g_rand_new_with_seed(seed);
+
+    for (gsize i = 0; i < TEST_HEAD_SIZE; i++)
+        data[i] = g_rand_int(random);
+    memcpy(data, head, length);
+
+    openpgp_summary *summary = openpgp_inspect(data, TEST_HEAD_SIZE);
+
+    /* Cleanup */
+    g_rand_free(random);
+    random = NULL;
+
+    g_free(data);
+    data = NULL;
+
+    return summary;
+}
+
+/**
+ * This function checks that a PNG image is not a signature.
+ */
+static void test_png(void)
+{
+    /* Signature and IHDR chunk of a 256x256 RGBA image */
+    static const guint8 png[] = {
+        0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n',
+        0x00, 0x00, 0x00, 0x0d, 'I', 'H', 'D', 'R',
+        0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x01, 0x00,
+        0x08, 0x06, 0x00, 0x00, 0x00, 0x5c, 0x72, 0xa8, 0x66
+    };
+
+    g_assert_null(openpgp_inspect(png, sizeof(png)));
+
+    for (guint32 seed = 0; seed < 16; seed++)
+        g_assert_null(test_inspect_padded(png, sizeof(png), seed));
+}
+
+/**
+ * This function checks that binary data starting like session key packets is not encrypted.
+ */
+static void test_session_key_heads(void)
+{
+    /* Legacy public-key and symmetric-key encrypted session key headers */
+    static const guint8 heads[][4] = {
+        { 0x84, 0x0c, 0x03, 0x00 },
+        { 0x84, 0x5e, 0x06, 0x00 },
+        { 0x8c, 0x0d, 0x04, 0x07 },
+        { 0x8c, 0x3d, 0x06, 0x26 },
+    };
+
+    for (gsize i = 0; i < G_N_ELEMENTS(heads); i++) {
+        for (guint32 seed = 0; seed < 256; seed++)
+            g_assert_null(test_inspect_padded(heads[i], sizeof(heads[i]),
+                                              seed));
+    }
+}
+
+/**
+ * This function checks that other binary formats are not OpenPGP.
+ */
+static void test_binary_heads(void)
+{
+    static const guint8 jpeg[] = { 0xff, 0xd8, 0xff, 0xe0, 0x00, 0x10, 'J' };
+    static const guint8 gif[] = { 'G', 'I', 'F', '8', '9', 'a' };
+    static const guint8 zip[] = { 'P', 'K', 0x03, 0x04 };
+    static const guint8 elf[] = { 0x7f, 'E', 'L', 'F', 0x02, 0x01, 0x01 };
+    static const guint8 empty[] = { 0x00 };
+
+    g_assert_null(openpgp_inspect(jpeg, sizeof(jpeg)));
+    g_assert_null(openpgp_inspect(gif, sizeof(gif)));
+    g_assert_null(openpgp_inspect(zip, sizeof(zip)));
+    g_assert_null(openpgp_inspect(elf, sizeof(elf)));
+    g_assert_null(openpgp_inspect(empty, 0));
+
+    g_assert_null(test_inspect_padded(jpeg, sizeof(jpeg), 0));
+}
+
+/**
+ * This function checks that random data starting with a packet header is not OpenPGP.
+ */
+static void test_random_heads(void)
+{
+    for (guint32 seed = 0; seed < TEST_RANDOM_RUNS; seed++) {
+        guint8 first = 0x80 | (seed & 0x7f);
+        g_assert_null(test_inspect_padded(&first, 1, seed));
+    }
+}
+
+/**
+ * This function checks that an encrypted message is recognized.
+ */
+static void test_encrypted(void)
+{
+    /* Version 3 session key for 0123456789ABCDEF, password session key, version 1 encrypted data */
+    static const guint8 message[] = {
+        0xc1, 0x0c, 0x03, 0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef,
+        0x01, 0x00, 0x00,
+        0xc3, 0x04, 0x04, 0x09, 0x00, 0x08,
+        0xd2, 0x05, 0x01, 0x00, 0x00, 0x00, 0x00
+    };
+
+    openpgp_summary *summary = openpgp_inspect(message, sizeof(message));
+
+    g_assert_nonnull(summary);
+    g_assert_cmpint(summary->type, ==, OPENPGP_MESSAGE_ENCRYPTED);
+    g_assert_cmpuint(summary->recipients->len, ==, 1);
+    g_assert_cmpstr(g_ptr_array_index(summary->recipients, 0), ==,
+                    "0123456789ABCDEF");
+    g_assert_cmpuint(summary->passwords, ==, 1);
+
+    openpgp_summary_free(summary);
+    summary = NULL;
+
+    /* Without the encrypted data the session keys lead nowhere */
+    g_assert_null(openpgp_inspect(message, 20));
+}
+
+/**
+ * This function checks that literal data is recognized, even if it is truncated.
+ */
+static void test_literal(void)
+{
+    static const guint8 message[] = {
+        0xcb, 0x0f, 'b', 0x04, 'n', 'o', 't', 'e', 0x00, 0x00, 0x00, 0x00,
+        'h', 'e', 'l', 'l', 'o'
+    };
+
+    openpgp_summary *summary = openpgp_inspect(message, sizeof(message));
+
+    g_assert_nonnull(summary);
+    g_assert_cmpint(summary->type, ==, OPENPGP_MESSAGE_LITERAL);
+    g_assert_cmpstr(summary->file_name, ==, "note");
+
+    openpgp_summary_free(summary);
+    summary = NULL;
+
+    summary = openpgp_inspect(message, 14);
+    g_assert_nonnull(summary);
+
+    openpgp_summary_free(summary);
+    summary = NULL;
+}
+
+/**
+ * This function checks that a detached signature is recognized only if it ends with the data.
+ */
+static void test_signature(void)
+{
+    /* Version 4 binary signature with an issuer key ID */
+    static const guint8 signature[] = {
+        0xc2, 0x19, 0x04, 0x00, 0x01, 0x08, 0x00, 0x00,
+        0x00, 0x0a, 0x09, 0x10, 0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd,
+        0xef, 0x12, 0x34, 0x00, 0x08, 0x55, 0x00, 0x00
+    };
+
+    openpgp_summary *summary = openpgp_inspect(signature, sizeof(signature));
+
+    g_assert_nonnull(summary);
+    g_assert_cmpint(summary->type, ==, OPENPGP_MESSAGE_SIGNATURE);
+    g_assert_cmpuint(summary->signers->len, ==, 1);
+    g_assert_cmpstr(g_ptr_array_index(summary->signers, 0), ==,
+                    "0123456789ABCDEF");
+
+    openpgp_summary_free(summary);
+    summary = NULL;
+
+    g_assert_null(test_inspect_padded(signature, sizeof(signature), 0));
+}
+
+/**
+ * This function checks that a public key is recognized only if its key material fills the packet.
+ */
+static void test_public_key(void)
+{
+    /* Version 4 Ed25519 key with the user ID “Test” */
+    guint8 key[] = {
+        0xc6, 0x33, 0x04, 0x5f, 0x00, 0x00, 0x00, 0x16,
+        0x09, 0x2b, 0x06, 0x01, 0x04, 0x01, 0xda, 0x47, 0x0f, 0x01,
+        0x01, 0x07, 0x40,
+        0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08,
+        0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x10,
+        0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18,
+        0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f, 0x20,
+        0xcd, 0x04, 'T', 'e', 's', 't'
+    };
+
+    openpgp_summary *summary = openpgp_inspect(key, sizeof(key));
+
+    g_assert_nonnull(summary);
+    g_assert_cmpint(summary->type, ==, OPENPGP_MESSAGE_PUBLIC_KEY);
+    g_assert_cmpstr(summary->uid, ==, "Test");
+    g_assert_nonnull(summary->fingerprint);
+
+    openpgp_summary_free(summary);
+    summary = NULL;
+
+    /* A point of 256 bits leaves one octet of the packet unaccounted for */
+    key[19] = 0x00;
+    g_assert_null(openpgp_inspect(key, sizeof(key)));
+}
+
+int main(int argc, char *argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/openpgp/inspect/png", test_png);
+    g_test_add_func("/openpgp/inspect/session-key-heads",
+                    test_session_key_heads);
+    g_test_add_func("/openpgp/inspect/binary-heads", test_binary_heads);
+    g_test_add_func("/openpgp/inspect/random-heads", test_random_heads);
+    g_test_add_func("/openpgp/inspect/encrypted", test_encrypted);
+    g_test_add_func("/openpgp/inspect/literal", test_literal);
+    g_test_add_func("/openpgp/inspect/signature", test_signature);
+    g_test_add_func("/openpgp/inspect/public-key", test_public_key);
+
+    return g_test_run();
+}
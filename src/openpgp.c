@@ -0,0 +1,1016 @@
+#include "openpgp.h"
+
+#include <adwaita.h>
+#include <gio/gio.h>
+#include <glib/gi18n.h>
+#include <locale.h>
+#include "config.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+#define ARMOR_BEGIN "-----BEGIN PGP "
+#define ARMOR_END "-----END PGP "
+#define ARMOR_CLEARTEXT "-----BEGIN PGP SIGNED MESSAGE"
+
+/**
+ * This function frees a key block.
+ *
+ * @param block Key block to free
+ */
+void openpgp_key_block_free(openpgp_key_block *block)
+{
+    if (block == NULL)
+        return;
+
+    g_free(block->fingerprint);
+    g_hash_table_unref(block->packets);
+    g_free(block);
+}
+
+/**
+ * This function frees a summary of OpenPGP data.
+ *
+ * @param summary Summary to free. Can be NULL
+ */
+void openpgp_summary_free(openpgp_summary *summary)
+{
+    if (summary == NULL)
+        return;
+
+    g_ptr_array_unref(summary->recipients);
+    g_ptr_array_unref(summary->signers);
+    g_free(summary->fingerprint);
+    g_free(summary->uid);
+    g_free(summary->file_name);
+    g_free(summary);
+}
+
+/**
+ * This function reads the next line of a buffer.
+ *
+ * @param data Buffer
+ * @param length Length of the buffer
+ * @param offset Offset of the line. Set to the offset of the following line
+ * @param line_length Set to the length of the line without its terminator
+ *
+ * @return Start of the line or NULL at the end of the buffer
+ */
+static const guint8 *openpgp_next_line(const guint8 *data, gsize length,
+                                       gsize *offset, gsize *line_length)
+{
+    if (*offset >= length)
+        return NULL;
+
+    const guint8 *line = data + *offset;
+    const guint8 *end = memchr(line, '\n', length - *offset);
+
+    gsize size = (end == NULL) ? length - *offset : (gsize) (end - line);
+    *offset += size + ((end == NULL) ? 0 : 1);
+
+    if (size > 0 && line[size - 1] == '\r')
+        size--;
+    *line_length = size;
+
+    return line;
+}
+
+/**
+ * This function checks whether a line starts with a prefix.
+ *
+ * @param line Line
+ * @param line_length Length of the line
+ * @param prefix Prefix
+ *
+ * @return Whether the line starts with the prefix
+ */
+static bool openpgp_line_has_prefix(const guint8 *line, gsize line_length,
+                                    const char *prefix)
+{
+    gsize prefix_length = strlen(prefix);
+
+    return line_length >= prefix_length
+        && memcmp(line, prefix, prefix_length) == 0;
+}
+
+/**
+ * This function removes the ASCII armor of OpenPGP data.
+ *
+ * All armored blocks of the buffer are decoded and concatenated. Cleartext signed messages are skipped.
+ *
+ * @param data Buffer
+ * @param length Length of the buffer
+ *
+ * @return Binary data or NULL if the buffer contains no armored block. Owned by caller
+ */
+GBytes *openpgp_dearmor(const guint8 *data, gsize length)
+{
+    GByteArray *binary = NULL;
+    gsize offset = 0;
+    gsize line_length;
+    const guint8 *line;
+
+    while ((line =
+            openpgp_next_line(data, length, &offset, &line_length)) != NULL) {
+        if (!openpgp_line_has_prefix(line, line_length, ARMOR_BEGIN)
+            || openpgp_line_has_prefix(line, line_length, ARMOR_CLEARTEXT))
+            continue;
+
+        if (binary == NULL)
+            binary = g_byte_array_new();
+
+        bool headers = true;
+        gint state = 0;
+        guint save = 0;
+
+        while ((line =
+                openpgp_next_line(data, length, &offset,
+                                  &line_length)) != NULL) {
+            if (openpgp_line_has_prefix(line, line_length, ARMOR_END))
+                break;
+
+            /* Armor headers end with an empty line */
+            if (headers) {
+                if (line_length == 0 || memchr(line, ':', line_length) != NULL) {
+                    headers = line_length != 0;
+                    continue;
+                }
+                headers = false;
+            }
+
+            /* Checksum */
+            if (line_length > 0 && line[0] == '=')
+                continue;
+
+            gsize position = binary->len;
+            g_byte_array_set_size(binary, position + (line_length / 4) * 3 + 3);
+            gsize decoded = g_base64_decode_step((const gchar *)line,
+                                                 line_length,
+                                                 binary->data + position,
+                                                 &state, &save);
+            g_byte_array_set_size(binary, position + decoded);
+        }
+    }
+
+    if (binary == NULL)
+        return NULL;
+
+    return g_byte_array_free_to_bytes(binary);
+}
+
+/**
+ * This function parses the header of the next packet of a buffer.
+ *
+ * The body of the packet may extend beyond the buffer, e.g. if only the start of a file was read.
+ *
+ * @param data Buffer
+ * @param length Length of the buffer
+ * @param offset Offset of the packet. Set to the offset of the following packet, which may be beyond the buffer
+ * @param packet Set to the position of the packet
+ *
+ * @return Whether a packet header was found
+ */
+bool openpgp_packet_next(const guint8 *data, gsize length, gsize *offset,
+                         openpgp_packet *packet)
+{
+    gsize position = *offset;
+    if (position >= length || !(data[position] & 0x80))
+        return false;
+
+    memset(packet, 0, sizeof(*packet));
+    packet->offset = position;
+
+    guint8 header = data[position++];
+    gsize body_length;
+
+    if (header & 0x40) {
+        /* New format */
+        packet->tag = header & 0x3f;
+
+        if (position >= length)
+            return false;
+
+        guint8 first = data[position++];
+        if (first < 192) {
+            body_length = first;
+        } else if (first < 224) {
+            if (position >= length)
+                return false;
+
+            body_length = ((gsize) (first - 192) << 8) + data[position++] + 192;
+        } else if (first == 255) {
+            if (position + 4 > length)
+                return false;
+
+            body_length = ((gsize) data[position] << 24)
+                | ((gsize) data[position + 1] << 16)
+                | ((gsize) data[position + 2] << 8) | data[position + 3];
+            position += 4;
+        } else {
+            body_length = (gsize) 1 << (first & 0x1f);
+            packet->partial = true;
+        }
+    } else {
+        /* Legacy format */
+        packet->tag = (header >> 2) & 0x0f;
+
+        switch (header & 0x03) {
+        case 0:
+            if (position + 1 > length)
+                return false;
+
+            body_length = data[position];
+            position += 1;
+            break;
+        case 1:
+            if (position + 2 > length)
+                return false;
+
+            body_length = ((gsize) data[position] << 8) | data[position + 1];
+            position += 2;
+            break;
+        case 2:
+            if (position + 4 > length)
+                return false;
+
+            body_length = ((gsize) data[position] << 24)
+                | ((gsize) data[position + 1] << 16)
+                | ((gsize) data[position + 2] << 8) | data[position + 3];
+            position += 4;
+            break;
+        default:
+            /* Indeterminate length extends to the end of the data */
+            body_length = length - position;
+            break;
+        }
+    }
+
+    packet->body_offset = position;
+    packet->body_length = body_length;
+
+    if (!packet->partial) {
+        *offset = position + body_length;
+        return true;
+    }
+
+    /* Skip the remaining chunks of a partial body */
+    position += body_length;
+    while (position < length) {
+        guint8 chunk = data[position++];
+
+        if (chunk < 192) {
+            position += chunk;
+            break;
+        } else if (chunk < 224) {
+            if (position >= length)
+                break;
+
+            position += ((gsize) (chunk - 192) << 8) + data[position] + 192 + 1;
+            break;
+        } else if (chunk == 255) {
+            if (position + 4 > length) {
+                position = G_MAXSIZE;
+                break;
+            }
+
+            position += 4 + (((gsize) data[position] << 24)
+                             | ((gsize) data[position + 1] << 16)
+                             | ((gsize) data[position + 2] << 8)
+                             | data[position + 3]);
+            break;
+        }
+
+        position += (gsize) 1 << (chunk & 0x1f);
+    }
+    *offset = position;
+
+    return true;
+}
+
+/**
+ * This function computes the fingerprint of a key packet.
+ *
+ * @param body Body of a public or secret key packet
+ * @param length Length of the body
+ *
+ * @return Fingerprint as uppercase hexadecimal or NULL for unsupported key versions. Owned by caller
+ */
+char *openpgp_fingerprint(const guint8 *body, gsize length)
+{
+    if (length < 1)
+        return NULL;
+
+    GChecksum *checksum;
+    guint8 prefix[5];
+    gsize prefix_length;
+
+    switch (body[0]) {
+    case 4:
+        /* Only the public part of a secret key packet is hashed */
+        checksum = g_checksum_new(G_CHECKSUM_SHA1);
+        prefix[0] = 0x99;
+        prefix[1] = (length >> 8) & 0xff;
+        prefix[2] = length & 0xff;
+        prefix_length = 3;
+        break;
+    case 5:
+    case 6:
+        checksum = g_checksum_new(G_CHECKSUM_SHA256);
+        prefix[0] = (body[0] == 5) ? 0x9a : 0x9b;
+        prefix[1] = (length >> 24) & 0xff;
+        prefix[2] = (length >> 16) & 0xff;
+        prefix[3] = (length >> 8) & 0xff;
+        prefix[4] = length & 0xff;
+        prefix_length = 5;
+        break;
+    default:
+        return NULL;
+    }
+
+    g_checksum_update(checksum, prefix, prefix_length);
+    g_checksum_update(checksum, body, length);
+
+    char *fingerprint = g_ascii_strup(g_checksum_get_string(checksum), -1);
+
+    /* Cleanup */
+    g_checksum_free(checksum);
+    checksum = NULL;
+
+    return fingerprint;
+}
+
+/**
+ * This function splits OpenPGP key data into transferable keys.
+ *
+ * @param data Binary key data
+ * @param length Length of the key data
+ *
+ * @return Array of openpgp_key_block or NULL if the data is not a sequence of well-formed keys. Owned by caller
+ */
+GPtrArray *openpgp_key_blocks(const guint8 *data, gsize length)
+{
+    GPtrArray *blocks =
+        g_ptr_array_new_with_free_func((GDestroyNotify) openpgp_key_block_free);
+    openpgp_key_block *block = NULL;
+
+    gsize offset = 0;
+    openpgp_packet packet;
+
+    while (offset < length) {
+        if (!openpgp_packet_next(data, length, &offset, &packet)
+            || packet.partial || offset > length)
+            goto error;
+
+        const guint8 *body = data + packet.body_offset;
+
+        if (packet.tag == OPENPGP_TAG_PUBLIC_KEY
+            || packet.tag == OPENPGP_TAG_SECRET_KEY) {
+            if (block != NULL)
+                block->length = packet.offset - block->offset;
+
+            block = g_new0(openpgp_key_block, 1);
+            block->offset = packet.offset;
+            block->secret = packet.tag == OPENPGP_TAG_SECRET_KEY;
+            block->packets =
+                g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+            g_ptr_array_add(blocks, block);
+
+            /* Secret keys are always imported and need no fingerprint */
+            block->fingerprint =
+                block->secret ? NULL : openpgp_fingerprint(body,
+                                                           packet.body_length);
+            if (!block->secret && block->fingerprint == NULL)
+                goto error;
+        } else if (packet.tag == OPENPGP_TAG_TRUST
+                   || packet.tag == OPENPGP_TAG_MARKER
+                   || packet.tag == OPENPGP_TAG_PADDING) {
+            /* Local or meaningless packets */
+            continue;
+        } else if (block == NULL) {
+            goto error;
+        }
+
+        GChecksum *checksum = g_checksum_new(G_CHECKSUM_SHA256);
+        g_checksum_update(checksum, &packet.tag, 1);
+        g_checksum_update(checksum, body, packet.body_length);
+        g_hash_table_add(block->packets,
+                         g_strdup(g_checksum_get_string(checksum)));
+
+        g_checksum_free(checksum);
+        checksum = NULL;
+    }
+
+    if (block != NULL)
+        block->length = length - block->offset;
+
+    return blocks;
+
+ error:
+    g_ptr_array_unref(blocks);
+    return NULL;
+}
+
+/**
+ * This function formats a key ID or fingerprint as uppercase hexadecimal.
+ *
+ * @param data Key ID or fingerprint
+ * @param length Length of the key ID or fingerprint
+ *
+ * @return Hexadecimal string. Owned by caller
+ */
+static char *openpgp_hex(const guint8 *data, gsize length)
+{
+    GString *hex = g_string_sized_new(length * 2);
+
+    for (gsize i = 0; i < length; i++)
+        g_string_append_printf(hex, "%02X", data[i]);
+
+    return g_string_free(hex, false);
+}
+
+/**
+ * This function adds a key ID or fingerprint to a list, unless it is already listed.
+ *
+ * @param ids List of hexadecimal strings
+ * @param data Key ID or fingerprint
+ * @param length Length of the key ID or fingerprint
+ */
+static void openpgp_add_id(GPtrArray *ids, const guint8 *data, gsize length)
+{
+    char *id = openpgp_hex(data, length);
+
+    if (g_ptr_array_find_with_equal_func(ids, id, g_str_equal, NULL)) {
+        g_free(id);
+        id = NULL;
+        return;
+    }
+
+    g_ptr_array_add(ids, id);
+}
+
+/**
+ * This function finds the issuer of a signature packet in its subpackets.
+ *
+ * @param ids List to add the issuer to
+ * @param body Body of the signature packet
+ * @param length Length of the body
+ */
+static void openpgp_signature_issuer(GPtrArray *ids, const guint8 *body,
+                                     gsize length)
+{
+    /* Version 4 and 6 signatures, the subpacket areas of version 6 have four length octets */
+    if (length < 1 || (body[0] != 4 && body[0] != 6))
+        return;
+
+    gsize size_length = (body[0] == 6) ? 4 : 2;
+    gsize position = 4;
+
+    /* Hashed, then unhashed subpackets */
+    for (int area = 0; area < 2; area++) {
+        if (position + size_length > length)
+            return;
+
+        gsize size = 0;
+        for (gsize i = 0; i < size_length; i++)
+            size = (size << 8) | body[position + i];
+        position += size_length;
+
+        if (size > length - position)
+            return;
+
+        gsize end = position + size;
+        while (position < end) {
+            gsize subpacket_length = body[position++];
+
+            if (subpacket_length >= 192 && subpacket_length < 255) {
+                if (position >= end)
+                    return;
+
+                subpacket_length = ((subpacket_length - 192) << 8)
+                    + body[position++] + 192;
+            } else if (subpacket_length == 255) {
+                if (position + 4 > end)
+                    return;
+
+                subpacket_length = ((gsize) body[position] << 24)
+                    | ((gsize) body[position + 1] << 16)
+                    | ((gsize) body[position + 2] << 8) | body[position + 3];
+                position += 4;
+            }
+
+            if (subpacket_length < 1 || subpacket_length > end - position)
+                return;
+
+            guint8 type = body[position] & 0x7f;
+            const guint8 *value = body + position + 1;
+            gsize value_length = subpacket_length - 1;
+
+            /* Issuer fingerprints are preferred over key IDs */
+            if (type == 33 && (value_length == 21 || value_length == 33)) {
+                openpgp_add_id(ids, value + 1, value_length - 1);
+                return;
+            }
+            if (type == 16 && value_length == 8) {
+                openpgp_add_id(ids, value, value_length);
+                return;
+            }
+
+            position += subpacket_length;
+        }
+    }
+}
+
+/**
+ * This function checks whether a public-key algorithm can encrypt session keys.
+ *
+ * @param algorithm Algorithm ID, RFC 9580 section 9.1
+ *
+ * @return Whether the algorithm is RSA, Elgamal, ECDH, X25519 or X448
+ */
+static bool openpgp_encryption_algorithm(guint8 algorithm)
+{
+    return algorithm == 1 || algorithm == 2 || algorithm == 16
+        || algorithm == 18 || algorithm == 20 || algorithm == 25
+        || algorithm == 26;
+}
+
+/**
+ * This function checks the leading octets of a session key packet.
+ *
+ * @param tag OPENPGP_TAG_PKESK or OPENPGP_TAG_SKESK
+ * @param body Body of the packet
+ * @param length Available length of the body
+ *
+ * @return Whether the version and algorithms are known
+ */
+static bool openpgp_session_key_valid(guint8 tag, const guint8 *body,
+                                      gsize length)
+{
+    if (tag == OPENPGP_TAG_PKESK && length >= 10 && body[0] == 3)
+        return openpgp_encryption_algorithm(body[9]);
+
+    /* Version 6 holds the length of the key version and fingerprint, which are left out for anonymous recipients */
+    if (tag == OPENPGP_TAG_PKESK && length >= 3 && body[0] == 6)
+        return (gsize) body[1] + 2 < length
+            && openpgp_encryption_algorithm(body[2 + body[1]]);
+
+    /* Symmetric algorithms, RFC 9580 section 9.3 */
+    if (tag == OPENPGP_TAG_SKESK && length >= 3 && body[0] == 4)
+        return body[1] >= 1 && body[1] <= 13 && body[2] <= 4;
+
+    if (tag == OPENPGP_TAG_SKESK && length >= 6
+        && (body[0] == 5 || body[0] == 6))
+        return body[2] >= 1 && body[2] <= 13 && body[3] >= 1
+            && body[3] <= 3 && body[5] <= 4;
+
+    return false;
+}
+
+/**
+ * This function measures the public key material of a key packet.
+ *
+ * @param algorithm Public-key algorithm, RFC 9580 section 9.1
+ * @param data Start of the key material
+ * @param length Available length of the key material
+ *
+ * @return Length of the key material or 0 if it does not fit
+ */
+static gsize openpgp_key_material(guint8 algorithm, const guint8 *data,
+                                  gsize length)
+{
+    gsize position = 0;
+    guint integers = 0;
+
+    switch (algorithm) {
+    case 1:
+    case 2:
+    case 3:
+        integers = 2;
+        break;
+    case 16:
+    case 20:
+        integers = 3;
+        break;
+    case 17:
+        integers = 4;
+        break;
+    case 18:
+    case 19:
+    case 22:
+        /* Curve OID */
+        if (length < 1 || data[0] == 0 || data[0] == 0xff
+            || data[0] >= length)
+            return 0;
+
+        position = 1 + data[0];
+        integers = 1;
+        break;
+    case 25:
+    case 27:
+        return (length >= 32) ? 32 : 0;
+    case 26:
+        return (length >= 56) ? 56 : 0;
+    case 28:
+        return (length >= 57) ? 57 : 0;
+    default:
+        return 0;
+    }
+
+    for (guint i = 0; i < integers; i++) {
+        if (position + 2 > length)
+            return 0;
+
+        gsize bits = ((gsize) data[position] << 8) | data[position + 1];
+        position += 2 + (bits + 7) / 8;
+
+        if (bits == 0 || position > length)
+            return 0;
+    }
+
+    /* KDF parameters of ECDH */
+    if (algorithm == 18) {
+        if (position + 4 > length || data[position] < 3
+            || data[position + 1] != 1)
+            return 0;
+
+        position += 1 + data[position];
+        if (position > length)
+            return 0;
+    }
+
+    return position;
+}
+
+/**
+ * This function checks that a key packet holds a key.
+ *
+ * @param tag OPENPGP_TAG_PUBLIC_KEY or OPENPGP_TAG_SECRET_KEY
+ * @param body Body of the key packet
+ * @param length Length of the body
+ *
+ * @return Whether the version is known and the key material fills the packet
+ */
+static bool openpgp_key_valid(guint8 tag, const guint8 *body, gsize length)
+{
+    /* Version 5 and 6 keys hold the length of the key material */
+    if (length < 6 || body[0] < 4 || body[0] > 6)
+        return false;
+
+    gsize start = (body[0] == 4) ? 6 : 10;
+    if (start > length)
+        return false;
+
+    gsize material =
+        openpgp_key_material(body[5], body + start, length - start);
+    if (material == 0)
+        return false;
+
+    if (body[0] != 4
+        && material != (((gsize) body[6] << 24) | ((gsize) body[7] << 16)
+                        | ((gsize) body[8] << 8) | body[9]))
+        return false;
+
+    if (tag == OPENPGP_TAG_PUBLIC_KEY)
+        return start + material == length;
+
+    /* Secret keys continue with the protection of the secret part */
+    if (start + material >= length)
+        return false;
+
+    /* Unprotected, a symmetric algorithm or an S2K usage */
+    guint8 usage = body[start + material];
+    return usage <= 13 || usage >= 253;
+}
+
+/**
+ * This function checks the start of a literal data packet.
+ *
+ * @param body Body of the literal data packet
+ * @param length Available length of the body
+ *
+ * @return Whether the format is known and the file name and date fit the data
+ */
+static bool openpgp_literal_valid(const guint8 *body, gsize length)
+{
+    if (length < 2 || body[0] == 0 || memchr("btul1m", body[0], 6) == NULL
+        || (gsize) body[1] + 6 > length)
+        return false;
+
+    /* File names are text */
+    for (gsize i = 0; i < body[1]; i++) {
+        if (body[2 + i] < 0x20 || body[2 + i] == 0x7f)
+            return false;
+    }
+
+    return g_utf8_validate((const char *)body + 2, body[1], NULL);
+}
+
+/**
+ * This function checks that compressed data holds the packets of a message.
+ *
+ * Only the first octets are decompressed, which is enough for the header of the first packet.
+ *
+ * @param body Body of the compressed data packet
+ * @param length Available length of the body
+ *
+ * @return Whether the data decompresses to a one-pass signature, signature or literal data packet
+ */
+static bool openpgp_compressed_valid(const guint8 *body, gsize length)
+{
+    if (length < 2)
+        return false;
+
+    /* BZip2 streams are only checked for their magic */
+    if (body[0] == 3)
+        return length >= 5 && memcmp(body + 1, "BZh", 3) == 0
+            && body[4] >= '1' && body[4] <= '9';
+
+    guint8 plain[64];
+    gsize written = 0;
+
+    if (body[0] == 0) {
+        written = MIN(length - 1, sizeof(plain));
+        memcpy(plain, body + 1, written);
+    } else if (body[0] == 1 || body[0] == 2) {
+        GZlibDecompressor *decompressor =
+            g_zlib_decompressor_new((body[0] == 1) ?
+                                    G_ZLIB_COMPRESSOR_FORMAT_RAW :
+                                    G_ZLIB_COMPRESSOR_FORMAT_ZLIB);
+        gsize read = 0;
+
+        if (g_converter_convert(G_CONVERTER(decompressor), body + 1,
+                                length - 1, plain, sizeof(plain),
+                                G_CONVERTER_NO_FLAGS, &read, &written,
+                                NULL) == G_CONVERTER_ERROR)
+            written = 0;
+
+        g_object_unref(decompressor);
+        decompressor = NULL;
+    }
+
+    gsize offset = 0;
+    openpgp_packet packet;
+    if (written == 0
+        || !openpgp_packet_next(plain, written, &offset, &packet))
+        return false;
+
+    return packet.tag == OPENPGP_TAG_ONE_PASS_SIGNATURE
+        || packet.tag == OPENPGP_TAG_SIGNATURE
+        || packet.tag == OPENPGP_TAG_LITERAL;
+}
+
+/**
+ * This function checks the leading octets of a signature packet.
+ *
+ * @param body Body of the signature packet
+ * @param length Available length of the body
+ *
+ * @return Whether the version and signature type are known
+ */
+static bool openpgp_signature_valid(const guint8 *body, gsize length)
+{
+    static const guint8 types[] = {
+        0x00, 0x01, 0x02, 0x10, 0x11, 0x12, 0x13, 0x18, 0x19, 0x1f, 0x20,
+        0x28, 0x30, 0x40, 0x50
+    };
+
+    /* Version 3 signatures hold the length of the hashed material first */
+    if (length < 3 || body[0] < 3 || body[0] > 6
+        || (body[0] == 3 && body[1] != 5))
+        return false;
+
+    guint8 type = body[(body[0] == 3) ? 2 : 1];
+    return memchr(types, type, sizeof(types)) != NULL;
+}
+
+/**
+ * This function summarizes OpenPGP data from its leading packets, without decrypting or verifying anything.
+ *
+ * Only packet headers and the small packets in front of the payload are read, so the start of a file is enough.
+ * The packets in front of the payload have to be complete and of known versions, and the sequence has to reach
+ * encrypted data, literal or compressed data or a key. Detached and cleartext signatures have to end with the data.
+ * Anything else, e.g. binary files that happen to start like a packet header, is not OpenPGP.
+ *
+ * @param data Binary or armored data, can be truncated
+ * @param length Length of the data
+ *
+ * @return Summary or NULL if the data is not OpenPGP. Free with openpgp_summary_free()
+ */
+openpgp_summary *openpgp_inspect(const guint8 *data, gsize length)
+{
+    GBytes *binary = NULL;
+    bool cleartext = false;
+
+    if (length > 0 && !(data[0] & 0x80)) {
+        binary = openpgp_dearmor(data, length);
+        if (binary == NULL)
+            return NULL;
+
+        gsize offset = 0;
+        gsize line_length;
+        const guint8 *line;
+        while ((line =
+                openpgp_next_line(data, length, &offset,
+                                  &line_length)) != NULL && !cleartext)
+            cleartext =
+                openpgp_line_has_prefix(line, line_length, ARMOR_CLEARTEXT);
+
+        data = g_bytes_get_data(binary, &length);
+    }
+
+    openpgp_summary *summary = g_new0(openpgp_summary, 1);
+    summary->armored = binary != NULL;
+    summary->recipients = g_ptr_array_new_with_free_func(g_free);
+    summary->signers = g_ptr_array_new_with_free_func(g_free);
+
+    gsize offset = 0;
+    openpgp_packet packet;
+    bool done = false;
+    bool valid = true;
+    bool terminated = false; /**< Payload or key reached */
+
+    while (!done && valid
+           && openpgp_packet_next(data, length, &offset, &packet)) {
+        const guint8 *body = data + packet.body_offset;
+        gsize available = (packet.body_offset < length) ?
+            MIN(packet.body_length, length - packet.body_offset) : 0;
+
+        /* Packets in front of the payload are small, so the data holds them completely */
+        bool complete = !packet.partial && available == packet.body_length;
+
+        switch (packet.tag) {
+        case OPENPGP_TAG_PKESK:
+            valid = complete
+                && openpgp_session_key_valid(packet.tag, body, available)
+                && (summary->type == OPENPGP_MESSAGE_UNKNOWN
+                    || summary->type == OPENPGP_MESSAGE_ENCRYPTED);
+            if (!valid)
+                break;
+
+            summary->type = OPENPGP_MESSAGE_ENCRYPTED;
+
+            /* Version 3 holds a key ID, version 6 a key version and fingerprint */
+            if (available >= 9 && body[0] == 3)
+                openpgp_add_id(summary->recipients, body + 1, 8);
+            else if (body[0] == 6 && body[1] == 0)
+                g_ptr_array_add(summary->recipients,
+                                g_strdup("0000000000000000"));
+            else if (body[0] == 6 && body[1] - 1u <= available - 3)
+                openpgp_add_id(summary->recipients, body + 3, body[1] - 1u);
+            break;
+        case OPENPGP_TAG_SKESK:
+            valid = complete
+                && openpgp_session_key_valid(packet.tag, body, available)
+                && (summary->type == OPENPGP_MESSAGE_UNKNOWN
+                    || summary->type == OPENPGP_MESSAGE_ENCRYPTED);
+            if (!valid)
+                break;
+
+            summary->type = OPENPGP_MESSAGE_ENCRYPTED;
+            summary->passwords++;
+            break;
+        case OPENPGP_TAG_SEIPD:
+        case OPENPGP_TAG_AEAD:
+            /* Data without integrity protection is refused by the engine anyway, and has no version to check */
+            valid = summary->type == OPENPGP_MESSAGE_ENCRYPTED
+                && available >= 1
+                && ((packet.tag == OPENPGP_TAG_SEIPD
+                     && (body[0] == 1 || body[0] == 2))
+                    || (packet.tag == OPENPGP_TAG_AEAD && body[0] == 1));
+
+            terminated = true;
+            done = true;
+            break;
+        case OPENPGP_TAG_ONE_PASS_SIGNATURE:
+            valid = complete && available >= 4
+                && (body[0] == 3 || body[0] == 6)
+                && (summary->type == OPENPGP_MESSAGE_UNKNOWN
+                    || summary->type == OPENPGP_MESSAGE_SIGNED);
+            if (!valid)
+                break;
+
+            summary->type = OPENPGP_MESSAGE_SIGNED;
+
+            /* Version 3 holds a key ID, version 6 a salt and fingerprint */
+            if (available >= 12 && body[0] == 3)
+                openpgp_add_id(summary->signers, body + 4, 8);
+            else if (available >= 5 && body[0] == 6
+                     && available >= 5u + body[4] + 32)
+                openpgp_add_id(summary->signers, body + 5 + body[4], 32);
+            break;
+        case OPENPGP_TAG_SIGNATURE:
+            valid = complete && openpgp_signature_valid(body, available)
+                && summary->type != OPENPGP_MESSAGE_ENCRYPTED;
+            if (!valid)
+                break;
+
+            if (summary->type == OPENPGP_MESSAGE_UNKNOWN)
+                summary->type = cleartext ? OPENPGP_MESSAGE_SIGNED :
+                    OPENPGP_MESSAGE_SIGNATURE;
+
+            if (summary->type == OPENPGP_MESSAGE_SIGNED
+                || summary->type == OPENPGP_MESSAGE_SIGNATURE)
+                openpgp_signature_issuer(summary->signers, body, available);
+            break;
+        case OPENPGP_TAG_LITERAL:
+            valid = openpgp_literal_valid(body, available)
+                && (summary->type == OPENPGP_MESSAGE_UNKNOWN
+                    || summary->type == OPENPGP_MESSAGE_SIGNED
+                    || summary->type == OPENPGP_MESSAGE_SIGNATURE);
+            if (!valid)
+                break;
+
+            /* Leading signature packets sign the literal data */
+            if (summary->type == OPENPGP_MESSAGE_SIGNATURE)
+                summary->type = OPENPGP_MESSAGE_SIGNED;
+            else if (summary->type == OPENPGP_MESSAGE_UNKNOWN)
+                summary->type = OPENPGP_MESSAGE_LITERAL;
+
+            summary->file_name = g_strndup((const char *)body + 2, body[1]);
+
+            terminated = true;
+            done = true;
+            break;
+        case OPENPGP_TAG_COMPRESSED:
+            valid = openpgp_compressed_valid(body, available)
+                && (summary->type == OPENPGP_MESSAGE_UNKNOWN
+                    || summary->type == OPENPGP_MESSAGE_SIGNED
+                    || summary->type == OPENPGP_MESSAGE_SIGNATURE);
+            if (!valid)
+                break;
+
+            if (summary->type == OPENPGP_MESSAGE_SIGNATURE)
+                summary->type = OPENPGP_MESSAGE_SIGNED;
+            else if (summary->type == OPENPGP_MESSAGE_UNKNOWN)
+                summary->type = OPENPGP_MESSAGE_COMPRESSED;
+
+            terminated = true;
+            done = true;
+            break;
+        case OPENPGP_TAG_PUBLIC_KEY:
+        case OPENPGP_TAG_SECRET_KEY:
+            /* The next key of a key ring */
+            if (summary->type != OPENPGP_MESSAGE_UNKNOWN) {
+                done = true;
+                break;
+            }
+
+            valid = complete
+                && openpgp_key_valid(packet.tag, body, available);
+            if (!valid)
+                break;
+
+            summary->type = (packet.tag == OPENPGP_TAG_SECRET_KEY) ?
+                OPENPGP_MESSAGE_SECRET_KEY : OPENPGP_MESSAGE_PUBLIC_KEY;
+            terminated = true;
+
+            /* The fingerprint of a secret key only covers its public part */
+            if (packet.tag == OPENPGP_TAG_PUBLIC_KEY)
+                summary->fingerprint = openpgp_fingerprint(body, available);
+            break;
+        case OPENPGP_TAG_USER_ID:
+            if (summary->uid == NULL
+                && (summary->type == OPENPGP_MESSAGE_PUBLIC_KEY
+                    || summary->type == OPENPGP_MESSAGE_SECRET_KEY))
+                summary->uid = g_utf8_make_valid((const char *)body, available);
+
+            valid = terminated;
+            done = summary->uid != NULL;
+            break;
+        case OPENPGP_TAG_MARKER:
+            valid = complete && available == 3
+                && memcmp(body, "PGP", 3) == 0;
+            break;
+        case OPENPGP_TAG_PADDING:
+        case OPENPGP_TAG_TRUST:
+            valid = complete;
+            break;
+        default:
+            /* Other packets of a key, anything else is not a message */
+            valid = terminated;
+            done = true;
+            break;
+        }
+
+        if (packet.partial)
+            done = true;
+    }
+
+    /* Detached and cleartext signatures consist of signature packets only */
+    if (valid && !terminated && offset == length
+        && (summary->type == OPENPGP_MESSAGE_SIGNATURE
+            || (summary->type == OPENPGP_MESSAGE_SIGNED && cleartext)))
+        terminated = true;
+
+    /* Cleanup */
+    if (binary != NULL)
+        g_bytes_unref(binary);
+    binary = NULL;
+
+    if (!valid || !terminated || summary->type == OPENPGP_MESSAGE_UNKNOWN) {
+        openpgp_summary_free(summary);
+        summary = NULL;
+    }
+
+    return summary;
+}
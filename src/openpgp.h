@@ -0,0 +1,88 @@
+#ifndef OPENPGP_H
+#define OPENPGP_H
+
+#include <glib.h>
+
+#include <stdbool.h>
+
+/* Packet tags, RFC 9580 section 5 */
+#define OPENPGP_TAG_PKESK 1
+#define OPENPGP_TAG_SIGNATURE 2
+#define OPENPGP_TAG_SKESK 3
+#define OPENPGP_TAG_ONE_PASS_SIGNATURE 4
+#define OPENPGP_TAG_SECRET_KEY 5
+#define OPENPGP_TAG_PUBLIC_KEY 6
+#define OPENPGP_TAG_SECRET_SUBKEY 7
+#define OPENPGP_TAG_COMPRESSED 8
+#define OPENPGP_TAG_SED 9
+#define OPENPGP_TAG_MARKER 10
+#define OPENPGP_TAG_LITERAL 11
+#define OPENPGP_TAG_TRUST 12
+#define OPENPGP_TAG_USER_ID 13
+#define OPENPGP_TAG_PUBLIC_SUBKEY 14
+#define OPENPGP_TAG_USER_ATTRIBUTE 17
+#define OPENPGP_TAG_SEIPD 18
+#define OPENPGP_TAG_AEAD 20
+#define OPENPGP_TAG_PADDING 21
+
+/**
+ * This structure describes the position of a packet in a buffer.
+ */
+typedef struct {
+    guint8 tag;
+    gsize offset; /**< Offset of the packet header */
+    gsize body_offset;
+    gsize body_length; /**< Length of the first chunk if partial */
+    bool partial; /**< Body uses partial lengths */
+} openpgp_packet;
+
+/**
+ * This structure describes a transferable key in a buffer.
+ */
+typedef struct {
+    char *fingerprint;
+    bool secret;
+    gsize offset;
+    gsize length;
+    GHashTable *packets; /**< Set of digests of the packets of the key */
+} openpgp_key_block;
+
+/**
+ * This enumeration describes the kind of OpenPGP data.
+ */
+typedef enum {
+    OPENPGP_MESSAGE_UNKNOWN,
+    OPENPGP_MESSAGE_ENCRYPTED,
+    OPENPGP_MESSAGE_SIGNED, /**< Inline or cleartext signed */
+    OPENPGP_MESSAGE_SIGNATURE, /**< Detached signature */
+    OPENPGP_MESSAGE_LITERAL,
+    OPENPGP_MESSAGE_COMPRESSED,
+    OPENPGP_MESSAGE_PUBLIC_KEY,
+    OPENPGP_MESSAGE_SECRET_KEY,
+} openpgp_message_type;
+
+/**
+ * This structure summarizes the leading packets of OpenPGP data.
+ */
+typedef struct {
+    openpgp_message_type type;
+    bool armored;
+    GPtrArray *recipients; /**< Key IDs or fingerprints as uppercase hexadecimal, all zeros for anonymous recipients */
+    guint passwords; /**< Number of password-encrypted session keys */
+    GPtrArray *signers; /**< Key IDs or fingerprints as uppercase hexadecimal */
+    char *fingerprint; /**< Of a public key */
+    char *uid; /**< First user ID of a key */
+    char *file_name; /**< Of literal data, can be empty */
+} openpgp_summary;
+
+void openpgp_key_block_free(openpgp_key_block * block);
+void openpgp_summary_free(openpgp_summary * summary);
+
+GBytes *openpgp_dearmor(const guint8 * data, gsize length);
+bool openpgp_packet_next(const guint8 * data, gsize length, gsize * offset,
+                         openpgp_packet * packet);
+char *openpgp_fingerprint(const guint8 * body, gsize length);
+GPtrArray *openpgp_key_blocks(const guint8 * data, gsize length);
+openpgp_summary *openpgp_inspect(const guint8 * data, gsize length);
+
+#endif                          // OPENPGP_H
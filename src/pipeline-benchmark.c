@@ -0,0 +1,247 @@
+#include "pipeline.h"
+
+#include <gio/gio.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include "config.h"
+
+#include <gpgme.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+/*
+ * Compares the I/O backends of the file pipeline.
+ *
+ * Files are copied through an input and an output stage, which is everything process_file() does except the engine.
+ * Run with `meson test --benchmark`, or directly with file sizes in MiB as arguments.
+ */
+
+#define BENCHMARK_BUFFER_SIZE (64 * 1024)
+#define BENCHMARK_RUNS 3
+
+static const guint64 benchmark_sizes[] = { 1, 16, 256 };
+
+/**
+ * This function creates a file of random data.
+ *
+ * @param path Path of the file
+ * @param size Size in bytes
+ *
+ * @return Success
+ */
+static bool benchmark_create(const char *path, guint64 size)
+{
+    int descriptor = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (descriptor < 0)
+        return false;
+
+    GRand *random = g_rand_new();
+    guint32 *block = g_malloc(PIPELINE_BLOCK_SIZE);
+    bool success = true;
+
+    for (guint64 written = 0; success && written < size;) {
+        gsize length = MIN(PIPELINE_BLOCK_SIZE, size - written);
+
+        for (gsize i = 0; i < PIPELINE_BLOCK_SIZE / sizeof(guint32); i++)
+            block[i] = g_rand_int(random);
+
+        success = (write(descriptor, block, length) == (ssize_t) length);
+        written += length;
+    }
+
+    success = success && fsync(descriptor) == 0;
+
+    /* Cleanup */
+    g_free(block);
+    block = NULL;
+
+    g_rand_free(random);
+    random = NULL;
+
+    close(descriptor);
+
+    return success;
+}
+
+/**
+ * This function evicts a file from the page cache, so it is read from disk again.
+ *
+ * @param path Path of the file
+ */
+static void benchmark_evict(const char *path)
+{
+    int descriptor = open(path, O_RDONLY | O_CLOEXEC);
+    if (descriptor < 0)
+        return;
+
+    posix_fadvise(descriptor, 0, 0, POSIX_FADV_DONTNEED);
+    close(descriptor);
+}
+
+/**
+ * This function returns the processor time used by all threads of the process.
+ *
+ * @return Seconds
+ */
+static double benchmark_cpu_time()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6
+        + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+}
+
+/**
+ * This function copies a file through the pipeline like the engine would.
+ *
+ * @param input_path Path of the file to read
+ * @param output_path Path of the file to write
+ * @param size Size of the file in bytes
+ * @param seconds Receives the wall clock time
+ * @param cpu Receives the processor time
+ *
+ * @return Success
+ */
+static bool benchmark_copy(const char *input_path, const char *output_path,
+                           guint64 size, double *seconds, double *cpu)
+{
+    g_autoptr(GFile) input_file = g_file_new_for_path(input_path);
+    g_autoptr(GFile) output_file = g_file_new_for_path(output_path);
+
+    gpgme_data_t input;
+    gpgme_data_t output;
+    pipeline_stage *stage;
+
+    benchmark_evict(input_path);
+
+    double cpu_start = benchmark_cpu_time();
+    gint64 start = g_get_monotonic_time();
+
+    if (pipeline_input_data(input_file, false, &input))
+        return false;
+    if (pipeline_output_data(output_file, false, size, &output, &stage)) {
+        gpgme_data_release(input);
+        return false;
+    }
+
+    char *buffer = g_malloc(BENCHMARK_BUFFER_SIZE);
+    bool success = true;
+    ssize_t count;
+
+    while (success
+           && (count = gpgme_data_read(input, buffer, BENCHMARK_BUFFER_SIZE)) > 0)
+        success = (gpgme_data_write(output, buffer, count) == count);
+
+    success = success && count == 0 && pipeline_finish(stage);
+
+    /* Cleanup */
+    gpgme_data_release(input);
+    gpgme_data_release(output);
+
+    g_free(buffer);
+    buffer = NULL;
+
+    *seconds = (g_get_monotonic_time() - start) / 1e6;
+    *cpu = benchmark_cpu_time() - cpu_start;
+
+    return success;
+}
+
+/**
+ * This function measures a backend on a file.
+ *
+ * @param backend Backend to measure
+ * @param name Name of the backend
+ * @param input_path Path of the file to read
+ * @param output_path Path of the file to write
+ * @param size Size of the file in bytes
+ *
+ * @return Success
+ */
+static bool benchmark_backend(pipeline_backend backend, const char *name,
+                              const char *input_path, const char *output_path,
+                              guint64 size)
+{
+    pipeline_set_backend(backend);
+
+    double best = G_MAXDOUBLE;
+    double best_cpu = 0;
+
+    for (int run = 0; run < BENCHMARK_RUNS; run++) {
+        double seconds;
+        double cpu;
+
+        if (!benchmark_copy
+            (input_path, output_path, size, &seconds, &cpu)) {
+            g_printerr("%s: %s\n", name, g_strerror(errno));
+            return false;
+        }
+
+        if (seconds < best) {
+            best = seconds;
+            best_cpu = cpu;
+        }
+    }
+
+    g_print("%8" G_GUINT64_FORMAT " MiB  %-9s %9.1f MB/s %9.3f s CPU\n",
+            size / (1024 * 1024), name, size / best / 1e6, best_cpu);
+
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    gpgme_check_version(NULL);
+
+    g_autoptr(GError) error = NULL;
+    gchar *directory = g_dir_make_tmp("lock-benchmark-XXXXXX", &error);
+    if (directory == NULL) {
+        g_printerr("%s\n", error->message);
+        return EXIT_FAILURE;
+    }
+
+    gchar *input_path = g_build_filename(directory, "input", NULL);
+    gchar *output_path = g_build_filename(directory, "output", NULL);
+
+    bool uring = pipeline_uring_available();
+    if (!uring)
+        g_print("io_uring is unavailable and is skipped\n");
+
+    int count = (argc > 1) ? argc - 1 : (int)G_N_ELEMENTS(benchmark_sizes);
+    bool success = true;
+
+    for (int i = 0; success && i < count; i++) {
+        guint64 size = (argc > 1) ? g_ascii_strtoull(argv[i + 1], NULL, 10) :
+            benchmark_sizes[i];
+        size *= 1024 * 1024;
+
+        success = benchmark_create(input_path, size)
+            && benchmark_backend(PIPELINE_BACKEND_POSIX, "read/write",
+                                 input_path, output_path, size)
+            && (!uring
+                || benchmark_backend(PIPELINE_BACKEND_IO_URING, "io_uring",
+                                     input_path, output_path, size));
+    }
+
+    /* Cleanup */
+    g_unlink(input_path);
+    g_unlink(output_path);
+    g_rmdir(directory);
+
+    g_free(input_path);
+    input_path = NULL;
+
+    g_free(output_path);
+    output_path = NULL;
+
+    g_free(directory);
+    directory = NULL;
+
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,1638 @@
+#define _GNU_SOURCE             // O_TMPFILE, fallocate and linkat
+
+#include "pipeline.h"
+
+#include <adwaita.h>
+#include <gio/gfiledescriptorbased.h>
+#include <glib/gi18n.h>
+#include <glib/gstdio.h>
+#include <locale.h>
+#include "config.h"
+
+#include <gpgme.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/xattr.h>
+#include <unistd.h>
+
+#if HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#if HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+/*
+ * Files are processed by three stages running at the same time:
+ *
+ * Reader thread -> ring -> engine (GPGME data callbacks) -> ring -> writer thread
+ *
+ * The rings hand over whole blocks, so the disk threads never wait on the engine unless a ring is full or empty.
+ * With io_uring, the disk threads queue reads and writes for every block they may use and register the blocks with the kernel.
+ *
+ * Files are opened through GIO. Local files are read and written through their file descriptor.
+ * Other locations, e.g. GVfs mounts, are streamed.
+ *
+ * Files exported by the document portal are local, but every block passes its FUSE daemon. Input is read from the host
+ * file instead if it is reachable, which is not the case inside a sandbox without filesystem permissions.
+ *
+ * Local output is written to an unnamed file in the target directory, preallocated and linked into place once complete.
+ */
+
+static pipeline_backend pipeline_io_backend = PIPELINE_BACKEND_AUTOMATIC;
+
+/**
+ * This structure holds a bounded ring of blocks between a producing and a consuming stage.
+ */
+typedef struct {
+    guint8 *blocks[PIPELINE_RING_SLOTS];
+    gsize lengths[PIPELINE_RING_SLOTS];
+    guint head; /**< Oldest block filled by the producer */
+    guint tail; /**< Next block to be filled by the producer */
+    guint count; /**< Blocks filled by the producer */
+
+    bool closed; /**< The producer will not fill any more blocks */
+    bool aborted; /**< Either stage gave up */
+    int error; /**< errno of the stage that failed */
+
+    GMutex mutex;
+    GCond cond;
+} pipeline_ring;
+
+/**
+ * This structure holds the state of a pipeline between the engine and a file.
+ */
+struct pipeline_stage {
+    GFile *file;
+    GInputStream *input_stream;
+    GOutputStream *output_stream;
+    int descriptor; /**< File descriptor of the stream or local output. -1 if the stream has none */
+    bool created; /**< The output file did not exist before */
+
+    /* Local output */
+    char *path; /**< Path to publish the output at */
+    char *temporary; /**< Path of the temporary file if unnamed files are unsupported */
+    guint64 written;
+
+    GThread *thread; /**< Reader or writer thread */
+    pipeline_ring ring;
+
+    /* Block of the ring used by the engine */
+    guint8 *block;
+    gsize block_length;
+    gsize position;
+
+    bool compress; /**< Input is compressed before it reaches the engine */
+    bool decompress; /**< Output is recognized and decompressed after the engine */
+    bool started; /**< The engine wrote output */
+    gsize marker; /**< Bytes of the marker emitted or matched */
+    bool decided; /**< Whether the output was recognized as compressed or not */
+    bool passthrough; /**< Output is not compressed and written as is */
+    bool eof;
+    bool finished; /**< Frame is complete */
+
+#if HAVE_ZSTD
+    ZSTD_CCtx *compressor;
+    ZSTD_DCtx *decompressor;
+    ZSTD_inBuffer input;
+#endif
+
+#if HAVE_LIBURING
+    struct io_uring uring;
+    bool uring_enabled;
+    bool uring_fixed; /**< Blocks are registered with the kernel */
+#endif
+};
+
+/**
+ * This function checks whether the pipeline can compress data.
+ *
+ * @return Whether Lock was built with zstd
+ */
+bool pipeline_available()
+{
+    return HAVE_ZSTD;
+}
+
+/**
+ * This function checks whether the kernel allows io_uring.
+ *
+ * Container sandboxes and hardened kernels often block it, so this is probed once.
+ *
+ * @return Whether io_uring can be used
+ */
+bool pipeline_uring_available()
+{
+#if HAVE_LIBURING
+    static gsize available = 0;
+
+    if (g_once_init_enter(&available)) {
+        struct io_uring uring;
+        bool supported = (io_uring_queue_init(1, &uring, 0) == 0);
+
+        if (supported)
+            io_uring_queue_exit(&uring);
+        else
+            g_debug("io_uring is unavailable, falling back to read and write");
+
+        g_once_init_leave(&available, supported ? 2 : 1);
+    }
+
+    return available == 2;
+#else
+    return false;
+#endif
+}
+
+/**
+ * This function chooses how pipeline stages read and write files.
+ *
+ * @param backend I/O backend of pipeline stages created afterwards
+ */
+void pipeline_set_backend(pipeline_backend backend)
+{
+    pipeline_io_backend = backend;
+}
+
+/**
+ * This function converts a GIO error to an errno value.
+ *
+ * @param error GIO error
+ *
+ * @return errno value
+ */
+static int pipeline_errno(GError *error)
+{
+    if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND))
+        return ENOENT;
+    if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_PERMISSION_DENIED))
+        return EACCES;
+    if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_NO_SPACE))
+        return ENOSPC;
+    if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_IS_DIRECTORY))
+        return EISDIR;
+
+    return EIO;
+}
+
+/**
+ * This function reads a block from the file of a pipeline stage.
+ *
+ * @param stage Pipeline stage
+ * @param block Block to fill
+ *
+ * @return Bytes read. Less than PIPELINE_BLOCK_SIZE at the end of the file. -1 on failure, sets errno
+ */
+static gssize pipeline_read_block(pipeline_stage *stage, guint8 *block)
+{
+    gsize length = 0;
+
+    if (stage->descriptor < 0) {
+        g_autoptr(GError) error = NULL;
+
+        if (!g_input_stream_read_all
+            (stage->input_stream, block, PIPELINE_BLOCK_SIZE, &length, NULL,
+             &error)) {
+            g_warning(_("Failed to read input file: %s"), error->message);
+
+            errno = pipeline_errno(error);
+            return -1;
+        }
+
+        return length;
+    }
+
+    while (length < PIPELINE_BLOCK_SIZE) {
+        ssize_t count = read(stage->descriptor, block + length,
+                             PIPELINE_BLOCK_SIZE - length);
+
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count < 0)
+            return -1;
+        if (count == 0)
+            break;
+
+        length += count;
+    }
+
+    return length;
+}
+
+/**
+ * This function writes a block to the file of a pipeline stage.
+ *
+ * @param stage Pipeline stage
+ * @param buffer Data to write
+ * @param length Length of the data
+ *
+ * @return Success. Sets errno on failure
+ */
+static bool pipeline_write_block(pipeline_stage *stage, const guint8 *buffer,
+                                 gsize length)
+{
+    if (stage->descriptor < 0) {
+        g_autoptr(GError) error = NULL;
+
+        if (!g_output_stream_write_all
+            (stage->output_stream, buffer, length, NULL, NULL, &error)) {
+            g_warning(_("Failed to write output file: %s"), error->message);
+
+            errno = pipeline_errno(error);
+            return false;
+        }
+
+        return true;
+    }
+
+    while (length > 0) {
+        ssize_t count = write(stage->descriptor, buffer, length);
+
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count < 0)
+            return false;
+
+        buffer += count;
+        length -= count;
+    }
+
+    return true;
+}
+
+/**** Ring ****/
+
+/**
+ * This function allocates the aligned blocks of a ring.
+ *
+ * @param ring Ring to initialize
+ */
+static void pipeline_ring_init(pipeline_ring *ring)
+{
+    for (guint i = 0; i < PIPELINE_RING_SLOTS; i++)
+        ring->blocks[i] =
+            g_aligned_alloc(1, PIPELINE_BLOCK_SIZE, PIPELINE_BLOCK_ALIGNMENT);
+
+    g_mutex_init(&ring->mutex);
+    g_cond_init(&ring->cond);
+}
+
+/**
+ * This function frees the blocks of a ring.
+ *
+ * @param ring Ring to clear
+ */
+static void pipeline_ring_clear(pipeline_ring *ring)
+{
+    for (guint i = 0; i < PIPELINE_RING_SLOTS; i++) {
+        g_aligned_free(ring->blocks[i]);
+        ring->blocks[i] = NULL;
+    }
+
+    g_mutex_clear(&ring->mutex);
+    g_cond_clear(&ring->cond);
+}
+
+/**
+ * This function waits for a free block of a ring to fill.
+ *
+ * @param ring Ring to produce into
+ * @param ahead Free blocks to skip, which the producer already fills
+ * @param wait Whether to wait for the consumer to free a block
+ * @param slot Receives the index of the block. Can be NULL
+ *
+ * @return Block of PIPELINE_BLOCK_SIZE bytes. NULL once the ring is aborted or if none is free without waiting
+ */
+static guint8 *pipeline_ring_reserve(pipeline_ring *ring, guint ahead,
+                                     bool wait, guint *slot)
+{
+    g_mutex_lock(&ring->mutex);
+    while (wait && ring->count + ahead >= PIPELINE_RING_SLOTS
+           && !ring->aborted)
+        g_cond_wait(&ring->cond, &ring->mutex);
+
+    guint index = (ring->tail + ahead) % PIPELINE_RING_SLOTS;
+    guint8 *block = (ring->aborted
+                     || ring->count + ahead >= PIPELINE_RING_SLOTS) ? NULL :
+        ring->blocks[index];
+    g_mutex_unlock(&ring->mutex);
+
+    if (slot != NULL)
+        *slot = index;
+
+    return block;
+}
+
+/**
+ * This function waits for a free block of a ring to fill.
+ *
+ * @param ring Ring to produce into
+ *
+ * @return Block of PIPELINE_BLOCK_SIZE bytes. NULL once the ring is aborted
+ */
+static guint8 *pipeline_ring_acquire(pipeline_ring *ring)
+{
+    return pipeline_ring_reserve(ring, 0, true, NULL);
+}
+
+/**
+ * This function hands the oldest reserved block of a ring to the consumer.
+ *
+ * @param ring Ring to produce into
+ * @param length Bytes filled
+ */
+static void pipeline_ring_commit(pipeline_ring *ring, gsize length)
+{
+    g_mutex_lock(&ring->mutex);
+    ring->lengths[ring->tail] = length;
+    ring->tail = (ring->tail + 1) % PIPELINE_RING_SLOTS;
+    ring->count++;
+    g_cond_broadcast(&ring->cond);
+    g_mutex_unlock(&ring->mutex);
+}
+
+/**
+ * This function waits for a filled block of a ring.
+ *
+ * @param ring Ring to consume from
+ * @param ahead Filled blocks to skip, which the consumer already uses
+ * @param wait Whether to wait for the producer to fill a block
+ * @param slot Receives the index of the block. Can be NULL
+ * @param length Receives the bytes filled
+ *
+ * @return Block. NULL once the ring is closed and drained, aborted or if none is filled without waiting
+ */
+static guint8 *pipeline_ring_peek_ahead(pipeline_ring *ring, guint ahead,
+                                        bool wait, guint *slot, gsize *length)
+{
+    g_mutex_lock(&ring->mutex);
+    while (wait && ring->count <= ahead && !ring->closed && !ring->aborted)
+        g_cond_wait(&ring->cond, &ring->mutex);
+
+    guint index = (ring->head + ahead) % PIPELINE_RING_SLOTS;
+    guint8 *block = NULL;
+    if (ring->count > ahead && !ring->aborted) {
+        block = ring->blocks[index];
+        *length = ring->lengths[index];
+    }
+    g_mutex_unlock(&ring->mutex);
+
+    if (slot != NULL)
+        *slot = index;
+
+    return block;
+}
+
+/**
+ * This function waits for the oldest filled block of a ring.
+ *
+ * @param ring Ring to consume from
+ * @param length Receives the bytes filled
+ *
+ * @return Block. NULL once the ring is closed and empty or aborted
+ */
+static guint8 *pipeline_ring_peek(pipeline_ring *ring, gsize *length)
+{
+    return pipeline_ring_peek_ahead(ring, 0, true, NULL, length);
+}
+
+/**
+ * This function returns the oldest filled block of a ring to the producer.
+ *
+ * @param ring Ring to consume from
+ */
+static void pipeline_ring_release(pipeline_ring *ring)
+{
+    g_mutex_lock(&ring->mutex);
+    ring->head = (ring->head + 1) % PIPELINE_RING_SLOTS;
+    ring->count--;
+    g_cond_broadcast(&ring->cond);
+    g_mutex_unlock(&ring->mutex);
+}
+
+/**
+ * This function ends a ring.
+ *
+ * @param ring Ring to end
+ * @param abort Whether the other stage should stop right away instead of draining the ring
+ * @param error errno of the failure. 0 if none
+ */
+static void pipeline_ring_close(pipeline_ring *ring, bool abort, int error)
+{
+    g_mutex_lock(&ring->mutex);
+    ring->closed = true;
+    ring->aborted |= abort;
+    if (ring->error == 0)
+        ring->error = error;
+    g_cond_broadcast(&ring->cond);
+    g_mutex_unlock(&ring->mutex);
+}
+
+/**
+ * This function returns the failure of a ring.
+ *
+ * @param ring Ring to check
+ *
+ * @return errno of the stage that failed. 0 if none
+ */
+static int pipeline_ring_error(pipeline_ring *ring)
+{
+    g_mutex_lock(&ring->mutex);
+    int error = ring->error;
+    g_mutex_unlock(&ring->mutex);
+
+    return error;
+}
+
+/**** Stage ****/
+
+/**
+ * This function creates a pipeline stage for a file.
+ *
+ * @param file File. Referenced by the stage
+ * @param stream Opened stream of the file. Owned by the stage. NULL for local output
+ * @param descriptor File descriptor of local output. Owned by the stage
+ * @param output Whether the stage writes the file
+ *
+ * @return Pipeline stage
+ */
+static pipeline_stage *pipeline_stage_new(GFile *file, GObject *stream,
+                                          int descriptor, bool output)
+{
+    pipeline_stage *stage = g_new0(pipeline_stage, 1);
+    stage->file = g_object_ref(file);
+    stage->descriptor = descriptor;
+
+    if (stream != NULL && output)
+        stage->output_stream = G_OUTPUT_STREAM(stream);
+    else if (stream != NULL)
+        stage->input_stream = G_INPUT_STREAM(stream);
+
+    if (stream != NULL)
+        stage->descriptor = G_IS_FILE_DESCRIPTOR_BASED(stream) ?
+            g_file_descriptor_based_get_fd(G_FILE_DESCRIPTOR_BASED(stream)) :
+            -1;
+    pipeline_ring_init(&stage->ring);
+
+    if (stage->descriptor < 0)
+        return stage;
+
+    // Doubles the readahead window on Linux
+    posix_fadvise(stage->descriptor, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+#if HAVE_LIBURING
+    if (pipeline_io_backend != PIPELINE_BACKEND_POSIX
+        && pipeline_uring_available()
+        && io_uring_queue_init(PIPELINE_RING_SLOTS, &stage->uring, 0) == 0) {
+        stage->uring_enabled = true;
+
+        struct iovec vectors[PIPELINE_RING_SLOTS];
+        for (guint i = 0; i < PIPELINE_RING_SLOTS; i++)
+            vectors[i] = (struct iovec) {
+            stage->ring.blocks[i], PIPELINE_BLOCK_SIZE};
+
+        // Fails if the blocks exceed RLIMIT_MEMLOCK, which only costs the page pinning per operation
+        stage->uring_fixed =
+            (io_uring_register_buffers
+             (&stage->uring, vectors, PIPELINE_RING_SLOTS) == 0);
+    }
+#endif
+
+    return stage;
+}
+
+/**
+ * This function stops the thread of a pipeline stage and frees it once GPGME releases its data.
+ *
+ * https://www.gnupg.org/documentation/manuals/gpgme/Callback-Based-Data-Buffers.html
+ *
+ * @param handle Pipeline stage
+ */
+static void pipeline_release(void *handle)
+{
+    pipeline_stage *stage = handle;
+
+    if (stage->thread != NULL) {
+        pipeline_ring_close(&stage->ring, true, 0);
+
+        g_thread_join(stage->thread);
+        stage->thread = NULL;
+    }
+
+#if HAVE_LIBURING
+    if (stage->uring_enabled)
+        io_uring_queue_exit(&stage->uring);
+#endif
+
+    g_clear_object(&stage->input_stream);
+
+    /* Unfinished output does not replace the file */
+    if (stage->output_stream != NULL) {
+        g_autoptr(GCancellable) cancellable = g_cancellable_new();
+        g_cancellable_cancel(cancellable);
+
+        g_output_stream_close(stage->output_stream, cancellable, NULL);
+        g_clear_object(&stage->output_stream);
+
+        if (stage->created)
+            g_file_delete(stage->file, NULL, NULL);
+    }
+
+    /* Local output that was not published is removed, unnamed files vanish with their descriptor */
+    if (stage->path != NULL) {
+        close(stage->descriptor);
+
+        if (stage->temporary != NULL)
+            g_unlink(stage->temporary);
+
+        g_free(stage->temporary);
+        stage->temporary = NULL;
+
+        g_free(stage->path);
+        stage->path = NULL;
+    }
+
+    g_clear_object(&stage->file);
+    pipeline_ring_clear(&stage->ring);
+
+#if HAVE_ZSTD
+    ZSTD_freeCCtx(stage->compressor);
+    stage->compressor = NULL;
+
+    ZSTD_freeDCtx(stage->decompressor);
+    stage->decompressor = NULL;
+#endif
+
+    g_free(stage);
+}
+
+/**** io_uring ****/
+
+#if HAVE_LIBURING
+/**
+ * This function queues a read or write of a block.
+ *
+ * @param stage Pipeline stage
+ * @param slot Index of the block
+ * @param length Bytes to transfer
+ * @param offset Offset in the file
+ * @param write Whether to write instead of read
+ */
+static void pipeline_uring_queue(pipeline_stage *stage, guint slot,
+                                 gsize length, guint64 offset, bool write)
+{
+    struct io_uring_sqe *entry = io_uring_get_sqe(&stage->uring);
+    guint8 *block = stage->ring.blocks[slot];
+
+    if (write && stage->uring_fixed)
+        io_uring_prep_write_fixed(entry, stage->descriptor, block, length,
+                                  offset, slot);
+    else if (write)
+        io_uring_prep_write(entry, stage->descriptor, block, length, offset);
+    else if (stage->uring_fixed)
+        io_uring_prep_read_fixed(entry, stage->descriptor, block, length,
+                                 offset, slot);
+    else
+        io_uring_prep_read(entry, stage->descriptor, block, length, offset);
+
+    io_uring_sqe_set_data64(entry, slot);
+}
+
+/**
+ * This function waits for a queued read or write of a block.
+ *
+ * @param stage Pipeline stage
+ * @param results Receives the result by block index
+ * @param completed Receives the completion by block index
+ *
+ * @return Success of waiting. Sets errno on failure
+ */
+static bool pipeline_uring_complete(pipeline_stage *stage, int *results,
+                                    bool *completed)
+{
+    struct io_uring_cqe *completion;
+
+    int error = io_uring_submit(&stage->uring);
+    if (error >= 0)
+        error = io_uring_wait_cqe(&stage->uring, &completion);
+
+    if (error < 0) {
+        errno = -error;
+        return false;
+    }
+
+    guint slot = io_uring_cqe_get_data64(completion);
+    results[slot] = completion->res;
+    completed[slot] = true;
+
+    io_uring_cqe_seen(&stage->uring, completion);
+
+    return true;
+}
+
+/**
+ * This function waits for the reads or writes still owned by the kernel.
+ *
+ * Blocks completed out of order were already reaped and are not waited for again.
+ *
+ * @param stage Pipeline stage
+ * @param results Receives the result by block index
+ * @param completed Completion by block index
+ * @param queued Number of blocks queued and not handed over
+ */
+static void pipeline_uring_drain(pipeline_stage *stage, int *results,
+                                 bool *completed, guint queued)
+{
+    for (guint slot = 0; slot < PIPELINE_RING_SLOTS; slot++) {
+        if (completed[slot])
+            queued--;
+    }
+
+    while (queued > 0) {
+        if (!pipeline_uring_complete(stage, results, completed))
+            break;
+        queued--;
+    }
+}
+
+/**
+ * This function reads a file into the ring of a pipeline stage with reads queued for every free block. Runs in its own thread.
+ *
+ * @param stage Pipeline stage
+ *
+ * @return NULL
+ */
+static gpointer pipeline_reader_uring(pipeline_stage *stage)
+{
+    int results[PIPELINE_RING_SLOTS];
+    bool completed[PIPELINE_RING_SLOTS] = { false };
+    gsize lengths[PIPELINE_RING_SLOTS];
+
+    struct stat status;
+    guint64 size = (fstat(stage->descriptor, &status) == 0) ? status.st_size : 0;
+    guint64 offset = 0;
+
+    guint queued = 0;
+    guint oldest = 0;
+    int error = 0;
+
+    while (error == 0) {
+        guint slot;
+
+        /* Reads ahead into every free block */
+        while (offset < size
+               && pipeline_ring_reserve(&stage->ring, queued, queued == 0,
+                                        &slot) != NULL) {
+            lengths[slot] = MIN(PIPELINE_BLOCK_SIZE, size - offset);
+            pipeline_uring_queue(stage, slot, lengths[slot], offset, false);
+
+            offset += lengths[slot];
+            queued++;
+        }
+
+        if (queued == 0)
+            break;
+
+        if (!pipeline_uring_complete(stage, results, completed)) {
+            error = errno;
+            break;
+        }
+
+        /* Blocks are handed over in file order */
+        while (queued > 0 && completed[oldest]) {
+            completed[oldest] = false;
+            queued--;
+
+            if (results[oldest] < 0)
+                error = -results[oldest];
+            else if ((gsize) results[oldest] != lengths[oldest])
+                error = EIO;    // Truncated while reading
+            if (error != 0)
+                break;
+
+            pipeline_ring_commit(&stage->ring, results[oldest]);
+            oldest = (oldest + 1) % PIPELINE_RING_SLOTS;
+        }
+    }
+
+    /* Registered blocks must not be freed while the kernel uses them */
+    pipeline_uring_drain(stage, results, completed, queued);
+
+    pipeline_ring_close(&stage->ring, false, error);
+
+    return NULL;
+}
+
+/**
+ * This function writes the ring of a pipeline stage to a file with writes queued for every filled block. Runs in its own thread.
+ *
+ * @param stage Pipeline stage
+ *
+ * @return NULL
+ */
+static gpointer pipeline_writer_uring(pipeline_stage *stage)
+{
+    int results[PIPELINE_RING_SLOTS];
+    bool completed[PIPELINE_RING_SLOTS] = { false };
+    gsize lengths[PIPELINE_RING_SLOTS];
+
+    guint64 offset = 0;
+    guint queued = 0;
+    guint oldest = 0;
+    int error = 0;
+
+    while (error == 0) {
+        guint slot;
+        gsize length;
+
+        /* Writes every filled block */
+        while (pipeline_ring_peek_ahead
+               (&stage->ring, queued, queued == 0, &slot, &length) != NULL) {
+            lengths[slot] = length;
+            pipeline_uring_queue(stage, slot, length, offset, true);
+
+            offset += length;
+            queued++;
+        }
+
+        if (queued == 0)
+            break;
+
+        if (!pipeline_uring_complete(stage, results, completed)) {
+            error = errno;
+            break;
+        }
+
+        while (queued > 0 && completed[oldest]) {
+            completed[oldest] = false;
+            queued--;
+
+            if (results[oldest] < 0)
+                error = -results[oldest];
+            else if ((gsize) results[oldest] != lengths[oldest])
+                error = ENOSPC;
+            if (error != 0)
+                break;
+
+            stage->written += lengths[oldest];
+            pipeline_ring_release(&stage->ring);
+            oldest = (oldest + 1) % PIPELINE_RING_SLOTS;
+        }
+    }
+
+    pipeline_uring_drain(stage, results, completed, queued);
+
+    if (error != 0)
+        pipeline_ring_close(&stage->ring, true, error);
+
+    return NULL;
+}
+#endif
+
+/**** Input ****/
+
+/**
+ * This function reads a file into the ring of a pipeline stage. Runs in its own thread.
+ *
+ * @param stage Pipeline stage
+ *
+ * @return NULL
+ */
+static gpointer pipeline_reader(pipeline_stage *stage)
+{
+#if HAVE_LIBURING
+    if (stage->uring_enabled)
+        return pipeline_reader_uring(stage);
+#endif
+
+    int error = 0;
+
+    while (error == 0) {
+        guint8 *block = pipeline_ring_acquire(&stage->ring);
+        if (block == NULL)
+            break;
+
+        gssize length = pipeline_read_block(stage, block);
+        if (length < 0) {
+            error = errno;
+            break;
+        }
+
+        if (length > 0)
+            pipeline_ring_commit(&stage->ring, length);
+
+        if (length < PIPELINE_BLOCK_SIZE)
+            break;
+    }
+
+    pipeline_ring_close(&stage->ring, false, error);
+
+    return NULL;
+}
+
+/**
+ * This function moves the engine to the next block read from the file.
+ *
+ * @param stage Pipeline stage
+ *
+ * @return Whether there is a block. Sets errno if the reader failed
+ */
+static bool pipeline_input_next(pipeline_stage *stage)
+{
+    if (stage->block != NULL) {
+        pipeline_ring_release(&stage->ring);
+        stage->block = NULL;
+    }
+
+    stage->position = 0;
+    stage->block = pipeline_ring_peek(&stage->ring, &stage->block_length);
+
+    if (stage->block == NULL)
+        errno = pipeline_ring_error(&stage->ring);
+
+    return stage->block != NULL;
+}
+
+/**
+ * This function reads the marker and compressed data of a file for GPGME.
+ *
+ * @param stage Pipeline stage
+ * @param buffer Buffer to fill
+ * @param size Size of the buffer
+ *
+ * @return Bytes read, 0 at the end and -1 on failure
+ */
+static ssize_t pipeline_input_compress(pipeline_stage *stage, void *buffer,
+                                       size_t size)
+{
+    if (stage->marker < PIPELINE_MARKER_LENGTH) {
+        gsize length = MIN(size, PIPELINE_MARKER_LENGTH - stage->marker);
+
+        memcpy(buffer, PIPELINE_MARKER + stage->marker, length);
+        stage->marker += length;
+
+        return length;
+    }
+
+#if HAVE_ZSTD
+    ZSTD_outBuffer output = { buffer, size, 0 };
+
+    while (output.pos == 0 && !stage->finished) {
+        if (stage->input.pos == stage->input.size && !stage->eof) {
+            if (pipeline_input_next(stage))
+                stage->input = (ZSTD_inBuffer) {
+                stage->block, stage->block_length, 0};
+            else if (errno != 0)
+                return -1;
+            else
+                stage->eof = true;
+        }
+
+        size_t remaining = ZSTD_compressStream2(stage->compressor, &output,
+                                                &stage->input,
+                                                stage->eof ? ZSTD_e_end :
+                                                ZSTD_e_continue);
+        if (ZSTD_isError(remaining)) {
+            g_warning(_("Failed to compress data: %s"),
+                      ZSTD_getErrorName(remaining));
+
+            errno = EIO;
+            return -1;
+        }
+
+        stage->finished = (stage->eof && remaining == 0);
+    }
+
+    return output.pos;
+#else
+    errno = ENOTSUP;
+    return -1;
+#endif
+}
+
+/**
+ * This function reads data of a file for GPGME.
+ *
+ * https://www.gnupg.org/documentation/manuals/gpgme/Callback-Based-Data-Buffers.html
+ *
+ * @param handle Pipeline stage
+ * @param buffer Buffer to fill
+ * @param size Size of the buffer
+ *
+ * @return Bytes read, 0 at the end and -1 on failure
+ */
+static ssize_t pipeline_input_read(void *handle, void *buffer, size_t size)
+{
+    pipeline_stage *stage = handle;
+
+    if (stage->compress)
+        return pipeline_input_compress(stage, buffer, size);
+
+    if (stage->eof)
+        return 0;
+
+    if (stage->block == NULL || stage->position == stage->block_length) {
+        if (!pipeline_input_next(stage)) {
+            stage->eof = (errno == 0);
+            return stage->eof ? 0 : -1;
+        }
+    }
+
+    gsize length = MIN(size, stage->block_length - stage->position);
+    memcpy(buffer, stage->block + stage->position, length);
+    stage->position += length;
+
+    return length;
+}
+
+static struct gpgme_data_cbs pipeline_input_callbacks = {
+    .read = pipeline_input_read,
+    .release = pipeline_release
+};
+
+/**
+ * This function opens the host file behind a file exported by the document portal.
+ *
+ * @param file File to read
+ *
+ * @return Stream of the host file. NULL to read through the portal
+ */
+static GFileInputStream *pipeline_portal_read(GFile *file)
+{
+    g_autofree gchar *path = g_file_get_path(file);
+    g_autofree gchar *portal =
+        g_strconcat(g_get_user_runtime_dir(), "/doc/", NULL);
+
+    if (path == NULL || !g_str_has_prefix(path, portal))
+        return NULL;
+
+    // Exposed by xdg-document-portal 1.17 and later
+    char host[PATH_MAX];
+    ssize_t length = getxattr(path, "user.document-portal.host-path", host,
+                              sizeof(host) - 1);
+    if (length <= 0)
+        return NULL;
+    host[length] = '\0';
+
+    /* Only the same contents, in case the host file was replaced meanwhile */
+    GStatBuf exported;
+    GStatBuf direct;
+    if (g_stat(path, &exported) != 0 || g_stat(host, &direct) != 0
+        || exported.st_size != direct.st_size
+        || exported.st_mtime != direct.st_mtime)
+        return NULL;
+
+    g_autoptr(GFile) host_file = g_file_new_for_path(host);
+    return g_file_read(host_file, NULL, NULL);
+}
+
+/**
+ * This function creates GPGME data that reads a file on a separate thread while the engine processes it.
+ *
+ * Compressed data starts with PIPELINE_MARKER, so pipeline_output_data() undoes the compression after decryption.
+ *
+ * @param file File to read
+ * @param compress Whether to compress the file with multi-threaded zstd
+ * @param data Receives the GPGME data. Owns the pipeline stage
+ *
+ * @return GPGME error
+ */
+gpgme_error_t pipeline_input_data(GFile *file, bool compress,
+                                  gpgme_data_t *data)
+{
+#if !HAVE_ZSTD
+    if (compress)
+        return gpgme_error(GPG_ERR_NOT_SUPPORTED);
+#endif
+
+    g_autoptr(GError) error_gio = NULL;
+    GFileInputStream *stream = pipeline_portal_read(file);
+    if (stream == NULL)
+        stream = g_file_read(file, NULL, &error_gio);
+    if (stream == NULL) {
+        g_warning(_("Failed to open input file: %s"), error_gio->message);
+        return gpgme_error_from_errno(pipeline_errno(error_gio));
+    }
+
+    pipeline_stage *stage =
+        pipeline_stage_new(file, G_OBJECT(stream), -1, false);
+    stage->compress = compress;
+
+#if HAVE_ZSTD
+    if (compress) {
+        stage->compressor = ZSTD_createCCtx();
+        ZSTD_CCtx_setParameter(stage->compressor, ZSTD_c_compressionLevel,
+                               ZSTD_CLEVEL_DEFAULT);
+        // Fails without multi-threading support in libzstd, which compresses on the calling thread instead
+        ZSTD_CCtx_setParameter(stage->compressor, ZSTD_c_nbWorkers,
+                               g_get_num_processors());
+    }
+#endif
+
+    stage->thread =
+        g_thread_new("pipeline-reader", (GThreadFunc) pipeline_reader, stage);
+
+    gpgme_error_t error =
+        gpgme_data_new_from_cbs(data, &pipeline_input_callbacks, stage);
+    if (error)
+        pipeline_release(stage);
+
+    return error;
+}
+
+/**** Output ****/
+
+/**
+ * This function writes the ring of a pipeline stage to a file. Runs in its own thread.
+ *
+ * @param stage Pipeline stage
+ *
+ * @return NULL
+ */
+static gpointer pipeline_writer(pipeline_stage *stage)
+{
+#if HAVE_LIBURING
+    if (stage->uring_enabled)
+        return pipeline_writer_uring(stage);
+#endif
+
+    guint8 *block;
+    gsize length;
+
+    while ((block = pipeline_ring_peek(&stage->ring, &length)) != NULL) {
+        if (!pipeline_write_block(stage, block, length)) {
+            pipeline_ring_close(&stage->ring, true, errno);
+            break;
+        }
+
+        stage->written += length;
+
+        pipeline_ring_release(&stage->ring);
+    }
+
+    return NULL;
+}
+
+/**
+ * This function makes sure the engine has a free block of the ring to write to.
+ *
+ * @param stage Pipeline stage
+ *
+ * @return Success. Sets errno if the writer failed
+ */
+static bool pipeline_output_block(pipeline_stage *stage)
+{
+    if (stage->block != NULL)
+        return true;
+
+    stage->position = 0;
+    stage->block = pipeline_ring_acquire(&stage->ring);
+
+    if (stage->block == NULL) {
+        errno = pipeline_ring_error(&stage->ring);
+        if (errno == 0)
+            errno = EIO;
+    }
+
+    return stage->block != NULL;
+}
+
+/**
+ * This function hands the block the engine wrote to over to the writer once it is full.
+ *
+ * @param stage Pipeline stage
+ * @param partial Whether to hand over a block that is not full
+ */
+static void pipeline_output_commit(pipeline_stage *stage, bool partial)
+{
+    if (stage->block == NULL || stage->position == 0)
+        return;
+
+    if (stage->position == PIPELINE_BLOCK_SIZE || partial) {
+        pipeline_ring_commit(&stage->ring, stage->position);
+        stage->block = NULL;
+    }
+}
+
+/**
+ * This function copies data into the ring of a pipeline stage.
+ *
+ * @param stage Pipeline stage
+ * @param bytes Data to write
+ * @param length Length of the data
+ *
+ * @return Success. Sets errno on failure
+ */
+static bool pipeline_output_put(pipeline_stage *stage, const guint8 *bytes,
+                                gsize length)
+{
+    while (length > 0) {
+        if (!pipeline_output_block(stage))
+            return false;
+
+        gsize count = MIN(length, PIPELINE_BLOCK_SIZE - stage->position);
+        memcpy(stage->block + stage->position, bytes, count);
+
+        stage->position += count;
+        bytes += count;
+        length -= count;
+
+        pipeline_output_commit(stage, false);
+    }
+
+    return true;
+}
+
+#if HAVE_ZSTD
+/**
+ * This function decompresses data straight into the ring of a pipeline stage.
+ *
+ * @param stage Pipeline stage
+ * @param buffer Compressed data
+ * @param length Length of the compressed data
+ *
+ * @return Success. Sets errno on failure
+ */
+static bool pipeline_decompress(pipeline_stage *stage, const guint8 *buffer,
+                                gsize length)
+{
+    ZSTD_inBuffer input = { buffer, length, 0 };
+    bool flushed = false;
+
+    while (input.pos < input.size || !flushed) {
+        if (!pipeline_output_block(stage))
+            return false;
+
+        ZSTD_outBuffer output = {
+            stage->block + stage->position,
+            PIPELINE_BLOCK_SIZE - stage->position, 0
+        };
+
+        size_t remaining =
+            ZSTD_decompressStream(stage->decompressor, &output, &input);
+        if (ZSTD_isError(remaining)) {
+            g_warning(_("Failed to decompress data: %s"),
+                      ZSTD_getErrorName(remaining));
+
+            errno = EIO;
+            return false;
+        }
+
+        stage->position += output.pos;
+        stage->finished = (remaining == 0);
+        flushed = (output.pos < output.size);
+
+        pipeline_output_commit(stage, false);
+    }
+
+    return true;
+}
+#endif
+
+/**
+ * This function recognizes PIPELINE_MARKER at the start of the decrypted data.
+ *
+ * @param stage Pipeline stage
+ * @param bytes Decrypted data
+ * @param size Length of the decrypted data
+ *
+ * @return Bytes of the marker consumed. -1 on failure
+ */
+static gssize pipeline_output_detect(pipeline_stage *stage,
+                                     const guint8 *bytes, gsize size)
+{
+    gsize consumed = 0;
+
+    while (stage->marker < PIPELINE_MARKER_LENGTH && consumed < size) {
+        if (bytes[consumed] != (guint8) PIPELINE_MARKER[stage->marker]) {
+            stage->passthrough = true;
+            break;
+        }
+
+        stage->marker++;
+        consumed++;
+    }
+
+    if (stage->passthrough) {
+        stage->decided = true;
+
+        if (!pipeline_output_put
+            (stage, (const guint8 *)PIPELINE_MARKER, stage->marker))
+            return -1;
+    } else if (stage->marker == PIPELINE_MARKER_LENGTH) {
+        stage->decided = true;
+
+#if HAVE_ZSTD
+        stage->decompressor = ZSTD_createDCtx();
+#else
+        g_warning(_("Failed to decompress data: Lock was built without zstd"));
+
+        errno = ENOTSUP;
+        return -1;
+#endif
+    }
+
+    return consumed;
+}
+
+/**
+ * This function writes the data of GPGME to a file and undoes the compression of the pipeline.
+ *
+ * Data without PIPELINE_MARKER is written as is.
+ *
+ * https://www.gnupg.org/documentation/manuals/gpgme/Callback-Based-Data-Buffers.html
+ *
+ * @param handle Pipeline stage
+ * @param buffer Data
+ * @param size Length of the data
+ *
+ * @return Bytes written or -1 on failure
+ */
+static ssize_t pipeline_output_write(void *handle, const void *buffer,
+                                     size_t size)
+{
+    pipeline_stage *stage = handle;
+    const guint8 *bytes = buffer;
+    gsize consumed = 0;
+
+    stage->started = true;
+
+    if (!stage->decided) {
+        gssize detected = pipeline_output_detect(stage, bytes, size);
+        if (detected < 0)
+            return -1;
+        if (!stage->decided)
+            return size;
+
+        consumed = detected;
+    }
+
+    if (stage->passthrough) {
+        if (!pipeline_output_put(stage, bytes + consumed, size - consumed))
+            return -1;
+
+        return size;
+    }
+#if HAVE_ZSTD
+    if (!pipeline_decompress(stage, bytes + consumed, size - consumed))
+        return -1;
+#endif
+
+    return size;
+}
+
+static struct gpgme_data_cbs pipeline_output_callbacks = {
+    .write = pipeline_output_write,
+    .release = pipeline_release
+};
+
+/**
+ * This function creates an unnamed file in the directory of a local output.
+ *
+ * @param stage Pipeline stage, receives the path of a temporary file if unnamed files are unsupported
+ * @param path Path of the output
+ *
+ * @return File descriptor. -1 on failure, sets errno
+ */
+static int pipeline_output_open(pipeline_stage *stage, const char *path)
+{
+    gchar *directory = g_path_get_dirname(path);
+
+    int descriptor = open(directory, O_TMPFILE | O_WRONLY | O_CLOEXEC, 0666);
+
+    // Not every file system supports unnamed files, e.g. the FUSE file system of the document portal
+    if (descriptor < 0) {
+        gchar *name = g_path_get_basename(path);
+
+        stage->temporary = g_strdup_printf("%s/.%s.XXXXXX", directory, name);
+        descriptor =
+            g_mkstemp_full(stage->temporary, O_WRONLY | O_CLOEXEC, 0666);
+
+        if (descriptor < 0) {
+            g_free(stage->temporary);
+            stage->temporary = NULL;
+        }
+
+        g_free(name);
+        name = NULL;
+    }
+
+    /* Cleanup */
+    g_free(directory);
+    directory = NULL;
+
+    return descriptor;
+}
+
+/**
+ * This function gives local output the mode and owner of the file it replaces.
+ *
+ * @param stage Pipeline stage
+ *
+ * @return Success. Sets errno on failure
+ */
+static bool pipeline_output_inherit(pipeline_stage *stage)
+{
+    GStatBuf status;
+    if (g_stat(stage->path, &status) != 0)
+        return errno == ENOENT;
+
+    // Only allowed for privileged users or groups of the user, the mode is kept regardless
+    if (fchown(stage->descriptor, status.st_uid, status.st_gid) != 0
+        && fchown(stage->descriptor, -1, status.st_gid) != 0)
+        g_debug("Keeping the owner of the output: %s", strerror(errno));
+
+    /* Changing the owner clears set-user-ID and set-group-ID bits */
+    return fchmod(stage->descriptor, status.st_mode & 07777) == 0;
+}
+
+/**
+ * This function moves complete local output into place.
+ *
+ * Replaced files keep their mode and, where allowed, their owner.
+ *
+ * @param stage Pipeline stage
+ *
+ * @return Success. Sets errno on failure
+ */
+static bool pipeline_output_publish(pipeline_stage *stage)
+{
+    // Drops the preallocation beyond the data and makes the data durable before its name
+    if (ftruncate(stage->descriptor, stage->written) != 0
+        || fdatasync(stage->descriptor) != 0
+        || !pipeline_output_inherit(stage))
+        return false;
+
+    if (stage->temporary != NULL) {
+        if (rename(stage->temporary, stage->path) != 0)
+            return false;
+
+        g_free(stage->temporary);
+        stage->temporary = NULL;
+
+        return true;
+    }
+
+    gchar *link = g_strdup_printf("/proc/self/fd/%d", stage->descriptor);
+    bool linked = (linkat(AT_FDCWD, link, AT_FDCWD, stage->path,
+                          AT_SYMLINK_FOLLOW) == 0);
+
+    /* Existing files are replaced atomically through a temporary name */
+    if (!linked && errno == EEXIST) {
+        gchar *temporary = g_strdup_printf("%s.%08x", stage->path,
+                                           g_random_int());
+
+        linked = (linkat(AT_FDCWD, link, AT_FDCWD, temporary,
+                         AT_SYMLINK_FOLLOW) == 0);
+        if (linked && rename(temporary, stage->path) != 0) {
+            int error = errno;
+
+            g_unlink(temporary);
+            errno = error;
+            linked = false;
+        }
+
+        g_free(temporary);
+        temporary = NULL;
+    }
+
+    /* Cleanup */
+    g_free(link);
+    link = NULL;
+
+    return linked;
+}
+
+/**
+ * This function opens local output that is written at arbitrary offsets by the caller, e.g. chunks of a container.
+ *
+ * The file is only replaced once pipeline_file_publish() succeeds.
+ *
+ * @param path Path of the output
+ * @param descriptor Receives the file descriptor to write to. Owned by the stage
+ *
+ * @return Pipeline stage. NULL on failure, sets errno. Free with pipeline_file_release()
+ */
+pipeline_stage *pipeline_file_open(const char *path, int *descriptor)
+{
+    pipeline_stage *stage = g_new0(pipeline_stage, 1);
+
+    stage->descriptor = pipeline_output_open(stage, path);
+    if (stage->descriptor < 0) {
+        int error = errno;
+
+        g_free(stage);
+        errno = error;
+        return NULL;
+    }
+
+    stage->path = g_strdup(path);
+    *descriptor = stage->descriptor;
+
+    return stage;
+}
+
+/**
+ * This function moves complete output of pipeline_file_open() into place.
+ *
+ * @param stage Pipeline stage
+ *
+ * @return Success. Sets errno on failure
+ */
+bool pipeline_file_publish(pipeline_stage *stage)
+{
+    struct stat status;
+    if (fstat(stage->descriptor, &status) != 0)
+        return false;
+
+    stage->written = status.st_size;
+
+    return pipeline_output_publish(stage);
+}
+
+/**
+ * This function frees a pipeline stage of pipeline_file_open(). Output that was not published is removed.
+ *
+ * @param stage Pipeline stage
+ */
+void pipeline_file_release(pipeline_stage *stage)
+{
+    close(stage->descriptor);
+
+    if (stage->temporary != NULL)
+        g_unlink(stage->temporary);
+
+    /* Cleanup */
+    g_free(stage->temporary);
+    stage->temporary = NULL;
+
+    g_free(stage->path);
+    stage->path = NULL;
+
+    g_free(stage);
+}
+
+/**
+ * This function creates GPGME data that writes to a file on a separate thread while the engine processes the input.
+ *
+ * The file is only replaced once pipeline_finish() succeeds.
+ *
+ * @param file File to write
+ * @param decompress Whether to recognize and undo the compression of pipeline_input_data()
+ * @param size Expected size of the output to preallocate. 0 if unknown
+ * @param data Receives the GPGME data. Owns the pipeline stage
+ * @param stage Receives the pipeline stage to finish once the engine wrote all data
+ *
+ * @return GPGME error
+ */
+gpgme_error_t pipeline_output_data(GFile *file, bool decompress,
+                                   guint64 size, gpgme_data_t *data,
+                                   pipeline_stage **stage)
+{
+    char *path = g_file_get_path(file);
+
+    if (path != NULL) {
+        pipeline_stage local = { 0 };
+
+        int descriptor = pipeline_output_open(&local, path);
+        if (descriptor < 0) {
+            g_warning(_("Failed to open output file: %s"), strerror(errno));
+
+            g_free(path);
+            return gpgme_error_from_syserror();
+        }
+
+        // Lets the file system allocate contiguous extents up front
+        if (size > 0)
+            fallocate(descriptor, 0, 0, size);
+
+        *stage = pipeline_stage_new(file, NULL, descriptor, true);
+        (*stage)->path = path;
+        (*stage)->temporary = local.temporary;
+    } else {
+        bool created = !g_file_query_exists(file, NULL);
+
+        g_autoptr(GError) error_gio = NULL;
+        GFileOutputStream *stream =
+            g_file_replace(file, NULL, false, G_FILE_CREATE_NONE, NULL,
+                           &error_gio);
+        if (stream == NULL) {
+            g_warning(_("Failed to open output file: %s"), error_gio->message);
+            return gpgme_error_from_errno(pipeline_errno(error_gio));
+        }
+
+        *stage = pipeline_stage_new(file, G_OBJECT(stream), -1, true);
+        (*stage)->created = created;
+    }
+
+    (*stage)->decompress = decompress;
+    (*stage)->decided = !decompress;
+    (*stage)->passthrough = !decompress;
+
+    (*stage)->thread =
+        g_thread_new("pipeline-writer", (GThreadFunc) pipeline_writer, *stage);
+
+    gpgme_error_t error =
+        gpgme_data_new_from_cbs(data, &pipeline_output_callbacks, *stage);
+    if (error) {
+        pipeline_release(*stage);
+        *stage = NULL;
+    }
+
+    return error;
+}
+
+/**
+ * This function lets a stage of pipeline_output_data() undo the compression of the pipeline after all, e.g. once the
+ * engine reports the literal file name PIPELINE_FILE_NAME.
+ *
+ * Only possible before the engine wrote any output. Must be called on the thread of the engine.
+ *
+ * @param stage Pipeline stage
+ *
+ * @return Whether the stage decompresses the output
+ */
+bool pipeline_output_decompress(pipeline_stage *stage)
+{
+    if (stage->decompress)
+        return true;
+    if (stage->started)
+        return false;
+
+    stage->decompress = true;
+    stage->decided = false;
+    stage->passthrough = false;
+
+    return true;
+}
+
+/**
+ * This function completes the output of a pipeline stage and waits for the writer.
+ *
+ * @param stage Pipeline stage of pipeline_output_data()
+ *
+ * @return Whether the output is complete. Sets errno on failure
+ */
+bool pipeline_finish(pipeline_stage *stage)
+{
+    bool success = true;
+
+    // Short output that matched the start of the marker
+    if (!stage->decided) {
+        stage->decided = true;
+        stage->passthrough = true;
+
+        success = pipeline_output_put(stage, (const guint8 *)PIPELINE_MARKER,
+                                      stage->marker);
+    }
+
+    if (success)
+        pipeline_output_commit(stage, true);
+    pipeline_ring_close(&stage->ring, !success, 0);
+
+    g_thread_join(stage->thread);
+    stage->thread = NULL;
+
+    int error = pipeline_ring_error(&stage->ring);
+    if (success && error != 0) {
+        g_warning(_("Failed to write output file: %s"), strerror(error));
+
+        errno = error;
+        success = false;
+    }
+
+    if (success && !stage->passthrough && !stage->finished) {
+        g_warning(_("Failed to decompress data: %s"),
+                  C_("Decompression error", "data is truncated"));
+
+        errno = EIO;
+        success = false;
+    }
+
+    /* Replaces the file */
+    if (success && stage->path != NULL) {
+        success = pipeline_output_publish(stage);
+        if (!success)
+            g_warning(_("Failed to write output file: %s"), strerror(errno));
+    } else if (success) {
+        g_autoptr(GError) error_gio = NULL;
+
+        success = g_output_stream_close(stage->output_stream, NULL,
+                                        &error_gio);
+        if (!success) {
+            g_warning(_("Failed to write output file: %s"),
+                      error_gio->message);
+            errno = pipeline_errno(error_gio);
+        }
+    }
+
+    if (success)
+        g_clear_object(&stage->output_stream);
+
+    return success;
+}
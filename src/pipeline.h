@@ -0,0 +1,45 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <gio/gio.h>
+#include <gpgme.h>
+
+#include <stdbool.h>
+
+/* Marks plaintext compressed by the pipeline before encryption */
+#define PIPELINE_MARKER "LOCKZST\x01"
+#define PIPELINE_MARKER_LENGTH (sizeof(PIPELINE_MARKER) - 1)
+/* Literal file name signalling PIPELINE_MARKER in authenticated plaintext */
+#define PIPELINE_FILE_NAME "LOCKZST"
+
+/* Size and alignment of the blocks passed between the stages */
+#define PIPELINE_BLOCK_SIZE (1024 * 1024)
+#define PIPELINE_BLOCK_ALIGNMENT 4096
+/* Number of blocks buffered between two stages */
+#define PIPELINE_RING_SLOTS 8
+
+typedef enum {
+    PIPELINE_BACKEND_AUTOMATIC, /**< io_uring if the kernel allows it, POSIX otherwise */
+    PIPELINE_BACKEND_POSIX,
+    PIPELINE_BACKEND_IO_URING
+} pipeline_backend;
+
+typedef struct pipeline_stage pipeline_stage;
+
+bool pipeline_available();
+bool pipeline_uring_available();
+void pipeline_set_backend(pipeline_backend backend);
+
+gpgme_error_t pipeline_input_data(GFile * file, bool compress,
+                                  gpgme_data_t * data);
+gpgme_error_t pipeline_output_data(GFile * file, bool decompress,
+                                   guint64 size, gpgme_data_t * data,
+                                   pipeline_stage ** stage);
+bool pipeline_output_decompress(pipeline_stage * stage);
+bool pipeline_finish(pipeline_stage * stage);
+
+pipeline_stage *pipeline_file_open(const char *path, int *descriptor);
+bool pipeline_file_publish(pipeline_stage * stage);
+void pipeline_file_release(pipeline_stage * stage);
+
+#endif                          // PIPELINE_H
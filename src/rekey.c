@@ -0,0 +1,1090 @@
+#define _GNU_SOURCE             // copy_file_range
+
+#include "rekey.h"
+
+#include <adwaita.h>
+#include <glib/gi18n.h>
+#include <glib/gstdio.h>
+#include <locale.h>
+#include "config.h"
+
+#include <gpgme.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "openpgp.h"
+
+#if HAVE_LIBGCRYPT
+#include <gcrypt.h>
+#endif
+
+/*
+ * Re-keying replaces the public-key encrypted session key packets (PKESK) of an encrypted file,
+ * so new recipients can decrypt it, without touching the encrypted data packet.
+ *
+ * 1. The key packets and the start of the data packet are handed to the engine with export-session-key.
+ *    The engine decrypts the session key with the local secret key and fails on the truncated data.
+ * 2. The session key is encrypted for each new recipient into a version 3 PKESK packet, RFC 9580 section 5.1.
+ * 3. The new key packets are written in front of the unchanged data packet. If the key packets
+ *    keep their length, the file is cloned and only its first block is rewritten.
+ *
+ * The cost of a file is therefore one session key decryption plus one copy in the kernel, which
+ * file systems with reflinks turn into a metadata operation.
+ */
+
+#define REKEY_PKESK_VERSION 3
+#define REKEY_ALGORITHM_RSA 1
+#define REKEY_ALGORITHM_RSA_ENCRYPT 2
+#define REKEY_ALGORITHM_ECDH 18
+#define REKEY_BUFFER_SIZE (256 * 1024)
+
+/**
+ * This function checks whether files can be re-keyed.
+ *
+ * @return Whether libgcrypt is available
+ */
+bool rekey_available()
+{
+    return HAVE_LIBGCRYPT;
+}
+
+#if HAVE_LIBGCRYPT
+
+/**
+ * This structure describes an elliptic curve usable for ECDH, RFC 9580 section 9.2.
+ */
+typedef struct {
+    const guint8 *oid;
+    gsize oid_length;
+    const char *name; /**< Name of the curve in libgcrypt */
+    unsigned int bits;
+    bool montgomery; /**< Curve25519 keeps its points in little-endian order */
+} rekey_curve;
+
+static const rekey_curve rekey_curves[] = {
+    { (const guint8 *)"\x2b\x06\x01\x04\x01\x97\x55\x01\x05\x01", 10,
+     "Curve25519", 255, true },
+    { (const guint8 *)"\x2a\x86\x48\xce\x3d\x03\x01\x07", 8, "NIST P-256", 256,
+     false },
+    { (const guint8 *)"\x2b\x81\x04\x00\x22", 5, "NIST P-384", 384, false },
+    { (const guint8 *)"\x2b\x81\x04\x00\x23", 5, "NIST P-521", 521, false },
+    { (const guint8 *)"\x2b\x24\x03\x03\x02\x08\x01\x01\x07", 9,
+     "brainpoolP256r1", 256, false },
+    { (const guint8 *)"\x2b\x24\x03\x03\x02\x08\x01\x01\x0b", 9,
+     "brainpoolP384r1", 384, false },
+    { (const guint8 *)"\x2b\x24\x03\x03\x02\x08\x01\x01\x0d", 9,
+     "brainpoolP512r1", 512, false },
+};
+
+/**
+ * This function initializes libgcrypt once.
+ *
+ * @param data Unused
+ *
+ * @return Non-NULL on success
+ */
+static gpointer rekey_init(gpointer data)
+{
+    (void)data;
+
+    if (gcry_control(GCRYCTL_INITIALIZATION_FINISHED_P))
+        return GINT_TO_POINTER(true);
+
+    if (gcry_check_version(GCRYPT_VERSION) == NULL)
+        return NULL;
+
+    /* Session keys are held in regular memory by GPGME anyway */
+    gcry_control(GCRYCTL_DISABLE_SECMEM, 0);
+    gcry_control(GCRYCTL_INITIALIZATION_FINISHED, 0);
+
+    return GINT_TO_POINTER(true);
+}
+
+/**
+ * This function reads a multiprecision integer of a key packet.
+ *
+ * @param body Body of the key packet
+ * @param length Length of the body
+ * @param offset Offset of the integer. Set to the offset after the integer
+ * @param value Set to the big-endian value
+ * @param value_length Set to the length of the value
+ *
+ * @return Success
+ */
+static bool rekey_read_mpi(const guint8 *body, gsize length, gsize *offset,
+                           const guint8 **value, gsize *value_length)
+{
+    if (*offset + 2 > length)
+        return false;
+
+    gsize bits = ((gsize) body[*offset] << 8) | body[*offset + 1];
+    gsize bytes = (bits + 7) / 8;
+
+    if (*offset + 2 + bytes > length)
+        return false;
+
+    *value = body + *offset + 2;
+    *value_length = bytes;
+    *offset += 2 + bytes;
+
+    return true;
+}
+
+/**
+ * This function appends a multiprecision integer to a packet.
+ *
+ * @param packet Packet to append to
+ * @param value Big-endian value, leading zeros are removed
+ * @param length Length of the value
+ */
+static void rekey_append_mpi(GByteArray *packet, const guint8 *value,
+                             gsize length)
+{
+    while (length > 0 && value[0] == 0) {
+        value++;
+        length--;
+    }
+
+    gsize bits = 0;
+    if (length > 0)
+        bits = (length - 1) * 8 + g_bit_storage(value[0]);
+
+    guint8 prefix[] = { (bits >> 8) & 0xff, bits & 0xff };
+    g_byte_array_append(packet, prefix, sizeof(prefix));
+    g_byte_array_append(packet, value, length);
+}
+
+/**
+ * This function reads the value of an element of a libgcrypt S-expression.
+ *
+ * @param sexp S-expression
+ * @param token Name of the element
+ * @param value Set to the value, valid while the element is referenced
+ * @param length Set to the length of the value
+ *
+ * @return Element to release with gcry_sexp_release() or NULL if it is missing
+ */
+static gcry_sexp_t rekey_sexp_value(gcry_sexp_t sexp, const char *token,
+                                    const guint8 **value, gsize *length)
+{
+    gcry_sexp_t element = gcry_sexp_find_token(sexp, token, 0);
+    if (element == NULL)
+        return NULL;
+
+    size_t size = 0;
+    *value = (const guint8 *)gcry_sexp_nth_data(element, 1, &size);
+    *length = size;
+
+    if (*value == NULL) {
+        gcry_sexp_release(element);
+        return NULL;
+    }
+
+    return element;
+}
+
+/**
+ * This function encrypts a session key with an RSA key.
+ *
+ * @param body Body of the key packet
+ * @param length Length of the body
+ * @param offset Offset of the key material
+ * @param frame Algorithm, session key and checksum
+ * @param frame_length Length of the frame
+ * @param packet PKESK packet to append the encrypted session key to
+ *
+ * @return Success
+ */
+static bool rekey_encrypt_rsa(const guint8 *body, gsize length, gsize offset,
+                              const guint8 *frame, gsize frame_length,
+                              GByteArray *packet)
+{
+    const guint8 *n, *e;
+    gsize n_length, e_length;
+
+    if (!rekey_read_mpi(body, length, &offset, &n, &n_length)
+        || !rekey_read_mpi(body, length, &offset, &e, &e_length))
+        return false;
+
+    gcry_sexp_t key = NULL;
+    gcry_sexp_t data = NULL;
+    gcry_sexp_t result = NULL;
+    gcry_sexp_t element = NULL;
+    bool success = false;
+
+    if (gcry_sexp_build(&key, NULL, "(public-key(rsa(n%b)(e%b)))",
+                        (int)n_length, n, (int)e_length, e)
+        || gcry_sexp_build(&data, NULL, "(data(flags pkcs1)(value %b))",
+                           (int)frame_length, frame)
+        || gcry_pk_encrypt(&result, data, key))
+        goto cleanup;
+
+    const guint8 *value;
+    gsize value_length;
+    element = rekey_sexp_value(result, "a", &value, &value_length);
+    if (element == NULL)
+        goto cleanup;
+
+    rekey_append_mpi(packet, value, value_length);
+    success = true;
+
+ cleanup:
+    gcry_sexp_release(element);
+    element = NULL;
+
+    gcry_sexp_release(result);
+    result = NULL;
+
+    gcry_sexp_release(data);
+    data = NULL;
+
+    gcry_sexp_release(key);
+    key = NULL;
+
+    return success;
+}
+
+/**
+ * This function encrypts a session key with an ECDH key, RFC 9580 section 11.5.
+ *
+ * @param body Body of the key packet
+ * @param length Length of the body
+ * @param offset Offset of the key material
+ * @param fingerprint Binary version 4 fingerprint of the key
+ * @param frame Algorithm, session key and checksum
+ * @param frame_length Length of the frame
+ * @param packet PKESK packet to append the encrypted session key to
+ *
+ * @return Success
+ */
+static bool rekey_encrypt_ecdh(const guint8 *body, gsize length, gsize offset,
+                               const guint8 *fingerprint, const guint8 *frame,
+                               gsize frame_length, GByteArray *packet)
+{
+    if (offset >= length)
+        return false;
+
+    /* Curve */
+    gsize oid_offset = offset;
+    gsize oid_length = body[offset];
+    if (offset + 1 + oid_length > length)
+        return false;
+
+    const rekey_curve *curve = NULL;
+    for (gsize i = 0; curve == NULL && i < G_N_ELEMENTS(rekey_curves); i++)
+        if (rekey_curves[i].oid_length == oid_length
+            && memcmp(rekey_curves[i].oid, body + offset + 1, oid_length) == 0)
+            curve = &rekey_curves[i];
+    if (curve == NULL)
+        return false;
+
+    offset += 1 + oid_length;
+
+    const guint8 *point;
+    gsize point_length;
+    if (!rekey_read_mpi(body, length, &offset, &point, &point_length))
+        return false;
+
+    /* Key derivation parameters: length, reserved, hash, key wrap algorithm */
+    if (offset + 4 > length || body[offset] != 3 || body[offset + 1] != 1)
+        return false;
+
+    GChecksumType hash;
+    switch (body[offset + 2]) {
+    case 8:
+        hash = G_CHECKSUM_SHA256;
+        break;
+    case 9:
+        hash = G_CHECKSUM_SHA384;
+        break;
+    case 10:
+        hash = G_CHECKSUM_SHA512;
+        break;
+    default:
+        return false;
+    }
+
+    int cipher;
+    gsize kek_length;
+    switch (body[offset + 3]) {
+    case 7:
+        cipher = GCRY_CIPHER_AES128;
+        kek_length = 16;
+        break;
+    case 8:
+        cipher = GCRY_CIPHER_AES192;
+        kek_length = 24;
+        break;
+    case 9:
+        cipher = GCRY_CIPHER_AES256;
+        kek_length = 32;
+        break;
+    default:
+        return false;
+    }
+
+    gcry_sexp_t key = NULL;
+    gcry_sexp_t data = NULL;
+    gcry_sexp_t result = NULL;
+    gcry_sexp_t shared_element = NULL;
+    gcry_sexp_t ephemeral_element = NULL;
+    gcry_cipher_hd_t wrap = NULL;
+    gcry_mpi_t scalar = gcry_mpi_new(curve->bits);
+    GChecksum *checksum = NULL;
+    guint8 *padded = NULL;
+    guint8 *wrapped = NULL;
+    bool success = false;
+
+    /* Ephemeral key agreement, the same way GnuPG does it */
+    gcry_mpi_randomize(scalar, curve->bits, GCRY_STRONG_RANDOM);
+
+    if (gcry_sexp_build(&key, NULL,
+                        curve->montgomery ?
+                        "(public-key(ecdh(curve%s)(flags djb-tweak)(q%b)))" :
+                        "(public-key(ecdh(curve%s)(q%b)))", curve->name,
+                        (int)point_length, point)
+        || gcry_sexp_build(&data, NULL, "%m", scalar)
+        || gcry_pk_encrypt(&result, data, key))
+        goto cleanup;
+
+    const guint8 *shared, *ephemeral;
+    gsize shared_length, ephemeral_length;
+    shared_element = rekey_sexp_value(result, "s", &shared, &shared_length);
+    ephemeral_element =
+        rekey_sexp_value(result, "e", &ephemeral, &ephemeral_length);
+    if (shared_element == NULL || ephemeral_element == NULL)
+        goto cleanup;
+
+    /* The shared secret is the X coordinate, behind the prefix of the point */
+    gsize secret_length = (curve->bits + 7) / 8;
+    if (shared_length & 1) {
+        shared++;
+        shared_length--;
+    }
+    if (shared_length < secret_length)
+        goto cleanup;
+
+    /* Key derivation, RFC 9580 section 11.5.2 */
+    checksum = g_checksum_new(hash);
+    g_checksum_update(checksum, (const guchar *)"\x00\x00\x00\x01", 4);
+    g_checksum_update(checksum, shared, secret_length);
+    g_checksum_update(checksum, body + oid_offset, 1 + oid_length);
+    g_checksum_update(checksum, (const guchar *)"\x12", 1);
+    g_checksum_update(checksum, body + offset, 4);
+    g_checksum_update(checksum, (const guchar *)"Anonymous Sender    ", 20);
+    g_checksum_update(checksum, fingerprint, 20);
+
+    guint8 digest[64];
+    gsize digest_length = sizeof(digest);
+    g_checksum_get_digest(checksum, digest, &digest_length);
+
+    /* The frame is padded to the block size of the key wrap, RFC 9580 section 11.5.3 */
+    gsize padding = 8 - frame_length % 8;
+    gsize padded_length = frame_length + padding;
+    padded = g_malloc(padded_length);
+    memcpy(padded, frame, frame_length);
+    memset(padded + frame_length, padding, padding);
+
+    wrapped = g_malloc(padded_length + 8);
+    if (gcry_cipher_open(&wrap, cipher, GCRY_CIPHER_MODE_AESWRAP, 0)
+        || gcry_cipher_setkey(wrap, digest, kek_length)
+        || gcry_cipher_encrypt(wrap, wrapped, padded_length + 8, padded,
+                               padded_length))
+        goto wipe;
+
+    rekey_append_mpi(packet, ephemeral, ephemeral_length);
+
+    guint8 wrapped_length = padded_length + 8;
+    g_byte_array_append(packet, &wrapped_length, 1);
+    g_byte_array_append(packet, wrapped, wrapped_length);
+
+    success = true;
+
+ wipe:
+    memset(digest, 0, sizeof(digest));
+    memset(padded, 0, padded_length);
+
+ cleanup:
+    g_free(wrapped);
+    wrapped = NULL;
+
+    g_free(padded);
+    padded = NULL;
+
+    if (checksum != NULL)
+        g_checksum_free(checksum);
+    checksum = NULL;
+
+    gcry_cipher_close(wrap);
+    wrap = NULL;
+
+    gcry_mpi_release(scalar);
+    scalar = NULL;
+
+    gcry_sexp_release(ephemeral_element);
+    ephemeral_element = NULL;
+
+    gcry_sexp_release(shared_element);
+    shared_element = NULL;
+
+    gcry_sexp_release(result);
+    result = NULL;
+
+    gcry_sexp_release(data);
+    data = NULL;
+
+    gcry_sexp_release(key);
+    key = NULL;
+
+    return success;
+}
+
+/**
+ * This function appends the header of a packet.
+ *
+ * @param packets Packets to append to
+ * @param tag Tag of the packet
+ * @param length Length of the body
+ */
+static void rekey_append_header(GByteArray *packets, guint8 tag, gsize length)
+{
+    guint8 header[6] = { 0xc0 | tag };
+    gsize header_length;
+
+    if (length < 192) {
+        header[1] = length;
+        header_length = 2;
+    } else if (length < 8384) {
+        header[1] = ((length - 192) >> 8) + 192;
+        header[2] = (length - 192) & 0xff;
+        header_length = 3;
+    } else {
+        header[1] = 0xff;
+        header[2] = (length >> 24) & 0xff;
+        header[3] = (length >> 16) & 0xff;
+        header[4] = (length >> 8) & 0xff;
+        header[5] = length & 0xff;
+        header_length = 6;
+    }
+
+    g_byte_array_append(packets, header, header_length);
+}
+
+/**
+ * This function chooses the subkey a key is encrypted to.
+ *
+ * @param key Key of a recipient
+ *
+ * @return Newest usable encryption subkey or NULL
+ */
+static gpgme_subkey_t rekey_subkey(gpgme_key_t key)
+{
+    gpgme_subkey_t chosen = NULL;
+
+    for (gpgme_subkey_t subkey = key->subkeys; subkey != NULL;
+         subkey = subkey->next)
+        if (subkey->can_encrypt && !subkey->revoked && !subkey->expired
+            && !subkey->disabled && !subkey->invalid)
+            chosen = subkey;
+
+    return chosen;
+}
+
+/**
+ * This function encrypts a session key for a recipient into a PKESK packet.
+ *
+ * @param context GPGME context to export the key of the recipient with
+ * @param recipient Key of the recipient
+ * @param frame Algorithm, session key and checksum
+ * @param frame_length Length of the frame
+ * @param packets Packets to append the PKESK packet to
+ *
+ * @return Success
+ */
+static bool rekey_encrypt(gpgme_ctx_t context, gpgme_key_t recipient,
+                          const guint8 *frame, gsize frame_length,
+                          GByteArray *packets)
+{
+    gpgme_subkey_t subkey = rekey_subkey(recipient);
+    if (subkey == NULL || subkey->fpr == NULL) {
+        g_warning(_("Failed to re-key file: %s"),
+                  C_("Re-key error", "recipient has no usable encryption key"));
+        return false;
+    }
+
+    gpgme_data_t exported;
+    if (gpgme_data_new(&exported))
+        return false;
+
+    gpgme_error_t error = gpgme_op_export(context, recipient->subkeys->fpr,
+                                          GPGME_EXPORT_MODE_MINIMAL,
+                                          exported);
+
+    size_t length = 0;
+    guint8 *data = (guint8 *) gpgme_data_release_and_get_mem(exported, &length);
+    if (error || data == NULL) {
+        gpgme_free(data);
+        return false;
+    }
+
+    bool success = false;
+    gsize offset = 0;
+    openpgp_packet packet;
+
+    while (!success && openpgp_packet_next(data, length, &offset, &packet)) {
+        if ((packet.tag != OPENPGP_TAG_PUBLIC_KEY
+             && packet.tag != OPENPGP_TAG_PUBLIC_SUBKEY)
+            || packet.partial || offset > length)
+            continue;
+
+        const guint8 *body = data + packet.body_offset;
+        char *fingerprint = openpgp_fingerprint(body, packet.body_length);
+        bool match = fingerprint != NULL
+            && g_ascii_strcasecmp(fingerprint, subkey->fpr) == 0;
+
+        g_free(fingerprint);
+        fingerprint = NULL;
+
+        /* Version 4 keys, the only ones with version 3 PKESK packets */
+        if (!match || packet.body_length < 6 || body[0] != 4)
+            continue;
+
+        guint8 binary[20];
+        gsize binary_length = sizeof(binary);
+        GChecksum *checksum = g_checksum_new(G_CHECKSUM_SHA1);
+        guint8 prefix[] = { 0x99, (packet.body_length >> 8) & 0xff,
+            packet.body_length & 0xff
+        };
+        g_checksum_update(checksum, prefix, sizeof(prefix));
+        g_checksum_update(checksum, body, packet.body_length);
+        g_checksum_get_digest(checksum, binary, &binary_length);
+
+        g_checksum_free(checksum);
+        checksum = NULL;
+
+        /* Version, key ID, algorithm */
+        GByteArray *pkesk = g_byte_array_new();
+        guint8 version = REKEY_PKESK_VERSION;
+        g_byte_array_append(pkesk, &version, 1);
+        g_byte_array_append(pkesk, binary + 12, 8);
+        g_byte_array_append(pkesk, &body[5], 1);
+
+        switch (body[5]) {
+        case REKEY_ALGORITHM_RSA:
+        case REKEY_ALGORITHM_RSA_ENCRYPT:
+            success = rekey_encrypt_rsa(body, packet.body_length, 6, frame,
+                                        frame_length, pkesk);
+            break;
+        case REKEY_ALGORITHM_ECDH:
+            success = rekey_encrypt_ecdh(body, packet.body_length, 6, binary,
+                                         frame, frame_length, pkesk);
+            break;
+        default:
+            break;
+        }
+
+        if (success) {
+            rekey_append_header(packets, OPENPGP_TAG_PKESK, pkesk->len);
+            g_byte_array_append(packets, pkesk->data, pkesk->len);
+        } else {
+            g_warning(_("Failed to re-key file: %s"),
+                      C_("Re-key error",
+                         "algorithm of the recipient is not supported"));
+        }
+
+        g_byte_array_unref(pkesk);
+        pkesk = NULL;
+
+        break;
+    }
+
+    /* Cleanup */
+    gpgme_free(data);
+    data = NULL;
+
+    return success;
+}
+
+/**
+ * This function discards data written by the engine.
+ *
+ * @param handle https://www.gnupg.org/documentation/manuals/gpgme/Callback-Based-Data-Buffers.html
+ * @param buffer https://www.gnupg.org/documentation/manuals/gpgme/Callback-Based-Data-Buffers.html
+ * @param size https://www.gnupg.org/documentation/manuals/gpgme/Callback-Based-Data-Buffers.html
+ *
+ * @return Number of bytes consumed
+ */
+static gpgme_ssize_t rekey_discard(void *handle, const void *buffer,
+                                   size_t size)
+{
+    (void)handle;
+    (void)buffer;
+
+    return size;
+}
+
+static struct gpgme_data_cbs rekey_discard_cbs = {
+    .write = rekey_discard,
+};
+
+/**
+ * This function decrypts the session key of an encrypted file.
+ *
+ * @param context GPGME context
+ * @param input Encrypted data
+ * @param error Set to the error of the engine
+ *
+ * @return Session key as reported by the engine, e.g. “9:A1B2…”. NULL on failure. Owned by caller
+ */
+static char *rekey_session_key_from(gpgme_ctx_t context, gpgme_data_t input,
+                                    gpgme_error_t *error)
+{
+    gpgme_data_t output;
+    *error = gpgme_data_new_from_cbs(&output, &rekey_discard_cbs, NULL);
+    if (*error)
+        return NULL;
+
+    *error = gpgme_op_decrypt(context, input, output);
+
+    gpgme_decrypt_result_t result = gpgme_op_decrypt_result(context);
+    char *session_key = (result != NULL && result->session_key != NULL) ?
+        g_strdup(result->session_key) : NULL;
+
+    /* Cleanup */
+    gpgme_data_release(output);
+    output = NULL;
+
+    return session_key;
+}
+
+/**
+ * This function decrypts the session key of an encrypted file, reading as little of it as possible.
+ *
+ * @param context GPGME context
+ * @param head Start of the file
+ * @param head_length Length of the start
+ * @param descriptor File descriptor of the whole file
+ * @param size Size of the whole file
+ *
+ * @return Session key as reported by the engine. NULL on failure. Owned by caller
+ */
+static char *rekey_session_key(gpgme_ctx_t context, const guint8 *head,
+                               gsize head_length, int descriptor, gsize size)
+{
+    gpgme_data_t input;
+    gpgme_error_t error =
+        gpgme_data_new_from_mem(&input, (const char *)head, head_length, 0);
+    if (error)
+        return NULL;
+
+    char *session_key = rekey_session_key_from(context, input, &error);
+
+    gpgme_data_release(input);
+    input = NULL;
+
+    /* The engine might only report the session key of a complete message */
+    if (session_key == NULL && head_length < size
+        && gpg_err_code(error) != GPG_ERR_NO_SECKEY
+        && gpg_err_code(error) != GPG_ERR_CANCELED
+        && gpg_err_code(error) != GPG_ERR_BAD_PASSPHRASE
+        && lseek(descriptor, 0, SEEK_SET) == 0
+        && !gpgme_data_new_from_fd(&input, descriptor)) {
+        session_key = rekey_session_key_from(context, input, &error);
+
+        gpgme_data_release(input);
+        input = NULL;
+    }
+
+    if (session_key == NULL)
+        g_warning(C_
+                  ("Error message constructor for failed GPGME operations",
+                   "Failed to %s: %s"), C_("GPGME Error",
+                                           "decrypt session key of GPGME data"),
+                  gpgme_strerror(error));
+
+    return session_key;
+}
+
+/**
+ * This function converts a session key as reported by the engine into the frame encrypted for recipients.
+ *
+ * @param session_key Session key, e.g. “9:A1B2…”
+ * @param length Set to the length of the frame
+ *
+ * @return Algorithm, session key and checksum, RFC 9580 section 5.1.3. NULL if malformed. Owned by caller
+ */
+static guint8 *rekey_frame(const char *session_key, gsize *length)
+{
+    char *end = NULL;
+    guint64 algorithm = g_ascii_strtoull(session_key, &end, 10);
+    if (end == session_key || *end != ':' || algorithm == 0 || algorithm > 255)
+        return NULL;
+
+    const char *hex = end + 1;
+    gsize key_length = strlen(hex) / 2;
+    if (key_length == 0 || strlen(hex) % 2 != 0)
+        return NULL;
+
+    guint8 *frame = g_malloc(1 + key_length + 2);
+    frame[0] = algorithm;
+
+    guint16 sum = 0;
+    for (gsize i = 0; i < key_length; i++) {
+        int high = g_ascii_xdigit_value(hex[2 * i]);
+        int low = g_ascii_xdigit_value(hex[2 * i + 1]);
+
+        if (high < 0 || low < 0) {
+            memset(frame, 0, 1 + key_length + 2);
+            g_free(frame);
+            return NULL;
+        }
+
+        frame[1 + i] = (high << 4) | low;
+        sum += frame[1 + i];
+    }
+
+    frame[1 + key_length] = sum >> 8;
+    frame[2 + key_length] = sum & 0xff;
+    *length = 1 + key_length + 2;
+
+    return frame;
+}
+
+/**
+ * This function finds the key packets of an encrypted file.
+ *
+ * @param head Start of the file
+ * @param length Length of the start
+ * @param kept Receives the packets to keep, i.e. symmetrically encrypted session keys
+ * @param data_offset Set to the offset of the encrypted data packet
+ *
+ * @return Whether the file can be re-keyed
+ */
+static bool rekey_parse(const guint8 *head, gsize length, GByteArray *kept,
+                        gsize *data_offset)
+{
+    gsize offset = 0;
+    openpgp_packet packet;
+
+    while (openpgp_packet_next(head, length, &offset, &packet)) {
+        switch (packet.tag) {
+        case OPENPGP_TAG_PKESK:
+        case OPENPGP_TAG_MARKER:
+        case OPENPGP_TAG_SKESK:
+            if (packet.partial || offset > length)
+                return false;
+
+            if (packet.tag == OPENPGP_TAG_SKESK)
+                g_byte_array_append(kept, head + packet.offset,
+                                    offset - packet.offset);
+            break;
+        case OPENPGP_TAG_SEIPD:
+            /* Version 2 data needs version 6 PKESK packets */
+            if (packet.body_offset >= length || head[packet.body_offset] != 1)
+                return false;
+
+            *data_offset = packet.offset;
+            return true;
+        case OPENPGP_TAG_AEAD:
+            *data_offset = packet.offset;
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * This function copies a range of a file behind the current position of another one.
+ *
+ * The kernel shares the blocks where the file system supports it.
+ *
+ * @param source Descriptor of the source
+ * @param offset Offset of the range in the source
+ * @param target Descriptor of the target
+ * @param length Length of the range
+ *
+ * @return Success
+ */
+static bool rekey_copy(int source, off_t offset, int target, gsize length)
+{
+    while (length > 0) {
+        ssize_t count =
+            copy_file_range(source, &offset, target, NULL, length, 0);
+
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            break;
+
+        length -= count;
+    }
+
+    /* Falls back to reading and writing, e.g. on file systems without support */
+    guint8 *buffer = (length > 0) ? g_malloc(REKEY_BUFFER_SIZE) : NULL;
+
+    while (length > 0) {
+        ssize_t count =
+            pread(source, buffer, MIN(length, REKEY_BUFFER_SIZE), offset);
+
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            break;
+
+        ssize_t written = 0;
+        while (written < count) {
+            ssize_t result = write(target, buffer + written, count - written);
+
+            if (result < 0 && errno == EINTR)
+                continue;
+            if (result < 0)
+                goto cleanup;
+
+            written += result;
+        }
+
+        offset += count;
+        length -= count;
+    }
+
+ cleanup:
+    g_free(buffer);
+    buffer = NULL;
+
+    return length == 0;
+}
+
+/**
+ * This function writes all of a buffer at an offset.
+ *
+ * @param descriptor File descriptor
+ * @param data Buffer
+ * @param length Length of the buffer
+ * @param offset Offset in the file
+ *
+ * @return Success
+ */
+static bool rekey_pwrite(int descriptor, const guint8 *data, gsize length,
+                         off_t offset)
+{
+    while (length > 0) {
+        ssize_t count = pwrite(descriptor, data, length, offset);
+
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count < 0)
+            return false;
+
+        data += count;
+        length -= count;
+        offset += count;
+    }
+
+    return true;
+}
+
+/**
+ * This function writes the new key packets and the unchanged data packet into a file and replaces the output with it.
+ *
+ * @param source Descriptor of the encrypted file
+ * @param status Status of the encrypted file
+ * @param data_offset Offset of the data packet in the encrypted file
+ * @param packets New key packets
+ * @param path Path of the output
+ *
+ * @return Success
+ */
+static bool rekey_write(int source, GStatBuf *status, gsize data_offset,
+                        GByteArray *packets, const char *path)
+{
+    gchar *directory = g_path_get_dirname(path);
+    gchar *basename = g_path_get_basename(path);
+    gchar *name = g_strdup_printf(".%s.XXXXXX", basename);
+    gchar *temporary = g_build_filename(directory, name, NULL);
+
+    bool success = false;
+    int descriptor =
+        g_mkstemp_full(temporary, O_RDWR | O_CLOEXEC, status->st_mode & 07777);
+    if (descriptor < 0)
+        goto cleanup;
+
+    /* Key packets of the same length only change the first block of a clone */
+    if (packets->len == data_offset && ioctl(descriptor, FICLONE, source) == 0)
+        success = rekey_pwrite(descriptor, packets->data, packets->len, 0);
+    else
+        success = rekey_pwrite(descriptor, packets->data, packets->len, 0)
+            && lseek(descriptor, packets->len, SEEK_SET) >= 0
+            && rekey_copy(source, data_offset, descriptor,
+                          status->st_size - data_offset);
+
+    success = success && fdatasync(descriptor) == 0;
+    success = success && g_rename(temporary, path) == 0;
+
+    if (!success) {
+        g_warning(_("Failed to re-key file: %s"), g_strerror(errno));
+        g_unlink(temporary);
+    }
+
+    close(descriptor);
+
+ cleanup:
+    g_free(temporary);
+    temporary = NULL;
+
+    g_free(name);
+    name = NULL;
+
+    g_free(basename);
+    basename = NULL;
+
+    g_free(directory);
+    directory = NULL;
+
+    return success;
+}
+
+#endif                          // HAVE_LIBGCRYPT
+
+/**
+ * This function encrypts the session key of an encrypted file for new recipients, keeping the encrypted data.
+ *
+ * Needs the secret key of one of the current recipients.
+ *
+ * @param input Encrypted file. Needs to be local and binary
+ * @param output File to write the re-keyed file to. NULL to replace the input
+ * @param recipients NULL-terminated keys of the new recipients, which replace all current ones
+ *
+ * @return Success
+ */
+bool rekey_file(GFile *input, GFile *output, gpgme_key_t *recipients)
+{
+#if HAVE_LIBGCRYPT
+    static GOnce initialized = G_ONCE_INIT;
+    if (g_once(&initialized, rekey_init, NULL) == NULL) {
+        g_warning(_("Failed to re-key file: %s"),
+                  C_("Re-key error", "libgcrypt is too old"));
+        return false;
+    }
+
+    char *input_path = g_file_get_path(input);
+    char *output_path = g_file_get_path((output != NULL) ? output : input);
+    if (input_path == NULL || output_path == NULL) {
+        g_warning(_("Failed to re-key file: %s"),
+                  C_("Re-key error", "file is not stored locally"));
+
+        g_free(input_path);
+        g_free(output_path);
+        return false;
+    }
+
+    bool success = false;
+    gpgme_ctx_t context = NULL;
+    guint8 *head = g_malloc(REKEY_HEAD_SIZE);
+    GByteArray *kept = g_byte_array_new();
+    GByteArray *packets = g_byte_array_new();
+    char *session_key = NULL;
+    guint8 *frame = NULL;
+    gsize frame_length = 0;
+
+    int descriptor = g_open(input_path, O_RDONLY | O_CLOEXEC, 0);
+    GStatBuf status;
+    if (descriptor < 0 || fstat(descriptor, &status) != 0) {
+        g_warning(_("Failed to re-key file: %s"), g_strerror(errno));
+        goto cleanup;
+    }
+
+    ssize_t head_length;
+    do
+        head_length = pread(descriptor, head, REKEY_HEAD_SIZE, 0);
+    while (head_length < 0 && errno == EINTR);
+
+    gsize data_offset = 0;
+    if (head_length <= 0
+        || !rekey_parse(head, head_length, kept, &data_offset)) {
+        g_warning(_("Failed to re-key file: %s"),
+                  C_("Re-key error",
+                     "file is not a binary file encrypted for keys"));
+        goto cleanup;
+    }
+
+    if (gpgme_new(&context)
+        || gpgme_set_protocol(context, GPGME_PROTOCOL_OpenPGP)
+        || gpgme_set_ctx_flag(context, "export-session-key", "1"))
+        goto cleanup;
+
+    session_key =
+        rekey_session_key(context, head, head_length, descriptor,
+                          status.st_size);
+    if (session_key == NULL)
+        goto cleanup;
+
+    frame = rekey_frame(session_key, &frame_length);
+    if (frame == NULL)
+        goto cleanup;
+
+    for (gsize i = 0; recipients[i] != NULL; i++)
+        if (!rekey_encrypt(context, recipients[i], frame, frame_length,
+                           packets))
+            goto cleanup;
+
+    if (packets->len == 0)
+        goto cleanup;
+
+    g_byte_array_append(packets, kept->data, kept->len);
+
+    success =
+        rekey_write(descriptor, &status, data_offset, packets, output_path);
+
+ cleanup:
+    if (frame != NULL)
+        memset(frame, 0, frame_length);
+    g_free(frame);
+    frame = NULL;
+
+    if (session_key != NULL)
+        memset(session_key, 0, strlen(session_key));
+    g_free(session_key);
+    session_key = NULL;
+
+    if (context != NULL)
+        gpgme_release(context);
+    context = NULL;
+
+    if (descriptor >= 0)
+        close(descriptor);
+    descriptor = -1;
+
+    g_byte_array_unref(packets);
+    packets = NULL;
+
+    g_byte_array_unref(kept);
+    kept = NULL;
+
+    g_free(head);
+    head = NULL;
+
+    g_free(output_path);
+    output_path = NULL;
+
+    g_free(input_path);
+    input_path = NULL;
+
+    return success;
+#else
+    (void)input;
+    (void)output;
+    (void)recipients;
+
+    g_warning(_("Failed to re-key file: %s"),
+              C_("Re-key error", "built without libgcrypt"));
+    return false;
+#endif
+}
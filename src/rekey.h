@@ -0,0 +1,15 @@
+#ifndef REKEY_H
+#define REKEY_H
+
+#include <gio/gio.h>
+#include <gpgme.h>
+
+#include <stdbool.h>
+
+/* Bytes read from the start of an encrypted file to find its key packets */
+#define REKEY_HEAD_SIZE (64 * 1024)
+
+bool rekey_available();
+bool rekey_file(GFile * input, GFile * output, gpgme_key_t * recipients);
+
+#endif                          // REKEY_H
@@ -0,0 +1,246 @@
+#include "sessioncache.h"
+
+#include <adwaita.h>
+#include <glib/gi18n.h>
+#include <locale.h>
+#include "config.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+/*
+ * The session cache remembers the session keys of decrypted messages in memory, so decrypting the same
+ * message again skips the public-key decryption, including pinentry and gpg-agent round-trips.
+ *
+ * Messages are identified by a SHA-256 digest of their start and their size. The start holds the encrypted
+ * session keys, which are unique to each message.
+ *
+ * Entries expire SESSION_CACHE_TTL_SECONDS after they were last used and are wiped before they are freed.
+ * The whole cache is wiped when the session locks or the cache is turned off.
+ */
+
+/**
+ * This structure holds a remembered session key.
+ */
+typedef struct {
+    char *session_key; /**< As reported by the engine, e.g. “9:A1B2…” */
+    gint64 expires; /**< Monotonic time in microseconds */
+} session_cache_entry;
+
+static GMutex session_cache_lock;
+static GHashTable *session_cache = NULL;
+static guint session_cache_timeout = 0;
+
+/**
+ * This function wipes and frees a session key.
+ *
+ * @param session_key Session key to free. Can be NULL
+ */
+void session_cache_key_free(char *session_key)
+{
+    if (session_key == NULL)
+        return;
+
+    /* volatile keeps the compiler from dropping the wipe of memory about to be freed */
+    volatile char *byte = session_key;
+    while (*byte != '\0')
+        *byte++ = '\0';
+
+    g_free(session_key);
+}
+
+/**
+ * This function wipes and frees a remembered session key.
+ *
+ * @param entry Entry to free
+ */
+static void session_cache_entry_free(session_cache_entry *entry)
+{
+    session_cache_key_free(entry->session_key);
+    entry->session_key = NULL;
+
+    g_free(entry);
+}
+
+/**
+ * This function identifies an encrypted file.
+ *
+ * @param file Encrypted file
+ *
+ * @return Hexadecimal SHA-256 digest. NULL if the file cannot be read. Owned by caller
+ */
+gchar *session_cache_id_file(GFile *file)
+{
+    GFileInputStream *stream = g_file_read(file, NULL, NULL);
+    if (stream == NULL)
+        return NULL;
+
+    guint8 *head = g_malloc(SESSION_CACHE_HEAD_SIZE);
+    gsize length = 0;
+    gchar *id = NULL;
+
+    GFileInfo *info =
+        g_file_input_stream_query_info(stream, G_FILE_ATTRIBUTE_STANDARD_SIZE,
+                                       NULL, NULL);
+
+    if (info != NULL
+        && g_input_stream_read_all(G_INPUT_STREAM(stream), head,
+                                   SESSION_CACHE_HEAD_SIZE, &length, NULL,
+                                   NULL)) {
+        GChecksum *checksum = g_checksum_new(G_CHECKSUM_SHA256);
+
+        gchar *size = g_strdup_printf("%" G_GINT64_FORMAT "\n",
+                                      (gint64) g_file_info_get_size(info));
+        g_checksum_update(checksum, (const guchar *)size, -1);
+        g_checksum_update(checksum, head, length);
+
+        id = g_strdup(g_checksum_get_string(checksum));
+
+        g_free(size);
+        size = NULL;
+
+        g_checksum_free(checksum);
+        checksum = NULL;
+    }
+
+    /* Cleanup */
+    g_clear_object(&info);
+
+    g_free(head);
+    head = NULL;
+
+    g_object_unref(stream);
+    stream = NULL;
+
+    return id;
+}
+
+/**
+ * This function identifies an encrypted message in memory.
+ *
+ * @param data Encrypted message, binary or armored
+ * @param length Length of the message
+ *
+ * @return Hexadecimal SHA-256 digest. Owned by caller
+ */
+gchar *session_cache_id_data(const char *data, gsize length)
+{
+    return g_compute_checksum_for_data(G_CHECKSUM_SHA256,
+                                       (const guchar *)data, length);
+}
+
+/**
+ * This function removes expired session keys and is supposed to be called via g_timeout_add_seconds().
+ *
+ * @param data Unused
+ *
+ * @return Whether keys are left to expire
+ */
+static gboolean session_cache_expire(gpointer data)
+{
+    (void)data;
+
+    g_mutex_lock(&session_cache_lock);
+
+    gint64 now = g_get_monotonic_time();
+    GHashTableIter iter;
+    session_cache_entry *entry;
+
+    g_hash_table_iter_init(&iter, session_cache);
+    while (g_hash_table_iter_next(&iter, NULL, (gpointer *) & entry))
+        if (entry->expires <= now)
+            g_hash_table_iter_remove(&iter);
+
+    bool remaining = g_hash_table_size(session_cache) > 0;
+    if (!remaining)
+        session_cache_timeout = 0;
+
+    g_mutex_unlock(&session_cache_lock);
+
+    return remaining;
+}
+
+/**
+ * This function looks up the session key of an encrypted message and extends its lifetime.
+ *
+ * @param id Identity of the message
+ *
+ * @return Session key or NULL. Free with session_cache_key_free()
+ */
+char *session_cache_lookup(const char *id)
+{
+    char *session_key = NULL;
+
+    g_mutex_lock(&session_cache_lock);
+
+    session_cache_entry *entry = (session_cache != NULL) ?
+        g_hash_table_lookup(session_cache, id) : NULL;
+    gint64 now = g_get_monotonic_time();
+
+    if (entry != NULL && entry->expires > now) {
+        entry->expires = now + SESSION_CACHE_TTL_SECONDS * G_USEC_PER_SEC;
+        session_key = g_strdup(entry->session_key);
+    }
+
+    g_mutex_unlock(&session_cache_lock);
+
+    return session_key;
+}
+
+/**
+ * This function remembers the session key of an encrypted message.
+ *
+ * @param id Identity of the message
+ * @param session_key Session key as reported by the engine
+ */
+void session_cache_insert(const char *id, const char *session_key)
+{
+    session_cache_entry *entry = g_new0(session_cache_entry, 1);
+    entry->session_key = g_strdup(session_key);
+    entry->expires =
+        g_get_monotonic_time() + SESSION_CACHE_TTL_SECONDS * G_USEC_PER_SEC;
+
+    g_mutex_lock(&session_cache_lock);
+
+    if (session_cache == NULL)
+        session_cache =
+            g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                  (GDestroyNotify) session_cache_entry_free);
+
+    g_hash_table_replace(session_cache, g_strdup(id), entry);
+
+    /* Expiry runs on the main context, a minute late at most */
+    if (session_cache_timeout == 0)
+        session_cache_timeout =
+            g_timeout_add_seconds(60, session_cache_expire, NULL);
+
+    g_mutex_unlock(&session_cache_lock);
+}
+
+/**
+ * This function forgets the session key of an encrypted message.
+ *
+ * @param id Identity of the message
+ */
+void session_cache_remove(const char *id)
+{
+    g_mutex_lock(&session_cache_lock);
+
+    if (session_cache != NULL)
+        g_hash_table_remove(session_cache, id);
+
+    g_mutex_unlock(&session_cache_lock);
+}
+
+/**
+ * This function wipes all remembered session keys.
+ */
+void session_cache_clear()
+{
+    g_mutex_lock(&session_cache_lock);
+
+    if (session_cache != NULL)
+        g_hash_table_remove_all(session_cache);
+
+    g_mutex_unlock(&session_cache_lock);
+}
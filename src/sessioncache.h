@@ -0,0 +1,20 @@
+#ifndef SESSIONCACHE_H
+#define SESSIONCACHE_H
+
+#include <gio/gio.h>
+#include <glib.h>
+
+/* Time a session key is remembered after it was last used */
+#define SESSION_CACHE_TTL_SECONDS (10 * 60)
+/* Bytes of an encrypted file hashed to identify it */
+#define SESSION_CACHE_HEAD_SIZE (64 * 1024)
+
+gchar *session_cache_id_file(GFile * file);
+gchar *session_cache_id_data(const char *data, gsize length);
+char *session_cache_lookup(const char *id);
+void session_cache_insert(const char *id, const char *session_key);
+void session_cache_remove(const char *id);
+void session_cache_clear();
+void session_cache_key_free(char *session_key);
+
+#endif                          // SESSIONCACHE_H
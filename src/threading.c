@@ -162,6 +162,64 @@ void thread_verify_file(GtkButton *self, LockWindow *window)
                                 lock_window_verify_file, window);
 }
 
+/**
+ * This function creates a new thread for the inspection of the input file of a LockWindow.
+ *
+ * @param window Window to inspect the input file of. Referenced by the caller, released by the thread
+ */
+void thread_inspect_file(LockWindow *window)
+{
+    CRYPTOGRAPHY_THREAD_WRAPPER("inspect_file",
+                                C_("Thread Error", "file inspection"),
+                                lock_window_inspect_file, window);
+
+    g_object_unref(window);
+}
+
+/**
+ * This function creates a new thread for the automatically routed processing of the input file of a LockWindow.
+ *
+ * @param self https://docs.gtk.org/gtk4/signal.Button.clicked.html
+ * @param window https://docs.gtk.org/gtk4/signal.Button.clicked.html
+ */
+void thread_process_file(GtkButton *self, LockWindow *window)
+{
+    (void)self;
+
+    CRYPTOGRAPHY_THREAD_WRAPPER("process_file",
+                                C_("Thread Error", "file processing"),
+                                lock_window_process_file, window);
+}
+
+/**
+ * This function creates a new thread for the preview of the input file of a LockWindow.
+ *
+ * @param self https://docs.gtk.org/gtk4/signal.Button.clicked.html
+ * @param window https://docs.gtk.org/gtk4/signal.Button.clicked.html
+ */
+void thread_preview_file(GtkButton *self, LockWindow *window)
+{
+    (void)self;
+
+    CRYPTOGRAPHY_THREAD_WRAPPER("preview_file",
+                                C_("Thread Error", "file preview"),
+                                lock_window_preview_file, window);
+}
+
+/**
+ * This function creates a new thread for the reconciliation of the key list of a LockKeyDialog.
+ *
+ * @param dialog Dialog to reconcile the key list of
+ */
+void thread_refresh_keys(LockKeyDialog *dialog)
+{
+    CRYPTOGRAPHY_THREAD_WRAPPER("refresh_keys",
+                                C_("Thread Error", "key listing"),
+                                lock_key_dialog_reconcile, dialog);
+
+    lock_key_dialog_reconcile_on_completed(dialog);
+}
+
 /**
  * This function creates a new thread for the import of a file as a key of a LockKeyDialog.
  *
@@ -189,6 +247,32 @@ void thread_generate_key(GtkButton *self, LockKeyDialog *dialog)
                                 lock_key_dialog_generate, dialog);
 }
 
+/**
+ * This function creates a new thread for the generation of a keypair for every identity of a CSV file in a LockKeyDialog.
+ *
+ * @param dialog Dialog to generate the keypairs in
+ */
+void thread_generate_keys(LockKeyDialog *dialog)
+{
+    CRYPTOGRAPHY_THREAD_WRAPPER("generate_keys",
+                                C_("Thread Error", "key generation"),
+                                lock_key_dialog_generate_batch, dialog);
+}
+
+/**
+ * This function creates a new thread for the benchmark of the key algorithms of a LockKeyDialog.
+ *
+ * @param dialog Dialog to present the benchmark in
+ */
+void thread_benchmark_keys(LockKeyDialog *dialog)
+{
+    CRYPTOGRAPHY_THREAD_WRAPPER("benchmark_keys",
+                                C_("Thread Error", "key benchmark"),
+                                lock_key_dialog_benchmark, dialog);
+
+    lock_key_dialog_benchmark_on_completed(dialog);
+}
+
 /**
  * This function creates a new thread for the export of a key as a file in a LockKeyRow.
  *
@@ -212,3 +296,27 @@ void thread_remove_key(LockKeyRow *row)
                                 C_("Thread Error", "key removal"),
                                 lock_key_row_remove, row);
 }
+
+/**
+ * This function creates a new thread for the export of the selected keys of a LockKeyDialog to a single file.
+ *
+ * @param dialog Dialog to export the selected keys of
+ */
+void thread_export_keys(LockKeyDialog *dialog)
+{
+    CRYPTOGRAPHY_THREAD_WRAPPER("export_keys",
+                                C_("Thread Error", "key export"),
+                                lock_key_dialog_export, dialog);
+}
+
+/**
+ * This function creates a new thread for the removal of the selected keys of a LockKeyDialog.
+ *
+ * @param dialog Dialog to remove the selected keys of
+ */
+void thread_remove_keys(LockKeyDialog *dialog)
+{
+    CRYPTOGRAPHY_THREAD_WRAPPER("remove_keys",
+                                C_("Thread Error", "key removal"),
+                                lock_key_dialog_remove, dialog);
+}
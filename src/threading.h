@@ -28,10 +28,20 @@ void thread_verify_text(GSimpleAction * self, GVariant * parameter,
                         LockWindow * window);
 void thread_verify_file(GtkButton * self, LockWindow * window);
 
+/* Inspect */
+void thread_inspect_file(LockWindow * window);
+void thread_process_file(GtkButton * self, LockWindow * window);
+void thread_preview_file(GtkButton * self, LockWindow * window);
+
 /* Key */
+void thread_refresh_keys(LockKeyDialog * dialog);
 void thread_import_key(LockKeyDialog * dialog);
 void thread_generate_key(GtkButton * self, LockKeyDialog * dialog);
+void thread_generate_keys(LockKeyDialog * dialog);
+void thread_benchmark_keys(LockKeyDialog * dialog);
 void thread_export_key(LockKeyRow * row);
 void thread_remove_key(LockKeyRow * row);
+void thread_export_keys(LockKeyDialog * dialog);
+void thread_remove_keys(LockKeyDialog * dialog);
 
 #endif                          // THREADING_H
@@ -0,0 +1,621 @@
+#include "watch.h"
+
+#include <adwaita.h>
+#include <glib/gi18n.h>
+#include <glib-unix.h>
+#include <locale.h>
+#include "config.h"
+
+#include <gpgme.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "batch.h"
+#include "cryptography.h"
+
+/*
+ * A watched directory encrypts files as soon as they are completely written.
+ *
+ * Every event of the file monitor on a file restarts its settle timer, closing the file shortens it.
+ * Once the timer fires, the size and modification time are checked against the last check,
+ * so files that are still being written without events are caught as well.
+ * Settled files are encrypted on a thread pool. Events or a different size or modification time after the encryption
+ * queue the file again, and its original is only disposed of if it did not change.
+ *
+ * Files that are hidden, end in “~” or BATCH_SUFFIX, or are older than their encrypted file are ignored.
+ */
+
+#define WATCH_SHRED_SIZE (64 * 1024)
+
+typedef enum {
+    WATCH_SETTLING,
+    WATCH_PROCESSING,
+    WATCH_DIRTY                 /**< Changed while being processed */
+} watch_state;
+
+typedef struct watch_context watch_context;
+
+/**
+ * This structure holds a file of a watched directory that waits to be encrypted.
+ */
+typedef struct {
+    watch_context *context;
+    GFile *file;
+    watch_state state;
+    guint timeout; /**< Settle timer. 0 if not armed */
+
+    bool checked; /**< Whether size and modified hold a previous check */
+    guint64 size;
+    guint64 modified;
+    guint32 modified_usec;
+
+    bool changed; /**< Whether the file changed while being encrypted */
+} watch_file;
+
+/**
+ * This structure holds the state of a watched directory.
+ */
+struct watch_context {
+    watch_config *config;
+    GMainLoop *loop;
+    GFileMonitor *monitor;
+    GThreadPool *pool;
+    GHashTable *files; /**< URIs of pending files to watch_file */
+};
+
+/**
+ * This function parses a policy for originals.
+ *
+ * @param policy “keep”, “delete”, “shred” or “move”
+ * @param originals Receives the policy
+ *
+ * @return Whether the policy is known
+ */
+bool watch_originals_parse(const char *policy, watch_originals *originals)
+{
+    static const char *policies[] = { "keep", "delete", "shred", "move" };
+
+    for (gsize i = 0; i < G_N_ELEMENTS(policies); i++) {
+        if (g_strcmp0(policy, policies[i]) == 0) {
+            *originals = (watch_originals) i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * This function frees a pending file.
+ *
+ * @param entry Pending file
+ */
+static void watch_file_free(watch_file *entry)
+{
+    if (entry->timeout != 0)
+        g_source_remove(entry->timeout);
+    entry->timeout = 0;
+
+    g_clear_object(&entry->file);
+
+    g_free(entry);
+}
+
+/**
+ * This function checks whether a file of the watched directory is left alone.
+ *
+ * @param file File
+ *
+ * @return Whether the file is ignored
+ */
+static bool watch_ignored(GFile *file)
+{
+    gchar *name = g_file_get_basename(file);
+
+    bool ignored = name == NULL || name[0] == '.'
+        || g_str_has_suffix(name, "~") || g_str_has_suffix(name, BATCH_SUFFIX);
+
+    /* Cleanup */
+    g_free(name);
+    name = NULL;
+
+    return ignored;
+}
+
+static gboolean watch_settled(watch_file * entry);
+
+/**
+ * This function (re)starts the settle timer of a file.
+ *
+ * @param context State of the watched directory
+ * @param file File that changed
+ * @param delay Milliseconds the file needs to stay unchanged
+ */
+static void watch_schedule(watch_context *context, GFile *file, guint delay)
+{
+    if (file == NULL || watch_ignored(file))
+        return;
+
+    gchar *uri = g_file_get_uri(file);
+    watch_file *entry = g_hash_table_lookup(context->files, uri);
+
+    if (entry == NULL) {
+        entry = g_new0(watch_file, 1);
+        entry->context = context;
+        entry->file = g_object_ref(file);
+
+        g_hash_table_insert(context->files, uri, entry);
+        uri = NULL;
+    }
+
+    if (entry->state != WATCH_SETTLING) {
+        entry->state = WATCH_DIRTY;
+    } else {
+        if (entry->timeout != 0)
+            g_source_remove(entry->timeout);
+
+        entry->timeout =
+            g_timeout_add(delay, (GSourceFunc) watch_settled, entry);
+    }
+
+    /* Cleanup */
+    g_free(uri);
+    uri = NULL;
+}
+
+/**
+ * This function stops tracking a file.
+ *
+ * @param entry Pending file. Freed by the function
+ */
+static void watch_forget(watch_file *entry)
+{
+    gchar *uri = g_file_get_uri(entry->file);
+
+    g_hash_table_remove(entry->context->files, uri);
+
+    g_free(uri);
+    uri = NULL;
+}
+
+/**
+ * This function checks whether the encrypted file of a file is up to date.
+ *
+ * @param config Configuration of the watched directory
+ * @param file File
+ * @param modified Modification time of the file in seconds
+ *
+ * @return Whether the encrypted file is at least as new as the file
+ */
+static bool watch_encrypted(watch_config *config, GFile *file,
+                            guint64 modified)
+{
+    GFile *output = batch_output_file(file, config->output, ENCRYPT);
+    GFileInfo *info = g_file_query_info(output, G_FILE_ATTRIBUTE_TIME_MODIFIED,
+                                        G_FILE_QUERY_INFO_NONE, NULL, NULL);
+
+    bool encrypted = info != NULL
+        && g_file_info_get_attribute_uint64(info,
+                                            G_FILE_ATTRIBUTE_TIME_MODIFIED) >=
+        modified;
+
+    /* Cleanup */
+    g_clear_object(&info);
+    g_object_unref(output);
+    output = NULL;
+
+    return encrypted;
+}
+
+/**
+ * This function hands a file to the thread pool once it stopped changing.
+ *
+ * @param entry Pending file
+ *
+ * @return https://docs.gtk.org/glib/callback.SourceFunc.html
+ */
+static gboolean watch_settled(watch_file *entry)
+{
+    entry->timeout = 0;
+
+    GFileInfo *info = g_file_query_info(entry->file,
+                                        G_FILE_ATTRIBUTE_STANDARD_TYPE ","
+                                        G_FILE_ATTRIBUTE_STANDARD_SIZE ","
+                                        G_FILE_ATTRIBUTE_TIME_MODIFIED ","
+                                        G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC,
+                                        G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                        NULL, NULL);
+
+    // Deleted, moved away or not a regular file
+    if (info == NULL
+        || g_file_info_get_file_type(info) != G_FILE_TYPE_REGULAR) {
+        g_clear_object(&info);
+        watch_forget(entry);
+
+        return false;
+    }
+
+    guint64 size = g_file_info_get_size(info);
+    guint64 modified =
+        g_file_info_get_attribute_uint64(info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+    guint32 modified_usec =
+        g_file_info_get_attribute_uint32(info,
+                                         G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+
+    g_object_unref(info);
+    info = NULL;
+
+    /* Still growing without events, e.g. written through a memory mapping */
+    if (!entry->checked || entry->size != size || entry->modified != modified
+        || entry->modified_usec != modified_usec) {
+        entry->checked = true;
+        entry->size = size;
+        entry->modified = modified;
+        entry->modified_usec = modified_usec;
+
+        entry->timeout = g_timeout_add(WATCH_CLOSED_MS,
+                                       (GSourceFunc) watch_settled, entry);
+
+        return false;
+    }
+
+    // Encrypted files of files that changed meanwhile are newer, but not up to date
+    if (!entry->changed
+        && watch_encrypted(entry->context->config, entry->file, modified)) {
+        watch_forget(entry);
+
+        return false;
+    }
+
+    // Shutting down
+    if (entry->context->pool == NULL)
+        return false;
+
+    entry->state = WATCH_PROCESSING;
+    entry->changed = false;
+    g_thread_pool_push(entry->context->pool, entry, NULL);
+
+    /* Only execute once */
+    return false;
+}
+
+/**
+ * This function overwrites a file with random data and deletes it.
+ *
+ * Copy-on-write file systems and flash storage may keep the previous blocks, so this is no guarantee.
+ *
+ * @param file File to shred
+ *
+ * @return Success
+ */
+static bool watch_shred(GFile *file)
+{
+    char *path = g_file_get_path(file);
+    if (path == NULL)
+        return g_file_delete(file, NULL, NULL);
+
+    bool success = false;
+    int descriptor = open(path, O_WRONLY | O_NOFOLLOW | O_CLOEXEC);
+    struct stat status;
+
+    if (descriptor >= 0 && fstat(descriptor, &status) == 0) {
+        guint32 *block = g_malloc(WATCH_SHRED_SIZE);
+        for (gsize i = 0; i < WATCH_SHRED_SIZE / sizeof(guint32); i++)
+            block[i] = g_random_int();
+
+        success = true;
+        for (off_t offset = 0; success && offset < status.st_size;) {
+            size_t length = MIN(WATCH_SHRED_SIZE, status.st_size - offset);
+            ssize_t count = pwrite(descriptor, block, length, offset);
+
+            if (count < 0 && errno == EINTR)
+                continue;
+
+            success = count > 0;
+            offset += count;
+        }
+
+        success = success && fdatasync(descriptor) == 0;
+
+        g_free(block);
+        block = NULL;
+    }
+
+    if (descriptor >= 0)
+        close(descriptor);
+
+    success = success && g_unlink(path) == 0;
+
+    /* Cleanup */
+    g_free(path);
+    path = NULL;
+
+    return success;
+}
+
+/**
+ * This function checks whether a file still has the size and modification time it settled with.
+ *
+ * @param entry Pending file
+ *
+ * @return Whether the file is unchanged
+ */
+static bool watch_unchanged(watch_file *entry)
+{
+    GFileInfo *info = g_file_query_info(entry->file,
+                                        G_FILE_ATTRIBUTE_STANDARD_SIZE ","
+                                        G_FILE_ATTRIBUTE_TIME_MODIFIED ","
+                                        G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC,
+                                        G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                        NULL, NULL);
+    if (info == NULL)
+        return false;
+
+    bool unchanged = (guint64) g_file_info_get_size(info) == entry->size
+        && g_file_info_get_attribute_uint64(info,
+                                            G_FILE_ATTRIBUTE_TIME_MODIFIED) ==
+        entry->modified
+        && g_file_info_get_attribute_uint32(info,
+                                            G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC)
+        == entry->modified_usec;
+
+    /* Cleanup */
+    g_object_unref(info);
+    info = NULL;
+
+    return unchanged;
+}
+
+/**
+ * This function applies the policy for originals to an encrypted file.
+ *
+ * @param config Configuration of the watched directory
+ * @param file Original file
+ *
+ * @return Success
+ */
+static bool watch_dispose(watch_config *config, GFile *file)
+{
+    g_autoptr(GError) error = NULL;
+    bool success = true;
+
+    switch (config->originals) {
+    case WATCH_ORIGINALS_KEEP:
+        break;
+    case WATCH_ORIGINALS_DELETE:
+        success = g_file_delete(file, NULL, &error);
+        break;
+    case WATCH_ORIGINALS_SHRED:
+        success = watch_shred(file);
+        break;
+    case WATCH_ORIGINALS_MOVE:{
+            gchar *name = g_file_get_basename(file);
+            GFile *target = g_file_get_child(config->archive, name);
+
+            success = g_file_move(file, target, G_FILE_COPY_NOFOLLOW_SYMLINKS,
+                                  NULL, NULL, NULL, &error);
+
+            g_object_unref(target);
+            target = NULL;
+
+            g_free(name);
+            name = NULL;
+            break;
+        }
+    }
+
+    if (!success)
+        g_warning(_("Failed to dispose of original file: %s"),
+                  (error != NULL) ? error->message : g_strerror(errno));
+
+    return success;
+}
+
+/**
+ * This function updates a pending file once it was processed and is supposed to be called via g_idle_add().
+ *
+ * @param entry Pending file
+ *
+ * @return https://docs.gtk.org/glib/func.idle_add.html
+ */
+static gboolean watch_processed(watch_file *entry)
+{
+    if (entry->state == WATCH_DIRTY || entry->changed) {
+        entry->state = WATCH_SETTLING;
+        entry->changed = true;
+        entry->checked = false;
+
+        watch_schedule(entry->context, entry->file, WATCH_SETTLE_MS);
+    } else {
+        watch_forget(entry);
+    }
+
+    /* Only execute once */
+    return false;               // https://docs.gtk.org/glib/func.idle_add.html
+}
+
+/**
+ * This function encrypts a settled file on a thread of the pool.
+ *
+ * @param entry Pending file
+ * @param context State of the watched directory
+ */
+static void watch_process(watch_file *entry, watch_context *context)
+{
+    watch_config *config = context->config;
+
+    GFile *output = batch_output_file(entry->file, config->output, ENCRYPT);
+    gchar *name = g_file_get_parse_name(entry->file);
+
+    cryptography_options options = config->options;
+    options.cipher = NULL;
+    options.signature_issue = NULL;
+
+    if (process_file(entry->file, output, ENCRYPT, config->key, &options)) {
+        g_message(_("Encrypted %s"), name);
+
+        // The encrypted file may miss what was written meanwhile, so it is encrypted again instead
+        entry->changed = !watch_unchanged(entry);
+        if (!entry->changed)
+            watch_dispose(config, entry->file);
+    } else {
+        g_warning(_("Failed to encrypt %s"), name);
+    }
+
+    /* Cleanup */
+    cryptography_options_clear(&options);
+
+    g_free(name);
+    name = NULL;
+
+    g_object_unref(output);
+    output = NULL;
+
+    g_idle_add((GSourceFunc) watch_processed, entry);
+}
+
+/**
+ * This function handles events of the file monitor of a watched directory.
+ *
+ * @param monitor https://docs.gtk.org/gio/signal.FileMonitor.changed.html
+ * @param file https://docs.gtk.org/gio/signal.FileMonitor.changed.html
+ * @param other https://docs.gtk.org/gio/signal.FileMonitor.changed.html
+ * @param event https://docs.gtk.org/gio/signal.FileMonitor.changed.html
+ * @param context State of the watched directory
+ */
+static void watch_on_changed(GFileMonitor *monitor, GFile *file, GFile *other,
+                             GFileMonitorEvent event, watch_context *context)
+{
+    (void)monitor;
+
+    switch (event) {
+    case G_FILE_MONITOR_EVENT_CREATED:
+    case G_FILE_MONITOR_EVENT_CHANGED:
+    case G_FILE_MONITOR_EVENT_MOVED_IN:
+        watch_schedule(context, file, WATCH_SETTLE_MS);
+        break;
+    case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
+        watch_schedule(context, file, WATCH_CLOSED_MS);
+        break;
+    case G_FILE_MONITOR_EVENT_RENAMED:
+        // E.g. a download renamed from its temporary name
+        watch_schedule(context, other, WATCH_CLOSED_MS);
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * This function queues the files already in a watched directory.
+ *
+ * @param context State of the watched directory
+ */
+static void watch_scan(watch_context *context)
+{
+    GFileEnumerator *children =
+        g_file_enumerate_children(context->config->directory,
+                                  G_FILE_ATTRIBUTE_STANDARD_NAME,
+                                  G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS, NULL,
+                                  NULL);
+    if (children == NULL)
+        return;
+
+    GFileInfo *info;
+    GFile *child;
+    while (g_file_enumerator_iterate(children, &info, &child, NULL, NULL)
+           && info != NULL)
+        watch_schedule(context, child, WATCH_CLOSED_MS);
+
+    /* Cleanup */
+    g_object_unref(children);
+    children = NULL;
+}
+
+/**
+ * This function stops watching on SIGINT or SIGTERM.
+ *
+ * @param loop Main loop
+ *
+ * @return https://docs.gtk.org/glib/callback.SourceFunc.html
+ */
+static gboolean watch_on_signal(GMainLoop *loop)
+{
+    g_main_loop_quit(loop);
+
+    return G_SOURCE_CONTINUE;
+}
+
+/**
+ * This function watches a directory and encrypts every file that lands in it until SIGINT or SIGTERM.
+ *
+ * @param config Configuration of the watched directory
+ *
+ * @return Exit status
+ */
+int watch_run(watch_config *config)
+{
+    g_autoptr(GError) error = NULL;
+
+    watch_context context = {
+        .config = config,
+        .loop = g_main_loop_new(NULL, false),
+        .files = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                       (GDestroyNotify) watch_file_free),
+    };
+
+    context.monitor =
+        g_file_monitor_directory(config->directory, G_FILE_MONITOR_WATCH_MOVES,
+                                 NULL, &error);
+    if (context.monitor == NULL) {
+        g_warning(_("Failed to watch folder: %s"), error->message);
+
+        g_hash_table_unref(context.files);
+        g_main_loop_unref(context.loop);
+        return EXIT_FAILURE;
+    }
+
+    context.pool =
+        g_thread_pool_new((GFunc) watch_process, &context,
+                          MAX(config->threads, 1), false, NULL);
+
+    g_signal_connect(context.monitor, "changed",
+                     G_CALLBACK(watch_on_changed), &context);
+    guint interrupt = g_unix_signal_add(SIGINT, (GSourceFunc) watch_on_signal,
+                                        context.loop);
+    guint terminate = g_unix_signal_add(SIGTERM, (GSourceFunc) watch_on_signal,
+                                        context.loop);
+
+    gchar *name = g_file_get_parse_name(config->directory);
+    g_message(_("Watching %s"), name);
+
+    watch_scan(&context);
+    g_main_loop_run(context.loop);
+
+    /* Cleanup */
+    g_file_monitor_cancel(context.monitor);
+    g_clear_object(&context.monitor);
+
+    // Lets running encryptions finish and delivers their results
+    g_thread_pool_free(context.pool, true, true);
+    context.pool = NULL;
+    while (g_main_context_iteration(NULL, false)) ;
+
+    g_source_remove(interrupt);
+    g_source_remove(terminate);
+
+    g_hash_table_unref(context.files);
+    context.files = NULL;
+
+    g_main_loop_unref(context.loop);
+    context.loop = NULL;
+
+    g_free(name);
+    name = NULL;
+
+    return EXIT_SUCCESS;
+}
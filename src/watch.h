@@ -0,0 +1,39 @@
+#ifndef WATCH_H
+#define WATCH_H
+
+#include <gio/gio.h>
+#include <glib.h>
+#include <gpgme.h>
+
+#include <stdbool.h>
+#include "cryptography.h"
+
+/* Time a file needs to stay unchanged before it is encrypted */
+#define WATCH_SETTLE_MS 2000
+/* Shorter delay once the writer closed the file */
+#define WATCH_CLOSED_MS 250
+
+typedef enum {
+    WATCH_ORIGINALS_KEEP,
+    WATCH_ORIGINALS_DELETE,
+    WATCH_ORIGINALS_SHRED,      /**< Overwrite with random data before deleting */
+    WATCH_ORIGINALS_MOVE        /**< Move into the archive directory */
+} watch_originals;
+
+/**
+ * This structure holds the configuration of a watched directory.
+ */
+typedef struct {
+    GFile *directory;
+    GFile *output; /**< Directory of the encrypted files. NULL for the watched directory */
+    GFile *archive; /**< Directory originals are moved into */
+    gpgme_key_t key;
+    cryptography_options options;
+    watch_originals originals;
+    unsigned int threads; /**< Number of files encrypted at the same time */
+} watch_config;
+
+bool watch_originals_parse(const char *policy, watch_originals * originals);
+int watch_run(watch_config * config);
+
+#endif                          // WATCH_H
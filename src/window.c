@@ -9,7 +9,13 @@
 #include "config.h"
 
 #include <gpgme.h>
+#include "batch.h"
 #include "cryptography.h"
+#include "directory.h"
+#include "keyindex.h"
+#include "mirror.h"
+#include "pipeline.h"
+#include "sessioncache.h"
 #include "threading.h"
 
 #define ACTION_MODE_TEXT 0
@@ -50,13 +56,33 @@ struct _LockWindow {
     gboolean file_success; /**< Success of the last cryptography operation on files */
     GFile *file_input;
     GFile *file_output;
+    GFile *file_input_directory; /**< Directory to encrypt as a whole instead of the input file */
+    GFile *file_inspect; /**< Input file waiting for its inspection, exchanged atomically */
+    GFile *file_signature; /**< Detached signature the last routed verification used */
+    cryptography_flags file_route; /**< Operation the last routed processing chose, 0 if there was nothing to do */
+    GFile *file_existing; /**< Derived output of the last routed processing that already exists */
+    GBytes *file_preview; /**< Start of the plaintext of the input file. NULL if the last preview failed */
 
     AdwActionRow *file_input_row;
     GtkButton *file_input_button;
+    GtkButton *file_input_folder_button;
+    GtkButton *file_preview_button;
 
     AdwActionRow *file_output_row;
     GtkButton *file_output_button;
+    GtkButton *file_output_folder_button;
 
+    cryptography_options file_options; /**< Parameters and details of the last cryptography operation on files */
+
+    GPtrArray *file_jobs; /**< Files of a batch, elements are batch_job. NULL for a single file */
+    GFile *file_output_directory; /**< Directory of the outputs of a batch or to decrypt a folder into. NULL to write next to each input */
+    unsigned int file_failed; /**< Number of failed files of the last batch */
+    mirror_stats file_mirror; /**< Outcome of the last incremental encryption of a folder into a folder */
+
+    GtkScrolledWindow *file_batch_window;
+    GtkListBox *file_batch_list;
+
+    GtkButton *file_process_button;
     GtkButton *file_encrypt_button;
     GtkButton *file_decrypt_button;
     GtkButton *file_sign_button;
@@ -86,10 +112,18 @@ gboolean lock_window_sign_file_on_completed(LockWindow * window);
 gboolean lock_window_verify_text_on_completed(LockWindow * window);
 gboolean lock_window_verify_file_on_completed(LockWindow * window);
 
+// Preview
+gboolean lock_window_preview_file_on_completed(LockWindow * window);
+
 /* Key management */
 static void lock_window_key_dialog(GSimpleAction * action, GVariant * parameter,
                                    LockWindow * window);
 
+/* Preferences */
+static void lock_window_session_cache_on_changed(GSimpleAction * action,
+                                                 GParamSpec * pspec,
+                                                 LockWindow * window);
+
 /* Text */
 static void lock_window_text_view_copy(AdwSplitButton * self,
                                        LockWindow * window);
@@ -97,14 +131,31 @@ static void lock_window_text_queue_set_text(LockWindow * window,
                                             const char *text);
 
 /* File */
+static void lock_window_file_set_inputs(LockWindow * window,
+                                        GListModel * files);
 static void lock_window_file_open(GObject * source_object, GAsyncResult * res,
                                   gpointer data);
+static gboolean lock_window_file_on_drop(GtkDropTarget * self,
+                                         const GValue * value, double x,
+                                         double y, LockWindow * window);
 static void lock_window_file_save(GObject * source_object, GAsyncResult * res,
                                   gpointer data);
 static void lock_window_file_open_dialog_present(GtkButton * self,
                                                  LockWindow * window);
 static void lock_window_file_save_dialog_present(GtkButton * self,
                                                  LockWindow * window);
+static void lock_window_folder_open_dialog_present(GtkButton * self,
+                                                   LockWindow * window);
+static void lock_window_folder_save_dialog_present(GtkButton * self,
+                                                   LockWindow * window);
+static gchar *lock_window_file_details(cryptography_options * options);
+static void lock_window_file_batch_clear(LockWindow * window);
+static bool lock_window_file_batch(LockWindow * window,
+                                   cryptography_flags flags, gpgme_key_t key,
+                                   cryptography_options * options);
+
+/* Inspection */
+static void lock_window_inspect_queue(LockWindow * window);
 
 /* Encryption */
 void lock_window_encrypt_text_dialog(GSimpleAction * self, GVariant * parameter,
@@ -136,6 +187,38 @@ static void lock_window_init(LockWindow *window)
                      G_CALLBACK(lock_window_key_dialog), window);
     g_action_map_add_action(G_ACTION_MAP(window), G_ACTION(manage_keys_action));
 
+    /* Preferences */
+    g_autoptr(GSimpleAction) compression_action =
+        g_simple_action_new_stateful("compression", G_VARIANT_TYPE_STRING,
+                                     g_variant_new_string("automatic"));
+    g_action_map_add_action(G_ACTION_MAP(window),
+                            G_ACTION(compression_action));
+
+    g_autoptr(GSimpleAction) zstd_action =
+        g_simple_action_new_stateful("zstd", NULL,
+                                     g_variant_new_boolean(false));
+    g_simple_action_set_enabled(zstd_action, pipeline_available());
+    g_action_map_add_action(G_ACTION_MAP(window), G_ACTION(zstd_action));
+
+    g_autoptr(GSimpleAction) chunked_action =
+        g_simple_action_new_stateful("chunked", NULL,
+                                     g_variant_new_boolean(false));
+    g_action_map_add_action(G_ACTION_MAP(window), G_ACTION(chunked_action));
+
+    g_autoptr(GSimpleAction) parallelism_action =
+        g_simple_action_new_stateful("parallelism", G_VARIANT_TYPE_STRING,
+                                     g_variant_new_string("automatic"));
+    g_action_map_add_action(G_ACTION_MAP(window),
+                            G_ACTION(parallelism_action));
+
+    g_autoptr(GSimpleAction) session_cache_action =
+        g_simple_action_new_stateful("session_cache", NULL,
+                                     g_variant_new_boolean(false));
+    g_signal_connect(session_cache_action, "notify::state",
+                     G_CALLBACK(lock_window_session_cache_on_changed), window);
+    g_action_map_add_action(G_ACTION_MAP(window),
+                            G_ACTION(session_cache_action));
+
     /* Text */
     g_signal_connect(window->text_button, "clicked",
                      G_CALLBACK(lock_window_text_view_copy), window);
@@ -177,6 +260,30 @@ static void lock_window_init(LockWindow *window)
                      G_CALLBACK(lock_window_file_open_dialog_present), window);
     g_signal_connect(window->file_output_button, "clicked",
                      G_CALLBACK(lock_window_file_save_dialog_present), window);
+
+    g_signal_connect(window->file_input_folder_button, "clicked",
+                     G_CALLBACK(lock_window_folder_open_dialog_present),
+                     window);
+    g_signal_connect(window->file_output_folder_button, "clicked",
+                     G_CALLBACK(lock_window_folder_save_dialog_present),
+                     window);
+    gtk_widget_set_visible(GTK_WIDGET(window->file_input_folder_button),
+                           directory_available());
+    gtk_widget_set_visible(GTK_WIDGET(window->file_output_folder_button),
+                           directory_available());
+
+    GtkDropTarget *file_drop_target =
+        gtk_drop_target_new(GDK_TYPE_FILE_LIST, GDK_ACTION_COPY);
+    g_signal_connect(file_drop_target, "drop",
+                     G_CALLBACK(lock_window_file_on_drop), window);
+    gtk_widget_add_controller(GTK_WIDGET(window),
+                              GTK_EVENT_CONTROLLER(file_drop_target));
+    // Preview
+    g_signal_connect(window->file_preview_button, "clicked",
+                     G_CALLBACK(thread_preview_file), window);
+    // Process
+    g_signal_connect(window->file_process_button, "clicked",
+                     G_CALLBACK(thread_process_file), window);
     // Encrypt
     g_signal_connect(window->file_encrypt_button, "clicked",
                      G_CALLBACK(lock_window_encrypt_file_dialog), window);
@@ -222,12 +329,25 @@ static void lock_window_class_init(LockWindowClass *class)
                                          file_input_row);
     gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), LockWindow,
                                          file_input_button);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), LockWindow,
+                                         file_input_folder_button);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), LockWindow,
+                                         file_preview_button);
 
     gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), LockWindow,
                                          file_output_row);
     gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), LockWindow,
                                          file_output_button);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), LockWindow,
+                                         file_output_folder_button);
+
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), LockWindow,
+                                         file_batch_window);
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), LockWindow,
+                                         file_batch_list);
 
+    gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), LockWindow,
+                                         file_process_button);
     gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), LockWindow,
                                          file_encrypt_button);
     gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(class), LockWindow,
@@ -251,16 +371,27 @@ LockWindow *lock_window_new(LockApplication *app)
 }
 
 /**
- * This function opens a LockWindow.
+ * This function opens files in a LockWindow.
  *
- * @param window Window to be opened
- * @param file File to be processed with the window
+ * @param window Window to open the files in
+ * @param files Files to be processed with the window
+ * @param n_files Number of files
  */
-
-void lock_window_open(LockWindow *window, GFile *file)
+void lock_window_open(LockWindow *window, GFile **files, int n_files)
 {
-    (void)window;
-    (void)file;
+    if (n_files < 1)
+        return;
+
+    GListStore *store = g_list_store_new(G_TYPE_FILE);
+    for (int i = 0; i < n_files; i++)
+        g_list_store_append(store, files[i]);
+
+    lock_window_file_set_inputs(window, G_LIST_MODEL(store));
+    adw_view_stack_set_visible_child_name(window->stack, "file_page");
+
+    /* Cleanup */
+    g_object_unref(store);
+    store = NULL;
 }
 
 /**** UI ****/
@@ -317,6 +448,32 @@ static void lock_window_key_dialog(GSimpleAction *action, GVariant *parameter,
     adw_dialog_present(ADW_DIALOG(dialog), GTK_WIDGET(window));
 }
 
+/**** Preferences ****/
+
+/**
+ * This function wipes the remembered session keys once the session cache of a LockWindow is turned off.
+ *
+ * @param action https://docs.gtk.org/gobject/signal.Object.notify.html
+ * @param pspec https://docs.gtk.org/gobject/signal.Object.notify.html
+ * @param window https://docs.gtk.org/gobject/signal.Object.notify.html
+ */
+static void lock_window_session_cache_on_changed(GSimpleAction *action,
+                                                 GParamSpec *pspec,
+                                                 LockWindow *window)
+{
+    (void)pspec;
+    (void)window;
+
+    GVariant *state = g_action_get_state(G_ACTION(action));
+
+    if (!g_variant_get_boolean(state))
+        session_cache_clear();
+
+    /* Cleanup */
+    g_variant_unref(state);
+    state = NULL;
+}
+
 /**** Text ****/
 
 /**
@@ -410,7 +567,72 @@ static void lock_window_text_queue_set_text(LockWindow *window,
 /**** File ****/
 
 /**
- * This function opens the input file of a LockWindow.
+ * This function sets the input files of a LockWindow.
+ *
+ * More than one file switches the file page to a batch.
+ *
+ * @param window Window to set the input files of
+ * @param files Files to process, at least one
+ */
+static void lock_window_file_set_inputs(LockWindow *window, GListModel *files)
+{
+    lock_window_file_batch_clear(window);
+    g_clear_object(&window->file_input);
+    g_clear_object(&window->file_input_directory);
+
+    guint n_files = g_list_model_get_n_items(files);
+    if (n_files == 1) {
+        window->file_input = g_list_model_get_item(files, 0);
+
+        gchar *name = g_file_get_basename(window->file_input);
+        adw_action_row_set_subtitle(window->file_input_row, name);
+
+        g_free(name);
+        name = NULL;
+
+        lock_window_inspect_queue(window);
+    } else {
+        window->file_jobs =
+            g_ptr_array_new_with_free_func((GDestroyNotify) batch_job_free);
+
+        for (guint i = 0; i < n_files; i++) {
+            GFile *file = g_list_model_get_item(files, i);
+
+            gchar *name = g_file_get_basename(file);
+
+            AdwActionRow *row = ADW_ACTION_ROW(adw_action_row_new());
+            adw_preferences_row_set_use_markup(ADW_PREFERENCES_ROW(row),
+                                               false);
+            adw_preferences_row_set_title(ADW_PREFERENCES_ROW(row), name);
+            gtk_list_box_append(window->file_batch_list, GTK_WIDGET(row));
+
+            g_ptr_array_add(window->file_jobs, batch_job_new(file, row));
+
+            g_free(name);
+            name = NULL;
+
+            g_object_unref(file);
+            file = NULL;
+        }
+
+        gchar *count = g_strdup_printf(ngettext("%u file", "%u files",
+                                                n_files), n_files);
+        adw_action_row_set_subtitle(window->file_input_row, count);
+
+        g_free(count);
+        count = NULL;
+
+        adw_preferences_row_set_title(ADW_PREFERENCES_ROW
+                                      (window->file_output_row),
+                                      _("Output Folder"));
+        adw_action_row_set_subtitle(window->file_output_row,
+                                    _("Next to the input files"));
+        gtk_widget_set_visible(GTK_WIDGET(window->file_batch_window), true);
+    }
+}
+
+/**
+ * This function opens the input files of a LockWindow.
  *
  * @param object https://docs.gtk.org/gio/callback.AsyncReadyCallback.html
  * @param result https://docs.gtk.org/gio/callback.AsyncReadyCallback.html
@@ -422,9 +644,12 @@ static void lock_window_file_open(GObject *source_object, GAsyncResult *res,
     GtkFileDialog *dialog = GTK_FILE_DIALOG(source_object);
     LockWindow *window = LOCK_WINDOW(data);
 
-    window->file_input = gtk_file_dialog_open_finish(dialog, res, NULL);
-    if (window->file_input == NULL) {
+    GListModel *files =
+        gtk_file_dialog_open_multiple_finish(dialog, res, NULL);
+    if (files == NULL || g_list_model_get_n_items(files) == 0) {
         /* Cleanup */
+        g_clear_object(&files);
+
         g_object_unref(dialog);
         dialog = NULL;
 
@@ -433,8 +658,10 @@ static void lock_window_file_open(GObject *source_object, GAsyncResult *res,
         return;
     }
 
-    adw_action_row_set_subtitle(window->file_input_row,
-                                g_file_get_basename(window->file_input));
+    lock_window_file_set_inputs(window, files);
+
+    g_object_unref(files);
+    files = NULL;
 
     /* Cleanup */
     g_object_unref(dialog);
@@ -443,6 +670,52 @@ static void lock_window_file_open(GObject *source_object, GAsyncResult *res,
     window = NULL;
 }
 
+/**
+ * This function opens files dropped onto a LockWindow and processes them as they need.
+ *
+ * @param self https://docs.gtk.org/gtk4/signal.DropTarget.drop.html
+ * @param value https://docs.gtk.org/gtk4/signal.DropTarget.drop.html
+ * @param x https://docs.gtk.org/gtk4/signal.DropTarget.drop.html
+ * @param y https://docs.gtk.org/gtk4/signal.DropTarget.drop.html
+ * @param window https://docs.gtk.org/gtk4/signal.DropTarget.drop.html
+ *
+ * @return Whether the drop was accepted
+ */
+static gboolean lock_window_file_on_drop(GtkDropTarget *self,
+                                         const GValue *value, double x,
+                                         double y, LockWindow *window)
+{
+    (void)self;
+    (void)x;
+    (void)y;
+
+    /* Controls are insensitive while a batch runs */
+    if (!gtk_widget_get_sensitive(GTK_WIDGET(window->file_process_button)))
+        return false;
+
+    GSList *files = gdk_file_list_get_files(g_value_get_boxed(value));
+    if (files == NULL)
+        return false;
+
+    GListStore *store = g_list_store_new(G_TYPE_FILE);
+    for (GSList *file = files; file != NULL; file = file->next)
+        g_list_store_append(store, file->data);
+
+    lock_window_file_set_inputs(window, G_LIST_MODEL(store));
+    adw_view_stack_set_visible_child_name(window->stack, "file_page");
+
+    thread_process_file(NULL, window);
+
+    /* Cleanup */
+    g_object_unref(store);
+    store = NULL;
+
+    g_slist_free(files);
+    files = NULL;
+
+    return true;
+}
+
 /**
  * This function opens the output file of a LockWindow.
  *
@@ -470,6 +743,74 @@ static void lock_window_file_save(GObject *source_object,
     adw_action_row_set_subtitle(window->file_output_row,
                                 g_file_get_basename(window->file_output));
 
+    // Decrypts into the file instead of a folder
+    g_clear_object(&window->file_output_directory);
+
+    /* Cleanup */
+    g_object_unref(dialog);
+    dialog = NULL;
+
+    window = NULL;
+}
+
+/**
+ * This function opens the input directory of a LockWindow.
+ *
+ * @param object https://docs.gtk.org/gio/callback.AsyncReadyCallback.html
+ * @param result https://docs.gtk.org/gio/callback.AsyncReadyCallback.html
+ * @param user_data https://docs.gtk.org/gio/callback.AsyncReadyCallback.html
+ */
+static void lock_window_folder_open(GObject *source_object, GAsyncResult *res,
+                                    gpointer data)
+{
+    GtkFileDialog *dialog = GTK_FILE_DIALOG(source_object);
+    LockWindow *window = LOCK_WINDOW(data);
+
+    GFile *directory = gtk_file_dialog_select_folder_finish(dialog, res, NULL);
+    if (directory != NULL) {
+        lock_window_file_batch_clear(window);
+        g_clear_object(&window->file_input);
+
+        g_clear_object(&window->file_input_directory);
+        window->file_input_directory = directory;
+
+        adw_action_row_set_subtitle(window->file_input_row,
+                                    g_file_get_basename(directory));
+    }
+
+    /* Cleanup */
+    g_object_unref(dialog);
+    dialog = NULL;
+
+    window = NULL;
+}
+
+/**
+ * This function opens the output directory of a LockWindow.
+ *
+ * Used by batches and to decrypt a folder.
+ *
+ * @param object https://docs.gtk.org/gio/callback.AsyncReadyCallback.html
+ * @param result https://docs.gtk.org/gio/callback.AsyncReadyCallback.html
+ * @param user_data https://docs.gtk.org/gio/callback.AsyncReadyCallback.html
+ */
+static void lock_window_file_select_folder(GObject *source_object,
+                                           GAsyncResult *res, gpointer data)
+{
+    GtkFileDialog *dialog = GTK_FILE_DIALOG(source_object);
+    LockWindow *window = LOCK_WINDOW(data);
+
+    GFile *directory = gtk_file_dialog_select_folder_finish(dialog, res, NULL);
+    if (directory != NULL) {
+        g_clear_object(&window->file_output);
+
+        g_clear_object(&window->file_output_directory);
+        window->file_output_directory = directory;
+
+        adw_action_row_set_subtitle(window->file_output_row,
+                                    g_file_get_basename(directory));
+    }
+
     /* Cleanup */
     g_object_unref(dialog);
     dialog = NULL;
@@ -491,8 +832,8 @@ lock_window_file_open_dialog_present(GtkButton *self, LockWindow *window)
     GtkFileDialog *dialog = gtk_file_dialog_new();
     GCancellable *cancel = g_cancellable_new();
 
-    gtk_file_dialog_open(dialog, GTK_WINDOW(window),
-                         cancel, lock_window_file_open, window);
+    gtk_file_dialog_open_multiple(dialog, GTK_WINDOW(window),
+                                  cancel, lock_window_file_open, window);
 }
 
 /**
@@ -509,183 +850,430 @@ lock_window_file_save_dialog_present(GtkButton *self, LockWindow *window)
     GtkFileDialog *dialog = gtk_file_dialog_new();
     GCancellable *cancel = g_cancellable_new();
 
-    gtk_file_dialog_save(dialog, GTK_WINDOW(window),
-                         cancel, lock_window_file_save, window);
+    /* A batch writes its outputs into a folder */
+    if (window->file_jobs != NULL)
+        gtk_file_dialog_select_folder(dialog, GTK_WINDOW(window), cancel,
+                                      lock_window_file_select_folder, window);
+    else
+        gtk_file_dialog_save(dialog, GTK_WINDOW(window),
+                             cancel, lock_window_file_save, window);
 }
 
-/**** Encryption ****/
-
 /**
- * This function overwrites the key UID of a LockWindow.
+ * This function opens a select folder dialog for the input of a LockWindow.
  *
- * @param window Window to overwrite the key UID of
- * @param uid UID to overwrite with
+ * @param self https://docs.gtk.org/gtk4/signal.Button.clicked.html
+ * @param window https://docs.gtk.org/gtk4/signal.Button.clicked.html
  */
-void lock_window_set_uid(LockWindow *window, const char *uid)
+static void
+lock_window_folder_open_dialog_present(GtkButton *self, LockWindow *window)
 {
-    window->uid = realloc(window->uid, (strlen(uid) + 1) * sizeof(char));
-    strcpy(window->uid, uid);
+    (void)self;
+
+    GtkFileDialog *dialog = gtk_file_dialog_new();
+    GCancellable *cancel = g_cancellable_new();
+
+    gtk_file_dialog_select_folder(dialog, GTK_WINDOW(window), cancel,
+                                  lock_window_folder_open, window);
 }
 
 /**
- * This function overwrites the used key UID of a LockWindow.
+ * This function opens a select folder dialog for the output of a LockWindow.
  *
- * @param window Window to overwrite the used key UID of
- * @param uid UID to overwrite with
+ * @param self https://docs.gtk.org/gtk4/signal.Button.clicked.html
+ * @param window https://docs.gtk.org/gtk4/signal.Button.clicked.html
  */
-void lock_window_set_uid_used(LockWindow *window, const char *uid)
+static void
+lock_window_folder_save_dialog_present(GtkButton *self, LockWindow *window)
 {
-    window->uid_used =
-        realloc(window->uid_used, (strlen(uid) + 1) * sizeof(char));
-    strcpy(window->uid_used, uid);
+    (void)self;
+
+    GtkFileDialog *dialog = gtk_file_dialog_new();
+    GCancellable *cancel = g_cancellable_new();
+
+    gtk_file_dialog_select_folder(dialog, GTK_WINDOW(window), cancel,
+                                  lock_window_file_select_folder, window);
 }
 
 /**
- * This function handles user input to select the target key for a text encryption process of a LockWindow.
+ * This function leaves batch mode of a LockWindow.
  *
- * @param self https://docs.gtk.org/gio/signal.SimpleAction.activate.html
- * @param parameter https://docs.gtk.org/gio/signal.SimpleAction.activate.html
- * @param window https://docs.gtk.org/gio/signal.SimpleAction.activate.html
+ * @param window Window to reset the file page of
  */
-void lock_window_encrypt_text_dialog(GSimpleAction *self, GVariant *parameter,
-                                     LockWindow *window)
+static void lock_window_file_batch_clear(LockWindow *window)
 {
-    (void)self;
-    (void)parameter;
+    if (window->file_jobs == NULL)
+        return;
 
-    LockEntryDialog *dialog =
-        lock_entry_dialog_new(_("Encrypt for"), _("Enter name or email …"),
-                              GTK_INPUT_PURPOSE_FREE_FORM);
+    g_ptr_array_unref(window->file_jobs);
+    window->file_jobs = NULL;
 
-    g_signal_connect(dialog, "entered", G_CALLBACK(thread_encrypt_text),
-                     window);
+    g_clear_object(&window->file_output_directory);
 
-    adw_dialog_present(ADW_DIALOG(dialog), GTK_WIDGET(window));
+    gtk_list_box_remove_all(window->file_batch_list);
+    gtk_widget_set_visible(GTK_WIDGET(window->file_batch_window), false);
+
+    adw_preferences_row_set_title(ADW_PREFERENCES_ROW(window->file_output_row),
+                                  _("Output File"));
+    adw_action_row_set_subtitle(window->file_output_row, "");
 }
 
 /**
- * This function handles user input to select the target key for a file encryption process of a LockWindow.
+ * This function returns the number of files a LockWindow processes at the same time.
  *
- * @param self https://docs.gtk.org/gtk4/signal.Button.clicked.html
- * @param window https://docs.gtk.org/gtk4/signal.Button.clicked.html
+ * @param window Window to get the parallelism of
+ *
+ * @return Number of threads
  */
-void lock_window_encrypt_file_dialog(GtkButton *self, LockWindow *window)
+static unsigned int lock_window_get_threads(LockWindow *window)
 {
-    (void)self;
+    GVariant *parallelism =
+        g_action_group_get_action_state(G_ACTION_GROUP(window), "parallelism");
+    const gchar *threads = g_variant_get_string(parallelism, NULL);
 
-    LockEntryDialog *dialog =
-        lock_entry_dialog_new(_("Encrypt for"), _("Enter name or email …"),
-                              GTK_INPUT_PURPOSE_EMAIL);
+    unsigned int count = (strcmp(threads, "automatic") == 0) ?
+        batch_threads() : (unsigned int)g_ascii_strtoull(threads, NULL, 10);
 
-    g_signal_connect(dialog, "entered", G_CALLBACK(thread_encrypt_file),
-                     window);
+    /* Cleanup */
+    g_variant_unref(parallelism);
+    parallelism = NULL;
 
-    adw_dialog_present(ADW_DIALOG(dialog), GTK_WIDGET(window));
+    return MAX(count, 1);
 }
 
 /**
- * This function encrypts text from the text view of a LockWindow.
+ * This function enables or disables the file page of a LockWindow while a batch is processed.
  *
- * @param window https://docs.gtk.org/glib/callback.SourceFunc.html
+ * @param window Window to update
+ * @param sensitive Whether the controls accept input
  */
-void lock_window_encrypt_text(LockWindow *window)
+static void lock_window_file_set_sensitive(LockWindow *window, bool sensitive)
 {
-    gchar *plain = lock_window_text_view_get_text(window);
+    gtk_widget_set_sensitive(GTK_WIDGET(window->file_input_button), sensitive);
+    gtk_widget_set_sensitive(GTK_WIDGET(window->file_input_folder_button),
+                             sensitive);
+    gtk_widget_set_sensitive(GTK_WIDGET(window->file_preview_button),
+                             sensitive);
+    gtk_widget_set_sensitive(GTK_WIDGET(window->file_output_button),
+                             sensitive);
+    gtk_widget_set_sensitive(GTK_WIDGET(window->file_output_folder_button),
+                             sensitive);
+
+    gtk_widget_set_sensitive(GTK_WIDGET(window->file_process_button),
+                             sensitive);
+    gtk_widget_set_sensitive(GTK_WIDGET(window->file_encrypt_button),
+                             sensitive);
+    gtk_widget_set_sensitive(GTK_WIDGET(window->file_decrypt_button),
+                             sensitive);
+    gtk_widget_set_sensitive(GTK_WIDGET(window->file_sign_button), sensitive);
+    gtk_widget_set_sensitive(GTK_WIDGET(window->file_verify_button),
+                             sensitive);
+}
 
-    gpgme_key_t key = key_search(window->uid);
-    HANDLE_ERROR_UID(, key, lock_window_encrypt_text_on_completed, window,
-                     g_free(plain); plain = NULL;);
-    lock_window_set_uid(window, "");    // Mark email search as successful
-    if (key->uids->name) {
-        lock_window_set_uid_used(window, key->uids->name);
-    } else if (key->uids->email) {
-        lock_window_set_uid_used(window, key->uids->email);
-    } else {
-        lock_window_set_uid_used(window, key->subkeys->fpr);
-    }
+/**
+ * This function shows the status of a file of a batch in a LockWindow.
+ *
+ * @param job File that changed its status
+ * @param status New status
+ * @param window Window showing the batch
+ */
+static void lock_window_file_batch_on_status(batch_job *job,
+                                             batch_status status,
+                                             LockWindow *window)
+{
+    (void)window;
 
-    gchar *armor = process_text(plain, ENCRYPT, key);
-    if (armor == NULL) {
-        lock_window_text_queue_set_text(window, "");
-    } else {
-        lock_window_text_queue_set_text(window, armor);
+    AdwActionRow *row = ADW_ACTION_ROW(job->data);
+    gchar *subtitle = NULL;
+
+    switch (status) {
+    case BATCH_QUEUED:
+        subtitle = g_strdup(C_("Status of a file in a batch", "Queued"));
+        break;
+    case BATCH_PROCESSING:
+        subtitle = g_strdup(C_("Status of a file in a batch", "Processing …"));
+        break;
+    case BATCH_SUCCEEDED:{
+            if (job->resumed) {
+                subtitle =
+                    g_strdup(C_
+                             ("Status of a file in a batch",
+                              "Already done by a previous run"));
+                break;
+            }
+
+            gchar *name = g_file_get_basename(job->output);
+            gchar *details = lock_window_file_details(&job->options);
+
+            subtitle =
+                g_strdup_printf(C_
+                                ("Status of a file in a batch. First formatter is the name of the output file, second formatter are details of the operation.",
+                                 "Saved as %s%s"), name, details);
+
+            g_free(name);
+            name = NULL;
+
+            g_free(details);
+            details = NULL;
+            break;
+        }
+    case BATCH_FAILED:
+        subtitle = g_strdup(job->exists ?
+                            C_("Status of a file in a batch",
+                               "Failed: output file already exists") :
+                            C_("Status of a file in a batch", "Failed"));
+        break;
     }
 
-    /* Cleanup */
-    g_free(plain);
-    plain = NULL;
-
-    g_free(armor);
-    armor = NULL;
+    adw_action_row_set_subtitle(row, subtitle);
 
-    gpgme_key_release(key);
+    /* Cleanup */
+    g_free(subtitle);
+    subtitle = NULL;
+}
 
-    /* UI */
-    g_idle_add((GSourceFunc) lock_window_encrypt_text_on_completed, window);
+/**
+ * This function disables the file page of a LockWindow once a batch starts and is supposed to be called via g_idle_add().
+ *
+ * @param window https://docs.gtk.org/glib/callback.SourceFunc.html
+ *
+ * @return https://docs.gtk.org/glib/func.idle_add.html
+ */
+static gboolean lock_window_file_batch_on_started(LockWindow *window)
+{
+    lock_window_file_set_sensitive(window, false);
 
-    g_thread_exit(0);
+    /* Only execute once */
+    return false;               // https://docs.gtk.org/glib/func.idle_add.html
 }
 
 /**
- * This function handles UI updates for text encryption and is supposed to be called via g_idle_add().
+ * This function handles UI updates for a batch of files and is supposed to be called via g_idle_add().
  *
  * @param window https://docs.gtk.org/glib/callback.SourceFunc.html
  *
  * @return https://docs.gtk.org/glib/func.idle_add.html
  */
-gboolean lock_window_encrypt_text_on_completed(LockWindow *window)
+static gboolean lock_window_file_batch_on_completed(LockWindow *window)
 {
     AdwToast *toast;
 
-    gchar *armor = lock_window_text_queue_get_text(window);
-    lock_window_text_queue_set_text(window, "");
-
-    if (strlen(window->uid) > 0) {
+    if (window->file_failed > 0) {
         toast =
             adw_toast_new(g_strdup_printf
-                          (_("Failed to find key for User ID “%s”"),
-                           window->uid));
-
-        lock_window_set_uid(window, "");
-    } else if (strcmp(armor, "") == 0) {
-        toast = adw_toast_new(_("Encryption failed"));
+                          (ngettext
+                           ("%u file failed", "%u files failed",
+                            window->file_failed), window->file_failed));
     } else {
         toast =
             adw_toast_new(g_strdup_printf
-                          (C_
-                           ("Formatter is either name, email or fingerprint of the public key used in the encryption process.",
-                            "Text encrypted for %s"), window->uid_used));
-
-        lock_window_text_view_set_text(window, armor);
+                          (ngettext
+                           ("%u file processed", "%u files processed",
+                            window->file_jobs->len), window->file_jobs->len));
     }
 
-    adw_toast_set_use_markup(toast, false);
     adw_toast_set_timeout(toast, 3);
     adw_toast_overlay_add_toast(window->toast_overlay, toast);
 
-    /* Cleanup */
-    g_free(armor);
-    armor = NULL;
+    lock_window_file_set_sensitive(window, true);
 
     /* Only execute once */
     return false;               // https://docs.gtk.org/glib/func.idle_add.html
 }
 
 /**
- * This function encrypts the file of a LockWindow.
+ * This function processes the files of a batch of a LockWindow if there is one.
+ *
+ * Supposed to be called on the thread of a file operation, which it does not exit.
+ *
+ * @param window Window holding the batch
+ * @param flags Operation to perform on each file
+ * @param key Key to encrypt for. Can be NULL for other operations
+ * @param options Parameters of the operation. Can be NULL
+ *
+ * @return Whether the window holds a batch, which was processed
+ */
+static bool lock_window_file_batch(LockWindow *window,
+                                   cryptography_flags flags, gpgme_key_t key,
+                                   cryptography_options *options)
+{
+    if (window->file_jobs == NULL)
+        return false;
+
+    g_idle_add((GSourceFunc) lock_window_file_batch_on_started, window);
+
+    window->file_failed =
+        batch_process(window->file_jobs, flags, key, options,
+                      window->file_output_directory,
+                      lock_window_get_threads(window), true,
+                      (batch_status_func) lock_window_file_batch_on_status,
+                      window);
+
+    /* UI */
+    g_idle_add((GSourceFunc) lock_window_file_batch_on_completed, window);
+
+    return true;
+}
+
+/**** Encryption ****/
+
+/**
+ * This function overwrites the key UID of a LockWindow.
+ *
+ * @param window Window to overwrite the key UID of
+ * @param uid UID to overwrite with
+ */
+void lock_window_set_uid(LockWindow *window, const char *uid)
+{
+    window->uid = realloc(window->uid, (strlen(uid) + 1) * sizeof(char));
+    strcpy(window->uid, uid);
+}
+
+/**
+ * This function overwrites the used key UID of a LockWindow.
+ *
+ * @param window Window to overwrite the used key UID of
+ * @param uid UID to overwrite with
+ */
+void lock_window_set_uid_used(LockWindow *window, const char *uid)
+{
+    window->uid_used =
+        realloc(window->uid_used, (strlen(uid) + 1) * sizeof(char));
+    strcpy(window->uid_used, uid);
+}
+
+/**
+ * This function returns the parameters of a cryptography operation chosen in a LockWindow.
+ *
+ * @param window Window to get the parameters of
+ *
+ * @return Parameters
+ */
+static cryptography_options lock_window_get_options(LockWindow *window)
+{
+    cryptography_options options = { 0 };
+
+    GVariant *compression =
+        g_action_group_get_action_state(G_ACTION_GROUP(window), "compression");
+    const gchar *mode = g_variant_get_string(compression, NULL);
+
+    if (strcmp(mode, "always") == 0)
+        options.compression = COMPRESSION_ALWAYS;
+    else if (strcmp(mode, "never") == 0)
+        options.compression = COMPRESSION_NEVER;
+    else
+        options.compression = COMPRESSION_AUTOMATIC;
+
+    GVariant *zstd = g_action_group_get_action_state(G_ACTION_GROUP(window),
+                                                     "zstd");
+    options.zstd = g_variant_get_boolean(zstd);
+
+    GVariant *chunked =
+        g_action_group_get_action_state(G_ACTION_GROUP(window), "chunked");
+    options.chunked = g_variant_get_boolean(chunked);
+
+    GVariant *session_cache =
+        g_action_group_get_action_state(G_ACTION_GROUP(window),
+                                        "session_cache");
+    options.session_cache = g_variant_get_boolean(session_cache);
+
+    /* Cleanup */
+    g_variant_unref(compression);
+    compression = NULL;
+
+    g_variant_unref(zstd);
+    zstd = NULL;
+
+    g_variant_unref(chunked);
+    chunked = NULL;
+
+    g_variant_unref(session_cache);
+    session_cache = NULL;
+
+    return options;
+}
+
+/**
+ * This function describes the details of a cryptography operation on a file.
+ *
+ * @param options Parameters and details of the operation
+ *
+ * @return Description of the cipher and throughput or an empty string. Owned by caller
+ */
+static gchar *lock_window_file_details(cryptography_options *options)
+{
+    GString *details = g_string_new(NULL);
+
+    if (options->cipher != NULL)
+        g_string_append_printf(details, " · %s", options->cipher);
+
+    if (options->signature_issue != NULL)
+        g_string_append_printf(details, " · %s", options->signature_issue);
+
+    if (options->duration > 0 && options->size > 0)
+        g_string_append_printf(details,
+                               C_("Throughput in megabytes per second",
+                                  " · %.0f MB/s"),
+                               options->size / (double)options->duration);
+
+    return g_string_free(details, false);
+}
+
+/**
+ * This function handles user input to select the target key for a text encryption process of a LockWindow.
+ *
+ * @param self https://docs.gtk.org/gio/signal.SimpleAction.activate.html
+ * @param parameter https://docs.gtk.org/gio/signal.SimpleAction.activate.html
+ * @param window https://docs.gtk.org/gio/signal.SimpleAction.activate.html
+ */
+void lock_window_encrypt_text_dialog(GSimpleAction *self, GVariant *parameter,
+                                     LockWindow *window)
+{
+    (void)self;
+    (void)parameter;
+
+    LockEntryDialog *dialog =
+        lock_entry_dialog_new(_("Encrypt for"), _("Enter name or email …"),
+                              GTK_INPUT_PURPOSE_FREE_FORM);
+
+    g_signal_connect(dialog, "entered", G_CALLBACK(thread_encrypt_text),
+                     window);
+
+    adw_dialog_present(ADW_DIALOG(dialog), GTK_WIDGET(window));
+}
+
+/**
+ * This function handles user input to select the target key for a file encryption process of a LockWindow.
+ *
+ * @param self https://docs.gtk.org/gtk4/signal.Button.clicked.html
+ * @param window https://docs.gtk.org/gtk4/signal.Button.clicked.html
+ */
+void lock_window_encrypt_file_dialog(GtkButton *self, LockWindow *window)
+{
+    (void)self;
+
+    LockEntryDialog *dialog =
+        lock_entry_dialog_new(_("Encrypt for"), _("Enter name or email …"),
+                              GTK_INPUT_PURPOSE_EMAIL);
+
+    g_signal_connect(dialog, "entered", G_CALLBACK(thread_encrypt_file),
+                     window);
+
+    adw_dialog_present(ADW_DIALOG(dialog), GTK_WIDGET(window));
+}
+
+/**
+ * This function encrypts text from the text view of a LockWindow.
  *
  * @param window https://docs.gtk.org/glib/callback.SourceFunc.html
  */
-void lock_window_encrypt_file(LockWindow *window)
+void lock_window_encrypt_text(LockWindow *window)
 {
-    char *input_path = g_file_get_path(window->file_input);
-    char *output_path = g_file_get_path(window->file_output);
+    gchar *plain = lock_window_text_view_get_text(window);
 
     gpgme_key_t key = key_search(window->uid);
-    HANDLE_ERROR_UID(, key, lock_window_encrypt_file_on_completed, window,
-                     /* Cleanup */
-                     g_free(input_path); input_path = NULL;
-                     g_free(output_path); output_path = NULL;);
+    HANDLE_ERROR_UID(, key, lock_window_encrypt_text_on_completed, window,
+                     g_free(plain); plain = NULL;);
     lock_window_set_uid(window, "");    // Mark email search as successful
     if (key->uids->name) {
         lock_window_set_uid_used(window, key->uids->name);
@@ -695,14 +1283,119 @@ void lock_window_encrypt_file(LockWindow *window)
         lock_window_set_uid_used(window, key->subkeys->fpr);
     }
 
-    window->file_success = process_file(input_path, output_path, ENCRYPT, key);
+    cryptography_options options = lock_window_get_options(window);
+    gchar *armor = process_text(plain, ENCRYPT, key, &options);
+    if (armor == NULL) {
+        lock_window_text_queue_set_text(window, "");
+    } else {
+        lock_window_text_queue_set_text(window, armor);
+    }
+
+    /* Cleanup */
+    g_free(plain);
+    plain = NULL;
+
+    g_free(armor);
+    armor = NULL;
+
+    gpgme_key_release(key);
+
+    /* UI */
+    g_idle_add((GSourceFunc) lock_window_encrypt_text_on_completed, window);
+
+    g_thread_exit(0);
+}
+
+/**
+ * This function handles UI updates for text encryption and is supposed to be called via g_idle_add().
+ *
+ * @param window https://docs.gtk.org/glib/callback.SourceFunc.html
+ *
+ * @return https://docs.gtk.org/glib/func.idle_add.html
+ */
+gboolean lock_window_encrypt_text_on_completed(LockWindow *window)
+{
+    AdwToast *toast;
+
+    gchar *armor = lock_window_text_queue_get_text(window);
+    lock_window_text_queue_set_text(window, "");
+
+    if (strlen(window->uid) > 0) {
+        toast =
+            adw_toast_new(g_strdup_printf
+                          (_("Failed to find key for User ID “%s”"),
+                           window->uid));
+
+        lock_window_set_uid(window, "");
+    } else if (strcmp(armor, "") == 0) {
+        toast = adw_toast_new(_("Encryption failed"));
+    } else {
+        toast =
+            adw_toast_new(g_strdup_printf
+                          (C_
+                           ("Formatter is either name, email or fingerprint of the public key used in the encryption process.",
+                            "Text encrypted for %s"), window->uid_used));
+
+        lock_window_text_view_set_text(window, armor);
+    }
+
+    adw_toast_set_use_markup(toast, false);
+    adw_toast_set_timeout(toast, 3);
+    adw_toast_overlay_add_toast(window->toast_overlay, toast);
 
     /* Cleanup */
-    g_free(input_path);
-    input_path = NULL;
+    g_free(armor);
+    armor = NULL;
+
+    /* Only execute once */
+    return false;               // https://docs.gtk.org/glib/func.idle_add.html
+}
+
+/**
+ * This function encrypts the file of a LockWindow.
+ *
+ * @param window https://docs.gtk.org/glib/callback.SourceFunc.html
+ */
+void lock_window_encrypt_file(LockWindow *window)
+{
+    gpgme_key_t key = key_search(window->uid);
+    HANDLE_ERROR_UID(, key, lock_window_encrypt_file_on_completed, window,);
+    lock_window_set_uid(window, "");    // Mark email search as successful
+    if (key->uids->name) {
+        lock_window_set_uid_used(window, key->uids->name);
+    } else if (key->uids->email) {
+        lock_window_set_uid_used(window, key->uids->email);
+    } else {
+        lock_window_set_uid_used(window, key->subkeys->fpr);
+    }
+
+    cryptography_options_clear(&window->file_options);
+    window->file_options = lock_window_get_options(window);
+
+    if (lock_window_file_batch(window, ENCRYPT, key, &window->file_options)) {
+        gpgme_key_release(key);
+        g_thread_exit(0);
+    }
 
-    g_free(output_path);
-    output_path = NULL;
+    /* A folder encrypted into a folder is mirrored file by file */
+    if (window->file_input_directory != NULL
+        && window->file_output_directory != NULL)
+        window->file_success =
+            mirror_directory(window->file_input_directory,
+                             window->file_output_directory, key,
+                             &window->file_options,
+                             lock_window_get_threads(window),
+                             &window->file_mirror);
+    else if (window->file_input_directory != NULL)
+        window->file_success =
+            window->file_output != NULL
+            && process_directory(window->file_input_directory,
+                                 window->file_output, ENCRYPT, key,
+                                 &window->file_options);
+    else
+        window->file_success =
+            process_file(window->file_input, window->file_output, ENCRYPT,
+                         key, &window->file_options);
 
     gpgme_key_release(key);
 
@@ -730,14 +1423,31 @@ gboolean lock_window_encrypt_file_on_completed(LockWindow *window)
                            window->uid));
 
         lock_window_set_uid(window, "");
+    } else if (window->file_input_directory != NULL
+               && window->file_output_directory != NULL) {
+        mirror_stats *stats = &window->file_mirror;
+
+        toast =
+            adw_toast_new(g_strdup_printf
+                          (C_
+                           ("First formatter is either name, email or fingerprint of the public key used in the encryption process, then the numbers of encrypted, unchanged and failed files.",
+                            "Folder encrypted for %s: %u encrypted, %u unchanged, %u failed"),
+                           window->uid_used, stats->encrypted,
+                           stats->unchanged, stats->failed));
     } else if (!window->file_success) {
         toast = adw_toast_new(_("Encryption failed"));
     } else {
+        gchar *details = lock_window_file_details(&window->file_options);
+
         toast =
             adw_toast_new(g_strdup_printf
                           (C_
-                           ("Formatter is either name, email or fingerprint of the public key used in the encryption process.",
-                            "File encrypted for %s"), window->uid_used));
+                           ("First formatter is either name, email or fingerprint of the public key used in the encryption process, second formatter are details of the operation.",
+                            "File encrypted for %s%s"), window->uid_used,
+                           details));
+
+        g_free(details);
+        details = NULL;
     }
 
     adw_toast_set_use_markup(toast, false);
@@ -759,7 +1469,8 @@ void lock_window_decrypt_text(LockWindow *window)
 {
     gchar *armor = lock_window_text_view_get_text(window);
 
-    gchar *plain = process_text(armor, DECRYPT, NULL);
+    cryptography_options options = lock_window_get_options(window);
+    gchar *plain = process_text(armor, DECRYPT, NULL, &options);
     if (plain == NULL) {
         lock_window_text_queue_set_text(window, "");
     } else {
@@ -773,6 +1484,8 @@ void lock_window_decrypt_text(LockWindow *window)
     g_free(plain);
     plain = NULL;
 
+    cryptography_options_clear(&options);
+
     /* UI */
     g_idle_add((GSourceFunc) lock_window_decrypt_text_on_completed, window);
 
@@ -819,17 +1532,23 @@ gboolean lock_window_decrypt_text_on_completed(LockWindow *window)
  */
 void lock_window_decrypt_file(LockWindow *window)
 {
-    char *input_path = g_file_get_path(window->file_input);
-    char *output_path = g_file_get_path(window->file_output);
-
-    window->file_success = process_file(input_path, output_path, DECRYPT, NULL);
-
-    /* Cleanup */
-    g_free(input_path);
-    input_path = NULL;
-
-    g_free(output_path);
-    output_path = NULL;
+    cryptography_options_clear(&window->file_options);
+    window->file_options = lock_window_get_options(window);
+
+    if (lock_window_file_batch(window, DECRYPT, NULL, &window->file_options))
+        g_thread_exit(0);
+
+    if (window->file_output_directory != NULL)
+        window->file_success =
+            window->file_input != NULL
+            && process_directory(window->file_input,
+                                 window->file_output_directory, DECRYPT, NULL,
+                                 &window->file_options);
+    else
+        window->file_success =
+            window->file_input != NULL
+            && process_file(window->file_input, window->file_output, DECRYPT,
+                            NULL, &window->file_options);
 
     /* UI */
     g_idle_add((GSourceFunc) lock_window_decrypt_file_on_completed, window);
@@ -851,7 +1570,16 @@ gboolean lock_window_decrypt_file_on_completed(LockWindow *window)
     if (!window->file_success) {
         toast = adw_toast_new(_("Decryption failed"));
     } else {
-        toast = adw_toast_new(_("File decrypted"));
+        gchar *details = lock_window_file_details(&window->file_options);
+
+        toast =
+            adw_toast_new(g_strdup_printf
+                          (C_
+                           ("Formatter are details of the operation",
+                            "File decrypted%s"), details));
+
+        g_free(details);
+        details = NULL;
     }
 
     adw_toast_set_timeout(toast, 3);
@@ -872,7 +1600,7 @@ void lock_window_sign_text(LockWindow *window)
 {
     gchar *plain = lock_window_text_view_get_text(window);
 
-    gchar *armor = process_text(plain, SIGN, NULL);
+    gchar *armor = process_text(plain, SIGN, NULL, NULL);
     if (armor == NULL) {
         lock_window_text_queue_set_text(window, "");
     } else {
@@ -932,17 +1660,12 @@ gboolean lock_window_sign_text_on_completed(LockWindow *window)
  */
 void lock_window_sign_file(LockWindow *window)
 {
-    char *input_path = g_file_get_path(window->file_input);
-    char *output_path = g_file_get_path(window->file_output);
+    if (lock_window_file_batch(window, SIGN, NULL, NULL))
+        g_thread_exit(0);
 
-    window->file_success = process_file(input_path, output_path, SIGN, NULL);
-
-    /* Cleanup */
-    g_free(input_path);
-    input_path = NULL;
-
-    g_free(output_path);
-    output_path = NULL;
+    window->file_success = window->file_input != NULL
+        && process_file(window->file_input, window->file_output, SIGN, NULL,
+                        NULL);
 
     /* UI */
     g_idle_add((GSourceFunc) lock_window_sign_file_on_completed, window);
@@ -985,7 +1708,7 @@ void lock_window_verify_text(LockWindow *window)
 {
     gchar *armor = lock_window_text_view_get_text(window);
 
-    gchar *plain = process_text(armor, VERIFY, NULL);
+    gchar *plain = process_text(armor, VERIFY, NULL, NULL);
     if (plain == NULL) {
         lock_window_text_queue_set_text(window, "");
     } else {
@@ -1045,17 +1768,12 @@ gboolean lock_window_verify_text_on_completed(LockWindow *window)
  */
 void lock_window_verify_file(LockWindow *window)
 {
-    char *input_path = g_file_get_path(window->file_input);
-    char *output_path = g_file_get_path(window->file_output);
-
-    window->file_success = process_file(input_path, output_path, VERIFY, NULL);
+    if (lock_window_file_batch(window, VERIFY, NULL, NULL))
+        g_thread_exit(0);
 
-    /* Cleanup */
-    g_free(input_path);
-    input_path = NULL;
-
-    g_free(output_path);
-    output_path = NULL;
+    window->file_success = window->file_input != NULL
+        && process_file(window->file_input, window->file_output, VERIFY, NULL,
+                        NULL);
 
     /* UI */
     g_idle_add((GSourceFunc) lock_window_verify_file_on_completed, window);
@@ -1086,3 +1804,562 @@ gboolean lock_window_verify_file_on_completed(LockWindow *window)
     /* Only execute once */
     return false;               // https://docs.gtk.org/glib/func.idle_add.html
 }
+
+/**** Inspection ****/
+
+/**
+ * This structure holds the outcome of the inspection of an input file.
+ */
+typedef struct {
+    LockWindow *window;
+    GFile *file;
+    gchar *description;
+} lock_window_inspection;
+
+/**
+ * This function queues the inspection of the input file of a LockWindow.
+ *
+ * @param window Window to inspect the input file of
+ */
+static void lock_window_inspect_queue(LockWindow *window)
+{
+    /* A pending inspection of a previous file is dropped */
+    GFile *previous = g_atomic_pointer_exchange(&window->file_inspect,
+                                                g_object_ref
+                                                (window->file_input));
+    g_clear_object(&previous);
+
+    g_object_ref(window);
+    thread_inspect_file(window);
+}
+
+/**
+ * This function names the key a key ID or fingerprint belongs to.
+ *
+ * @param id Key ID or fingerprint
+ * @param keys Array of key_index_entry. Can be NULL
+ *
+ * @return Name of the key. Owned by caller
+ */
+static gchar *lock_window_inspect_key(const char *id, GPtrArray *keys)
+{
+    if (strspn(id, "0") == strlen(id))
+        return g_strdup(C_
+                        ("Recipient of an encrypted file", "hidden recipient"));
+
+    key_index_entry *key = (keys != NULL) ? key_index_find(keys, id) : NULL;
+    if (key != NULL && key->uids[0] != NULL)
+        return g_strdup(key->uids[0]);
+
+    return g_strdup_printf(C_
+                           ("Key ID missing from the keyring",
+                            "unknown key %s"), id);
+}
+
+/**
+ * This function names a list of keys.
+ *
+ * @param ids Key IDs or fingerprints
+ * @param keys Array of key_index_entry. Can be NULL
+ * @param passwords Number of passwords to list after the keys
+ *
+ * @return Comma-separated names. Owned by caller
+ */
+static gchar *lock_window_inspect_keys(GPtrArray *ids, GPtrArray *keys,
+                                       guint passwords)
+{
+    GString *names = g_string_new(NULL);
+
+    for (guint i = 0; i < ids->len; i++) {
+        gchar *name = lock_window_inspect_key(g_ptr_array_index(ids, i), keys);
+
+        if (names->len > 0)
+            g_string_append(names, ", ");
+        g_string_append(names, name);
+
+        g_free(name);
+        name = NULL;
+    }
+
+    if (passwords > 0) {
+        if (names->len > 0)
+            g_string_append(names, ", ");
+        g_string_append(names,
+                        C_("Recipient of an encrypted file", "a password"));
+    }
+
+    return g_string_free(names, false);
+}
+
+/**
+ * This function describes a summary of OpenPGP data.
+ *
+ * @param summary Summary to describe
+ * @param keys Array of key_index_entry to name keys with. Can be NULL
+ *
+ * @return Description. Owned by caller
+ */
+static gchar *lock_window_inspect_describe(openpgp_summary *summary,
+                                           GPtrArray *keys)
+{
+    gchar *description = NULL;
+    gchar *names = NULL;
+
+    switch (summary->type) {
+    case OPENPGP_MESSAGE_ENCRYPTED:
+        names = lock_window_inspect_keys(summary->recipients, keys,
+                                         summary->passwords);
+        description = g_strdup_printf(_("Encrypted for %s"), names);
+        break;
+    case OPENPGP_MESSAGE_SIGNED:
+        names = lock_window_inspect_keys(summary->signers, keys, 0);
+        description = (names[0] != '\0') ?
+            g_strdup_printf(_("Signed by %s"), names) : g_strdup(_("Signed"));
+        break;
+    case OPENPGP_MESSAGE_SIGNATURE:
+        names = lock_window_inspect_keys(summary->signers, keys, 0);
+        description = (names[0] != '\0') ?
+            g_strdup_printf(_("Signature by %s"), names) :
+            g_strdup(_("Signature"));
+        break;
+    case OPENPGP_MESSAGE_LITERAL:
+        description = g_strdup(_("Unencrypted OpenPGP data"));
+        break;
+    case OPENPGP_MESSAGE_COMPRESSED:
+        description = g_strdup(_("Compressed OpenPGP data"));
+        break;
+    case OPENPGP_MESSAGE_PUBLIC_KEY:
+    case OPENPGP_MESSAGE_SECRET_KEY:{
+            key_index_entry *key = (keys != NULL
+                                    && summary->fingerprint != NULL) ?
+                key_index_find(keys, summary->fingerprint) : NULL;
+            const char *owner = (key != NULL && key->uids[0] != NULL) ?
+                key->uids[0] : (summary->uid != NULL) ? summary->uid :
+                (summary->fingerprint != NULL) ? summary->fingerprint : "";
+
+            if (summary->type == OPENPGP_MESSAGE_SECRET_KEY)
+                description = g_strdup_printf(_("Secret key of %s"), owner);
+            else if (key != NULL)
+                description =
+                    g_strdup_printf(_
+                                    ("Public key of %s, already in the keyring"),
+                                    owner);
+            else
+                description = g_strdup_printf(_("Public key of %s"), owner);
+            break;
+        }
+    default:
+        break;
+    }
+
+    /* Cleanup */
+    g_free(names);
+    names = NULL;
+
+    return description;
+}
+
+/**
+ * This function shows the inspection of the input file of a LockWindow and is supposed to be called via g_idle_add().
+ *
+ * @param inspection https://docs.gtk.org/glib/callback.SourceFunc.html
+ *
+ * @return https://docs.gtk.org/glib/func.idle_add.html
+ */
+static gboolean lock_window_inspect_file_on_completed(lock_window_inspection
+                                                      *inspection)
+{
+    LockWindow *window = inspection->window;
+
+    /* The input may have changed in the meantime */
+    if (inspection->description != NULL
+        && window->file_input == inspection->file) {
+        gchar *name = g_file_get_basename(inspection->file);
+        gchar *subtitle = g_strdup_printf("%s · %s", name,
+                                          inspection->description);
+
+        adw_action_row_set_subtitle(window->file_input_row, subtitle);
+
+        g_free(subtitle);
+        subtitle = NULL;
+
+        g_free(name);
+        name = NULL;
+    }
+
+    /* Cleanup */
+    g_object_unref(inspection->file);
+    g_free(inspection->description);
+    g_free(inspection);
+    inspection = NULL;
+
+    g_object_unref(window);
+    window = NULL;
+
+    /* Only execute once */
+    return false;               // https://docs.gtk.org/glib/func.idle_add.html
+}
+
+/**
+ * This function inspects the input file of a LockWindow without decrypting or verifying it.
+ *
+ * Only the leading packets of the file are read and matched against the key index, whatever the size of the file.
+ *
+ * @param window https://docs.gtk.org/glib/callback.ThreadFunc.html
+ */
+void lock_window_inspect_file(LockWindow *window)
+{
+    GFile *file = g_atomic_pointer_exchange(&window->file_inspect, NULL);
+    if (file == NULL) {
+        g_object_unref(window);
+        g_thread_exit(0);
+    }
+
+    openpgp_summary *summary = inspect_file(file);
+    GPtrArray *keys = NULL;
+
+    if (summary != NULL
+        && (summary->recipients->len > 0 || summary->signers->len > 0
+            || summary->fingerprint != NULL)) {
+        keys = key_index_load();
+
+        /* A stale index is rebuilt, like the key dialog does */
+        if (keys == NULL) {
+            key_index_stamp stamp;
+            keys = key_index_list(&stamp);
+
+            if (keys != NULL)
+                key_index_save(keys, &stamp);
+
+            key_index_stamp_clear(&stamp);
+        }
+    }
+
+    lock_window_inspection *inspection = g_new0(lock_window_inspection, 1);
+    inspection->window = window;
+    inspection->file = file;
+    inspection->description = (summary != NULL) ?
+        lock_window_inspect_describe(summary, keys) : NULL;
+
+    /* Cleanup */
+    if (keys != NULL)
+        g_ptr_array_unref(keys);
+    keys = NULL;
+
+    openpgp_summary_free(summary);
+    summary = NULL;
+
+    /* UI */
+    g_idle_add((GSourceFunc) lock_window_inspect_file_on_completed, inspection);
+
+    g_thread_exit(0);
+}
+
+/**** Processing ****/
+
+/**
+ * This function decides which operation the input of a LockWindow needs.
+ *
+ * All files of a batch need to route to the same operation on themselves, since a batch runs a single operation.
+ *
+ * @param window Window holding the input
+ * @param input Set to the file to process, NULL for batches and folders. Owned by caller
+ * @param signature Set to the detached signature to verify input against or NULL. Owned by caller
+ *
+ * @return Operation or 0 if there is nothing to do
+ */
+static cryptography_flags lock_window_process_route(LockWindow *window,
+                                                    GFile **input,
+                                                    GFile **signature)
+{
+    *input = NULL;
+    *signature = NULL;
+
+    if (window->file_input_directory != NULL)
+        return ENCRYPT;
+
+    if (window->file_input != NULL)
+        return inspect_route(window->file_input, input, signature);
+
+    if (window->file_jobs == NULL)
+        return 0;
+
+    cryptography_flags route = 0;
+    for (guint i = 0; i < window->file_jobs->len; i++) {
+        batch_job *job = g_ptr_array_index(window->file_jobs, i);
+        GFile *job_input = NULL;
+        GFile *job_signature = NULL;
+
+        cryptography_flags flags =
+            inspect_route(job->input, &job_input, &job_signature);
+        bool mixed = (i > 0 && flags != route) || job_signature != NULL
+            || !g_file_equal(job_input, job->input);
+        route = flags;
+
+        g_object_unref(job_input);
+        job_input = NULL;
+
+        g_clear_object(&job_signature);
+
+        if (mixed)
+            return 0;
+    }
+
+    return route;
+}
+
+/**
+ * This function hands the routed processing of the input file of a LockWindow over to the UI and is supposed to be called via g_idle_add().
+ *
+ * Encryption asks for the recipient first, anything else has nothing to do.
+ *
+ * @param window https://docs.gtk.org/glib/callback.SourceFunc.html
+ *
+ * @return https://docs.gtk.org/glib/func.idle_add.html
+ */
+static gboolean lock_window_process_file_on_routed(LockWindow *window)
+{
+    if (window->file_route == ENCRYPT) {
+        lock_window_encrypt_file_dialog(NULL, window);
+    } else {
+        AdwToast *toast =
+            adw_toast_new(window->file_jobs != NULL ?
+                          _("The files need different operations") :
+                          _("Nothing to decrypt, verify or encrypt"));
+
+        adw_toast_set_timeout(toast, 3);
+        adw_toast_overlay_add_toast(window->toast_overlay, toast);
+    }
+
+    /* Only execute once */
+    return false;               // https://docs.gtk.org/glib/func.idle_add.html
+}
+
+/**
+ * This function processes the input of a LockWindow again once an output was chosen in the save dialog.
+ *
+ * @param object https://docs.gtk.org/gio/callback.AsyncReadyCallback.html
+ * @param result https://docs.gtk.org/gio/callback.AsyncReadyCallback.html
+ * @param user_data https://docs.gtk.org/gio/callback.AsyncReadyCallback.html
+ */
+static void lock_window_process_file_on_saved(GObject *source_object,
+                                              GAsyncResult *res, gpointer data)
+{
+    LockWindow *window = LOCK_WINDOW(data);
+
+    lock_window_file_save(source_object, res, data);
+
+    if (window->file_output != NULL)
+        thread_process_file(NULL, window);
+}
+
+/**
+ * This function asks for the output of a LockWindow whose derived output already exists and is supposed to be called via g_idle_add().
+ *
+ * The save dialog proposes the derived output and confirms replacing it.
+ *
+ * @param window https://docs.gtk.org/glib/callback.SourceFunc.html
+ *
+ * @return https://docs.gtk.org/glib/func.idle_add.html
+ */
+static gboolean lock_window_process_file_on_exists(LockWindow *window)
+{
+    GtkFileDialog *dialog = gtk_file_dialog_new();
+    GCancellable *cancel = g_cancellable_new();
+
+    gtk_file_dialog_set_initial_file(dialog, window->file_existing);
+    gtk_file_dialog_save(dialog, GTK_WINDOW(window), cancel,
+                         lock_window_process_file_on_saved, window);
+
+    g_clear_object(&window->file_existing);
+
+    /* Only execute once */
+    return false;               // https://docs.gtk.org/glib/func.idle_add.html
+}
+
+/**
+ * This function processes the input of a LockWindow with the operation its leading packets call for.
+ *
+ * Outputs of single files default to the name of the input with the suffix of the operation removed. If that file
+ * exists, the save dialog asks for the output instead of replacing it.
+ *
+ * @param window https://docs.gtk.org/glib/callback.ThreadFunc.html
+ */
+void lock_window_process_file(LockWindow *window)
+{
+    GFile *input = NULL;
+    GFile *signature = NULL;
+
+    window->file_route = lock_window_process_route(window, &input, &signature);
+
+    if (window->file_route == 0 || window->file_route == ENCRYPT) {
+        g_idle_add((GSourceFunc) lock_window_process_file_on_routed, window);
+        goto cleanup;
+    }
+
+    cryptography_options_clear(&window->file_options);
+    window->file_options = lock_window_get_options(window);
+
+    if (lock_window_file_batch(window, window->file_route, NULL,
+                               &window->file_options))
+        goto cleanup;
+
+    g_clear_object(&window->file_signature);
+    window->file_signature = signature;
+    signature = NULL;
+    window->file_options.signature = window->file_signature;
+
+    if (window->file_route & DECRYPT
+        && window->file_output_directory != NULL) {
+        window->file_success =
+            process_directory(input, window->file_output_directory, DECRYPT,
+                              NULL, &window->file_options);
+    } else {
+        /* A detached signature leaves nothing to write */
+        GFile *output = (window->file_signature != NULL) ? NULL :
+            (window->file_output != NULL) ? g_object_ref(window->file_output) :
+            batch_output_file(input, NULL, window->file_route);
+
+        if (output != NULL && window->file_output == NULL
+            && g_file_query_exists(output, NULL)) {
+            window->file_options.signature = NULL;
+
+            g_clear_object(&window->file_existing);
+            window->file_existing = output;
+
+            g_idle_add((GSourceFunc) lock_window_process_file_on_exists,
+                       window);
+            goto cleanup;
+        }
+
+        window->file_success =
+            process_file(input, output, window->file_route, NULL,
+                         &window->file_options);
+
+        g_clear_object(&output);
+    }
+
+    window->file_options.signature = NULL;
+
+    /* UI */
+    if (window->file_route & DECRYPT)
+        g_idle_add((GSourceFunc) lock_window_decrypt_file_on_completed,
+                   window);
+    else
+        g_idle_add((GSourceFunc) lock_window_verify_file_on_completed, window);
+
+ cleanup:
+    g_clear_object(&input);
+    g_clear_object(&signature);
+
+    g_thread_exit(0);
+}
+
+/**** Preview ****/
+
+/**
+ * This function formats the plaintext of a preview for display.
+ *
+ * Binary plaintext is shown as a hexadecimal dump of its first kilobyte.
+ *
+ * @param preview Start of the plaintext
+ *
+ * @return Text to display. Owned by caller
+ */
+static gchar *lock_window_preview_format(GBytes *preview)
+{
+    gsize length;
+    const guint8 *data = g_bytes_get_data(preview, &length);
+
+    if (memchr(data, '\0', length) == NULL)
+        return g_utf8_make_valid((const gchar *)data, length);
+
+    GString *dump = g_string_new(NULL);
+    for (gsize offset = 0; offset < MIN(length, 1024); offset += 16) {
+        g_string_append_printf(dump, "%08" G_GSIZE_MODIFIER "x ", offset);
+
+        for (gsize i = offset; i < MIN(offset + 16, length); i++)
+            g_string_append_printf(dump, " %02x", data[i]);
+
+        g_string_append_c(dump, '\n');
+    }
+
+    return g_string_free(dump, false);
+}
+
+/**
+ * This function decrypts the start of the input file of a LockWindow for a preview.
+ *
+ * @param window https://docs.gtk.org/glib/callback.ThreadFunc.html
+ */
+void lock_window_preview_file(LockWindow *window)
+{
+    cryptography_options options = lock_window_get_options(window);
+
+    g_clear_pointer(&window->file_preview, g_bytes_unref);
+    if (window->file_input != NULL)
+        window->file_preview =
+            preview_file(window->file_input, PREVIEW_SIZE, &options);
+
+    cryptography_options_clear(&options);
+
+    /* UI */
+    g_idle_add((GSourceFunc) lock_window_preview_file_on_completed, window);
+
+    g_thread_exit(0);
+}
+
+/**
+ * This function shows the preview of the input file of a LockWindow and is supposed to be called via g_idle_add().
+ *
+ * @param window https://docs.gtk.org/glib/callback.SourceFunc.html
+ *
+ * @return https://docs.gtk.org/glib/func.idle_add.html
+ */
+gboolean lock_window_preview_file_on_completed(LockWindow *window)
+{
+    if (window->file_preview == NULL) {
+        AdwToast *toast = adw_toast_new(_("Preview failed"));
+
+        adw_toast_set_timeout(toast, 3);
+        adw_toast_overlay_add_toast(window->toast_overlay, toast);
+
+        /* Only execute once */
+        return false;           // https://docs.gtk.org/glib/func.idle_add.html
+    }
+
+    gchar *name = g_file_get_basename(window->file_input);
+    gchar *text = lock_window_preview_format(window->file_preview);
+
+    /* The plaintext is not kept around */
+    g_clear_pointer(&window->file_preview, g_bytes_unref);
+
+    GtkTextView *view = GTK_TEXT_VIEW(gtk_text_view_new());
+    gtk_text_view_set_editable(view, false);
+    gtk_text_view_set_monospace(view, true);
+    gtk_text_view_set_wrap_mode(view, GTK_WRAP_WORD_CHAR);
+    gtk_text_buffer_set_text(gtk_text_view_get_buffer(view), text, -1);
+
+    GtkScrolledWindow *scroll =
+        GTK_SCROLLED_WINDOW(gtk_scrolled_window_new());
+    gtk_scrolled_window_set_min_content_height(scroll, 300);
+    gtk_scrolled_window_set_child(scroll, GTK_WIDGET(view));
+
+    const char *body =
+        _("Start of the decrypted file, not checked for tampering yet");
+    AdwAlertDialog *dialog = ADW_ALERT_DIALOG(adw_alert_dialog_new(name, body));
+    adw_alert_dialog_set_extra_child(dialog, GTK_WIDGET(scroll));
+    adw_alert_dialog_add_responses(dialog, "close", _("_Close"), NULL);
+
+    adw_dialog_present(ADW_DIALOG(dialog), GTK_WIDGET(window));
+
+    /* Cleanup */
+    g_free(text);
+    text = NULL;
+
+    g_free(name);
+    name = NULL;
+
+    /* Only execute once */
+    return false;               // https://docs.gtk.org/glib/func.idle_add.html
+}
@@ -10,7 +10,7 @@ G_DECLARE_FINAL_TYPE(LockWindow, lock_window, LOCK, WINDOW,
                      AdwApplicationWindow);
 
 LockWindow *lock_window_new(LockApplication * app);
-void lock_window_open(LockWindow * window, GFile * file);
+void lock_window_open(LockWindow * window, GFile ** files, int n_files);
 
 /* Cryptography */
 
@@ -31,4 +31,9 @@ void lock_window_sign_file(LockWindow * window);
 void lock_window_verify_text(LockWindow * window);
 void lock_window_verify_file(LockWindow * window);
 
+// Inspection
+void lock_window_inspect_file(LockWindow * window);
+void lock_window_process_file(LockWindow * window);
+void lock_window_preview_file(LockWindow * window);
+
 #endif                          // WINDOW_H